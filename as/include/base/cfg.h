@@ -126,7 +126,9 @@ typedef struct as_config_s {
 	int					n_service_threads;
 	int					n_fabric_workers;
 	bool				use_queue_per_device;
+	bool				transaction_queue_stealing;
 	bool				allow_inline_transactions;
+	bool				pin_service_threads; // pin each service thread to its own CPU
 
 	/* max client file descriptors */
 	int					n_proto_fd_max;
@@ -190,6 +192,8 @@ typedef struct as_config_s {
 
 	/* object lock structure */
 	olock				*record_locks;
+	uint32_t			n_record_locks; // power of 2
+	olock_type			record_lock_type;
 
 	/* global configuration for how often to print 'ticker' info to the log - 0 is no ticker */
 	uint32_t			ticker_interval;
@@ -275,6 +279,10 @@ typedef struct as_config_s {
 	cf_atomic_int		migrate_num_incoming;
 	// For debouncing re-tansmitted migrate start messages:
 	int					migrate_rx_lifetime_ms;
+	// For sender-side migration bandwidth scheduling - 0 means no limit:
+	uint64_t			migrate_node_max_bytes_per_sec;
+	// Back off migration when client p99 latency reaches this - 0 means never:
+	uint32_t			migrate_latency_target_ms;
 
 	// Temporary dangling prole garbage collection.
 	uint32_t			prole_extra_ttl;	// seconds beyond expiry time after which we garbage collect, 0 for no garbage collection
@@ -463,6 +471,7 @@ typedef struct as_config_s {
 	histogram *			write_storage_close_hist; // histogram of time spent around record_storage close on a write path
 	histogram *			write_sindex_hist; // secondary index latency histogram
 	histogram *			prole_fabric_send_hist; // histogram of time spent for prole fabric getting queued
+	histogram *			record_lock_wait_hist; // histogram of time spent waiting for a contended record lock
 
 #ifdef HISTOGRAM_OBJECT_LATENCY
 	// these track read latencies of different size databuckets
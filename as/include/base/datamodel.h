@@ -42,10 +42,12 @@
 #include "arenax.h"
 #include "dynbuf.h"
 #include "hist.h"
+#include "ioring.h"
 #include "linear_hist.h"
 #include "util.h"
 #include "vmapx.h"
 
+#include "base/packet_compression.h"
 #include "base/proto.h"
 #include "base/rec_props.h"
 #include "base/transaction_policy.h"
@@ -264,6 +266,7 @@ extern int32_t as_bin_particle_stack_from_pickled(as_bin *b, uint8_t* stack, uin
 extern int as_bin_particle_compare_from_pickled(const as_bin *b, uint8_t **p_pickled);
 extern uint32_t as_bin_particle_client_value_size(const as_bin *b);
 extern uint32_t as_bin_particle_to_client(const as_bin *b, as_msg_op *op);
+extern uint32_t as_bin_particle_wire_ptr(const as_bin *b, const uint8_t **p_value);
 extern uint32_t as_bin_particle_pickled_size(const as_bin *b);
 extern uint32_t as_bin_particle_to_pickled(const as_bin *b, uint8_t *pickled);
 
@@ -300,6 +303,9 @@ extern int64_t as_bin_particle_integer_value(const as_bin *b);
 // string:
 extern uint32_t as_bin_particle_string_ptr(const as_bin *b, char **p_value);
 
+// blob (and particles with the same in-memory format):
+extern uint32_t as_bin_particle_blob_ptr(const as_bin *b, const uint8_t **p_value);
+
 // geojson:
 typedef void * geo_region_t;
 #define MAX_REGION_CELLS    32
@@ -542,6 +548,11 @@ typedef enum {
 	AS_NAMESPACE_CONFLICT_RESOLUTION_POLICY_LAST_UPDATE_TIME = 2
 } conflict_resolution_pol;
 
+typedef enum {
+	AS_INDEX_ENGINE_RBTREE = 0,	// red-black tree threaded through as_index
+	AS_INDEX_ENGINE_BTREE = 1	// B+tree of handles - see index_btree.h
+} as_index_engine;
+
 /* Record function declarations */
 // special - get_create returns 1 if created, 0 if just gotten, -1 if fail
 extern int as_record_get_create(struct as_index_tree_s *tree, cf_digest *keyd, as_index_ref *r_ref, as_namespace *ns, bool);
@@ -578,7 +589,7 @@ extern int as_record_set_set_from_msg(as_record *r, as_namespace *ns, as_msg *m)
 #define AS_COMPONENT_FLAG_LDT_ESR         0x08
 #define AS_COMPONENT_FLAG_MIG             0x10
 #define AS_COMPONENT_FLAG_DUP             0x20
-#define AS_COMPONENT_FLAG_UNUSED3         0x40
+#define AS_COMPONENT_FLAG_REPAIR          0x40
 #define AS_COMPONENT_FLAG_UNUSED4         0x80
 
 #define COMPONENT_IS_MIG(c) \
@@ -587,6 +598,11 @@ extern int as_record_set_set_from_msg(as_record *r, as_namespace *ns, as_msg *m)
 #define COMPONENT_IS_DUP(c) \
 	((c)->flag & AS_COMPONENT_FLAG_DUP)
 
+// Set in components fetched to replace a corrupt local copy - the local copy
+// must not win.
+#define COMPONENT_IS_REPAIR(c) \
+	((c)->flag & AS_COMPONENT_FLAG_REPAIR)
+
 #define COMPONENT_IS_LDT_PARENT(c) \
 	((c)->flag & AS_COMPONENT_FLAG_LDT_REC)
 
@@ -720,6 +736,10 @@ struct as_partition_s {
 	// Track ldt version in transit currently
 	uint64_t current_outgoing_ldt_version;
 	uint64_t current_incoming_ldt_version;
+
+	// Throughput of the last completed emigration of this partition.
+	uint64_t emig_records_per_sec;
+	uint64_t emig_bytes_per_sec;
 };
 
 #define AS_PARTITION_HAS_DATA(p)  ((p)->vp->elements || (p)->sub_vp->elements)
@@ -812,6 +832,10 @@ extern void as_partition_reservation_move(as_partition_reservation *dst, as_part
 extern void as_partition_reservation_copy(as_partition_reservation *dst, as_partition_reservation *src);
 extern void as_partition_release(as_partition_reservation *rsv);
 
+// reserve just the tree, e.g. for prefetching -
+extern struct as_index_tree_s *as_partition_reserve_tree(as_namespace *ns, as_partition_id pid);
+extern void as_partition_release_tree(as_namespace *ns, as_partition_id pid, struct as_index_tree_s *tree);
+
 extern int as_partition_tree_release(struct as_index_tree_s *p);
 
 extern void as_partition_getreplica_read_str(cf_dyn_buf *db);
@@ -982,9 +1006,19 @@ struct as_namespace_s {
 	as_treex* tree_roots;
 	as_treex* sub_tree_roots;
 
+	// Number of sprigs (sub-trees) each partition's tree is split into, and
+	// the structure of each sprig.
+	uint32_t partition_tree_sprigs;
+	as_index_engine index_engine;
+
 	// Pointer to arena structure (not stages) in persistent memory base block.
 	cf_arenax* arena;
 
+	// Arena stage placement - CF_ARENAX_HUGE_PAGES_... and CF_ARENAX_NUMA_...
+	// flags, or 0.
+	uint32_t index_huge_pages;
+	uint32_t index_numa_policy;
+
 #ifdef USE_JEM
 	// JEMalloc arena to be used for long-term storage in this namespace (-1 if nonexistent.)
 	int jem_arena;
@@ -1044,13 +1078,25 @@ struct as_namespace_s {
 	bool		storage_cold_start_empty;
 	bool		storage_disable_odirect;
 	bool		storage_enable_osync;
+	bool		storage_enable_checksum;
+	bool		storage_load_older_on_checksum_error;
 	uint32_t	storage_defrag_lwm_pct;
 	uint32_t	storage_defrag_queue_min;
 	uint32_t	storage_defrag_sleep;
+	bool		storage_defrag_adaptive;
+	uint32_t	storage_cold_stream_ttl;
+	bool		storage_write_hints;
+	uint32_t	storage_scrub_sleep;
 	int			storage_defrag_startup_minimum;
 	uint64_t	storage_flush_max_us;
 	uint64_t	storage_fsync_max_us;
 	uint32_t	storage_min_avail_pct;
+	cf_ioring_type storage_io_engine;
+	uint32_t	storage_io_depth;
+	uint32_t	storage_io_threads;
+	uint32_t	storage_cold_start_threads;
+	char		*storage_index_snapshot_file;
+	uint64_t	index_snapshot_generation;
 
 	// For data-not-in-memory, optionally cache swbs after writing to device.
 	cf_atomic32 storage_post_write_queue; // number of swbs/device held after writing to device
@@ -1059,6 +1105,41 @@ struct as_namespace_s {
 	cf_atomic32 n_reads_from_device;
 	float cache_read_pct;
 
+	// For data-not-in-memory, optional read-through cache of record blocks.
+	uint64_t	storage_read_cache_size; // max bytes held (0 = no cache)
+	cf_atomic64	n_read_cache_hits;
+	cf_atomic64	n_read_cache_misses;
+	cf_atomic64	n_read_cache_evictions;
+	cf_atomic64	read_cache_bytes;
+
+	// For data-not-in-memory, optional tier of hot records held in memory.
+	uint64_t	storage_hot_tier_size; // max bytes held (0 = no hot tier)
+	cf_atomic64	n_hot_tier_hits;
+	cf_atomic64	n_hot_tier_misses;
+	cf_atomic64	n_hot_tier_promotions;
+	cf_atomic64	n_hot_tier_demotions;
+	cf_atomic64	hot_tier_bytes;
+
+	// Records found with bad checksums - on read, defrag, cold start or scrub.
+	cf_atomic64	n_storage_checksum_errors;
+	cf_atomic64	n_storage_checksum_repairs; // corrupt copies replaced from replicas
+
+	// Defrag write amplification - bytes moved per byte reclaimed.
+	cf_atomic64	defrag_bytes_moved;		// record bytes rewritten by defrag
+	cf_atomic64	defrag_bytes_reclaimed;	// net bytes freed by defrag
+
+	// Optional compression of records' data on device.
+	compression_type storage_compression;
+	uint32_t	storage_compression_level; // 0 = type's default
+	uint32_t	storage_compression_threshold; // don't compress smaller records
+	cf_atomic64	compression_orig_bytes; // rounded sizes, had they not been compressed
+	cf_atomic64	compression_stored_bytes; // rounded sizes actually written
+	cf_atomic64	n_compressions;
+	cf_atomic64	n_compression_fails; // didn't fit or errored - stored uncompressed
+	cf_atomic64	compression_ns;
+	cf_atomic64	n_decompressions;
+	cf_atomic64	decompression_ns;
+
 	void *storage_private;
 
 	// TODO - could use n_devices in general, if we set it during config parse.
@@ -1105,10 +1186,18 @@ struct as_namespace_s {
 	cf_atomic_int	migrate_rx_partitions_remaining;
 
 	// migration per-record stats
-	cf_atomic_int	migrate_records_skipped; // relevant only for enterprise edition
+	cf_atomic_int	migrate_records_skipped; // by delta migration
 	cf_atomic_int	migrate_records_transmitted;
 	cf_atomic_int	migrate_record_retransmits;
 	cf_atomic_int	migrate_record_receives;
+	cf_atomic_int	migrate_record_batches_transmitted;
+	cf_atomic_int	migrate_record_batch_receives;
+	cf_atomic_int	migrate_tx_bytes;
+
+	// migration progress - refreshed every second by the migrate scheduler
+	uint64_t		migrate_tx_bytes_per_sec;
+	uint64_t		migrate_tx_records_per_sec;
+	uint64_t		migrate_tx_eta_sec; // 0 if done or not yet known
 
 	// the maximum void time of all records in the namespace
 	cf_atomic_int max_void_time;
@@ -1284,9 +1373,25 @@ int as_namespace_get_jem_arena(char *ns);
 
 struct as_treex_s {
 	cf_arenax_handle sentinel_h;
-	cf_arenax_handle root_h;
+	cf_arenax_handle root_h[]; // one per sprig
 };
 
+// Partitions' as_treex entries are laid out back to back, each sized for the
+// namespace's number of sprigs.
+static inline size_t
+as_treex_size(uint32_t n_sprigs)
+{
+	return sizeof(as_treex) + (n_sprigs * sizeof(cf_arenax_handle));
+}
+
+static inline as_treex*
+as_treex_get(as_treex* roots, uint32_t n_sprigs, uint32_t pid)
+{
+	return roots ?
+			(as_treex*)((uint8_t*)roots + (pid * as_treex_size(n_sprigs))) :
+			NULL;
+}
+
 void as_namespace_xmem_trusted(as_namespace *ns);
 void as_namespace_xmem_release(as_namespace* ns);
 
@@ -33,6 +33,7 @@
 #include "arenax.h"
 
 #include "base/datamodel.h"
+#include "base/index_btree.h"
 
 
 //==========================================================
@@ -283,22 +284,47 @@ typedef void (*as_index_value_destructor) (as_index *v, void *udata);
 // Index tree.
 //
 
-typedef struct as_index_tree_s {
+// Limits on the number of sprigs a tree is split into. Each sprig costs about
+// 180 bytes (with its red-black root element), per tree - at the max that's
+// ~180MB per namespace for main trees, and as much again for LDT sub-trees.
+#define MIN_PARTITION_TREE_SPRIGS 1
+#define MAX_PARTITION_TREE_SPRIGS 256
+
+// A tree is split into a power-of-two number of red-black sub-trees, "sprigs",
+// selected by digest bits. Each has its own root and locks, so lookups are
+// shallower, and inserts, deletes and reduces of different sprigs don't block
+// each other.
+typedef struct as_index_sprig_s {
 	// Note: reduce_lock's scope is always inside of lock's scope.
 	pthread_mutex_t		lock;        // insert, delete vs. insert, delete, get
 	pthread_mutex_t		reduce_lock; // insert, delete vs. reduce
 
-	as_index			*root;
-	cf_arenax_handle	root_h;
+	as_index			*root;		// index-engine rbtree only
+	cf_arenax_handle	root_h;		// index-engine rbtree only
+
+	as_btree			btree;		// index-engine btree only
+
+	uint32_t			elements; // changed under lock
+
+	// Bumped (under lock) before and after every insert or delete, so it's odd
+	// while the sprig is being restructured. Lets get and exists search
+	// without taking lock - see as_index_search_optimistic().
+	uint32_t			version;
+} as_index_sprig;
 
-	cf_arenax_handle	sentinel_h;
+typedef struct as_index_tree_s {
+	cf_arenax_handle	sentinel_h; // shared by all sprigs
 
 	as_index_value_destructor destructor;
 	void				*destructor_udata;
 
 	cf_arenax			*arena; // where we allocate and free to
 
-	uint32_t			elements; // not making this atomic, it's not very exact
+	cf_atomic32			elements; // sum over sprigs
+
+	as_index_engine		engine;
+	uint32_t			n_sprigs;
+	as_index_sprig		sprigs[];
 } as_index_tree;
 
 
@@ -306,8 +332,8 @@ typedef struct as_index_tree_s {
 // as_index_tree public API.
 //
 
-extern as_index_tree *as_index_tree_create(cf_arenax *arena, as_index_value_destructor destructor, void *destructor_udata, as_treex *p_treex);
-extern as_index_tree *as_index_tree_resume(cf_arenax *arena, as_index_value_destructor destructor, void *destructor_udata, as_treex *p_treex);
+extern as_index_tree *as_index_tree_create(cf_arenax *arena, as_index_value_destructor destructor, void *destructor_udata, as_index_engine engine, uint32_t n_sprigs, as_treex *p_treex);
+extern as_index_tree *as_index_tree_resume(cf_arenax *arena, as_index_value_destructor destructor, void *destructor_udata, as_index_engine engine, uint32_t n_sprigs, as_treex *p_treex);
 extern int as_index_tree_release(as_index_tree *tree, void *destructor_udata);
 extern uint32_t as_index_tree_size(as_index_tree *tree);
 
@@ -323,6 +349,12 @@ extern int as_index_get_vlock(as_index_tree *tree, cf_digest *keyd, as_index_ref
 extern int as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd, as_index_ref *index_ref);
 extern int as_index_delete(as_index_tree *tree, cf_digest *keyd);
 
+// Callers prefetching for several lookups should pass groups of about this many
+// digests to as_index_prefetch_multi().
+#define AS_INDEX_PREFETCH_GROUP 16
+
+extern void as_index_prefetch_multi(as_index_tree **trees, cf_digest *keyds, uint32_t n);
+
 #define as_index_reserve(_r) cf_atomic32_incr(&(_r->rc))
 #define as_index_release(_r) cf_atomic32_decr(&(_r->rc))
 
@@ -0,0 +1,89 @@
+/*
+ * index_btree.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * B+tree of as_index handles, ordered by digest - the alternative to a sprig's
+ * red-black tree when a namespace is configured with index-engine btree.
+ *
+ * Nodes are wide and heap allocated, and hold 8-byte digest prefixes alongside
+ * the handles, so a search touches a few cache lines per level and only
+ * resolves an as_index on the way down when prefixes tie. The as_index
+ * elements themselves stay in the arena, and their left_h/right_h go unused.
+ *
+ * Not thread safe - callers serialize access with the sprig locks, so unlike
+ * red-black sprigs, every lookup takes the sprig lock, and batch lookups aren't
+ * prefetched. Nodes aren't in the arena, so a btree namespace can't use an
+ * index snapshot (fast restart) - config parsing refuses the combination.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "citrusleaf/cf_digest.h"
+
+#include "arenax.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+typedef struct as_btree_node_s as_btree_node;
+
+typedef struct as_btree_s {
+	as_btree_node	*root; // NULL when empty
+} as_btree;
+
+// Return false to stop the reduce.
+typedef bool (*as_btree_reduce_fn) (cf_arenax_handle h, void *udata);
+
+
+//==========================================================
+// Public API.
+//
+
+void as_btree_init(as_btree *bt);
+void as_btree_destroy(as_btree *bt);
+
+// Returns 0 and the handle if found, -1 if not found.
+int as_btree_search(as_btree *bt, cf_arenax *arena, const cf_digest *keyd,
+		cf_arenax_handle *ret_h);
+
+// Element h must already hold its digest, and must not already be in the tree.
+void as_btree_insert(as_btree *bt, cf_arenax *arena, cf_arenax_handle h);
+
+// Returns 0 and the removed handle if found, -1 if not found.
+int as_btree_delete(as_btree *bt, cf_arenax *arena, const cf_digest *keyd,
+		cf_arenax_handle *ret_h);
+
+// Heap bytes used by the nodes, not counting the elements - walks the tree.
+uint64_t as_btree_size(const as_btree *bt);
+
+// Visit elements in digest order.
+void as_btree_reduce(as_btree *bt, as_btree_reduce_fn cb, void *udata);
+
+// Visit elements in digest order, starting after the given digest, which need
+// not be in the tree.
+void as_btree_reduce_from(as_btree *bt, cf_arenax *arena, const cf_digest *keyd,
+		as_btree_reduce_fn cb, void *udata);
@@ -22,10 +22,15 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
+// Values are persisted in storage - don't renumber.
 typedef enum compression_type_e {
-	COMPRESSION_ZLIB = 1
+	COMPRESSION_NONE = 0,
+	COMPRESSION_ZLIB = 1,
+	COMPRESSION_LZ4 = 2,	// only if built with USE_LZ4
+	COMPRESSION_ZSTD = 3	// only if built with USE_ZSTD
 } compression_type;
 
 /**
@@ -79,3 +84,28 @@ as_compress(int argc, uint8_t *argv[]);
  */
 int
 as_packet_compression(uint8_t *buf, size_t buf_sz, uint8_t **compressed_packet, size_t *compressed_packet_sz);
+
+/**
+ * Function to compress a buffer into a caller-supplied buffer
+ * @param type			Type of compression
+ * @param level			Compression level - 0 for the type's default
+ * @param buf_len		Length of buffer to be compressed
+ * @param buf			Pointer to buffer to be compressed
+ * @param out_buf_len	In: size of out_buf - Out: length of compressed data
+ * @param out_buf		Pointer to buffer to hold compressed data
+ * @return 0 if successful, non-zero if the compressed data won't fit
+ */
+int
+as_compress_buf(compression_type type, int level, size_t buf_len, const uint8_t *buf, size_t *out_buf_len, uint8_t *out_buf);
+
+/*
+ * Function to get the highest level a compression type accepts - 0 if none
+ */
+uint32_t
+as_compression_max_level(compression_type type);
+
+/*
+ * Function to get the config name of a compression type
+ */
+const char *
+as_compression_type_str(compression_type type);
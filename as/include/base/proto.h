@@ -507,6 +507,9 @@ extern int as_msg_send_reply(struct as_file_handle_s *fd_h, uint32_t result_code
 		uint *written_sz, uint64_t trid, const char *setname);
 extern int as_msg_send_ops_reply(struct as_file_handle_s *fd_h, cf_dyn_buf *db);
 
+extern size_t as_msg_response_msg_size(as_msg_op **ops, struct as_bin_s **bins,
+		uint16_t bin_count, struct as_namespace_s *ns, uint64_t trid,
+		const char *setname);
 extern cl_msg *as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
 		uint32_t void_time, as_msg_op **ops, struct as_bin_s **bins,
 		uint16_t bin_count, struct as_namespace_s *ns, cl_msg *msgp_in,
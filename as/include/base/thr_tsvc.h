@@ -74,6 +74,7 @@ void process_transaction(as_transaction *tr);
 
 // Statistics function for monitoring server load.
 extern int thr_tsvc_queue_get_size();
+extern void thr_tsvc_queue_get_steal_stats(uint32_t *max_depth, uint64_t *n_stolen);
 
 // Initialize the queues and start the handler threads.
 extern void as_tsvc_init();
@@ -35,6 +35,7 @@
 extern void as_write_init();
 extern int as_write_start(as_transaction *t);
 extern int as_read_start(as_transaction *t);
+extern void as_write_queue_repair(as_namespace *ns, cf_digest *keyd);
 extern int as_write_journal_apply(as_partition_reservation *prsv);
 extern int as_write_journal_start(as_namespace *ns, as_partition_id pid);
 
@@ -224,6 +224,7 @@ typedef struct as_transaction_s {
 #define FROM_FLAG_NSUP_DELETE	0x0001
 #define FROM_FLAG_BATCH_SUB		0x0002
 #define FROM_FLAG_SHIPPED_OP	0x0004
+#define FROM_FLAG_SCRUB_REPAIR	0x0008 // FROM_NSUP - replace corrupt local copy
 
 // 'flags' bits - set in transaction body after queuing:
 #define AS_TRANSACTION_FLAG_SINDEX_TOUCHED	0x0001
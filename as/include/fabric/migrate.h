@@ -108,6 +108,7 @@ void as_migrate_emigrate(const partition_migrate_record *pmr);
 bool as_migrate_is_incoming(cf_digest *subrec_digest, uint64_t version, as_partition_id partition_id, int state);
 void as_migrate_set_num_xmit_threads(int n_threads);
 void as_migrate_dump(bool verbose);
+uint32_t as_migrate_get_rate_pct();
 
 as_migrate_result as_partition_immigrate_start(as_namespace *ns, as_partition_id pid, uint64_t orig_cluster_key, uint32_t start_type, cf_node source_node);
 as_migrate_result as_partition_immigrate_done(as_namespace *ns, as_partition_id pid, uint64_t orig_cluster_key, cf_node source_node);
@@ -145,6 +146,8 @@ typedef enum {
 	MIG_FIELD_META_RECORDS,
 	MIG_FIELD_META_SEQUENCE,
 	MIG_FIELD_META_SEQUENCE_FINAL,
+	MIG_FIELD_BATCH_RECORDS,
+	MIG_FIELD_BATCH_N_RECORDS,
 
 	NUM_MIG_FIELDS
 } migrate_msg_fields;
@@ -162,8 +165,11 @@ typedef enum {
 #define OPERATION_CANCEL 10 // deprecated
 #define OPERATION_MERGE_META 11
 #define OPERATION_MERGE_META_ACK 12
+#define OPERATION_INSERT_BATCH 13
+#define OPERATION_INSERT_BATCH_ACK 14
 
 #define MIG_FEATURE_MERGE 0x00000001
+#define MIG_FEATURE_BATCH 0x00000002
 #define MIG_FEATURES_SEEN 0x80000000 // needed for backward compatibility
 extern const uint32_t MY_MIG_FEATURES;
 
@@ -185,6 +191,10 @@ typedef struct emig_meta_q_s {
 	cf_queue *batch_q;
 	cf_atomic32 last_acked;
 	bool is_done;
+
+	// Destination's records, sorted by digest once collected.
+	meta_record *records;
+	uint32_t n_records;
 } emig_meta_q;
 
 typedef struct emigration_s {
@@ -201,6 +211,19 @@ typedef struct emigration_s {
 	cf_queue    *ctrl_q;
 	emig_meta_q *meta_q;
 
+	// Multi-record batching - only touched by the emigrating thread, except
+	// use_batch which is set from the START ack.
+	bool        use_batch;
+	uint8_t     *batch_buf;
+	uint32_t    batch_sz;
+	uint32_t    batch_capacity;
+	uint32_t    batch_n_records;
+
+	// For throughput stats.
+	uint64_t    start_ms;
+	uint64_t    n_records_sent;
+	uint64_t    n_bytes_sent;
+
 	as_partition_reservation rsv;
 } emigration;
 
@@ -250,6 +273,7 @@ bool should_emigrate_record(emigration *emig, as_index_ref *r_ref);
 emig_meta_q *emig_meta_q_create();
 void emig_meta_q_destroy(emig_meta_q *emq);
 void emig_meta_q_push_batch(emig_meta_q *emq, const meta_batch *batch);
+void emig_meta_q_collect(emigration *emig);
 
 // Migrate fabric message handling.
 void emigration_handle_meta_batch_request(cf_node src, msg *m);
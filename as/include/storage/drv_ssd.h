@@ -33,10 +33,15 @@
 
 #include "citrusleaf/cf_atomic.h"
 #include "citrusleaf/cf_queue.h"
+#include "citrusleaf/cf_shash.h"
 
 #include "hist.h"
+#include "ioring.h"
 
 #include "base/datamodel.h"
+#include "storage/drv_ssd_cache.h"
+#include "storage/drv_ssd_defrag_q.h"
+#include "storage/drv_ssd_hot.h"
 
 
 //==========================================================
@@ -88,6 +93,7 @@ typedef struct {
 	cf_atomic32			rc;
 	cf_atomic32			n_writers;	// number of concurrent writers
 	bool				skip_post_write_q;
+	uint8_t				stream;		// ssd_stream_id of the stream filling it
 	struct drv_ssd_s	*ssd;
 	uint32_t			wblock_id;
 	uint32_t			pos;
@@ -95,6 +101,27 @@ typedef struct {
 } ssd_write_buf;
 
 
+//------------------------------------------------
+// Open write streams - records are grouped by
+// expected lifetime so a wblock's records tend to
+// expire (and the wblock empty out) together.
+//
+typedef enum {
+	SSD_STREAM_HOT,			// client writes expiring within cold-stream-ttl
+	SSD_STREAM_COLD,		// client writes living longer, or forever
+	SSD_STREAM_DEFRAG_HOT,	// defrag survivors expiring within cold-stream-ttl
+	SSD_STREAM_DEFRAG_COLD,	// defrag survivors living longer, or forever
+
+	SSD_N_STREAMS
+} ssd_stream_id;
+
+typedef struct ssd_write_stream_s {
+	pthread_mutex_t		lock;		// lock protects writes to swb
+	ssd_write_buf		*swb;		// swb currently being filled
+	cf_atomic_int		n_wblock_writes;	// swbs from this stream added to swb_write_q
+} ssd_write_stream;
+
+
 //------------------------------------------------
 // Per-wblock information.
 //
@@ -131,6 +158,18 @@ typedef enum {
 } e_free_to;
 
 
+//------------------------------------------------
+// Write lifetime hint last set on a device's (or
+// shadow's) inode. Hints are per inode, so the lock
+// is held from setting a hint until the write it's
+// for has completed.
+//
+typedef struct ssd_write_hint_s {
+	pthread_mutex_t	lock;
+	uint64_t		hint;
+} ssd_write_hint;
+
+
 //------------------------------------------------
 // Per-device information.
 //
@@ -143,17 +182,18 @@ typedef struct drv_ssd_s
 
 	uint32_t		running;
 
-	pthread_mutex_t	write_lock;			// lock protects writes to current swb
-	ssd_write_buf	*current_swb;		// swb currently being filled by writes
-
-	pthread_mutex_t	defrag_lock;		// lock protects writes to defrag swb
-	ssd_write_buf	*defrag_swb;		// swb currently being filled by defrag
+	ssd_write_stream streams[SSD_N_STREAMS];	// swbs currently being filled by writes & defrag
+	bool			write_hints;		// tag device writes with their stream's lifetime
+	ssd_write_hint	write_hint;			// current hint on device inode
+	ssd_write_hint	shadow_write_hint;	// current hint on shadow inode
 
 	cf_queue		*fd_q;				// queue of open fds
 	cf_queue		*shadow_fd_q;		// queue of open fds on shadow, if any
 
+	cf_ioring		*ioring;			// engine for defrag, cold start and write-queue I/O
+
 	cf_queue		*free_wblock_q;		// IDs of free wblocks
-	cf_queue		*defrag_wblock_q;	// IDs of wblocks to defrag
+	ssd_defrag_q	*defrag_wblock_q;	// IDs of wblocks to defrag, emptiest first
 
 	cf_queue		*swb_write_q;		// pointers to swbs ready to write
 	cf_queue		*swb_shadow_q;		// pointers to swbs ready to write to shadow, if any
@@ -163,6 +203,10 @@ typedef struct drv_ssd_s
 	cf_atomic_int	n_defrag_wblock_reads;	// total number of wblocks added to the defrag_wblock_q
 	cf_atomic_int	n_defrag_wblock_writes;	// total number of swbs added to the swb_write_q by defrag
 	cf_atomic_int	n_wblock_writes;		// total number of swbs added to the swb_write_q by writes
+	cf_atomic_int	n_coalesced_wblock_writes;	// total number of swbs written as part of a preceding wblock's write
+	cf_atomic_int	n_defrag_wblocks_freed;	// total number of wblocks freed by defrag
+
+	uint32_t		defrag_sleep;		// current defrag sleep, if adaptive
 
 	cf_atomic32		defrag_sweep;		// defrag sweep flag
 
@@ -184,13 +228,14 @@ typedef struct drv_ssd_s
 	bool			has_ldt;
 	bool			sub_sweep;
 
-	uint32_t		cold_start_block_counter;		// large blocks read
-	uint64_t		record_add_older_counter;		// records not inserted due to better existing one
-	uint64_t		record_add_expired_counter;		// records not inserted due to expiration
-	uint64_t		record_add_max_ttl_counter;		// records not inserted due to max-ttl
-	uint64_t		record_add_replace_counter;		// records reinserted
-	uint64_t		record_add_unique_counter;		// records inserted
-	uint64_t		record_add_sigfail_counter;
+	cf_atomic32		cold_start_block_counter;		// large blocks read
+	uint64_t		cold_start_start_ms;			// when the current sweep began
+	cf_atomic64		record_add_older_counter;		// records not inserted due to better existing one
+	cf_atomic64		record_add_expired_counter;		// records not inserted due to expiration
+	cf_atomic64		record_add_max_ttl_counter;		// records not inserted due to max-ttl
+	cf_atomic64		record_add_replace_counter;		// records reinserted
+	cf_atomic64		record_add_unique_counter;		// records inserted
+	cf_atomic64		record_add_sigfail_counter;
 
 	ssd_alloc_table	*alloc_table;
 
@@ -199,6 +244,7 @@ typedef struct drv_ssd_s
 	pthread_t		shadow_worker_thread;
 	pthread_t		load_device_thread;
 	pthread_t		defrag_thread;
+	pthread_t		scrub_thread;
 
 	histogram		*hist_read;
 	histogram		*hist_large_block_read;
@@ -220,6 +266,14 @@ typedef struct drv_ssds_s
 	// load a record.
 	bool get_state_from_storage[AS_PARTITIONS];
 
+	// Also used only at startup - digests of records that failed checksum,
+	// resolved once all devices are loaded.
+	pthread_mutex_t		checksum_fail_lock;
+	shash				*checksum_fail_hash;
+
+	ssd_read_cache		*read_cache;		// null if no read-cache-size
+	ssd_hot_tier		*hot_tier;			// null if no hot-tier-size
+
 	int					n_ssds;
 	drv_ssd				ssds[];
 } drv_ssds;
@@ -0,0 +1,58 @@
+/*
+ * drv_ssd_cache.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Read-through cache of record blocks for data-not-in-memory namespaces,
+ * keyed by device and rblock id.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "base/datamodel.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+typedef struct ssd_read_cache_s ssd_read_cache;
+
+
+//==========================================================
+// Public API.
+//
+
+ssd_read_cache* ssd_read_cache_create(as_namespace* ns, uint64_t max_size);
+
+// Returns a cf_malloc()'d copy of the cached block, or NULL on a miss.
+uint8_t* ssd_read_cache_get(ssd_read_cache* cache, uint32_t file_id,
+		uint64_t rblock_id, uint32_t size);
+
+void ssd_read_cache_put(ssd_read_cache* cache, uint32_t file_id,
+		uint64_t rblock_id, const uint8_t* data, uint32_t size);
+
+// Must be called before an rblock's space may be reused.
+void ssd_read_cache_remove(ssd_read_cache* cache, uint32_t file_id,
+		uint64_t rblock_id);
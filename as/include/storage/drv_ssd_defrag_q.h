@@ -0,0 +1,63 @@
+/*
+ * drv_ssd_defrag_q.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Queue of wblocks waiting to be defragged, ordered (in buckets) by how much
+ * of each wblock is still in use, so the cheapest wblocks to reclaim go first.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+typedef struct ssd_defrag_q_s ssd_defrag_q;
+
+
+//==========================================================
+// Public API.
+//
+
+ssd_defrag_q* ssd_defrag_q_create(uint32_t write_block_size,
+		uint32_t n_wblocks);
+
+void ssd_defrag_q_push(ssd_defrag_q* q, uint32_t wblock_id, uint32_t inuse_sz);
+
+// Goes ahead of other wblocks with similar in-use size.
+void ssd_defrag_q_push_head(ssd_defrag_q* q, uint32_t wblock_id,
+		uint32_t inuse_sz);
+
+// Moves a queued wblock to a lower bucket if its in-use size shrank across a
+// bucket boundary. No-op if the wblock isn't queued.
+void ssd_defrag_q_shrink(ssd_defrag_q* q, uint32_t wblock_id,
+		uint32_t old_inuse_sz, uint32_t new_inuse_sz);
+
+// Pops a wblock from the lowest occupied bucket. Waits up to ms_wait (< 0 is
+// forever) and returns false if nothing was queued in time.
+bool ssd_defrag_q_pop(ssd_defrag_q* q, uint32_t* p_wblock_id, int ms_wait);
+
+uint32_t ssd_defrag_q_sz(ssd_defrag_q* q);
@@ -0,0 +1,63 @@
+/*
+ * drv_ssd_hot.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Memory-bounded tier of hot records' images for data-not-in-memory
+ * namespaces, keyed by digest. The device stays the source of truth.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "citrusleaf/cf_digest.h"
+
+#include "base/datamodel.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+typedef struct ssd_hot_tier_s ssd_hot_tier;
+typedef struct ssd_hot_rec_s ssd_hot_rec;
+
+
+//==========================================================
+// Public API.
+//
+
+ssd_hot_tier* ssd_hot_tier_create(as_namespace* ns, uint64_t max_size);
+
+// On a hit, returns the image of the given version of the record, which stays
+// valid until the reservation in *p_rec is released.
+const uint8_t* ssd_hot_tier_get(ssd_hot_tier* tier, const cf_digest* keyd,
+		uint64_t version, ssd_hot_rec** p_rec);
+
+void ssd_hot_tier_release(ssd_hot_rec* rec);
+
+// Copies the image in, replacing any other version of the record.
+void ssd_hot_tier_promote(ssd_hot_tier* tier, const cf_digest* keyd,
+		uint64_t version, const uint8_t* data, uint32_t size);
+
+// Demotes records not read since the previous call.
+void ssd_hot_tier_demote(ssd_hot_tier* tier);
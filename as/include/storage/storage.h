@@ -114,6 +114,7 @@ typedef struct as_storage_rd_s {
 			uint8_t					*must_free_block;	// if not null, must free this pointer - may be different to block pointer
 														// if null, part of a bigger block that will be freed elsewhere
 			struct drv_ssd_s		*ssd;				// the particular ssd object we're using
+			struct ssd_hot_rec_s	*hot_rec;			// if not null, block is in the hot tier - must release this
 		} ssd;
 		struct {
 			struct drv_kv_block_s	*block;				// data that was read in at one point
@@ -160,6 +161,7 @@ extern void as_storage_wait_for_defrag();
 extern bool as_storage_overloaded(as_namespace *ns); // returns true if write queue is too backed up
 extern bool as_storage_has_space(as_namespace *ns);
 extern void as_storage_defrag_sweep(as_namespace *ns);
+extern void as_storage_demote_hot(as_namespace *ns); // called periodically by nsup
 
 // Storage of generic data into device headers.
 extern int as_storage_info_set(as_namespace *ns, uint idx, uint8_t *buf, size_t len);
@@ -226,6 +228,7 @@ extern void as_storage_wait_for_defrag_ssd(as_namespace *ns);
 extern bool as_storage_overloaded_ssd(as_namespace *ns);
 extern bool as_storage_has_space_ssd(as_namespace *ns);
 extern void as_storage_defrag_sweep_ssd(as_namespace *ns);
+extern void as_storage_demote_hot_ssd(as_namespace *ns);
 
 extern int as_storage_info_set_ssd(as_namespace *ns, uint idx, uint8_t *buf, size_t len);
 extern int as_storage_info_get_ssd(as_namespace *ns, uint idx, uint8_t *buf, size_t *len);
@@ -239,6 +242,8 @@ extern int as_storage_histogram_clear_ssd(as_namespace *ns);
 // Called by "base class" functions but not via table.
 extern bool as_storage_record_get_key_ssd(as_storage_rd *rd);
 extern void as_storage_shutdown_ssd(as_namespace *ns);
+extern bool as_storage_peek_random_ssd(as_namespace *ns, uint64_t *random);
+extern uint64_t as_storage_random_ssd(as_namespace *ns);
 
 
 //------------------------------------------------
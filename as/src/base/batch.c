@@ -45,6 +45,7 @@
 #define BATCH_BLOCK_SIZE (1024 * 128) // 128K
 #define BATCH_MAX_TRANSACTION_SIZE (1024 * 1024 * 10) // 10MB
 #define BATCH_REPEAT_SIZE 25  // index(4),digest(20) and repeat(1)
+#define BATCH_SUBMIT_GROUP AS_INDEX_PREFETCH_GROUP
 
 //---------------------------------------------------------
 // TYPES
@@ -102,6 +103,13 @@ typedef struct {
 	bool complete;
 } as_batch_work;
 
+// Sub-transaction held until its group of batch rows is submitted.
+typedef struct {
+	as_transaction tr;
+	as_namespace* ns;  // NULL if row namespace not known
+	bool inline_p;
+} as_batch_row;
+
 //---------------------------------------------------------
 // STATIC DATA
 //---------------------------------------------------------
@@ -592,6 +600,81 @@ as_batch_terminate(as_batch_shared* shared, uint32_t tran_count, int result_code
 	as_batch_transaction_end(shared, buffer, complete);
 }
 
+// Submit a group of sub-transactions. Inline sub-transactions are processed one
+// after another by this thread, so first walk all their index searches together
+// to overlap the cache misses. Only inline rows (data-in-memory namespaces) on
+// red-black trees are prefetched - rows queued to transaction threads would be
+// evicted from cache before they run. Keys in the same partition share one tree
+// reservation.
+static void
+as_batch_submit_group(as_batch_row* rows, uint32_t n)
+{
+	as_index_tree* trees[BATCH_SUBMIT_GROUP];
+	cf_digest keyds[BATCH_SUBMIT_GROUP];
+	uint32_t n_trees = 0;
+
+	as_index_tree* res_trees[BATCH_SUBMIT_GROUP];
+	as_namespace* res_nss[BATCH_SUBMIT_GROUP];
+	as_partition_id res_pids[BATCH_SUBMIT_GROUP];
+	uint32_t n_res = 0;
+
+	uint32_t n_prefetch = 0;
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (rows[i].inline_p && rows[i].ns &&
+				rows[i].ns->index_engine == AS_INDEX_ENGINE_RBTREE) {
+			n_prefetch++;
+		}
+	}
+
+	// Nothing to overlap with fewer than two lookups.
+	if (n_prefetch >= 2) {
+		for (uint32_t i = 0; i < n; i++) {
+			as_batch_row* row = &rows[i];
+			as_namespace* ns = row->ns;
+
+			if (! row->inline_p || ! ns ||
+					ns->index_engine != AS_INDEX_ENGINE_RBTREE) {
+				continue;
+			}
+
+			as_partition_id pid = as_partition_getid(row->tr.keyd);
+			uint32_t r = 0;
+
+			while (r < n_res && ! (res_nss[r] == ns && res_pids[r] == pid)) {
+				r++;
+			}
+
+			if (r == n_res) {
+				res_nss[r] = ns;
+				res_pids[r] = pid;
+				res_trees[r] = as_partition_reserve_tree(ns, pid);
+				n_res++;
+			}
+
+			trees[n_trees] = res_trees[r];
+			keyds[n_trees] = row->tr.keyd;
+			n_trees++;
+		}
+
+		as_index_prefetch_multi(trees, keyds, n_trees);
+	}
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (rows[i].inline_p) {
+			process_transaction(&rows[i].tr);
+		}
+		else {
+			// Queue transaction to be processed by a transaction thread.
+			thr_tsvc_enqueue(&rows[i].tr);
+		}
+	}
+
+	for (uint32_t r = 0; r < n_res; r++) {
+		as_partition_release_tree(res_nss[r], res_pids[r], res_trees[r]);
+	}
+}
+
 //---------------------------------------------------------
 // FUNCTIONS
 //---------------------------------------------------------
@@ -778,6 +861,9 @@ as_batch_queue_task(as_transaction* btr)
 	as_msg_op* op;
 	uint32_t tran_row = 0;
 	uint8_t info = *data++;  // allow transaction inline.
+	as_namespace* row_ns = NULL;
+	as_batch_row rows[BATCH_SUBMIT_GROUP];
+	uint32_t n_rows = 0;
 
 	bool allow_inline = (g_config.allow_inline_transactions && g_config.n_namespaces_in_memory != 0 && info);
 	bool check_inline = (allow_inline && g_config.n_namespaces_not_in_memory != 0);
@@ -829,9 +915,12 @@ as_batch_queue_task(as_transaction* btr)
 			data += sizeof(cl_msg);
 			mf = (as_msg_field*)data;
 			as_msg_swap_field(mf);
-			if (check_inline) {
-				as_namespace* ns = as_namespace_get_bymsgfield(mf);
-				should_inline = ns && ns->storage_data_in_memory;
+			if (allow_inline) {
+				row_ns = as_namespace_get_bymsgfield(mf);
+
+				if (check_inline) {
+					should_inline = row_ns && row_ns->storage_data_in_memory;
+				}
 			}
 			mf = as_msg_field_get_next(mf);
 
@@ -876,23 +965,27 @@ as_batch_queue_task(as_transaction* btr)
 			tr.msgp = out;
 		}
 
-		// Submit transaction.
-		if (should_inline) {
-			// Must copy generic transaction before processing inline, because some
-			// transaction fields are modified during the course of the transaction.
-			// We need each transaction to be initialized to proper values.
-			as_transaction tmp;
-			memcpy(&tmp, &tr, sizeof(as_transaction));
-			process_transaction(&tmp);
-		}
-		else {
-			// Queue transaction to be processed by a transaction thread.
-			thr_tsvc_enqueue(&tr);
+		// Hold transaction until its group is submitted. Must copy generic
+		// transaction, because some transaction fields are modified during the
+		// course of an inline transaction. We need each transaction to be
+		// initialized to proper values.
+		as_batch_row* row = &rows[n_rows++];
+		memcpy(&row->tr, &tr, sizeof(as_transaction));
+		row->ns = row_ns;
+		row->inline_p = should_inline;
+
+		if (n_rows == BATCH_SUBMIT_GROUP) {
+			as_batch_submit_group(rows, n_rows);
+			n_rows = 0;
 		}
 		tran_row++;
 	}
 
 TranEnd:
+	if (n_rows != 0) {
+		as_batch_submit_group(rows, n_rows);
+	}
+
 	if (tran_row < tran_count) {
 		// Mismatch between tran_count and actual data.  Terminate transaction.
 		cf_warning(AS_BATCH, "Batch keys mismatch. Expected %u Received %u", tran_count, tran_row);
@@ -214,7 +214,8 @@ cfg_set_defaults()
 
 	// TODO - not sure why these are in configuration - just to be global?
 	c->start_ms = cf_getms();
-	c->record_locks = olock_create(16 * 1024, true); // TODO - configurable number of locks?
+	c->n_record_locks = 16 * 1024;
+	c->record_lock_type = OLOCK_TYPE_MUTEX;
 
 	c->n_namespaces = 0;
 }
@@ -274,7 +275,9 @@ typedef enum {
 	CASE_SERVICE_LDT_BENCHMARKS,
 	CASE_SERVICE_LOG_LOCAL_TIME,
 	CASE_SERVICE_MICROBENCHMARKS,
+	CASE_SERVICE_MIGRATE_LATENCY_TARGET_MS,
 	CASE_SERVICE_MIGRATE_MAX_NUM_INCOMING,
+	CASE_SERVICE_MIGRATE_NODE_MAX_BYTES_PER_SEC,
 	CASE_SERVICE_MIGRATE_RX_LIFETIME_MS,
 	CASE_SERVICE_MIGRATE_THREADS,
 	CASE_SERVICE_NSUP_DELETE_SLEEP,
@@ -284,6 +287,7 @@ typedef enum {
 	CASE_SERVICE_PAXOS_PROTOCOL,
 	CASE_SERVICE_PAXOS_RECOVERY_POLICY,
 	CASE_SERVICE_PAXOS_RETRANSMIT_PERIOD,
+	CASE_SERVICE_PIN_SERVICE_THREADS,
 	CASE_SERVICE_PROTO_FD_IDLE_MS,
 	CASE_SERVICE_QUERY_BATCH_SIZE,
 	CASE_SERVICE_QUERY_BUFPOOL_SIZE,
@@ -300,6 +304,8 @@ typedef enum {
 	CASE_SERVICE_QUERY_THRESHOLD,
 	CASE_SERVICE_QUERY_UNTRACKED_TIME_MS,
 	CASE_SERVICE_QUERY_WORKER_THREADS,
+	CASE_SERVICE_RECORD_LOCK_TYPE,
+	CASE_SERVICE_RECORD_LOCKS,
 	CASE_SERVICE_REPLICATION_FIRE_AND_FORGET,
 	CASE_SERVICE_RESPOND_CLIENT_ON_MASTER_COMPLETION,
 	CASE_SERVICE_RUN_AS_DAEMON,
@@ -314,6 +320,7 @@ typedef enum {
 	CASE_SERVICE_TICKER_INTERVAL,
 	CASE_SERVICE_TRANSACTION_MAX_MS,
 	CASE_SERVICE_TRANSACTION_PENDING_LIMIT,
+	CASE_SERVICE_TRANSACTION_QUEUE_STEALING,
 	CASE_SERVICE_TRANSACTION_REPEATABLE_READ,
 	CASE_SERVICE_TRANSACTION_RETRY_MS,
 	CASE_SERVICE_UDF_RUNTIME_MAX_GMEMORY,
@@ -377,6 +384,10 @@ typedef enum {
 	CASE_SERVICE_PAXOS_RECOVERY_AUTO_RESET_MASTER,
 	CASE_SERVICE_PAXOS_RECOVERY_MANUAL,
 
+	// Service record lock type options (value tokens):
+	CASE_SERVICE_RECORD_LOCK_TYPE_MUTEX,
+	CASE_SERVICE_RECORD_LOCK_TYPE_ADAPTIVE,
+
 	// Logging options:
 	// Normally visible:
 	CASE_LOG_FILE_BEGIN,
@@ -478,6 +489,9 @@ typedef enum {
 	CASE_NAMESPACE_EVICT_TENTHS_PCT,
 	CASE_NAMESPACE_HIGH_WATER_DISK_PCT,
 	CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT,
+	CASE_NAMESPACE_INDEX_ENGINE,
+	CASE_NAMESPACE_INDEX_HUGE_PAGES,
+	CASE_NAMESPACE_INDEX_NUMA_POLICY,
 	CASE_NAMESPACE_LDT_ENABLED,
 	CASE_NAMESPACE_LDT_GC_RATE,
 	CASE_NAMESPACE_LDT_PAGE_SIZE,
@@ -485,6 +499,7 @@ typedef enum {
 	CASE_NAMESPACE_MIGRATE_ORDER,
 	CASE_NAMESPACE_MIGRATE_SLEEP,
 	CASE_NAMESPACE_OBJ_SIZE_HIST_MAX,
+	CASE_NAMESPACE_PARTITION_TREE_SPRIGS,
 	CASE_NAMESPACE_READ_CONSISTENCY_LEVEL_OVERRIDE,
 	CASE_NAMESPACE_SET_BEGIN,
 	CASE_NAMESPACE_SI_BEGIN,
@@ -504,6 +519,21 @@ typedef enum {
 	CASE_NAMESPACE_CONFLICT_RESOLUTION_GENERATION,
 	CASE_NAMESPACE_CONFLICT_RESOLUTION_LAST_UPDATE_TIME,
 
+	// Namespace index-engine options (value tokens):
+	CASE_NAMESPACE_INDEX_ENGINE_RBTREE,
+	CASE_NAMESPACE_INDEX_ENGINE_BTREE,
+
+	// Namespace index-huge-pages options (value tokens):
+	CASE_NAMESPACE_INDEX_HUGE_PAGES_FALSE,
+	CASE_NAMESPACE_INDEX_HUGE_PAGES_THP,
+	CASE_NAMESPACE_INDEX_HUGE_PAGES_2M,
+	CASE_NAMESPACE_INDEX_HUGE_PAGES_1G,
+
+	// Namespace index-numa-policy options (value tokens):
+	CASE_NAMESPACE_INDEX_NUMA_POLICY_NONE,
+	CASE_NAMESPACE_INDEX_NUMA_POLICY_INTERLEAVE,
+	CASE_NAMESPACE_INDEX_NUMA_POLICY_STRIPE,
+
 	// Namespace read consistency level options:
 	CASE_NAMESPACE_READ_CONSISTENCY_ALL,
 	CASE_NAMESPACE_READ_CONSISTENCY_OFF,
@@ -531,17 +561,33 @@ typedef enum {
 	CASE_NAMESPACE_STORAGE_DEVICE_DATA_IN_MEMORY,
 	// Normally hidden:
 	CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_EMPTY,
+	CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_THREADS,
+	CASE_NAMESPACE_STORAGE_DEVICE_COLD_STREAM_TTL,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LEVEL,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_THRESHOLD,
+	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_ADAPTIVE,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_LWM_PCT,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_QUEUE_MIN,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_SLEEP,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_STARTUP_MINIMUM,
 	CASE_NAMESPACE_STORAGE_DEVICE_DISABLE_ODIRECT,
+	CASE_NAMESPACE_STORAGE_DEVICE_ENABLE_CHECKSUM,
 	CASE_NAMESPACE_STORAGE_DEVICE_ENABLE_OSYNC,
 	CASE_NAMESPACE_STORAGE_DEVICE_FLUSH_MAX_MS,
 	CASE_NAMESPACE_STORAGE_DEVICE_FSYNC_MAX_SEC,
+	CASE_NAMESPACE_STORAGE_DEVICE_HOT_TIER_SIZE,
+	CASE_NAMESPACE_STORAGE_DEVICE_INDEX_SNAPSHOT_FILE,
+	CASE_NAMESPACE_STORAGE_DEVICE_IO_DEPTH,
+	CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE,
+	CASE_NAMESPACE_STORAGE_DEVICE_IO_THREADS,
+	CASE_NAMESPACE_STORAGE_DEVICE_LOAD_OLDER_ON_CHECKSUM_ERROR,
 	CASE_NAMESPACE_STORAGE_DEVICE_MAX_WRITE_CACHE,
 	CASE_NAMESPACE_STORAGE_DEVICE_MIN_AVAIL_PCT,
 	CASE_NAMESPACE_STORAGE_DEVICE_POST_WRITE_QUEUE,
+	CASE_NAMESPACE_STORAGE_DEVICE_READ_CACHE_SIZE,
+	CASE_NAMESPACE_STORAGE_DEVICE_SCRUB_SLEEP,
+	CASE_NAMESPACE_STORAGE_DEVICE_WRITE_HINTS,
 	CASE_NAMESPACE_STORAGE_DEVICE_WRITE_THREADS,
 	// Deprecated:
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_MAX_BLOCKS,
@@ -552,6 +598,17 @@ typedef enum {
 	CASE_NAMESPACE_STORAGE_DEVICE_SIGNATURE,
 	CASE_NAMESPACE_STORAGE_DEVICE_WRITE_SMOOTHING_PERIOD,
 
+	// Namespace storage-engine device io-engine options (value tokens):
+	CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_SYNC,
+	CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_THREADS,
+	CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_IO_URING,
+
+	// Namespace storage-engine device compression options (value tokens):
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_NONE,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LZ4,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZSTD,
+
 	// Namespace storage-engine kv options:
 	CASE_NAMESPACE_STORAGE_KV_DEVICE,
 	CASE_NAMESPACE_STORAGE_KV_FILESIZE,
@@ -681,7 +738,9 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "ldt-benchmarks",					CASE_SERVICE_LDT_BENCHMARKS },
 		{ "log-local-time",					CASE_SERVICE_LOG_LOCAL_TIME },
 		{ "microbenchmarks",				CASE_SERVICE_MICROBENCHMARKS },
+		{ "migrate-latency-target-ms",		CASE_SERVICE_MIGRATE_LATENCY_TARGET_MS },
 		{ "migrate-max-num-incoming",		CASE_SERVICE_MIGRATE_MAX_NUM_INCOMING },
+		{ "migrate-node-max-bytes-per-sec",	CASE_SERVICE_MIGRATE_NODE_MAX_BYTES_PER_SEC },
 		{ "migrate-read-priority",			CASE_SERVICE_MIGRATE_READ_PRIORITY },
 		{ "migrate-read-sleep",				CASE_SERVICE_MIGRATE_READ_SLEEP },
 		{ "migrate-rx-lifetime-ms",			CASE_SERVICE_MIGRATE_RX_LIFETIME_MS },
@@ -698,6 +757,7 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "paxos-protocol",					CASE_SERVICE_PAXOS_PROTOCOL },
 		{ "paxos-recovery-policy",			CASE_SERVICE_PAXOS_RECOVERY_POLICY },
 		{ "paxos-retransmit-period",		CASE_SERVICE_PAXOS_RETRANSMIT_PERIOD },
+		{ "pin-service-threads",			CASE_SERVICE_PIN_SERVICE_THREADS },
 		{ "proto-fd-idle-ms",				CASE_SERVICE_PROTO_FD_IDLE_MS },
 		{ "query-batch-size",				CASE_SERVICE_QUERY_BATCH_SIZE },
 		{ "query-bufpool-size",				CASE_SERVICE_QUERY_BUFPOOL_SIZE },
@@ -714,6 +774,8 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "query-threshold", 				CASE_SERVICE_QUERY_THRESHOLD },
 		{ "query-untracked-time-ms",		CASE_SERVICE_QUERY_UNTRACKED_TIME_MS },
 		{ "query-worker-threads",			CASE_SERVICE_QUERY_WORKER_THREADS },
+		{ "record-lock-type",				CASE_SERVICE_RECORD_LOCK_TYPE },
+		{ "record-locks",					CASE_SERVICE_RECORD_LOCKS },
 		{ "replication-fire-and-forget",	CASE_SERVICE_REPLICATION_FIRE_AND_FORGET },
 		{ "respond-client-on-master-completion", CASE_SERVICE_RESPOND_CLIENT_ON_MASTER_COMPLETION },
 		{ "run-as-daemon",					CASE_SERVICE_RUN_AS_DAEMON },
@@ -728,6 +790,7 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "ticker-interval",				CASE_SERVICE_TICKER_INTERVAL },
 		{ "transaction-max-ms",				CASE_SERVICE_TRANSACTION_MAX_MS },
 		{ "transaction-pending-limit",		CASE_SERVICE_TRANSACTION_PENDING_LIMIT },
+		{ "transaction-queue-stealing",		CASE_SERVICE_TRANSACTION_QUEUE_STEALING },
 		{ "transaction-repeatable-read",	CASE_SERVICE_TRANSACTION_REPEATABLE_READ },
 		{ "transaction-retry-ms",			CASE_SERVICE_TRANSACTION_RETRY_MS },
 		{ "udf-runtime-max-gmemory",		CASE_SERVICE_UDF_RUNTIME_MAX_GMEMORY },
@@ -786,6 +849,11 @@ const cfg_opt SERVICE_PAXOS_RECOVERY_OPTS[] = {
 		{ "manual",							CASE_SERVICE_PAXOS_RECOVERY_MANUAL }
 };
 
+const cfg_opt SERVICE_RECORD_LOCK_TYPE_OPTS[] = {
+		{ "mutex",							CASE_SERVICE_RECORD_LOCK_TYPE_MUTEX },
+		{ "adaptive",						CASE_SERVICE_RECORD_LOCK_TYPE_ADAPTIVE }
+};
+
 const cfg_opt LOGGING_OPTS[] = {
 		{ "file",							CASE_LOG_FILE_BEGIN },
 		{ "console",						CASE_LOG_CONSOLE_BEGIN },
@@ -887,6 +955,9 @@ const cfg_opt NAMESPACE_OPTS[] = {
 		{ "evict-tenths-pct",				CASE_NAMESPACE_EVICT_TENTHS_PCT },
 		{ "high-water-disk-pct",			CASE_NAMESPACE_HIGH_WATER_DISK_PCT },
 		{ "high-water-memory-pct",			CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT },
+		{ "index-engine",					CASE_NAMESPACE_INDEX_ENGINE },
+		{ "index-huge-pages",				CASE_NAMESPACE_INDEX_HUGE_PAGES },
+		{ "index-numa-policy",				CASE_NAMESPACE_INDEX_NUMA_POLICY },
 		{ "ldt-enabled",					CASE_NAMESPACE_LDT_ENABLED },
 		{ "ldt-gc-rate",					CASE_NAMESPACE_LDT_GC_RATE },
 		{ "ldt-page-size",					CASE_NAMESPACE_LDT_PAGE_SIZE },
@@ -894,6 +965,7 @@ const cfg_opt NAMESPACE_OPTS[] = {
 		{ "migrate-order",					CASE_NAMESPACE_MIGRATE_ORDER },
 		{ "migrate-sleep",					CASE_NAMESPACE_MIGRATE_SLEEP},
 		{ "obj-size-hist-max",				CASE_NAMESPACE_OBJ_SIZE_HIST_MAX },
+		{ "partition-tree-sprigs",			CASE_NAMESPACE_PARTITION_TREE_SPRIGS },
 		{ "read-consistency-level-override", CASE_NAMESPACE_READ_CONSISTENCY_LEVEL_OVERRIDE },
 		{ "set",							CASE_NAMESPACE_SET_BEGIN },
 		{ "si",								CASE_NAMESPACE_SI_BEGIN },
@@ -915,6 +987,24 @@ const cfg_opt NAMESPACE_CONFLICT_RESOLUTION_OPTS[] = {
 		{ "last-update-time",				CASE_NAMESPACE_CONFLICT_RESOLUTION_LAST_UPDATE_TIME }
 };
 
+const cfg_opt NAMESPACE_INDEX_ENGINE_OPTS[] = {
+		{ "rbtree",							CASE_NAMESPACE_INDEX_ENGINE_RBTREE },
+		{ "btree",							CASE_NAMESPACE_INDEX_ENGINE_BTREE }
+};
+
+const cfg_opt NAMESPACE_INDEX_HUGE_PAGES_OPTS[] = {
+		{ "false",							CASE_NAMESPACE_INDEX_HUGE_PAGES_FALSE },
+		{ "thp",							CASE_NAMESPACE_INDEX_HUGE_PAGES_THP },
+		{ "2m",								CASE_NAMESPACE_INDEX_HUGE_PAGES_2M },
+		{ "1g",								CASE_NAMESPACE_INDEX_HUGE_PAGES_1G }
+};
+
+const cfg_opt NAMESPACE_INDEX_NUMA_POLICY_OPTS[] = {
+		{ "none",							CASE_NAMESPACE_INDEX_NUMA_POLICY_NONE },
+		{ "interleave",						CASE_NAMESPACE_INDEX_NUMA_POLICY_INTERLEAVE },
+		{ "stripe",							CASE_NAMESPACE_INDEX_NUMA_POLICY_STRIPE }
+};
+
 const cfg_opt NAMESPACE_READ_CONSISTENCY_OPTS[] = {
 		{ "all",							CASE_NAMESPACE_READ_CONSISTENCY_ALL },
 		{ "off",							CASE_NAMESPACE_READ_CONSISTENCY_OFF },
@@ -943,17 +1033,33 @@ const cfg_opt NAMESPACE_STORAGE_DEVICE_OPTS[] = {
 		{ "memory-all",						CASE_NAMESPACE_STORAGE_DEVICE_MEMORY_ALL },
 		{ "data-in-memory",					CASE_NAMESPACE_STORAGE_DEVICE_DATA_IN_MEMORY },
 		{ "cold-start-empty",				CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_EMPTY },
+		{ "cold-start-threads",				CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_THREADS },
+		{ "cold-stream-ttl",				CASE_NAMESPACE_STORAGE_DEVICE_COLD_STREAM_TTL },
+		{ "compression",					CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION },
+		{ "compression-level",				CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LEVEL },
+		{ "compression-threshold",			CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_THRESHOLD },
+		{ "defrag-adaptive",				CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_ADAPTIVE },
 		{ "defrag-lwm-pct",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_LWM_PCT },
 		{ "defrag-queue-min",				CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_QUEUE_MIN },
 		{ "defrag-sleep",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_SLEEP },
 		{ "defrag-startup-minimum",			CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_STARTUP_MINIMUM },
 		{ "disable-odirect",				CASE_NAMESPACE_STORAGE_DEVICE_DISABLE_ODIRECT },
+		{ "enable-checksum",				CASE_NAMESPACE_STORAGE_DEVICE_ENABLE_CHECKSUM },
 		{ "enable-osync",					CASE_NAMESPACE_STORAGE_DEVICE_ENABLE_OSYNC },
 		{ "flush-max-ms",					CASE_NAMESPACE_STORAGE_DEVICE_FLUSH_MAX_MS },
 		{ "fsync-max-sec",					CASE_NAMESPACE_STORAGE_DEVICE_FSYNC_MAX_SEC },
+		{ "hot-tier-size",					CASE_NAMESPACE_STORAGE_DEVICE_HOT_TIER_SIZE },
+		{ "index-snapshot-file",			CASE_NAMESPACE_STORAGE_DEVICE_INDEX_SNAPSHOT_FILE },
+		{ "io-depth",						CASE_NAMESPACE_STORAGE_DEVICE_IO_DEPTH },
+		{ "io-engine",						CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE },
+		{ "io-threads",						CASE_NAMESPACE_STORAGE_DEVICE_IO_THREADS },
+		{ "load-older-on-checksum-error",	CASE_NAMESPACE_STORAGE_DEVICE_LOAD_OLDER_ON_CHECKSUM_ERROR },
 		{ "max-write-cache",				CASE_NAMESPACE_STORAGE_DEVICE_MAX_WRITE_CACHE },
 		{ "min-avail-pct",					CASE_NAMESPACE_STORAGE_DEVICE_MIN_AVAIL_PCT },
 		{ "post-write-queue",				CASE_NAMESPACE_STORAGE_DEVICE_POST_WRITE_QUEUE },
+		{ "read-cache-size",				CASE_NAMESPACE_STORAGE_DEVICE_READ_CACHE_SIZE },
+		{ "scrub-sleep",					CASE_NAMESPACE_STORAGE_DEVICE_SCRUB_SLEEP },
+		{ "write-hints",					CASE_NAMESPACE_STORAGE_DEVICE_WRITE_HINTS },
 		{ "write-threads",					CASE_NAMESPACE_STORAGE_DEVICE_WRITE_THREADS },
 		{ "defrag-max-blocks",				CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_MAX_BLOCKS },
 		{ "defrag-period",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_PERIOD },
@@ -965,6 +1071,19 @@ const cfg_opt NAMESPACE_STORAGE_DEVICE_OPTS[] = {
 		{ "}",								CASE_CONTEXT_END }
 };
 
+const cfg_opt NAMESPACE_STORAGE_DEVICE_IO_ENGINE_OPTS[] = {
+		{ "sync",							CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_SYNC },
+		{ "threads",						CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_THREADS },
+		{ "io_uring",						CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_IO_URING }
+};
+
+const cfg_opt NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS[] = {
+		{ "none",							CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_NONE },
+		{ "zlib",							CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB },
+		{ "lz4",							CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LZ4 },
+		{ "zstd",							CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZSTD }
+};
+
 const cfg_opt NAMESPACE_STORAGE_KV_OPTS[] = {
 		{ "device",							CASE_NAMESPACE_STORAGE_KV_DEVICE },
 		{ "filesize",						CASE_NAMESPACE_STORAGE_KV_FILESIZE },
@@ -1069,6 +1188,7 @@ const int NUM_GLOBAL_OPTS							= sizeof(GLOBAL_OPTS) / sizeof(cfg_opt);
 const int NUM_SERVICE_OPTS							= sizeof(SERVICE_OPTS) / sizeof(cfg_opt);
 const int NUM_SERVICE_PAXOS_PROTOCOL_OPTS			= sizeof(SERVICE_PAXOS_PROTOCOL_OPTS) / sizeof(cfg_opt);
 const int NUM_SERVICE_PAXOS_RECOVERY_OPTS			= sizeof(SERVICE_PAXOS_RECOVERY_OPTS) / sizeof(cfg_opt);
+const int NUM_SERVICE_RECORD_LOCK_TYPE_OPTS			= sizeof(SERVICE_RECORD_LOCK_TYPE_OPTS) / sizeof(cfg_opt);
 const int NUM_LOGGING_OPTS							= sizeof(LOGGING_OPTS) / sizeof(cfg_opt);
 const int NUM_LOGGING_FILE_OPTS						= sizeof(LOGGING_FILE_OPTS) / sizeof(cfg_opt);
 const int NUM_LOGGING_CONSOLE_OPTS					= sizeof(LOGGING_CONSOLE_OPTS) / sizeof(cfg_opt);
@@ -1081,10 +1201,15 @@ const int NUM_NETWORK_FABRIC_OPTS					= sizeof(NETWORK_FABRIC_OPTS) / sizeof(cfg
 const int NUM_NETWORK_INFO_OPTS						= sizeof(NETWORK_INFO_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_OPTS						= sizeof(NAMESPACE_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_CONFLICT_RESOLUTION_OPTS	= sizeof(NAMESPACE_CONFLICT_RESOLUTION_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_INDEX_ENGINE_OPTS			= sizeof(NAMESPACE_INDEX_ENGINE_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_INDEX_HUGE_PAGES_OPTS		= sizeof(NAMESPACE_INDEX_HUGE_PAGES_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_INDEX_NUMA_POLICY_OPTS		= sizeof(NAMESPACE_INDEX_NUMA_POLICY_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_READ_CONSISTENCY_OPTS		= sizeof(NAMESPACE_READ_CONSISTENCY_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_WRITE_COMMIT_OPTS			= sizeof(NAMESPACE_WRITE_COMMIT_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_STORAGE_OPTS				= sizeof(NAMESPACE_STORAGE_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_STORAGE_DEVICE_OPTS			= sizeof(NAMESPACE_STORAGE_DEVICE_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_OPTS	= sizeof(NAMESPACE_STORAGE_DEVICE_IO_ENGINE_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS	= sizeof(NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_STORAGE_KV_OPTS				= sizeof(NAMESPACE_STORAGE_KV_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_SET_OPTS					= sizeof(NAMESPACE_SET_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_SET_ENABLE_XDR_OPTS			= sizeof(NAMESPACE_SET_ENABLE_XDR_OPTS) / sizeof(cfg_opt);
@@ -1972,9 +2097,15 @@ as_config_init(const char *config_file)
 			case CASE_SERVICE_MICROBENCHMARKS:
 				c->microbenchmarks = cfg_bool(&line);
 				break;
+			case CASE_SERVICE_MIGRATE_LATENCY_TARGET_MS:
+				c->migrate_latency_target_ms = cfg_u32_no_checks(&line);
+				break;
 			case CASE_SERVICE_MIGRATE_MAX_NUM_INCOMING:
 				c->migrate_max_num_incoming = cfg_int(&line, 0, INT_MAX);
 				break;
+			case CASE_SERVICE_MIGRATE_NODE_MAX_BYTES_PER_SEC:
+				c->migrate_node_max_bytes_per_sec = cfg_u64_no_checks(&line);
+				break;
 			case CASE_SERVICE_MIGRATE_RX_LIFETIME_MS:
 				c->migrate_rx_lifetime_ms = cfg_int_no_checks(&line);
 				break;
@@ -2036,6 +2167,9 @@ as_config_init(const char *config_file)
 			case CASE_SERVICE_PAXOS_RETRANSMIT_PERIOD:
 				c->paxos_retransmit_period = cfg_u32_no_checks(&line);
 				break;
+			case CASE_SERVICE_PIN_SERVICE_THREADS:
+				c->pin_service_threads = cfg_bool(&line);
+				break;
 			case CASE_SERVICE_PROTO_FD_IDLE_MS:
 				c->proto_fd_idle_ms = cfg_int_no_checks(&line);
 				break;
@@ -2084,6 +2218,27 @@ as_config_init(const char *config_file)
 			case CASE_SERVICE_QUERY_WORKER_THREADS:
 				c->query_worker_threads = cfg_u32(&line, 1, AS_QUERY_MAX_WORKER_THREADS);
 				break;
+			case CASE_SERVICE_RECORD_LOCK_TYPE:
+				switch(cfg_find_tok(line.val_tok_1, SERVICE_RECORD_LOCK_TYPE_OPTS, NUM_SERVICE_RECORD_LOCK_TYPE_OPTS)) {
+				case CASE_SERVICE_RECORD_LOCK_TYPE_MUTEX:
+					c->record_lock_type = OLOCK_TYPE_MUTEX;
+					break;
+				case CASE_SERVICE_RECORD_LOCK_TYPE_ADAPTIVE:
+					c->record_lock_type = OLOCK_TYPE_ADAPTIVE;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
+			case CASE_SERVICE_RECORD_LOCKS:
+				c->n_record_locks = cfg_u32(&line, 1024, 16 * 1024 * 1024);
+				if ((c->n_record_locks & (c->n_record_locks - 1)) != 0) {
+					cf_crash_nostack(AS_CFG, "line %d :: %s must be a power of 2, not %u",
+							line.num, line.name_tok, c->n_record_locks);
+				}
+				break;
 			case CASE_SERVICE_REPLICATION_FIRE_AND_FORGET:
 				c->replication_fire_and_forget = cfg_bool(&line);
 				break;
@@ -2134,6 +2289,9 @@ as_config_init(const char *config_file)
 			case CASE_SERVICE_TRANSACTION_PENDING_LIMIT:
 				c->transaction_pending_limit = cfg_u32_no_checks(&line);
 				break;
+			case CASE_SERVICE_TRANSACTION_QUEUE_STEALING:
+				c->transaction_queue_stealing = cfg_bool(&line);
+				break;
 			case CASE_SERVICE_TRANSACTION_REPEATABLE_READ:
 				c->transaction_repeatable_read = cfg_bool(&line);
 				break;
@@ -2614,6 +2772,57 @@ as_config_init(const char *config_file)
 			case CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT:
 				ns->hwm_memory = (float)cfg_pct_fraction(&line);
 				break;
+			case CASE_NAMESPACE_INDEX_ENGINE:
+				switch(cfg_find_tok(line.val_tok_1, NAMESPACE_INDEX_ENGINE_OPTS, NUM_NAMESPACE_INDEX_ENGINE_OPTS)) {
+				case CASE_NAMESPACE_INDEX_ENGINE_RBTREE:
+					ns->index_engine = AS_INDEX_ENGINE_RBTREE;
+					break;
+				case CASE_NAMESPACE_INDEX_ENGINE_BTREE:
+					ns->index_engine = AS_INDEX_ENGINE_BTREE;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
+			case CASE_NAMESPACE_INDEX_HUGE_PAGES:
+				switch(cfg_find_tok(line.val_tok_1, NAMESPACE_INDEX_HUGE_PAGES_OPTS, NUM_NAMESPACE_INDEX_HUGE_PAGES_OPTS)) {
+				case CASE_NAMESPACE_INDEX_HUGE_PAGES_FALSE:
+					ns->index_huge_pages = 0;
+					break;
+				case CASE_NAMESPACE_INDEX_HUGE_PAGES_THP:
+					ns->index_huge_pages = CF_ARENAX_HUGE_PAGES_THP;
+					break;
+				case CASE_NAMESPACE_INDEX_HUGE_PAGES_2M:
+					ns->index_huge_pages = CF_ARENAX_HUGE_PAGES_2M;
+					break;
+				case CASE_NAMESPACE_INDEX_HUGE_PAGES_1G:
+					ns->index_huge_pages = CF_ARENAX_HUGE_PAGES_1G;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
+			case CASE_NAMESPACE_INDEX_NUMA_POLICY:
+				switch(cfg_find_tok(line.val_tok_1, NAMESPACE_INDEX_NUMA_POLICY_OPTS, NUM_NAMESPACE_INDEX_NUMA_POLICY_OPTS)) {
+				case CASE_NAMESPACE_INDEX_NUMA_POLICY_NONE:
+					ns->index_numa_policy = 0;
+					break;
+				case CASE_NAMESPACE_INDEX_NUMA_POLICY_INTERLEAVE:
+					ns->index_numa_policy = CF_ARENAX_NUMA_INTERLEAVE;
+					break;
+				case CASE_NAMESPACE_INDEX_NUMA_POLICY_STRIPE:
+					ns->index_numa_policy = CF_ARENAX_NUMA_STRIPE;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
 			case CASE_NAMESPACE_LDT_ENABLED:
 				ns->ldt_enabled = cfg_bool(&line);
 				break;
@@ -2635,6 +2844,12 @@ as_config_init(const char *config_file)
 			case CASE_NAMESPACE_OBJ_SIZE_HIST_MAX:
 				ns->obj_size_hist_max = cfg_obj_size_hist_max(cfg_u32_no_checks(&line));
 				break;
+			case CASE_NAMESPACE_PARTITION_TREE_SPRIGS:
+				ns->partition_tree_sprigs = cfg_u32(&line, MIN_PARTITION_TREE_SPRIGS, MAX_PARTITION_TREE_SPRIGS);
+				if ((ns->partition_tree_sprigs & (ns->partition_tree_sprigs - 1)) != 0) {
+					cf_crash_nostack(AS_CFG, "ns %s partition-tree-sprigs %u must be a power of 2", ns->name, ns->partition_tree_sprigs);
+				}
+				break;
 			case CASE_NAMESPACE_READ_CONSISTENCY_LEVEL_OVERRIDE:
 				switch(cfg_find_tok(line.val_tok_1, NAMESPACE_READ_CONSISTENCY_OPTS, NUM_NAMESPACE_READ_CONSISTENCY_OPTS)) {
 				case CASE_NAMESPACE_READ_CONSISTENCY_ALL:
@@ -2713,6 +2928,14 @@ as_config_init(const char *config_file)
 				if (ns->default_ttl > ns->max_ttl) {
 					cf_crash_nostack(AS_CFG, "ns %s default-ttl can't be > max-ttl", ns->name);
 				}
+				if (ns->index_engine == AS_INDEX_ENGINE_BTREE && ns->storage_index_snapshot_file) {
+					cf_crash_nostack(AS_CFG, "ns %s index-engine btree can't be used with index-snapshot-file", ns->name);
+				}
+				if (ns->partition_tree_sprigs > 1) {
+					// Main and sub trees, for every partition.
+					uint64_t sprig_sz = sizeof(as_index_sprig) + (ns->index_engine == AS_INDEX_ENGINE_RBTREE ? sizeof(as_index) : 0);
+					cf_info(AS_CFG, "ns %s partition-tree-sprigs %u will use %lu MB of memory", ns->name, ns->partition_tree_sprigs, (2UL * AS_PARTITIONS * ns->partition_tree_sprigs * sprig_sz) / (1024 * 1024));
+				}
 				if (ns->storage_data_in_memory) {
 					ns->storage_post_write_queue = 0; // override default (or configuration mistake)
 					c->n_namespaces_in_memory++;
@@ -2762,6 +2985,49 @@ as_config_init(const char *config_file)
 			case CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_EMPTY:
 				ns->storage_cold_start_empty = cfg_bool(&line);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_THREADS:
+				ns->storage_cold_start_threads = cfg_u32(&line, 0, 32);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COLD_STREAM_TTL:
+				ns->storage_cold_stream_ttl = cfg_seconds_no_checks(&line);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION:
+				switch(cfg_find_tok(line.val_tok_1, NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS, NUM_NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS)) {
+				case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_NONE:
+					ns->storage_compression = COMPRESSION_NONE;
+					break;
+				case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB:
+					ns->storage_compression = COMPRESSION_ZLIB;
+					break;
+				case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+					ns->storage_compression = COMPRESSION_LZ4;
+#else
+					cfg_not_supported(&line, "LZ4");
+#endif
+					break;
+				case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+					ns->storage_compression = COMPRESSION_ZSTD;
+#else
+					cfg_not_supported(&line, "ZSTD");
+#endif
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LEVEL:
+				ns->storage_compression_level = cfg_u32_no_checks(&line); // checked at context end
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_THRESHOLD:
+				ns->storage_compression_threshold = cfg_u32_no_checks(&line);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_ADAPTIVE:
+				ns->storage_defrag_adaptive = cfg_bool(&line);
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_LWM_PCT:
 				ns->storage_defrag_lwm_pct = cfg_u32_no_checks(&line);
 				break;
@@ -2777,6 +3043,9 @@ as_config_init(const char *config_file)
 			case CASE_NAMESPACE_STORAGE_DEVICE_DISABLE_ODIRECT:
 				ns->storage_disable_odirect = cfg_bool(&line);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_ENABLE_CHECKSUM:
+				ns->storage_enable_checksum = cfg_bool(&line);
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_ENABLE_OSYNC:
 				ns->storage_enable_osync = cfg_bool(&line);
 				break;
@@ -2786,6 +3055,38 @@ as_config_init(const char *config_file)
 			case CASE_NAMESPACE_STORAGE_DEVICE_FSYNC_MAX_SEC:
 				ns->storage_fsync_max_us = cfg_u64_no_checks(&line) * 1000000;
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_HOT_TIER_SIZE:
+				ns->storage_hot_tier_size = cfg_u64_no_checks(&line);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_INDEX_SNAPSHOT_FILE:
+				ns->storage_index_snapshot_file = cfg_strdup_no_checks(&line);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_IO_DEPTH:
+				ns->storage_io_depth = cfg_u32(&line, 1, CF_IORING_MAX_DEPTH);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE:
+				switch(cfg_find_tok(line.val_tok_1, NAMESPACE_STORAGE_DEVICE_IO_ENGINE_OPTS, NUM_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_OPTS)) {
+				case CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_SYNC:
+					ns->storage_io_engine = CF_IORING_SYNC;
+					break;
+				case CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_THREADS:
+					ns->storage_io_engine = CF_IORING_THREADS;
+					break;
+				case CASE_NAMESPACE_STORAGE_DEVICE_IO_ENGINE_IO_URING:
+					ns->storage_io_engine = CF_IORING_URING;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_IO_THREADS:
+				ns->storage_io_threads = cfg_u32(&line, 1, CF_IORING_MAX_THREADS);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_LOAD_OLDER_ON_CHECKSUM_ERROR:
+				ns->storage_load_older_on_checksum_error = cfg_bool(&line);
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_MAX_WRITE_CACHE:
 				ns->storage_max_write_cache = cfg_u64_no_checks(&line);
 				break;
@@ -2795,6 +3096,19 @@ as_config_init(const char *config_file)
 			case CASE_NAMESPACE_STORAGE_DEVICE_POST_WRITE_QUEUE:
 				ns->storage_post_write_queue = cfg_u32(&line, 0, 2 * 1024);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_READ_CACHE_SIZE:
+				ns->storage_read_cache_size = cfg_u64_no_checks(&line);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_SCRUB_SLEEP:
+				ns->storage_scrub_sleep = cfg_u32_no_checks(&line);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_WRITE_HINTS:
+				ns->storage_write_hints = cfg_bool(&line);
+				if (ns->storage_write_hints) {
+					cf_warning(AS_CFG, "line %d :: {%s} %s serializes each device's writes between streams - batched writes only overlap within a stream",
+							line.num, ns->name, line.name_tok);
+				}
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_WRITE_THREADS:
 				ns->storage_write_threads = cfg_u32_no_checks(&line);
 				break;
@@ -2808,6 +3122,9 @@ as_config_init(const char *config_file)
 				cfg_deprecated_name_tok(&line);
 				break;
 			case CASE_CONTEXT_END:
+				if (ns->storage_compression_level > as_compression_max_level(ns->storage_compression)) {
+					cf_crash_nostack(AS_CFG, "ns %s compression-level must be <= %u for compression %s, not %u", ns->name, as_compression_max_level(ns->storage_compression), as_compression_type_str(ns->storage_compression), ns->storage_compression_level);
+				}
 				cfg_end_context(&state);
 				break;
 			case CASE_NOT_FOUND:
@@ -3288,6 +3605,11 @@ as_config_post_process(as_config *c, const char *config_file)
 	// Setup performance metrics histograms.
 	cfg_create_all_histograms();
 
+	// Create the record lock table - needs the lock wait histogram.
+	if (! (c->record_locks = olock_create(c->n_record_locks, c->record_lock_type, c->record_lock_wait_hist))) {
+		cf_crash(AS_CFG, "failed to create %u record locks", c->n_record_locks);
+	}
+
 	// Since cfg_use_hardware_values() has side effects, we MUST call it, and
 	// THEN if we are doing the new topology, set the new type of Self Node
 	// value.
@@ -3572,6 +3894,7 @@ cfg_create_all_histograms()
 	create_and_check_hist(&c->write_storage_close_hist, "write_storage_close", HIST_MILLISECONDS);
 	create_and_check_hist(&c->write_sindex_hist, "write_sindex", HIST_MILLISECONDS);
 	create_and_check_hist(&c->prole_fabric_send_hist, "prole_fabric_send", HIST_MILLISECONDS);
+	create_and_check_hist(&c->record_lock_wait_hist, "record_lock_wait", HIST_MICROSECONDS);
 
 	create_and_check_hist(&c->ldt_multiop_prole_hist, "ldt_multiop_prole", HIST_MILLISECONDS);
 	create_and_check_hist(&c->ldt_io_record_cnt_hist, "ldt_rec_io_count", HIST_RAW);
@@ -35,7 +35,6 @@
 
 #include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_atomic.h"
-#include "citrusleaf/cf_clock.h"
 #include "citrusleaf/cf_digest.h"
 
 #include "arenax.h"
@@ -53,6 +52,10 @@
 
 #define RESOLVE_H(__h) ((as_index*)cf_arenax_resolve(tree->arena, __h))
 
+// Select a digest's sprig, using digest bits the partition ID doesn't use.
+#define SPRIG_GET(__keyd) \
+	(&tree->sprigs[*(uint32_t*)&(__keyd)->digest[8] & (tree->n_sprigs - 1)])
+
 typedef enum {
 	AS_BLACK	= 0,
 	AS_RED		= 1
@@ -61,6 +64,21 @@ typedef enum {
 // Flag to indicate full index reduce.
 #define AS_REDUCE_ALL (-1)
 
+// A reduce collects this many elements per visit under reduce_lock - small
+// enough that inserts and deletes barely notice, big enough that re-finding the
+// resume point is a small fraction of the work.
+#define REDUCE_CHUNK_SIZE 256
+
+// A red-black tree never gets deeper than this - an unlocked search that walks
+// further must have followed a handle that was changing under it.
+#define MAX_SEARCH_DEPTH (64 * 2)
+
+// Unlocked searches that keep racing writers give up and take the tree lock.
+#define MAX_OPTIMISTIC_TRIES 4
+
+// Return value for an unlocked search that raced a writer.
+#define SEARCH_RACED (-2)
+
 typedef struct as_index_ph_s {
 	as_index			*r;
 	cf_arenax_handle	r_h;
@@ -78,20 +96,50 @@ typedef struct as_index_ele_s {
 	as_index				*me;
 } as_index_ele;
 
+typedef struct as_index_prefetch_state_s {
+	as_index_tree		*tree;
+	cf_digest			*keyd;
+	cf_arenax_handle	r_h;
+} as_index_prefetch_state;
+
+typedef struct as_index_btree_snapshot_info_s {
+	as_index_tree		*tree;
+	as_index_ph_array	*v_a;
+} as_index_btree_snapshot_info;
+
+typedef struct as_index_btree_sync_info_s {
+	as_index_tree			*tree;
+	as_index_reduce_sync_fn	cb;
+	void					*udata;
+	uint32_t				n_elements;
+} as_index_btree_sync_info;
+
 
 
 //==========================================================
 // Forward declarations.
 //
 
+void as_index_sprigs_destroy(as_index_tree *tree, uint32_t n_sprigs);
 void as_index_tree_purge(as_index_tree *tree, as_index *r, cf_arenax_handle r_h);
-void as_index_reduce_traverse(as_index_tree *tree, cf_arenax_handle r_h, cf_arenax_handle sentinel_h, as_index_ph_array *v_a);
-void as_index_reduce_sync_traverse(as_index_tree *tree, as_index *r, cf_arenax_handle sentinel_h, as_index_reduce_sync_fn cb, void *udata);
-int as_index_search_lockless(as_index_tree *tree, cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h);
-void as_index_insert_rebalance(as_index_tree *tree, as_index_ele *ele);
-void as_index_delete_rebalance(as_index_tree *tree, as_index_ele *ele);
+uint32_t as_index_reduce_sprig(as_index_tree *tree, as_index_sprig *sprig, uint32_t sample_count, as_index_reduce_fn cb, void *udata);
+void as_index_reduce_traverse(as_index_tree *tree, cf_arenax_handle r_h, cf_arenax_handle sentinel_h, cf_digest *after, as_index_ph_array *v_a);
+uint32_t as_index_reduce_sync_traverse(as_index_tree *tree, as_index *r, cf_arenax_handle sentinel_h, as_index_reduce_sync_fn cb, void *udata);
+int as_index_search_lockless(as_index_tree *tree, as_index_sprig *sprig, cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h);
+int as_index_search_optimistic(as_index_tree *tree, as_index_sprig *sprig, cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h);
+bool as_index_reserve_if_live(as_index *r);
+void as_index_release_unlocked(as_index_tree *tree, as_index *r, cf_arenax_handle r_h);
+void as_index_restructure_begin(as_index_sprig *sprig);
+void as_index_restructure_end(as_index_sprig *sprig);
+void as_index_insert_rebalance(as_index_tree *tree, as_index_sprig *sprig, as_index_ele *ele);
+void as_index_delete_rebalance(as_index_tree *tree, as_index_sprig *sprig, as_index_ele *ele);
 void as_index_rotate_left(as_index_tree *tree, as_index_ele *a, as_index_ele *b);
 void as_index_rotate_right(as_index_tree *tree, as_index_ele *a, as_index_ele *b);
+int as_index_btree_get_insert_vlock(as_index_tree *tree, as_index_sprig *sprig, cf_digest *keyd, as_index_ref *index_ref);
+int as_index_btree_delete(as_index_tree *tree, as_index_sprig *sprig, cf_digest *keyd);
+bool as_index_btree_purge_cb(cf_arenax_handle r_h, void *udata);
+bool as_index_btree_snapshot_cb(cf_arenax_handle r_h, void *udata);
+bool as_index_btree_sync_cb(cf_arenax_handle r_h, void *udata);
 
 
 
@@ -99,23 +147,24 @@ void as_index_rotate_right(as_index_tree *tree, as_index_ele *a, as_index_ele *b
 // Public API - create/resume/destroy/size a tree.
 //
 
-// Create a new red-black tree.
+// Create a new tree of n_sprigs sprigs, each a red-black tree or a B+tree.
 as_index_tree *
 as_index_tree_create(cf_arenax *arena, as_index_value_destructor destructor,
-		void *destructor_udata, as_treex *p_treex)
+		void *destructor_udata, as_index_engine engine, uint32_t n_sprigs,
+		as_treex *p_treex)
 {
-	as_index_tree *tree = cf_rc_alloc(sizeof(as_index_tree));
+	as_index_tree *tree = cf_rc_alloc(sizeof(as_index_tree) +
+			(n_sprigs * sizeof(as_index_sprig)));
 
 	if (! tree) {
 		return NULL;
 	}
 
-	pthread_mutex_init(&tree->lock, NULL);
-	pthread_mutex_init(&tree->reduce_lock, NULL);
-
 	tree->arena = arena;
+	tree->engine = engine;
+	tree->n_sprigs = n_sprigs;
 
-	// Make the sentinel element.
+	// Make the sentinel element, shared by all sprigs.
 	tree->sentinel_h = cf_arenax_alloc(arena);
 
 	if (tree->sentinel_h == 0) {
@@ -129,19 +178,34 @@ as_index_tree_create(cf_arenax *arena, as_index_value_destructor destructor,
 	sentinel->left_h = sentinel->right_h = tree->sentinel_h;
 	sentinel->color = AS_BLACK;
 
-	// Make the fixed root element.
-	tree->root_h = cf_arenax_alloc(arena);
+	// Make the fixed root element of each red-black sprig.
+	for (uint32_t i = 0; i < n_sprigs; i++) {
+		as_index_sprig *sprig = &tree->sprigs[i];
 
-	if (tree->root_h == 0) {
-		cf_arenax_free(arena, tree->sentinel_h);
-		cf_rc_free(tree);
-		return NULL;
-	}
+		if (engine == AS_INDEX_ENGINE_BTREE) {
+			sprig->root_h = 0;
+			sprig->root = NULL;
+			as_btree_init(&sprig->btree);
+		}
+		else if ((sprig->root_h = cf_arenax_alloc(arena)) == 0) {
+			as_index_sprigs_destroy(tree, i);
+			cf_arenax_free(arena, tree->sentinel_h);
+			cf_rc_free(tree);
+			return NULL;
+		}
+		else {
+			sprig->root = RESOLVE_H(sprig->root_h);
+			memset(sprig->root, 0, sizeof(as_index));
+			sprig->root->left_h = sprig->root->right_h = tree->sentinel_h;
+			sprig->root->color = AS_BLACK;
+		}
+
+		pthread_mutex_init(&sprig->lock, NULL);
+		pthread_mutex_init(&sprig->reduce_lock, NULL);
 
-	tree->root = RESOLVE_H(tree->root_h);
-	memset(tree->root, 0, sizeof(as_index));
-	tree->root->left_h = tree->root->right_h = tree->sentinel_h;
-	tree->root->color = AS_BLACK;
+		sprig->elements = 0;
+		sprig->version = 0;
+	}
 
 	tree->destructor = destructor;
 	tree->destructor_udata = destructor_udata;
@@ -151,29 +215,39 @@ as_index_tree_create(cf_arenax *arena, as_index_value_destructor destructor,
 	if (p_treex) {
 		// Update the tree information in persistent memory.
 		p_treex->sentinel_h = tree->sentinel_h;
-		p_treex->root_h = tree->root_h;
+
+		for (uint32_t i = 0; i < n_sprigs; i++) {
+			p_treex->root_h[i] = tree->sprigs[i].root_h;
+		}
 	}
 
 	return tree;
 }
 
 
-// Resume a red-black tree in persistent memory.
+// Resume a tree of n_sprigs red-black sprigs in persistent memory. B+tree nodes
+// live on the heap, so B+tree sprigs can't be resumed.
 // TODO - should really hide this in an EE version of as_index.c.
 as_index_tree *
 as_index_tree_resume(cf_arenax *arena, as_index_value_destructor destructor,
-		void *destructor_udata, as_treex *p_treex)
+		void *destructor_udata, as_index_engine engine, uint32_t n_sprigs,
+		as_treex *p_treex)
 {
-	as_index_tree *tree = cf_rc_alloc(sizeof(as_index_tree));
+	if (engine != AS_INDEX_ENGINE_RBTREE) {
+		cf_warning(AS_INDEX, "can't resume index-engine btree tree");
+		return NULL;
+	}
+
+	as_index_tree *tree = cf_rc_alloc(sizeof(as_index_tree) +
+			(n_sprigs * sizeof(as_index_sprig)));
 
 	if (! tree) {
 		return NULL;
 	}
 
-	pthread_mutex_init(&tree->lock, NULL);
-	pthread_mutex_init(&tree->reduce_lock, NULL);
-
 	tree->arena = arena;
+	tree->engine = engine;
+	tree->n_sprigs = n_sprigs;
 
 	// Resume the sentinel.
 	tree->sentinel_h = p_treex->sentinel_h;
@@ -183,27 +257,43 @@ as_index_tree_resume(cf_arenax *arena, as_index_value_destructor destructor,
 		return NULL;
 	}
 
-	// Resume the fixed root.
-	tree->root_h = p_treex->root_h;
+	// Resume the fixed roots.
+	for (uint32_t i = 0; i < n_sprigs; i++) {
+		as_index_sprig *sprig = &tree->sprigs[i];
 
-	if (tree->root_h == 0) {
-		cf_rc_free(tree);
-		return NULL;
-	}
+		sprig->root_h = p_treex->root_h[i];
+
+		if (sprig->root_h == 0) {
+			for (uint32_t j = 0; j < i; j++) {
+				pthread_mutex_destroy(&tree->sprigs[j].lock);
+				pthread_mutex_destroy(&tree->sprigs[j].reduce_lock);
+			}
 
-	tree->root = RESOLVE_H(tree->root_h);
+			cf_rc_free(tree);
+			return NULL;
+		}
+
+		pthread_mutex_init(&sprig->lock, NULL);
+		pthread_mutex_init(&sprig->reduce_lock, NULL);
+
+		sprig->root = RESOLVE_H(sprig->root_h);
+
+		// We'll soon update this to its proper value by reducing the tree.
+		sprig->elements = 0;
+		sprig->version = 0;
+	}
 
 	tree->destructor = destructor;
 	tree->destructor_udata = destructor_udata;
 
-	// We'll soon update this to its proper value by reducing the tree.
+	// Sum of sprig element counts, updated with them.
 	tree->elements = 0;
 
 	return tree;
 }
 
 
-// Destroy a red-black tree; return 0 if the tree was destroyed or 1 otherwise.
+// Destroy a tree; return 0 if the tree was destroyed or 1 otherwise.
 // TODO - nobody cares about the return value, make it void?
 int
 as_index_tree_release(as_index_tree *tree, void *destructor_udata)
@@ -212,16 +302,24 @@ as_index_tree_release(as_index_tree *tree, void *destructor_udata)
 		return 1;
 	}
 
-	as_index_tree_purge(tree, RESOLVE_H(tree->root->left_h),
-			tree->root->left_h);
+	for (uint32_t i = 0; i < tree->n_sprigs; i++) {
+		as_index_sprig *sprig = &tree->sprigs[i];
 
-	cf_arenax_free(tree->arena, tree->root_h);
-	cf_arenax_free(tree->arena, tree->sentinel_h);
+		if (tree->engine == AS_INDEX_ENGINE_BTREE) {
+			as_btree_reduce(&sprig->btree, as_index_btree_purge_cb, tree);
+		}
+		else {
+			as_index_tree_purge(tree, RESOLVE_H(sprig->root->left_h),
+					sprig->root->left_h);
+		}
+	}
 
-	pthread_mutex_destroy(&tree->lock);
-	pthread_mutex_destroy(&tree->reduce_lock);
+	as_index_sprigs_destroy(tree, tree->n_sprigs);
+	cf_arenax_free(tree->arena, tree->sentinel_h);
 
-	memset(tree, 0, sizeof(as_index_tree)); // paranoia - for debugging only
+	// paranoia - for debugging only
+	memset(tree, 0, sizeof(as_index_tree) +
+			(tree->n_sprigs * sizeof(as_index_sprig)));
 	cf_rc_free(tree);
 
 	return 0;
@@ -232,13 +330,7 @@ as_index_tree_release(as_index_tree *tree, void *destructor_udata)
 uint32_t
 as_index_tree_size(as_index_tree *tree)
 {
-	pthread_mutex_lock(&tree->lock);
-
-	uint32_t sz = tree->elements;
-
-	pthread_mutex_unlock(&tree->lock);
-
-	return sz;
+	return tree->elements;
 }
 
 
@@ -256,74 +348,20 @@ as_index_reduce(as_index_tree *tree, as_index_reduce_fn cb, void *udata)
 
 
 // Make a callback for a specified number of elements in the tree, from outside
-// the tree lock.
+// the tree lock. Sprigs are reduced one at a time, each in bounded chunks, so
+// inserts and deletes only ever wait for one chunk to be collected.
 void
 as_index_reduce_partial(as_index_tree *tree, uint32_t sample_count,
 		as_index_reduce_fn cb, void *udata)
 {
-	pthread_mutex_lock(&tree->reduce_lock);
+	for (uint32_t i = 0; i < tree->n_sprigs && sample_count != 0; i++) {
+		uint32_t n_reduced = as_index_reduce_sprig(tree, &tree->sprigs[i],
+				sample_count, cb, udata);
 
-	// For full reduce, get the number of elements inside the tree lock.
-	if (sample_count == AS_REDUCE_ALL) {
-		sample_count = tree->elements;
-	}
-
-	if (sample_count == 0) {
-		pthread_mutex_unlock(&tree->reduce_lock);
-		return;
-	}
-
-	size_t sz = sizeof(as_index_ph_array) +
-			(sizeof(as_index_ph) * sample_count);
-	as_index_ph_array *v_a;
-	uint8_t buf[64 * 1024];
-
-	if (sz > 64 * 1024) {
-		v_a = cf_malloc(sz);
-
-		if (! v_a) {
-			pthread_mutex_unlock(&tree->reduce_lock);
-			return;
+		if (sample_count != AS_REDUCE_ALL) {
+			sample_count -= n_reduced;
 		}
 	}
-	else {
-		v_a = (as_index_ph_array*)buf;
-	}
-
-	v_a->alloc_sz = sample_count;
-	v_a->pos = 0;
-
-	uint64_t start_ms = cf_getms();
-
-	// Recursively, fetch all the value pointers into this array, so we can make
-	// all the callbacks outside the big lock.
-	if (tree->root->left_h != tree->sentinel_h) {
-		as_index_reduce_traverse(tree, tree->root->left_h, tree->sentinel_h,
-				v_a);
-	}
-
-	cf_debug(AS_INDEX, "as_index_reduce_traverse took %"PRIu64" ms",
-			cf_getms() - start_ms);
-
-	pthread_mutex_unlock(&tree->reduce_lock);
-
-	for (uint32_t i = 0; i < v_a->pos; i++) {
-		as_index_ref r_ref;
-
-		r_ref.skip_lock = false;
-		r_ref.r = v_a->indexes[i].r;
-		r_ref.r_h = v_a->indexes[i].r_h;
-
-		olock_vlock(g_config.record_locks, &r_ref.r->key, &r_ref.olock);
-		cf_atomic_int_incr(&g_config.global_record_lock_count);
-
-		// Callback MUST call as_record_done() to unlock and release record.
-		cb(&r_ref, udata);
-	}
-
-	if (v_a != (as_index_ph_array*)buf) {
-		cf_free(v_a);
-	}
 }
 
 
@@ -332,14 +370,37 @@ void
 as_index_reduce_sync(as_index_tree *tree, as_index_reduce_sync_fn cb,
 		void *udata)
 {
-	pthread_mutex_lock(&tree->reduce_lock);
+	for (uint32_t i = 0; i < tree->n_sprigs; i++) {
+		as_index_sprig *sprig = &tree->sprigs[i];
+		uint32_t n_elements = 0;
+
+		pthread_mutex_lock(&sprig->reduce_lock);
+
+		if (tree->engine == AS_INDEX_ENGINE_BTREE) {
+			as_index_btree_sync_info info = {
+					.tree = tree,
+					.cb = cb,
+					.udata = udata,
+					.n_elements = 0
+			};
+
+			as_btree_reduce(&sprig->btree, as_index_btree_sync_cb, &info);
+			n_elements = info.n_elements;
+		}
+		else if (sprig->root->left_h != tree->sentinel_h) {
+			n_elements = as_index_reduce_sync_traverse(tree,
+					RESOLVE_H(sprig->root->left_h), tree->sentinel_h, cb,
+					udata);
+		}
 
-	if (tree->root->left_h != tree->sentinel_h) {
-		as_index_reduce_sync_traverse(tree, RESOLVE_H(tree->root->left_h),
-				tree->sentinel_h, cb, udata);
-	}
+		// The sprig can't change under reduce_lock, so make its element count
+		// exact - this is how counts get established after a resume.
+		cf_atomic32_add(&tree->elements,
+				(int32_t)(n_elements - sprig->elements));
+		sprig->elements = n_elements;
 
-	pthread_mutex_unlock(&tree->reduce_lock);
+		pthread_mutex_unlock(&sprig->reduce_lock);
+	}
 }
 
 
@@ -356,11 +417,23 @@ as_index_reduce_sync(as_index_tree *tree, as_index_reduce_sync_fn cb,
 int
 as_index_exists(as_index_tree *tree, cf_digest *keyd)
 {
-	pthread_mutex_lock(&tree->lock);
+	as_index_sprig *sprig = SPRIG_GET(keyd);
+	int n_tries = tree->engine == AS_INDEX_ENGINE_RBTREE ?
+			MAX_OPTIMISTIC_TRIES : 0;
+
+	for (int i = 0; i < n_tries; i++) {
+		int rv = as_index_search_optimistic(tree, sprig, keyd, NULL, NULL);
+
+		if (rv != SEARCH_RACED) {
+			return rv;
+		}
+	}
 
-	int rv = as_index_search_lockless(tree, keyd, NULL, NULL);
+	pthread_mutex_lock(&sprig->lock);
 
-	pthread_mutex_unlock(&tree->lock);
+	int rv = as_index_search_lockless(tree, sprig, keyd, NULL, NULL);
+
+	pthread_mutex_unlock(&sprig->lock);
 
 	return rv;
 }
@@ -369,6 +442,10 @@ as_index_exists(as_index_tree *tree, cf_digest *keyd)
 // If there's an element with specified digest in the tree, return a locked
 // and reserved reference to it in index_ref.
 //
+// The search is first tried without the sprig lock, so point reads don't
+// serialize on it - only if it keeps racing inserts and deletes do we fall
+// back to searching under the lock.
+//
 // Returns:
 //		 0 - found (reference returned in index_ref)
 //		-1 - not found (index_ref untouched)
@@ -376,20 +453,38 @@ int
 as_index_get_vlock(as_index_tree *tree, cf_digest *keyd,
 		as_index_ref *index_ref)
 {
-	pthread_mutex_lock(&tree->lock);
+	as_index_sprig *sprig = SPRIG_GET(keyd);
+	as_index *r = NULL;
+	cf_arenax_handle r_h = 0;
+	int rv = SEARCH_RACED;
+	int n_tries = tree->engine == AS_INDEX_ENGINE_RBTREE ?
+			MAX_OPTIMISTIC_TRIES : 0;
+
+	for (int i = 0; i < n_tries && rv == SEARCH_RACED; i++) {
+		rv = as_index_search_optimistic(tree, sprig, keyd, &r, &r_h);
+	}
 
-	int rv = as_index_search_lockless(tree, keyd, &index_ref->r,
-			&index_ref->r_h);
+	if (rv == SEARCH_RACED) {
+		pthread_mutex_lock(&sprig->lock);
+
+		rv = as_index_search_lockless(tree, sprig, keyd, &r, &r_h);
+
+		if (rv == 0) {
+			as_index_reserve(r);
+		}
+
+		pthread_mutex_unlock(&sprig->lock);
+	}
 
 	if (rv != 0) {
-		pthread_mutex_unlock(&tree->lock);
 		return rv;
 	}
 
-	as_index_reserve(index_ref->r);
+	// r is now reserved, whichever way we found it.
 	cf_atomic_int_incr(&g_config.global_record_ref_count);
 
-	pthread_mutex_unlock(&tree->lock);
+	index_ref->r = r;
+	index_ref->r_h = r_h;
 
 	if (! index_ref->skip_lock) {
 		olock_vlock(g_config.record_locks, keyd, &index_ref->olock);
@@ -413,6 +508,12 @@ int
 as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 		as_index_ref *index_ref)
 {
+	as_index_sprig *sprig = SPRIG_GET(keyd);
+
+	if (tree->engine == AS_INDEX_ENGINE_BTREE) {
+		return as_index_btree_get_insert_vlock(tree, sprig, keyd, index_ref);
+	}
+
 	int cmp = 0;
 	bool retry;
 
@@ -423,15 +524,15 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 	do {
 		ele = eles;
 
-		pthread_mutex_lock(&tree->lock);
+		pthread_mutex_lock(&sprig->lock);
 
 		// Search for the specified element, or a parent to insert it under.
 
 		ele->parent = NULL; // we'll never look this far up
-		ele->me_h = tree->root_h;
-		ele->me = tree->root;
+		ele->me_h = sprig->root_h;
+		ele->me = sprig->root;
 
-		cf_arenax_handle t_h = tree->root->left_h;
+		cf_arenax_handle t_h = sprig->root->left_h;
 		as_index *t = RESOLVE_H(t_h);
 
 		while (t_h != tree->sentinel_h) {
@@ -446,7 +547,7 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 				as_index_reserve(t);
 				cf_atomic_int_incr(&g_config.global_record_ref_count);
 
-				pthread_mutex_unlock(&tree->lock);
+				pthread_mutex_unlock(&sprig->lock);
 
 				if (! index_ref->skip_lock) {
 					olock_vlock(g_config.record_locks, keyd, &index_ref->olock);
@@ -467,14 +568,14 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 
 		retry = false;
 
-		if (EBUSY == pthread_mutex_trylock(&tree->reduce_lock)) {
+		if (EBUSY == pthread_mutex_trylock(&sprig->reduce_lock)) {
 			// The tree is being reduced - could take long, unlock so reads and
 			// overwrites aren't blocked.
-			pthread_mutex_unlock(&tree->lock);
+			pthread_mutex_unlock(&sprig->lock);
 
 			// Wait until the tree reduce is done...
-			pthread_mutex_lock(&tree->reduce_lock);
-			pthread_mutex_unlock(&tree->reduce_lock);
+			pthread_mutex_lock(&sprig->reduce_lock);
+			pthread_mutex_unlock(&sprig->reduce_lock);
 
 			// ... and start over - we unlocked, so the tree may have changed.
 			retry = true;
@@ -488,8 +589,8 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 
 	if (n_h == 0) {
 		cf_warning(AS_INDEX, "arenax alloc failed");
-		pthread_mutex_unlock(&tree->reduce_lock);
-		pthread_mutex_unlock(&tree->lock);
+		pthread_mutex_unlock(&sprig->reduce_lock);
+		pthread_mutex_unlock(&sprig->lock);
 		return -1;
 	}
 
@@ -506,8 +607,10 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 	// Make sure we can detect that the record isn't initialized.
 	as_index_clear_record_info(n);
 
+	as_index_restructure_begin(sprig);
+
 	// Insert the new element n under parent ele.
-	if (ele->me == tree->root || 0 < cmp) {
+	if (ele->me == sprig->root || 0 < cmp) {
 		ele->me->left_h = n_h;
 	}
 	else {
@@ -520,12 +623,15 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 	ele->me = n;
 
 	// Rebalance the tree as needed.
-	as_index_insert_rebalance(tree, ele);
+	as_index_insert_rebalance(tree, sprig, ele);
 
-	tree->elements++;
+	as_index_restructure_end(sprig);
 
-	pthread_mutex_unlock(&tree->reduce_lock);
-	pthread_mutex_unlock(&tree->lock);
+	sprig->elements++;
+	cf_atomic32_incr(&tree->elements);
+
+	pthread_mutex_unlock(&sprig->reduce_lock);
+	pthread_mutex_unlock(&sprig->lock);
 
 	if (! index_ref->skip_lock) {
 		olock_vlock(g_config.record_locks, keyd, &index_ref->olock);
@@ -548,6 +654,12 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 int
 as_index_delete(as_index_tree *tree, cf_digest *keyd)
 {
+	as_index_sprig *sprig = SPRIG_GET(keyd);
+
+	if (tree->engine == AS_INDEX_ENGINE_BTREE) {
+		return as_index_btree_delete(tree, sprig, keyd);
+	}
+
 	as_index *r;
 	cf_arenax_handle r_h;
 	bool retry;
@@ -559,13 +671,13 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 	do {
 		ele = eles;
 
-		pthread_mutex_lock(&tree->lock);
+		pthread_mutex_lock(&sprig->lock);
 
 		ele->parent = NULL; // we'll never look this far up
-		ele->me_h = tree->root_h;
-		ele->me = tree->root;
+		ele->me_h = sprig->root_h;
+		ele->me = sprig->root;
 
-		r_h = tree->root->left_h;
+		r_h = sprig->root->left_h;
 		r = RESOLVE_H(r_h);
 
 		while (r_h != tree->sentinel_h) {
@@ -585,7 +697,7 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 		}
 
 		if (r_h == tree->sentinel_h) {
-			pthread_mutex_unlock(&tree->lock);
+			pthread_mutex_unlock(&sprig->lock);
 			return -1; // not found, nothing to delete
 		}
 
@@ -593,14 +705,14 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 
 		retry = false;
 
-		if (EBUSY == pthread_mutex_trylock(&tree->reduce_lock)) {
+		if (EBUSY == pthread_mutex_trylock(&sprig->reduce_lock)) {
 			// The tree is being reduced - could take long, unlock so reads and
 			// overwrites aren't blocked.
-			pthread_mutex_unlock(&tree->lock);
+			pthread_mutex_unlock(&sprig->lock);
 
 			// Wait until the tree reduce is done...
-			pthread_mutex_lock(&tree->reduce_lock);
-			pthread_mutex_unlock(&tree->reduce_lock);
+			pthread_mutex_lock(&sprig->reduce_lock);
+			pthread_mutex_unlock(&sprig->reduce_lock);
 
 			// ... and start over - we unlocked, so the tree may have changed.
 			retry = true;
@@ -609,6 +721,8 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 
 	// Delete the element.
 
+	as_index_restructure_begin(sprig);
+
 	// Snapshot the element to delete, r. (Already have r_h and r shortcuts.)
 	as_index_ele *r_e = ele;
 
@@ -659,7 +773,7 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 	// Rebalance at ele if necessary. (Note - if r != s, r is in the tree, and
 	// its parent may change during rebalancing.)
 	if (s->color == AS_BLACK) {
-		as_index_delete_rebalance(tree, ele);
+		as_index_delete_rebalance(tree, sprig, ele);
 	}
 
 	if (s != r) {
@@ -676,6 +790,10 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 		}
 	}
 
+	// Readers that reserved r during an unlocked search will now see the
+	// version change, and release r again.
+	as_index_restructure_end(sprig);
+
 	// We may now destroy r, which is no longer in the tree.
 	if (0 == as_index_release(r)) {
 		if (tree->destructor) {
@@ -687,20 +805,113 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 
 	cf_atomic_int_decr(&g_config.global_record_ref_count);
 
-	tree->elements--;
+	sprig->elements--;
+	cf_atomic32_decr(&tree->elements);
 
-	pthread_mutex_unlock(&tree->reduce_lock);
-	pthread_mutex_unlock(&tree->lock);
+	pthread_mutex_unlock(&sprig->reduce_lock);
+	pthread_mutex_unlock(&sprig->lock);
 
 	return 0;
 }
 
 
 
+// Walk the searches for several digests in lockstep, prefetching each search's
+// next element before moving on to the next search, so the searches' cache
+// misses overlap instead of adding up. Each digest is searched in the tree of
+// the same index - the trees must be reserved by the caller.
+//
+// Nothing is found, reserved, or locked - this just warms the cache for the
+// get/insert calls that follow. Like as_index_search_optimistic(), a walk that
+// races a writer reads garbage but can't fault, and the depth bound keeps it
+// from cycling. B+tree sprigs can't be walked without the sprig lock, so their
+// digests are skipped.
+void
+as_index_prefetch_multi(as_index_tree **trees, cf_digest *keyds, uint32_t n)
+{
+	while (n != 0) {
+		as_index_prefetch_state states[AS_INDEX_PREFETCH_GROUP];
+		uint32_t n_group = n < AS_INDEX_PREFETCH_GROUP ?
+				n : AS_INDEX_PREFETCH_GROUP;
+		uint32_t n_active = 0;
+
+		for (uint32_t i = 0; i < n_group; i++) {
+			as_index_tree *tree = trees[i];
+
+			if (tree->engine != AS_INDEX_ENGINE_RBTREE) {
+				continue;
+			}
+
+			as_index_prefetch_state *state = &states[n_active++];
+
+			state->tree = tree;
+			state->keyd = &keyds[i];
+			state->r_h = SPRIG_GET(state->keyd)->root->left_h;
+
+			__builtin_prefetch(RESOLVE_H(state->r_h));
+		}
+
+		for (uint32_t depth = 0; n_active != 0 && depth < MAX_SEARCH_DEPTH;
+				depth++) {
+			uint32_t i = 0;
+
+			while (i < n_active) {
+				as_index_prefetch_state *state = &states[i];
+				as_index_tree *tree = state->tree;
+
+				if (state->r_h != tree->sentinel_h) {
+					as_index *r = RESOLVE_H(state->r_h);
+					int cmp = cf_digest_compare(state->keyd, &r->key);
+
+					if (cmp != 0) {
+						state->r_h = cmp > 0 ? r->left_h : r->right_h;
+
+						if (state->r_h != tree->sentinel_h) {
+							__builtin_prefetch(RESOLVE_H(state->r_h));
+							i++;
+							continue;
+						}
+					}
+				}
+
+				// This search is done - drop it, keeping the active ones packed.
+				*state = states[--n_active];
+			}
+		}
+
+		trees += n_group;
+		keyds += n_group;
+		n -= n_group;
+	}
+}
+
+
+
 //==========================================================
 // Local helpers.
 //
 
+// Free the fixed roots (or B+tree nodes) and destroy the locks of the first
+// n_sprigs sprigs.
+void
+as_index_sprigs_destroy(as_index_tree *tree, uint32_t n_sprigs)
+{
+	for (uint32_t i = 0; i < n_sprigs; i++) {
+		as_index_sprig *sprig = &tree->sprigs[i];
+
+		if (tree->engine == AS_INDEX_ENGINE_BTREE) {
+			as_btree_destroy(&sprig->btree);
+		}
+		else {
+			cf_arenax_free(tree->arena, sprig->root_h);
+		}
+
+		pthread_mutex_destroy(&sprig->lock);
+		pthread_mutex_destroy(&sprig->reduce_lock);
+	}
+}
+
+
 void
 as_index_tree_purge(as_index_tree *tree, as_index *r, cf_arenax_handle r_h)
 {
@@ -724,9 +935,100 @@ as_index_tree_purge(as_index_tree *tree, as_index *r, cf_arenax_handle r_h)
 }
 
 
+// Make a callback for up to sample_count elements in a sprig, from outside the
+// sprig locks. Elements are collected REDUCE_CHUNK_SIZE at a time, each chunk
+// resuming after the last digest of the one before, with reduce_lock released
+// between chunks. Elements inserted ahead of the cursor during the reduce are
+// visited, those deleted ahead of it aren't. Returns the number of elements
+// reduced.
+uint32_t
+as_index_reduce_sprig(as_index_tree *tree, as_index_sprig *sprig,
+		uint32_t sample_count, as_index_reduce_fn cb, void *udata)
+{
+	uint8_t buf[sizeof(as_index_ph_array) +
+			(sizeof(as_index_ph) * REDUCE_CHUNK_SIZE)];
+	as_index_ph_array *v_a = (as_index_ph_array*)buf;
+	cf_digest cursor;
+	bool started = false;
+	uint32_t n_reduced = 0;
+
+	// Note - AS_REDUCE_ALL is the biggest possible sample_count.
+	while (n_reduced < sample_count) {
+		uint32_t n_left = sample_count - n_reduced;
+
+		v_a->alloc_sz = n_left < REDUCE_CHUNK_SIZE ? n_left : REDUCE_CHUNK_SIZE;
+		v_a->pos = 0;
+
+		pthread_mutex_lock(&sprig->reduce_lock);
+
+		// Fetch the next chunk of value pointers into the array, so we can make
+		// the callbacks outside the lock.
+		if (tree->engine == AS_INDEX_ENGINE_BTREE) {
+			as_index_btree_snapshot_info info = {
+					.tree = tree,
+					.v_a = v_a
+			};
+
+			if (started) {
+				as_btree_reduce_from(&sprig->btree, tree->arena, &cursor,
+						as_index_btree_snapshot_cb, &info);
+			}
+			else {
+				as_btree_reduce(&sprig->btree, as_index_btree_snapshot_cb,
+						&info);
+			}
+		}
+		else if (sprig->root->left_h != tree->sentinel_h) {
+			as_index_reduce_traverse(tree, sprig->root->left_h,
+					tree->sentinel_h, started ? &cursor : NULL, v_a);
+		}
+
+		pthread_mutex_unlock(&sprig->reduce_lock);
+
+		uint32_t n_chunk = v_a->pos;
+
+		if (n_chunk == 0) {
+			break;
+		}
+
+		// Our reservation keeps the element (and its digest) intact, even if a
+		// callback deletes it.
+		cursor = v_a->indexes[n_chunk - 1].r->key;
+		started = true;
+
+		for (uint32_t i = 0; i < n_chunk; i++) {
+			as_index_ref r_ref;
+
+			r_ref.skip_lock = false;
+			r_ref.r = v_a->indexes[i].r;
+			r_ref.r_h = v_a->indexes[i].r_h;
+
+			olock_vlock(g_config.record_locks, &r_ref.r->key, &r_ref.olock);
+			cf_atomic_int_incr(&g_config.global_record_lock_count);
+
+			// Callback MUST call as_record_done() to unlock and release record.
+			cb(&r_ref, udata);
+		}
+
+		n_reduced += n_chunk;
+
+		// A short chunk means we reached the end of the sprig.
+		if (n_chunk < v_a->alloc_sz) {
+			break;
+		}
+	}
+
+	return n_reduced;
+}
+
+
+// Collect elements in traversal order into v_a, until it's full. If after is
+// set, start with the first element after that digest's place in the order.
+// (Traversal order is descending digest order - bigger digests go left.)
 void
 as_index_reduce_traverse(as_index_tree *tree, cf_arenax_handle r_h,
-		cf_arenax_handle sentinel_h, as_index_ph_array *v_a)
+		cf_arenax_handle sentinel_h, cf_digest *after,
+		as_index_ph_array *v_a)
 {
 	if (v_a->pos >= v_a->alloc_sz) {
 		return;
@@ -734,8 +1036,22 @@ as_index_reduce_traverse(as_index_tree *tree, cf_arenax_handle r_h,
 
 	as_index *r = RESOLVE_H(r_h);
 
+	// If r isn't after the cursor, neither is anything in r's left sub-tree.
+	if (after && cf_digest_compare(after, &r->key) <= 0) {
+		if (r->right_h != sentinel_h) {
+			as_index_reduce_traverse(tree, r->right_h, sentinel_h, after, v_a);
+		}
+
+		return;
+	}
+
 	if (r->left_h != sentinel_h) {
-		as_index_reduce_traverse(tree, r->left_h, sentinel_h, v_a);
+		as_index_reduce_traverse(tree, r->left_h, sentinel_h, after, v_a);
+
+		// The left sub-tree may have filled the array.
+		if (v_a->pos >= v_a->alloc_sz) {
+			return;
+		}
 	}
 
 	as_index_reserve(r);
@@ -745,35 +1061,59 @@ as_index_reduce_traverse(as_index_tree *tree, cf_arenax_handle r_h,
 	v_a->indexes[v_a->pos].r_h = r_h;
 	v_a->pos++;
 
+	// Everything in r's right sub-tree is after r, so after the cursor.
 	if (r->right_h != sentinel_h) {
-		as_index_reduce_traverse(tree, r->right_h, sentinel_h, v_a);
+		as_index_reduce_traverse(tree, r->right_h, sentinel_h, NULL, v_a);
 	}
 }
 
 
-void
+// Returns the number of elements visited.
+uint32_t
 as_index_reduce_sync_traverse(as_index_tree *tree, as_index *r,
 		cf_arenax_handle sentinel_h, as_index_reduce_sync_fn cb, void *udata)
 {
+	uint32_t n = 1;
+
 	cb(r, udata);
 
 	if (r->left_h != sentinel_h) {
-		as_index_reduce_sync_traverse(tree, RESOLVE_H(r->left_h), sentinel_h,
-				cb, udata);
+		n += as_index_reduce_sync_traverse(tree, RESOLVE_H(r->left_h),
+				sentinel_h, cb, udata);
 	}
 
 	if (r->right_h != sentinel_h) {
-		as_index_reduce_sync_traverse(tree, RESOLVE_H(r->right_h), sentinel_h,
-				cb, udata);
+		n += as_index_reduce_sync_traverse(tree, RESOLVE_H(r->right_h),
+				sentinel_h, cb, udata);
 	}
+
+	return n;
 }
 
 
 int
-as_index_search_lockless(as_index_tree *tree, cf_digest *keyd, as_index **ret,
-		cf_arenax_handle *ret_h)
+as_index_search_lockless(as_index_tree *tree, as_index_sprig *sprig,
+		cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h)
 {
-	cf_arenax_handle r_h = tree->root->left_h;
+	if (tree->engine == AS_INDEX_ENGINE_BTREE) {
+		cf_arenax_handle b_h;
+
+		if (as_btree_search(&sprig->btree, tree->arena, keyd, &b_h) != 0) {
+			return -1; // not found
+		}
+
+		if (ret_h) {
+			*ret_h = b_h;
+		}
+
+		if (ret) {
+			*ret = RESOLVE_H(b_h);
+		}
+
+		return 0; // found
+	}
+
+	cf_arenax_handle r_h = sprig->root->left_h;
 	as_index *r = RESOLVE_H(r_h);
 
 	while (r_h != tree->sentinel_h) {
@@ -799,8 +1139,135 @@ as_index_search_lockless(as_index_tree *tree, cf_digest *keyd, as_index **ret,
 }
 
 
+// Search without the sprig lock. The sprig version is sampled before and after
+// - if it's odd, or has changed, an insert or delete may have restructured the
+// sprig under us and we report the race so the caller can retry.
+//
+// Handles we follow always resolve into mapped arena memory - elements are
+// never unmapped, only recycled - so a stale walk reads garbage but can't
+// fault. The depth bound keeps it from cycling.
+//
+// If ret is set, a found element is returned reserved.
+//
+// Returns:
+//		 0 - found
+//		-1 - not found
+//		SEARCH_RACED - raced a writer, result unknown
+int
+as_index_search_optimistic(as_index_tree *tree, as_index_sprig *sprig,
+		cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h)
+{
+	uint32_t version = __atomic_load_n(&sprig->version, __ATOMIC_ACQUIRE);
+
+	if ((version & 1) != 0) {
+		return SEARCH_RACED;
+	}
+
+	cf_arenax_handle r_h = sprig->root->left_h;
+	uint32_t depth = 0;
+
+	while (r_h != tree->sentinel_h) {
+		if (++depth > MAX_SEARCH_DEPTH) {
+			return SEARCH_RACED;
+		}
+
+		as_index *r = RESOLVE_H(r_h);
+		int cmp = cf_digest_compare(keyd, &r->key);
+
+		if (cmp == 0) {
+			if (! ret) {
+				__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+				return __atomic_load_n(&sprig->version, __ATOMIC_RELAXED) ==
+						version ? 0 : SEARCH_RACED;
+			}
+
+			if (! as_index_reserve_if_live(r)) {
+				return SEARCH_RACED;
+			}
+
+			// The reserve was a full barrier - if the version still matches,
+			// r was in the tree when we reserved it.
+			if (__atomic_load_n(&sprig->version, __ATOMIC_RELAXED) != version) {
+				as_index_release_unlocked(tree, r, r_h);
+				return SEARCH_RACED;
+			}
+
+			*ret = r;
+
+			if (ret_h) {
+				*ret_h = r_h;
+			}
+
+			return 0; // found
+		}
+
+		r_h = cmp > 0 ? r->left_h : r->right_h;
+	}
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&sprig->version, __ATOMIC_RELAXED) == version ?
+			-1 : SEARCH_RACED;
+}
+
+
+// Reserve an element found without the tree lock, unless it's already dead -
+// its last reference is gone, or it's on the arena free list (which overlays
+// rc with the free magic). Never resurrects an element from zero.
+bool
+as_index_reserve_if_live(as_index *r)
+{
+	uint32_t rc = __atomic_load_n(&r->rc, __ATOMIC_RELAXED);
+
+	while (rc != 0 && rc != FREE_MAGIC) {
+		if (__atomic_compare_exchange_n(&r->rc, &rc, rc + 1, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+// Drop a reservation taken by an unlocked search that lost its race. If the
+// element was deleted meanwhile we may hold the last reference, in which case
+// we destroy it, as as_record_done() would.
 void
-as_index_insert_rebalance(as_index_tree *tree, as_index_ele *ele)
+as_index_release_unlocked(as_index_tree *tree, as_index *r,
+		cf_arenax_handle r_h)
+{
+	if (0 == as_index_release(r)) {
+		if (tree->destructor) {
+			tree->destructor(r, tree->destructor_udata);
+		}
+
+		cf_arenax_free(tree->arena, r_h);
+	}
+}
+
+
+// Writers, holding the sprig lock, bracket restructuring with these. The atomic
+// increments are full barriers, so a reader that sees the same even version
+// before and after its search saw no restructuring.
+void
+as_index_restructure_begin(as_index_sprig *sprig)
+{
+	__atomic_add_fetch(&sprig->version, 1, __ATOMIC_SEQ_CST);
+}
+
+
+void
+as_index_restructure_end(as_index_sprig *sprig)
+{
+	__atomic_add_fetch(&sprig->version, 1, __ATOMIC_SEQ_CST);
+}
+
+
+void
+as_index_insert_rebalance(as_index_tree *tree, as_index_sprig *sprig,
+		as_index_ele *ele)
 {
 	// Entering here, ele is the last element on the stack. It turns out during
 	// insert rebalancing we won't ever need new elements on the stack, but make
@@ -885,19 +1352,20 @@ as_index_insert_rebalance(as_index_tree *tree, as_index_ele *ele)
 		}
 	}
 
-	RESOLVE_H(tree->root->left_h)->color = AS_BLACK;
+	RESOLVE_H(sprig->root->left_h)->color = AS_BLACK;
 }
 
 
 void
-as_index_delete_rebalance(as_index_tree *tree, as_index_ele *ele)
+as_index_delete_rebalance(as_index_tree *tree, as_index_sprig *sprig,
+		as_index_ele *ele)
 {
 	// Entering here, ele is the last element on the stack. It's possible as r_e
 	// crawls up the tree, we'll need new elements on the stack, in which case
 	// ele keeps building the stack down while r_e goes up.
 	as_index_ele *r_e = ele;
 
-	while (r_e->me->color == AS_BLACK && r_e->me_h != tree->root->left_h) {
+	while (r_e->me->color == AS_BLACK && r_e->me_h != sprig->root->left_h) {
 		as_index *r_parent = r_e->parent->me;
 
 		if (r_e->me_h == r_parent->left_h) {
@@ -961,7 +1429,7 @@ as_index_delete_rebalance(as_index_tree *tree, as_index_ele *ele)
 
 				as_index_rotate_left(tree, r_e->parent, ele);
 
-				RESOLVE_H(tree->root->left_h)->color = AS_BLACK;
+				RESOLVE_H(sprig->root->left_h)->color = AS_BLACK;
 
 				return;
 			}
@@ -1027,7 +1495,7 @@ as_index_delete_rebalance(as_index_tree *tree, as_index_ele *ele)
 
 				as_index_rotate_right(tree, r_e->parent, ele);
 
-				RESOLVE_H(tree->root->left_h)->color = AS_BLACK;
+				RESOLVE_H(sprig->root->left_h)->color = AS_BLACK;
 
 				return;
 			}
@@ -1106,6 +1574,203 @@ as_index_rotate_right(as_index_tree *tree, as_index_ele *a, as_index_ele *b)
 }
 
 
+//------------------------------------------------
+// B+tree sprigs (index-engine btree).
+//
+
+// Same contract as as_index_get_insert_vlock(). B+tree searches are fast enough
+// that we don't bother searching without the sprig lock.
+int
+as_index_btree_get_insert_vlock(as_index_tree *tree, as_index_sprig *sprig,
+		cf_digest *keyd, as_index_ref *index_ref)
+{
+	cf_arenax_handle r_h;
+	bool retry;
+
+	do {
+		pthread_mutex_lock(&sprig->lock);
+
+		if (as_btree_search(&sprig->btree, tree->arena, keyd, &r_h) == 0) {
+			// The element already exists, simply return it.
+			as_index *r = RESOLVE_H(r_h);
+
+			as_index_reserve(r);
+			cf_atomic_int_incr(&g_config.global_record_ref_count);
+
+			pthread_mutex_unlock(&sprig->lock);
+
+			if (! index_ref->skip_lock) {
+				olock_vlock(g_config.record_locks, keyd, &index_ref->olock);
+				cf_atomic_int_incr(&g_config.global_record_lock_count);
+			}
+
+			index_ref->r = r;
+			index_ref->r_h = r_h;
+
+			return 0;
+		}
+
+		retry = false;
+
+		if (EBUSY == pthread_mutex_trylock(&sprig->reduce_lock)) {
+			// The tree is being reduced - wait, then start over.
+			pthread_mutex_unlock(&sprig->lock);
+			pthread_mutex_lock(&sprig->reduce_lock);
+			pthread_mutex_unlock(&sprig->reduce_lock);
+			retry = true;
+		}
+	} while (retry);
+
+	cf_arenax_handle n_h = cf_arenax_alloc(tree->arena);
+
+	if (n_h == 0) {
+		cf_warning(AS_INDEX, "arenax alloc failed");
+		pthread_mutex_unlock(&sprig->reduce_lock);
+		pthread_mutex_unlock(&sprig->lock);
+		return -1;
+	}
+
+	as_index *n = RESOLVE_H(n_h);
+
+	n->rc = 2; // one for create (eventually balanced by delete), one for caller
+	cf_atomic_int_add(&g_config.global_record_ref_count, 2);
+
+	n->key = *keyd;
+
+	// Unused by B+tree sprigs.
+	n->left_h = n->right_h = 0;
+	n->color = AS_BLACK;
+
+	// Make sure we can detect that the record isn't initialized.
+	as_index_clear_record_info(n);
+
+	as_btree_insert(&sprig->btree, tree->arena, n_h);
+
+	sprig->elements++;
+	cf_atomic32_incr(&tree->elements);
+
+	pthread_mutex_unlock(&sprig->reduce_lock);
+	pthread_mutex_unlock(&sprig->lock);
+
+	if (! index_ref->skip_lock) {
+		olock_vlock(g_config.record_locks, keyd, &index_ref->olock);
+		cf_atomic_int_incr(&g_config.global_record_lock_count);
+	}
+
+	index_ref->r = n;
+	index_ref->r_h = n_h;
+
+	return 1;
+}
+
+
+// Same contract as as_index_delete().
+int
+as_index_btree_delete(as_index_tree *tree, as_index_sprig *sprig,
+		cf_digest *keyd)
+{
+	cf_arenax_handle r_h;
+	bool retry;
+
+	do {
+		pthread_mutex_lock(&sprig->lock);
+
+		if (as_btree_search(&sprig->btree, tree->arena, keyd, &r_h) != 0) {
+			pthread_mutex_unlock(&sprig->lock);
+			return -1; // not found, nothing to delete
+		}
+
+		retry = false;
+
+		if (EBUSY == pthread_mutex_trylock(&sprig->reduce_lock)) {
+			// The tree is being reduced - wait, then start over.
+			pthread_mutex_unlock(&sprig->lock);
+			pthread_mutex_lock(&sprig->reduce_lock);
+			pthread_mutex_unlock(&sprig->reduce_lock);
+			retry = true;
+		}
+	} while (retry);
+
+	as_btree_delete(&sprig->btree, tree->arena, keyd, &r_h);
+
+	as_index *r = RESOLVE_H(r_h);
+
+	if (0 == as_index_release(r)) {
+		if (tree->destructor) {
+			tree->destructor(r, tree->destructor_udata);
+		}
+
+		cf_arenax_free(tree->arena, r_h);
+	}
+
+	cf_atomic_int_decr(&g_config.global_record_ref_count);
+
+	sprig->elements--;
+	cf_atomic32_decr(&tree->elements);
+
+	pthread_mutex_unlock(&sprig->reduce_lock);
+	pthread_mutex_unlock(&sprig->lock);
+
+	return 0;
+}
+
+
+// as_btree_reduce() callback - the B+tree flavor of as_index_tree_purge().
+bool
+as_index_btree_purge_cb(cf_arenax_handle r_h, void *udata)
+{
+	as_index_tree *tree = (as_index_tree*)udata;
+	as_index *r = RESOLVE_H(r_h);
+
+	if (0 == as_index_release(r)) {
+		if (tree->destructor) {
+			tree->destructor(r, tree->destructor_udata);
+		}
+
+		cf_arenax_free(tree->arena, r_h);
+	}
+
+	cf_atomic_int_decr(&g_config.global_record_ref_count);
+
+	return true;
+}
+
+
+// as_btree_reduce() callback - the B+tree flavor of as_index_reduce_traverse().
+bool
+as_index_btree_snapshot_cb(cf_arenax_handle r_h, void *udata)
+{
+	as_index_btree_snapshot_info *info = (as_index_btree_snapshot_info*)udata;
+	as_index_tree *tree = info->tree;
+	as_index_ph_array *v_a = info->v_a;
+	as_index *r = RESOLVE_H(r_h);
+
+	as_index_reserve(r);
+	cf_atomic_int_incr(&g_config.global_record_ref_count);
+
+	v_a->indexes[v_a->pos].r = r;
+	v_a->indexes[v_a->pos].r_h = r_h;
+	v_a->pos++;
+
+	return v_a->pos < v_a->alloc_sz;
+}
+
+
+// as_btree_reduce() callback - the B+tree flavor of
+// as_index_reduce_sync_traverse().
+bool
+as_index_btree_sync_cb(cf_arenax_handle r_h, void *udata)
+{
+	as_index_btree_sync_info *info = (as_index_btree_sync_info*)udata;
+	as_index_tree *tree = info->tree;
+
+	info->cb(RESOLVE_H(r_h), info->udata);
+	info->n_elements++;
+
+	return true;
+}
+
+
 
 //==========================================================
 // KV API - currently unmaintained.
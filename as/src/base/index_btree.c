@@ -0,0 +1,737 @@
+/*
+ * index_btree.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "base/index_btree.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_digest.h"
+
+#include "arenax.h"
+#include "fault.h"
+
+#include "base/index.h"
+
+
+
+//==========================================================
+// Typedefs and constants.
+//
+
+// Maximum keys per node. A leaf is then 6 cache lines.
+#define BTREE_ORDER 32
+
+// A leaf left with this many keys or fewer is merged into a sibling if they fit.
+#define BTREE_MERGE_KEYS (BTREE_ORDER / 4)
+
+// Far deeper than a sprig's worth of elements can make the tree.
+#define BTREE_MAX_DEPTH 32
+
+// Leaves and inner nodes share this header. Keys are ordered by prefix, then
+// by whole digest - prefixes alone decide almost every comparison.
+struct as_btree_node_s {
+	uint32_t	n_keys;
+	uint32_t	is_leaf;
+	uint64_t	prefixes[BTREE_ORDER];
+};
+
+typedef struct btree_leaf_s {
+	as_btree_node		hdr;
+	cf_arenax_handle	handles[BTREE_ORDER];
+} btree_leaf;
+
+// Key i bounds children i and i + 1 - all keys in child i are less than it, and
+// all keys in child i + 1 are at least it.
+typedef struct btree_inner_s {
+	as_btree_node	hdr;
+	cf_digest		keys[BTREE_ORDER];
+	as_btree_node	*children[BTREE_ORDER + 1];
+} btree_inner;
+
+// Inner nodes visited on the way down, and which child was taken.
+typedef struct btree_path_s {
+	btree_inner	*node;
+	uint32_t	child_ix;
+} btree_path;
+
+
+
+//==========================================================
+// Forward declarations.
+//
+
+as_btree_node *btree_node_create(bool is_leaf);
+void btree_node_destroy(as_btree_node *node);
+void btree_node_destroy_all(as_btree_node *node);
+uint64_t btree_node_size(const as_btree_node *node);
+bool btree_node_reduce(as_btree_node *node, as_btree_reduce_fn cb, void *udata);
+bool btree_node_reduce_from(as_btree_node *node, cf_arenax *arena, uint64_t prefix, const cf_digest *keyd, as_btree_reduce_fn cb, void *udata);
+btree_leaf *btree_descend(as_btree *bt, uint64_t prefix, const cf_digest *keyd, btree_path *path, uint32_t *p_depth);
+uint32_t btree_prefix_lower_bound(const as_btree_node *node, uint64_t prefix);
+uint32_t btree_leaf_lower_bound(cf_arenax *arena, const btree_leaf *leaf, uint64_t prefix, const cf_digest *keyd, bool *p_found);
+uint32_t btree_inner_child_ix(const btree_inner *inner, uint64_t prefix, const cf_digest *keyd);
+void btree_leaf_insert_at(btree_leaf *leaf, uint32_t ix, uint64_t prefix, cf_arenax_handle h);
+void btree_leaf_remove_at(btree_leaf *leaf, uint32_t ix);
+void btree_inner_insert_at(btree_inner *inner, uint32_t ix, uint64_t prefix, const cf_digest *key, as_btree_node *right);
+void btree_inner_remove_child(btree_inner *inner, uint32_t ix);
+void btree_insert_parent(as_btree *bt, btree_path *path, uint32_t depth, uint64_t prefix, const cf_digest *key, as_btree_node *right);
+void btree_leaf_merge(btree_inner *parent, uint32_t child_ix);
+void btree_collapse_root(as_btree *bt);
+
+// Digest bytes the partition ID and sprig selection don't use.
+static inline uint64_t
+btree_prefix(const cf_digest *keyd)
+{
+	uint64_t prefix;
+
+	memcpy(&prefix, &keyd->digest[12], sizeof(prefix));
+
+	return prefix;
+}
+
+static inline const cf_digest *
+btree_leaf_key(cf_arenax *arena, const btree_leaf *leaf, uint32_t ix)
+{
+	return &((as_index *)cf_arenax_resolve(arena, leaf->handles[ix]))->key;
+}
+
+
+
+//==========================================================
+// Public API.
+//
+
+void
+as_btree_init(as_btree *bt)
+{
+	bt->root = NULL;
+}
+
+
+// Frees the nodes only - the caller disposes of the elements.
+void
+as_btree_destroy(as_btree *bt)
+{
+	if (bt->root) {
+		btree_node_destroy_all(bt->root);
+		bt->root = NULL;
+	}
+}
+
+
+int
+as_btree_search(as_btree *bt, cf_arenax *arena, const cf_digest *keyd,
+		cf_arenax_handle *ret_h)
+{
+	if (! bt->root) {
+		return -1;
+	}
+
+	uint64_t prefix = btree_prefix(keyd);
+	uint32_t depth;
+	btree_leaf *leaf = btree_descend(bt, prefix, keyd, NULL, &depth);
+	bool found;
+	uint32_t ix = btree_leaf_lower_bound(arena, leaf, prefix, keyd, &found);
+
+	if (! found) {
+		return -1;
+	}
+
+	*ret_h = leaf->handles[ix];
+
+	return 0;
+}
+
+
+void
+as_btree_insert(as_btree *bt, cf_arenax *arena, cf_arenax_handle h)
+{
+	const cf_digest *keyd = &((as_index *)cf_arenax_resolve(arena, h))->key;
+	uint64_t prefix = btree_prefix(keyd);
+
+	if (! bt->root) {
+		btree_leaf *leaf = (btree_leaf *)btree_node_create(true);
+
+		btree_leaf_insert_at(leaf, 0, prefix, h);
+		bt->root = &leaf->hdr;
+
+		return;
+	}
+
+	btree_path path[BTREE_MAX_DEPTH];
+	uint32_t depth;
+	btree_leaf *leaf = btree_descend(bt, prefix, keyd, path, &depth);
+	bool found;
+	uint32_t ix = btree_leaf_lower_bound(arena, leaf, prefix, keyd, &found);
+
+	if (found) {
+		cf_crash(AS_INDEX, "btree insert of element already in tree");
+	}
+
+	if (leaf->hdr.n_keys < BTREE_ORDER) {
+		btree_leaf_insert_at(leaf, ix, prefix, h);
+		return;
+	}
+
+	// Split the full leaf, moving its upper half to a new right sibling.
+	btree_leaf *right = (btree_leaf *)btree_node_create(true);
+	uint32_t n_left = BTREE_ORDER / 2;
+	uint32_t n_right = BTREE_ORDER - n_left;
+
+	memcpy(right->hdr.prefixes, &leaf->hdr.prefixes[n_left],
+			n_right * sizeof(uint64_t));
+	memcpy(right->handles, &leaf->handles[n_left],
+			n_right * sizeof(cf_arenax_handle));
+
+	right->hdr.n_keys = n_right;
+	leaf->hdr.n_keys = n_left;
+
+	if (ix <= n_left) {
+		btree_leaf_insert_at(leaf, ix, prefix, h);
+	}
+	else {
+		btree_leaf_insert_at(right, ix - n_left, prefix, h);
+	}
+
+	cf_digest key = *btree_leaf_key(arena, right, 0);
+
+	btree_insert_parent(bt, path, depth, right->hdr.prefixes[0], &key,
+			&right->hdr);
+}
+
+
+int
+as_btree_delete(as_btree *bt, cf_arenax *arena, const cf_digest *keyd,
+		cf_arenax_handle *ret_h)
+{
+	if (! bt->root) {
+		return -1;
+	}
+
+	uint64_t prefix = btree_prefix(keyd);
+	btree_path path[BTREE_MAX_DEPTH];
+	uint32_t depth;
+	btree_leaf *leaf = btree_descend(bt, prefix, keyd, path, &depth);
+	bool found;
+	uint32_t ix = btree_leaf_lower_bound(arena, leaf, prefix, keyd, &found);
+
+	if (! found) {
+		return -1;
+	}
+
+	*ret_h = leaf->handles[ix];
+	btree_leaf_remove_at(leaf, ix);
+
+	if (leaf->hdr.n_keys != 0) {
+		// Fold a sparse leaf into a sibling once both fit in half a leaf. The
+		// gap to the split point keeps churn from splitting and merging the
+		// same leaf back and forth.
+		if (depth != 0 && leaf->hdr.n_keys <= BTREE_MERGE_KEYS) {
+			btree_leaf_merge(path[depth - 1].node, path[depth - 1].child_ix);
+			btree_collapse_root(bt);
+		}
+
+		return 0;
+	}
+
+	as_btree_node *empty = &leaf->hdr;
+
+	while (true) {
+		btree_node_destroy(empty);
+
+		if (depth == 0) {
+			bt->root = NULL;
+			return 0;
+		}
+
+		btree_path *p = &path[--depth];
+
+		if (p->node->hdr.n_keys != 0) {
+			btree_inner_remove_child(p->node, p->child_ix);
+			break;
+		}
+
+		// The inner node's only child is gone - it's empty too.
+		empty = &p->node->hdr;
+	}
+
+	btree_collapse_root(bt);
+
+	return 0;
+}
+
+
+// Heap bytes used by the nodes.
+uint64_t
+as_btree_size(const as_btree *bt)
+{
+	return bt->root ? btree_node_size(bt->root) : 0;
+}
+
+
+void
+as_btree_reduce(as_btree *bt, as_btree_reduce_fn cb, void *udata)
+{
+	if (bt->root) {
+		btree_node_reduce(bt->root, cb, udata);
+	}
+}
+
+
+void
+as_btree_reduce_from(as_btree *bt, cf_arenax *arena, const cf_digest *keyd,
+		as_btree_reduce_fn cb, void *udata)
+{
+	if (bt->root) {
+		btree_node_reduce_from(bt->root, arena, btree_prefix(keyd), keyd, cb,
+				udata);
+	}
+}
+
+
+
+//==========================================================
+// Local helpers.
+//
+
+as_btree_node *
+btree_node_create(bool is_leaf)
+{
+	size_t sz = is_leaf ? sizeof(btree_leaf) : sizeof(btree_inner);
+	as_btree_node *node = cf_malloc(sz);
+
+	if (! node) {
+		cf_crash(AS_INDEX, "failed btree node alloc");
+	}
+
+	node->n_keys = 0;
+	node->is_leaf = is_leaf ? 1 : 0;
+
+	return node;
+}
+
+
+void
+btree_node_destroy(as_btree_node *node)
+{
+	cf_free(node);
+}
+
+
+void
+btree_node_destroy_all(as_btree_node *node)
+{
+	if (! node->is_leaf) {
+		btree_inner *inner = (btree_inner *)node;
+
+		for (uint32_t i = 0; i <= inner->hdr.n_keys; i++) {
+			btree_node_destroy_all(inner->children[i]);
+		}
+	}
+
+	btree_node_destroy(node);
+}
+
+
+uint64_t
+btree_node_size(const as_btree_node *node)
+{
+	if (node->is_leaf) {
+		return sizeof(btree_leaf);
+	}
+
+	const btree_inner *inner = (const btree_inner *)node;
+	uint64_t sz = sizeof(btree_inner);
+
+	for (uint32_t i = 0; i <= inner->hdr.n_keys; i++) {
+		sz += btree_node_size(inner->children[i]);
+	}
+
+	return sz;
+}
+
+
+bool
+btree_node_reduce(as_btree_node *node, as_btree_reduce_fn cb, void *udata)
+{
+	if (node->is_leaf) {
+		btree_leaf *leaf = (btree_leaf *)node;
+
+		for (uint32_t i = 0; i < leaf->hdr.n_keys; i++) {
+			if (! cb(leaf->handles[i], udata)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	btree_inner *inner = (btree_inner *)node;
+
+	for (uint32_t i = 0; i <= inner->hdr.n_keys; i++) {
+		if (! btree_node_reduce(inner->children[i], cb, udata)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+// Like btree_node_reduce(), but skipping keys not greater than the given key.
+bool
+btree_node_reduce_from(as_btree_node *node, cf_arenax *arena, uint64_t prefix,
+		const cf_digest *keyd, as_btree_reduce_fn cb, void *udata)
+{
+	if (node->is_leaf) {
+		btree_leaf *leaf = (btree_leaf *)node;
+		bool found;
+		uint32_t ix = btree_leaf_lower_bound(arena, leaf, prefix, keyd, &found);
+
+		if (found) {
+			ix++;
+		}
+
+		for (uint32_t i = ix; i < leaf->hdr.n_keys; i++) {
+			if (! cb(leaf->handles[i], udata)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	btree_inner *inner = (btree_inner *)node;
+	uint32_t ix = btree_inner_child_ix(inner, prefix, keyd);
+
+	if (! btree_node_reduce_from(inner->children[ix], arena, prefix, keyd, cb,
+			udata)) {
+		return false;
+	}
+
+	for (uint32_t i = ix + 1; i <= inner->hdr.n_keys; i++) {
+		if (! btree_node_reduce(inner->children[i], cb, udata)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+btree_leaf *
+btree_descend(as_btree *bt, uint64_t prefix, const cf_digest *keyd,
+		btree_path *path, uint32_t *p_depth)
+{
+	as_btree_node *node = bt->root;
+	uint32_t depth = 0;
+
+	while (! node->is_leaf) {
+		btree_inner *inner = (btree_inner *)node;
+		uint32_t ix = btree_inner_child_ix(inner, prefix, keyd);
+
+		if (depth == BTREE_MAX_DEPTH) {
+			cf_crash(AS_INDEX, "btree deeper than %u", BTREE_MAX_DEPTH);
+		}
+
+		if (path) {
+			path[depth].node = inner;
+			path[depth].child_ix = ix;
+		}
+
+		depth++;
+		node = inner->children[ix];
+	}
+
+	*p_depth = depth;
+
+	return (btree_leaf *)node;
+}
+
+
+uint32_t
+btree_prefix_lower_bound(const as_btree_node *node, uint64_t prefix)
+{
+	uint32_t lo = 0;
+	uint32_t hi = node->n_keys;
+
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+
+		if (node->prefixes[mid] < prefix) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+
+// Position of the first key not less than the given key.
+uint32_t
+btree_leaf_lower_bound(cf_arenax *arena, const btree_leaf *leaf,
+		uint64_t prefix, const cf_digest *keyd, bool *p_found)
+{
+	uint32_t ix = btree_prefix_lower_bound(&leaf->hdr, prefix);
+
+	*p_found = false;
+
+	// Only prefix ties need the element resolved.
+	while (ix < leaf->hdr.n_keys && leaf->hdr.prefixes[ix] == prefix) {
+		int cmp = memcmp(btree_leaf_key(arena, leaf, ix), keyd,
+				sizeof(cf_digest));
+
+		if (cmp == 0) {
+			*p_found = true;
+			break;
+		}
+
+		if (cmp > 0) {
+			break;
+		}
+
+		ix++;
+	}
+
+	return ix;
+}
+
+
+// Child to descend into - the number of keys not greater than the given key.
+uint32_t
+btree_inner_child_ix(const btree_inner *inner, uint64_t prefix,
+		const cf_digest *keyd)
+{
+	uint32_t ix = btree_prefix_lower_bound(&inner->hdr, prefix);
+
+	while (ix < inner->hdr.n_keys && inner->hdr.prefixes[ix] == prefix &&
+			memcmp(&inner->keys[ix], keyd, sizeof(cf_digest)) <= 0) {
+		ix++;
+	}
+
+	return ix;
+}
+
+
+void
+btree_leaf_insert_at(btree_leaf *leaf, uint32_t ix, uint64_t prefix,
+		cf_arenax_handle h)
+{
+	uint32_t n_move = leaf->hdr.n_keys - ix;
+
+	memmove(&leaf->hdr.prefixes[ix + 1], &leaf->hdr.prefixes[ix],
+			n_move * sizeof(uint64_t));
+	memmove(&leaf->handles[ix + 1], &leaf->handles[ix],
+			n_move * sizeof(cf_arenax_handle));
+
+	leaf->hdr.prefixes[ix] = prefix;
+	leaf->handles[ix] = h;
+	leaf->hdr.n_keys++;
+}
+
+
+void
+btree_leaf_remove_at(btree_leaf *leaf, uint32_t ix)
+{
+	uint32_t n_move = leaf->hdr.n_keys - ix - 1;
+
+	memmove(&leaf->hdr.prefixes[ix], &leaf->hdr.prefixes[ix + 1],
+			n_move * sizeof(uint64_t));
+	memmove(&leaf->handles[ix], &leaf->handles[ix + 1],
+			n_move * sizeof(cf_arenax_handle));
+
+	leaf->hdr.n_keys--;
+}
+
+
+// Insert key at ix, with its right child at ix + 1.
+void
+btree_inner_insert_at(btree_inner *inner, uint32_t ix, uint64_t prefix,
+		const cf_digest *key, as_btree_node *right)
+{
+	uint32_t n_move = inner->hdr.n_keys - ix;
+
+	memmove(&inner->hdr.prefixes[ix + 1], &inner->hdr.prefixes[ix],
+			n_move * sizeof(uint64_t));
+	memmove(&inner->keys[ix + 1], &inner->keys[ix],
+			n_move * sizeof(cf_digest));
+	memmove(&inner->children[ix + 2], &inner->children[ix + 1],
+			n_move * sizeof(as_btree_node *));
+
+	inner->hdr.prefixes[ix] = prefix;
+	inner->keys[ix] = *key;
+	inner->children[ix + 1] = right;
+	inner->hdr.n_keys++;
+}
+
+
+// Remove a child that's empty or merged away, with the key before it - or for
+// the first child, the key after it. Either way, the remaining bounds still
+// hold.
+void
+btree_inner_remove_child(btree_inner *inner, uint32_t ix)
+{
+	uint32_t n_keys = inner->hdr.n_keys;
+	uint32_t key_ix = ix == 0 ? 0 : ix - 1;
+
+	memmove(&inner->hdr.prefixes[key_ix], &inner->hdr.prefixes[key_ix + 1],
+			(n_keys - key_ix - 1) * sizeof(uint64_t));
+	memmove(&inner->keys[key_ix], &inner->keys[key_ix + 1],
+			(n_keys - key_ix - 1) * sizeof(cf_digest));
+	memmove(&inner->children[ix], &inner->children[ix + 1],
+			(n_keys - ix) * sizeof(as_btree_node *));
+
+	inner->hdr.n_keys--;
+}
+
+
+// A child at the bottom of path split - insert the new key and right sibling
+// into its parent, splitting upward as needed.
+void
+btree_insert_parent(as_btree *bt, btree_path *path, uint32_t depth,
+		uint64_t prefix, const cf_digest *key, as_btree_node *right)
+{
+	cf_digest up_key = *key;
+
+	while (depth != 0) {
+		btree_path *p = &path[--depth];
+		btree_inner *inner = p->node;
+		uint32_t ix = p->child_ix;
+
+		if (inner->hdr.n_keys < BTREE_ORDER) {
+			btree_inner_insert_at(inner, ix, prefix, &up_key, right);
+			return;
+		}
+
+		// Split the full inner node - lay out all keys and children including
+		// the new ones, then the middle key moves up.
+		uint64_t prefixes[BTREE_ORDER + 1];
+		cf_digest keys[BTREE_ORDER + 1];
+		as_btree_node *children[BTREE_ORDER + 2];
+
+		memcpy(prefixes, inner->hdr.prefixes, ix * sizeof(uint64_t));
+		memcpy(keys, inner->keys, ix * sizeof(cf_digest));
+		memcpy(children, inner->children, (ix + 1) * sizeof(as_btree_node *));
+
+		prefixes[ix] = prefix;
+		keys[ix] = up_key;
+		children[ix + 1] = right;
+
+		memcpy(&prefixes[ix + 1], &inner->hdr.prefixes[ix],
+				(BTREE_ORDER - ix) * sizeof(uint64_t));
+		memcpy(&keys[ix + 1], &inner->keys[ix],
+				(BTREE_ORDER - ix) * sizeof(cf_digest));
+		memcpy(&children[ix + 2], &inner->children[ix + 1],
+				(BTREE_ORDER - ix) * sizeof(as_btree_node *));
+
+		uint32_t n_left = (BTREE_ORDER + 1) / 2;
+		uint32_t n_right = BTREE_ORDER - n_left;
+		btree_inner *sibling = (btree_inner *)btree_node_create(false);
+
+		memcpy(inner->hdr.prefixes, prefixes, n_left * sizeof(uint64_t));
+		memcpy(inner->keys, keys, n_left * sizeof(cf_digest));
+		memcpy(inner->children, children,
+				(n_left + 1) * sizeof(as_btree_node *));
+		inner->hdr.n_keys = n_left;
+
+		memcpy(sibling->hdr.prefixes, &prefixes[n_left + 1],
+				n_right * sizeof(uint64_t));
+		memcpy(sibling->keys, &keys[n_left + 1], n_right * sizeof(cf_digest));
+		memcpy(sibling->children, &children[n_left + 1],
+				(n_right + 1) * sizeof(as_btree_node *));
+		sibling->hdr.n_keys = n_right;
+
+		prefix = prefixes[n_left];
+		up_key = keys[n_left];
+		right = &sibling->hdr;
+	}
+
+	// The root split - grow a new root above it.
+	btree_inner *root = (btree_inner *)btree_node_create(false);
+
+	root->hdr.prefixes[0] = prefix;
+	root->keys[0] = up_key;
+	root->children[0] = bt->root;
+	root->children[1] = right;
+	root->hdr.n_keys = 1;
+
+	bt->root = &root->hdr;
+}
+
+
+// Merge the sparse leaf at child_ix with its left sibling, or if it's the first
+// child, with its right sibling - if their keys fit in half a leaf. The right
+// leaf of the pair moves into the left one. Inner nodes aren't merged, only
+// removed once empty - there are few enough of them not to matter.
+void
+btree_leaf_merge(btree_inner *parent, uint32_t child_ix)
+{
+	if (parent->hdr.n_keys == 0) {
+		return; // no sibling
+	}
+
+	uint32_t right_ix = child_ix == 0 ? 1 : child_ix;
+	btree_leaf *left = (btree_leaf *)parent->children[right_ix - 1];
+	btree_leaf *right = (btree_leaf *)parent->children[right_ix];
+	uint32_t n_left = left->hdr.n_keys;
+	uint32_t n_right = right->hdr.n_keys;
+
+	if (n_left + n_right > BTREE_ORDER / 2) {
+		return;
+	}
+
+	memcpy(&left->hdr.prefixes[n_left], right->hdr.prefixes,
+			n_right * sizeof(uint64_t));
+	memcpy(&left->handles[n_left], right->handles,
+			n_right * sizeof(cf_arenax_handle));
+
+	left->hdr.n_keys = n_left + n_right;
+
+	// Drops the bound between the two leaves - the merged leaf's keys all fall
+	// between the bounds either side of the pair.
+	btree_inner_remove_child(parent, right_ix);
+	btree_node_destroy(&right->hdr);
+}
+
+
+// Collapse roots that route everything to a single child.
+void
+btree_collapse_root(as_btree *bt)
+{
+	while (! bt->root->is_leaf && bt->root->n_keys == 0) {
+		btree_inner *root = (btree_inner *)bt->root;
+
+		bt->root = root->children[0];
+		btree_node_destroy(&root->hdr);
+	}
+}
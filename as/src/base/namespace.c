@@ -131,6 +131,10 @@ as_namespace_create(char *name, uint16_t replication_factor)
 	ns->migrate_order = 5;
 	ns->migrate_sleep = 1;
 	ns->obj_size_hist_max = OBJ_SIZE_HIST_NUM_BUCKETS;
+	ns->index_engine = AS_INDEX_ENGINE_RBTREE;
+	ns->index_huge_pages = 0; // arena stages use default pages
+	ns->index_numa_policy = 0; // arena stages use default NUMA policy
+	ns->partition_tree_sprigs = 1; // a single red-black tree per partition
 	ns->single_bin = false;
 	ns->stop_writes_pct = 0.9; // stop writes when 90% of either memory or disk is used
 
@@ -151,13 +155,29 @@ as_namespace_create(char *name, uint16_t replication_factor)
 	ns->storage_defrag_lwm_pct = 50; // defrag if occupancy of block is < 50%
 	ns->storage_defrag_queue_min = 0; // don't defrag unless the queue has this many eligible wblocks (0: defrag anything queued)
 	ns->storage_defrag_sleep = 1000; // sleep this many microseconds between each wblock
+	ns->storage_defrag_adaptive = false; // don't adjust defrag-sleep to device load and free space
+	ns->storage_cold_stream_ttl = 0; // records with more than this many seconds to live are written apart from others (0 = all together)
+	ns->storage_write_hints = false; // don't pass write streams' expected lifetimes to devices
+	ns->storage_enable_checksum = false; // don't checksum records as they're written
+	ns->storage_load_older_on_checksum_error = true; // cold start keeps the loaded copy if a newer-looking copy is corrupt
+	ns->storage_scrub_sleep = 0; // sleep this many microseconds between each wblock scrubbed (0 = don't scrub)
 	ns->storage_defrag_startup_minimum = 10; // defrag until >= 10% disk is writable before joining cluster
 	ns->storage_flush_max_us = 1000 * 1000; // wait this many microseconds before flushing inactive current write buffer (0 = never)
 	ns->storage_fsync_max_us = 0; // fsync interval in microseconds (0 = never)
+	ns->storage_index_snapshot_file = NULL; // null means don't write an index snapshot at shutdown (community edition fast restart)
+	ns->storage_cold_start_threads = 0; // record-indexing threads per device during cold start (0 = spread CPUs across devices)
+	ns->storage_io_engine = CF_IORING_SYNC; // defrag, cold start and write-queue I/O done inline by the calling thread
+	ns->storage_io_depth = 32; // max defrag and cold start reads in flight per device
+	ns->storage_io_threads = 4; // worker threads per device for io-engine threads
 	ns->storage_max_write_cache = 1024 * 1024 * 64;
 	ns->storage_min_avail_pct = 5; // stop writes when < 5% disk is writable
 	ns->storage_num_write_blocks = 64; // number of write blocks to use with KV store devices
 	ns->storage_post_write_queue = 256; // number of wblocks per device used as post-write cache
+	ns->storage_compression = COMPRESSION_NONE; // store records' data uncompressed
+	ns->storage_compression_level = 0; // use compression type's default level
+	ns->storage_compression_threshold = 256; // only compress records of at least this many bytes
+	ns->storage_read_cache_size = 0; // bytes of record blocks cached after reading from device (0 = no cache)
+	ns->storage_hot_tier_size = 0; // bytes of hot records' images held in memory (0 = no hot tier)
 	ns->storage_read_block_size = 64 * 1024; // size in bytes of read buffers to use with KV store devices
 	// [Note - current FusionIO maximum read buffer size is 1MB - 512B.]
 	ns->storage_write_threads = 1;
@@ -20,18 +20,323 @@
  * along with this program.  If not, see http://www.gnu.org/licenses/
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
 #include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_clock.h"
 
 #include "arenax.h"
+#include "crc32c.h"
 #include "fault.h"
 #include "vmapx.h"
 
 #include "base/cfg.h"
 #include "base/datamodel.h"
 #include "base/index.h"
+#include "storage/storage.h"
+
+
+//==========================================================
+// Index snapshot - without shared memory, the index arena
+// and tree roots can be written to a file at shutdown and
+// read back at startup instead of sweeping the devices.
+//
+// File layout: header, as_set array, tree roots, sub-tree
+// roots, then the arena. The header's checksum covers
+// everything after the header.
+//
+
+#define INDEX_SNAPSHOT_MAGIC 0x5844494E53534100
+#define INDEX_SNAPSHOT_VERSION 2
+
+typedef struct index_snapshot_header_s {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	index_size;		// sizeof(as_index) when written
+	char		ns_name[AS_ID_NAMESPACE_SZ];
+	uint64_t	device_random;	// devices' header signature when written
+	uint64_t	generation;		// incremented each time a snapshot is written
+	uint32_t	n_partitions;
+	uint32_t	n_sets;
+	uint32_t	n_sprigs;		// sprigs per partition tree
+	uint32_t	checksum;		// CRC32C of everything after this header
+} __attribute__ ((__packed__)) index_snapshot_header;
+
+// Arena flags, including configured stage placement.
+static uint32_t
+index_arena_flags(as_namespace* ns)
+{
+	return CF_ARENAX_BIGLOCK | ns->index_huge_pages | ns->index_numa_policy;
+}
+
+static bool
+snapshot_write(int fd, const void* buf, size_t size, uint32_t* p_crc)
+{
+	*p_crc = cf_crc32c(*p_crc, buf, size);
+
+	return write(fd, buf, size) == (ssize_t)size;
+}
+
+static bool
+snapshot_read(int fd, void* buf, size_t size, uint32_t* p_crc)
+{
+	if (read(fd, buf, size) != (ssize_t)size) {
+		return false;
+	}
+
+	*p_crc = cf_crc32c(*p_crc, buf, size);
+
+	return true;
+}
+
+// Read a snapshot, and if it's valid and matches the devices, set up the arena,
+// sets and tree roots from it.
+static bool
+index_snapshot_read(as_namespace* ns, int fd)
+{
+	index_snapshot_header header;
+
+	if (read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+			header.magic != INDEX_SNAPSHOT_MAGIC ||
+			header.version != INDEX_SNAPSHOT_VERSION ||
+			header.index_size != as_index_size_get(ns) ||
+			strncmp(header.ns_name, ns->name, AS_ID_NAMESPACE_SZ) != 0 ||
+			header.n_partitions != AS_PARTITIONS ||
+			header.n_sets > AS_SET_MAX_COUNT) {
+		cf_warning(AS_NAMESPACE, "ns %s index snapshot has bad header", ns->name);
+		return false;
+	}
+
+	if (header.n_sprigs != ns->partition_tree_sprigs) {
+		cf_info(AS_NAMESPACE, "ns %s index snapshot has %u partition-tree-sprigs, configured %u",
+				ns->name, header.n_sprigs, ns->partition_tree_sprigs);
+		return false;
+	}
+
+	// Devices written to after the snapshot (or by a later run) will have a
+	// different signature.
+	uint64_t device_random;
+
+	if (! as_storage_peek_random_ssd(ns, &device_random) ||
+			device_random != header.device_random) {
+		cf_info(AS_NAMESPACE, "ns %s index snapshot doesn't match devices", ns->name);
+		return false;
+	}
+
+	uint32_t crc = 0;
+	size_t sets_size = header.n_sets * sizeof(as_set);
+	as_set* sets = cf_malloc(sets_size + 1); // not 0 bytes
+	size_t roots_size = AS_PARTITIONS * as_treex_size(header.n_sprigs);
+	as_treex* tree_roots = cf_malloc(roots_size);
+	as_treex* sub_tree_roots = cf_malloc(roots_size);
+
+	if (! sets || ! tree_roots || ! sub_tree_roots) {
+		cf_crash(AS_NAMESPACE, "ns %s can't allocate for index snapshot", ns->name);
+	}
+
+	bool ok = snapshot_read(fd, sets, sets_size, &crc) &&
+			snapshot_read(fd, tree_roots, roots_size, &crc) &&
+			snapshot_read(fd, sub_tree_roots, roots_size, &crc);
+
+	if (ok && cf_arenax_load(ns->arena, fd, as_index_size_get(ns), index_arena_flags(ns), &crc) != CF_ARENAX_OK) {
+		ok = false;
+	}
+	else if (ok && crc != header.checksum) {
+		cf_warning(AS_NAMESPACE, "ns %s index snapshot checksum mismatch", ns->name);
+		cf_arenax_destroy(ns->arena);
+		ok = false;
+	}
+
+	for (uint32_t i = 0; ok && i < header.n_sets; i++) {
+		as_set* p_set = &sets[i];
+		uint32_t idx;
+
+		// Counts are rebuilt when the storage engine reduces the index.
+		p_set->name[AS_SET_NAME_MAX_SIZE - 1] = 0;
+		p_set->num_elements = 0;
+		p_set->n_bytes_memory = 0;
+
+		if (cf_vmapx_put_unique(ns->p_sets_vmap, p_set, &idx) != CF_VMAPX_OK ||
+				idx != i) {
+			cf_warning(AS_NAMESPACE, "ns %s can't restore set %s from index snapshot",
+					ns->name, p_set->name);
+			cf_arenax_destroy(ns->arena);
+			ok = false;
+		}
+	}
+
+	cf_free(sets);
+
+	if (! ok) {
+		cf_free(tree_roots);
+		cf_free(sub_tree_roots);
+		return false;
+	}
+
+	ns->tree_roots = tree_roots;
+	ns->sub_tree_roots = sub_tree_roots;
+	ns->index_snapshot_generation = header.generation;
+
+	return true;
+}
+
+// A snapshot is only good for one startup, since the devices are written
+// from then on - remove it whether or not it's used.
+static bool
+index_snapshot_load(as_namespace* ns)
+{
+	const char* path = ns->storage_index_snapshot_file;
+
+	// B+tree index nodes aren't in the arena, so can't be snapshotted.
+	if (! path || ns->storage_type != AS_STORAGE_ENGINE_SSD ||
+			ns->storage_data_in_memory ||
+			ns->index_engine != AS_INDEX_ENGINE_RBTREE) {
+		return false;
+	}
+
+	int fd = open(path, O_RDONLY);
+
+	if (fd == -1) {
+		if (errno != ENOENT) {
+			cf_warning(AS_NAMESPACE, "ns %s can't open index snapshot %s: errno %d",
+					ns->name, path, errno);
+		}
+
+		return false;
+	}
+
+	uint64_t start_ms = cf_getms();
+	bool ok = index_snapshot_read(ns, fd);
+
+	close(fd);
+
+	if (unlink(path) != 0) {
+		cf_warning(AS_NAMESPACE, "ns %s can't remove index snapshot %s: errno %d",
+				ns->name, path, errno);
+	}
+
+	if (ok) {
+		cf_info(AS_NAMESPACE, "ns %s read index snapshot %s generation %lu in %lu ms",
+				ns->name, path, ns->index_snapshot_generation,
+				cf_getms() - start_ms);
+	}
+
+	return ok;
+}
+
+// Gather the roots of all partitions' trees (or sub-trees) for the snapshot.
+static void
+index_snapshot_fill_roots(as_namespace* ns, as_treex* roots, bool sub)
+{
+	uint32_t n_sprigs = ns->partition_tree_sprigs;
+
+	for (uint32_t pid = 0; pid < AS_PARTITIONS; pid++) {
+		as_index_tree* tree = sub ?
+				ns->partitions[pid].sub_vp : ns->partitions[pid].vp;
+		as_treex* treex = as_treex_get(roots, n_sprigs, pid);
+
+		treex->sentinel_h = tree->sentinel_h;
+
+		for (uint32_t i = 0; i < n_sprigs; i++) {
+			treex->root_h[i] = tree->sprigs[i].root_h;
+		}
+	}
+}
+
+// Write the index snapshot. Called at shutdown with all record locks held and
+// storage flushed, so the index and device contents are frozen.
+static void
+index_snapshot_save(as_namespace* ns)
+{
+	const char* path = ns->storage_index_snapshot_file;
+	char tmp_path[PATH_MAX];
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+
+	if (fd == -1) {
+		cf_warning(AS_NAMESPACE, "ns %s can't create index snapshot %s: errno %d",
+				ns->name, tmp_path, errno);
+		return;
+	}
+
+	uint64_t start_ms = cf_getms();
+	uint32_t n_sets = cf_vmapx_count(ns->p_sets_vmap);
+	index_snapshot_header header = {
+			.magic = INDEX_SNAPSHOT_MAGIC,
+			.version = INDEX_SNAPSHOT_VERSION,
+			.index_size = as_index_size_get(ns),
+			.device_random = as_storage_random_ssd(ns),
+			.generation = ns->index_snapshot_generation + 1,
+			.n_partitions = AS_PARTITIONS,
+			.n_sets = n_sets,
+			.n_sprigs = ns->partition_tree_sprigs
+	};
+
+	strncpy(header.ns_name, ns->name, AS_ID_NAMESPACE_SZ);
+
+	uint32_t crc = 0;
+	bool ok = lseek(fd, sizeof(header), SEEK_SET) == (off_t)sizeof(header);
+
+	for (uint32_t i = 0; ok && i < n_sets; i++) {
+		as_set* p_set;
+
+		ok = cf_vmapx_get_by_index(ns->p_sets_vmap, i, (void**)&p_set) ==
+				CF_VMAPX_OK && snapshot_write(fd, p_set, sizeof(as_set), &crc);
+	}
+
+	uint32_t n_sprigs = ns->partition_tree_sprigs;
+	size_t roots_size = AS_PARTITIONS * as_treex_size(n_sprigs);
+	as_treex* roots = cf_malloc(roots_size);
+
+	if (! roots) {
+		cf_crash(AS_NAMESPACE, "ns %s can't allocate for index snapshot", ns->name);
+	}
+
+	index_snapshot_fill_roots(ns, roots, false);
+	ok = ok && snapshot_write(fd, roots, roots_size, &crc);
+
+	index_snapshot_fill_roots(ns, roots, true);
+	ok = ok && snapshot_write(fd, roots, roots_size, &crc) &&
+			cf_arenax_save(ns->arena, fd, &crc) == CF_ARENAX_OK;
+
+	cf_free(roots);
+
+	header.checksum = crc;
+
+	ok = ok && pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+			fsync(fd) == 0;
+
+	off_t size = lseek(fd, 0, SEEK_END);
+
+	close(fd);
+
+	if (! ok || rename(tmp_path, path) != 0) {
+		cf_warning(AS_NAMESPACE, "ns %s failed writing index snapshot %s: errno %d",
+				ns->name, path, errno);
+		unlink(tmp_path);
+		return;
+	}
+
+	cf_info(AS_NAMESPACE, "ns %s wrote index snapshot %s generation %lu (%lu MB) in %lu ms",
+			ns->name, path, header.generation, size / (1024 * 1024),
+			cf_getms() - start_ms);
+}
+
+
+//==========================================================
+// Public API.
+//
 
 void
 as_xmem_scheme_check() {
@@ -96,10 +401,6 @@ as_mem_check()
 void
 as_namespace_setup(as_namespace* ns, uint32_t instance, uint32_t stage_capacity)
 {
-	ns->cold_start = true;
-
-	cf_info(AS_NAMESPACE, "ns %s beginning COLD start", ns->name);
-
 	//--------------------------------------------
 	// Set up the set name vmap.
 	//
@@ -116,11 +417,6 @@ as_namespace_setup(as_namespace* ns, uint32_t instance, uint32_t stage_capacity)
 		cf_crash(AS_NAMESPACE, "ns %s can't create sets vmap: %d", ns->name, vmap_result);
 	}
 
-	// Transfer configuration file information about sets.
-	if (! as_namespace_configure_sets(ns)) {
-		cf_crash(AS_NAMESPACE, "ns %s can't configure sets", ns->name);
-	}
-
 	//--------------------------------------------
 	// Set up the bin name vmap.
 	//
@@ -149,15 +445,35 @@ as_namespace_setup(as_namespace* ns, uint32_t instance, uint32_t stage_capacity)
 		cf_crash(AS_NAMESPACE, "ns %s can't allocate index arena", ns->name);
 	}
 
-	cf_arenax_err arena_result = cf_arenax_create(ns->arena, 0, as_index_size_get(ns), stage_capacity, 0, CF_ARENAX_BIGLOCK);
+	// Resume from an index snapshot if there's a good one, else cold start.
+	if (! ns->cold_start && index_snapshot_load(ns)) {
+		cf_info(AS_NAMESPACE, "ns %s beginning WARM start from index snapshot", ns->name);
+	}
+	else {
+		ns->cold_start = true;
 
-	if (arena_result != CF_ARENAX_OK) {
-		cf_crash(AS_NAMESPACE, "ns %s can't create arena: %s", ns->name, cf_arenax_errstr(arena_result));
+		cf_info(AS_NAMESPACE, "ns %s beginning COLD start", ns->name);
+
+		cf_arenax_err arena_result = cf_arenax_create(ns->arena, 0, as_index_size_get(ns), stage_capacity, 0, index_arena_flags(ns));
+
+		if (arena_result != CF_ARENAX_OK) {
+			cf_crash(AS_NAMESPACE, "ns %s can't create arena: %s", ns->name, cf_arenax_errstr(arena_result));
+		}
+	}
+
+	// Transfer configuration file information about sets. (After any sets
+	// restored from a snapshot, so their set-ids are unchanged.)
+	if (! as_namespace_configure_sets(ns)) {
+		cf_crash(AS_NAMESPACE, "ns %s can't configure sets", ns->name);
 	}
 }
 
 void
 as_namespace_xmem_trusted(as_namespace *ns)
 {
-	// For enterprise version only.
+	// Called at shutdown after storage is flushed.
+	if (ns->storage_index_snapshot_file && ! ns->storage_data_in_memory &&
+			ns->index_engine == AS_INDEX_ENGINE_RBTREE) {
+		index_snapshot_save(ns);
+	}
 }
@@ -24,6 +24,14 @@
 #include <stdlib.h>
 #include <zlib.h>
 
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "citrusleaf/alloc.h"
 
 #include "fault.h"
@@ -57,6 +65,26 @@ as_decompress(compression_type type, size_t buf_len, const uint8_t *buf, size_t
 			*out_buf_len = converted_out_buf_len;
 			break;
 		}
+#ifdef USE_LZ4
+		case COMPRESSION_LZ4: {
+			int out_sz = LZ4_decompress_safe((const char *)buf, (char *)out_buf, (int)buf_len, (int)*out_buf_len);
+			if (out_sz >= 0) {
+				*out_buf_len = (size_t)out_sz;
+				ret_value = 0;
+			}
+			break;
+		}
+#endif
+#ifdef USE_ZSTD
+		case COMPRESSION_ZSTD: {
+			size_t out_sz = ZSTD_decompress(out_buf, *out_buf_len, buf, buf_len);
+			if (! ZSTD_isError(out_sz)) {
+				*out_buf_len = out_sz;
+				ret_value = 0;
+			}
+			break;
+		}
+#endif
 		default:
 			cf_warning(AS_COMPRESSION, "Unknown as_proto compression type: %d", type);
 			break;
@@ -232,3 +260,98 @@ as_packet_compression(uint8_t *buf, size_t buf_sz, uint8_t **compressed_packet,
 	cf_debug(AS_COMPRESSION, "Returned as_packet_compression : 0");
 	return 0;
 }
+
+/**
+ * Function to compress a buffer into a caller-supplied buffer
+ * @param type			Type of compression
+ * @param level			Compression level - 0 for the type's default
+ * @param buf_len		Length of buffer to be compressed
+ * @param buf			Pointer to buffer to be compressed
+ * @param out_buf_len	In: size of out_buf - Out: length of compressed data
+ * @param out_buf		Pointer to buffer to hold compressed data
+ * @return 0 if successful, non-zero if the compressed data won't fit
+ */
+int
+as_compress_buf(compression_type type, int level, size_t buf_len, const uint8_t *buf, size_t *out_buf_len, uint8_t *out_buf)
+{
+	int ret_value = -1;
+
+	switch (type) {
+		case COMPRESSION_ZLIB: {
+			uLongf converted_out_buf_len = *out_buf_len;
+			// Z_BUF_ERROR if out_buf is too small
+			ret_value = compress2(out_buf, &converted_out_buf_len, buf, (uLong) buf_len, level == 0 ? Z_BEST_SPEED : level);
+			*out_buf_len = converted_out_buf_len;
+			break;
+		}
+#ifdef USE_LZ4
+		case COMPRESSION_LZ4: {
+			// level is LZ4's "acceleration" - higher is faster, compresses less
+			int out_sz = LZ4_compress_fast((const char *)buf, (char *)out_buf, (int)buf_len, (int)*out_buf_len, level == 0 ? 1 : level);
+			if (out_sz > 0) {
+				*out_buf_len = (size_t)out_sz;
+				ret_value = 0;
+			}
+			break;
+		}
+#endif
+#ifdef USE_ZSTD
+		case COMPRESSION_ZSTD: {
+			size_t out_sz = ZSTD_compress(out_buf, *out_buf_len, buf, buf_len, level == 0 ? 1 : level);
+			if (! ZSTD_isError(out_sz)) {
+				*out_buf_len = out_sz;
+				ret_value = 0;
+			}
+			break;
+		}
+#endif
+		default:
+			cf_warning(AS_COMPRESSION, "Unknown compression type: %d", type);
+			break;
+	}
+
+	return ret_value;
+}
+
+/*
+ * Function to get the highest level a compression type accepts - 0 if none
+ * (level 0 always means the type's default)
+ */
+uint32_t
+as_compression_max_level(compression_type type)
+{
+	switch (type) {
+		case COMPRESSION_ZLIB:
+			return Z_BEST_COMPRESSION;
+#ifdef USE_LZ4
+		case COMPRESSION_LZ4:
+			return 65537; // LZ4_ACCELERATION_MAX - higher is clamped
+#endif
+#ifdef USE_ZSTD
+		case COMPRESSION_ZSTD:
+			return (uint32_t)ZSTD_maxCLevel();
+#endif
+		default:
+			return 0;
+	}
+}
+
+/*
+ * Function to get the config name of a compression type
+ */
+const char *
+as_compression_type_str(compression_type type)
+{
+	switch (type) {
+		case COMPRESSION_NONE:
+			return "none";
+		case COMPRESSION_ZLIB:
+			return "zlib";
+		case COMPRESSION_LZ4:
+			return "lz4";
+		case COMPRESSION_ZSTD:
+			return "zstd";
+		default:
+			return "illegal";
+	}
+}
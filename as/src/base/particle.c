@@ -40,6 +40,7 @@
 
 #include "base/datamodel.h"
 #include "base/ldt.h"
+#include "base/particle_blob.h"
 #include "base/proto.h"
 #include "storage/storage.h"
 
@@ -261,6 +262,25 @@ as_particle_asval_to_client(const as_val *val, as_msg_op *op)
 	return added_size;
 }
 
+// If the bin's wire value is its in-memory value, point at it in place and
+// return its size - the caller can send it without copying. Otherwise (or if
+// there's no value) return 0.
+uint32_t
+as_bin_particle_wire_ptr(const as_bin *b, const uint8_t **p_value)
+{
+	if (! (b && as_bin_inuse(b)) || as_bin_is_hidden(b)) {
+		return 0;
+	}
+
+	uint8_t type = as_bin_get_particle_type(b);
+
+	if (particle_vtable[type]->to_wire_fn != blob_to_wire) {
+		return 0;
+	}
+
+	return as_bin_particle_blob_ptr(b, p_value);
+}
+
 
 //==========================================================
 // as_bin particle functions.
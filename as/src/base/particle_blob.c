@@ -402,6 +402,23 @@ blob_to_flat(const as_particle *p, uint8_t *flat)
 }
 
 
+//==========================================================
+// as_bin particle functions specific to BLOB.
+//
+
+uint32_t
+as_bin_particle_blob_ptr(const as_bin *b, const uint8_t **p_value)
+{
+	// Caller must ensure this is called only for particles with the BLOB
+	// in-memory format (BLOB, STRING, language BLOBs).
+	blob_mem *p_blob_mem = (blob_mem *)b->particle;
+
+	*p_value = p_blob_mem->data;
+
+	return p_blob_mem->sz;
+}
+
+
 //==========================================================
 // Local helpers.
 //
@@ -35,6 +35,7 @@
 #include <asm/byteorder.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "aerospike/as_val.h"
 #include "citrusleaf/alloc.h"
@@ -87,17 +88,10 @@ as_msg_swap_field(as_msg_field *mf)
 	mf->field_sz = ntohl(mf->field_sz);
 }
 
-//
-// This function will attempt to fill the passed in buffer,
-// but if too small, will malloc and return that.
-// Either way it returns what it filled in.
-//
-
-cl_msg *
-as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
-		uint32_t void_time, as_msg_op **ops, as_bin **bins, uint16_t bin_count,
-		as_namespace *ns, cl_msg *msgp_in, size_t *msg_sz_in, uint64_t trid,
-		const char *setname)
+// Size of the response as_msg_make_response_msg() would make.
+size_t
+as_msg_response_msg_size(as_msg_op **ops, as_bin **bins, uint16_t bin_count,
+		as_namespace *ns, uint64_t trid, const char *setname)
 {
 	size_t msg_sz = sizeof(cl_msg);
 
@@ -124,29 +118,20 @@ as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
 		msg_sz += sizeof(as_msg_field) + sizeof(trid);
 	}
 
-	uint32_t setname_len = 0;
-
 	if (setname) {
-		setname_len = strlen(setname);
-		msg_sz += sizeof(as_msg_field) + setname_len;
-	}
-
-	uint8_t *b;
-
-	if (! msgp_in || *msg_sz_in < msg_sz) {
-		b = cf_malloc(msg_sz);
-
-		if (! b) {
-			return NULL;
-		}
-	}
-	else {
-		b = (uint8_t *)msgp_in;
+		msg_sz += sizeof(as_msg_field) + strlen(setname);
 	}
 
-	*msg_sz_in = msg_sz;
+	return msg_sz;
+}
 
-	uint8_t *buf = b;
+// Write the proto and as_msg headers and the trid and set fields of a
+// response - returns where the ops start.
+static uint8_t *
+response_write_header(uint8_t *buf, size_t msg_sz, uint32_t result_code,
+		uint32_t generation, uint32_t void_time, uint16_t bin_count,
+		uint64_t trid, const char *setname, uint32_t setname_len)
+{
 	cl_msg *msgp = (cl_msg *)buf;
 
 	msgp->proto.version = PROTO_VERSION;
@@ -198,6 +183,43 @@ as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
 
 	as_msg_swap_header(m);
 
+	return buf;
+}
+
+//
+// This function will attempt to fill the passed in buffer,
+// but if too small, will malloc and return that.
+// Either way it returns what it filled in.
+//
+
+cl_msg *
+as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
+		uint32_t void_time, as_msg_op **ops, as_bin **bins, uint16_t bin_count,
+		as_namespace *ns, cl_msg *msgp_in, size_t *msg_sz_in, uint64_t trid,
+		const char *setname)
+{
+	size_t msg_sz = as_msg_response_msg_size(ops, bins, bin_count, ns, trid,
+			setname);
+	uint32_t setname_len = setname ? strlen(setname) : 0;
+
+	uint8_t *b;
+
+	if (! msgp_in || *msg_sz_in < msg_sz) {
+		b = cf_malloc(msg_sz);
+
+		if (! b) {
+			return NULL;
+		}
+	}
+	else {
+		b = (uint8_t *)msgp_in;
+	}
+
+	*msg_sz_in = msg_sz;
+
+	uint8_t *buf = response_write_header(b, msg_sz, result_code, generation,
+			void_time, bin_count, trid, setname, setname_len);
+
 	for (uint16_t i = 0; i < bin_count; i++) {
 		as_msg_op *op = (as_msg_op *)buf;
 
@@ -672,6 +694,186 @@ as_msg_make_error_response_bufbuilder(cf_digest *keyd, int result_code, cf_buf_b
 
 #define MSG_STACK_BUFFER_SZ (1024 * 16)
 
+// Bin values at least this big are sent from where they are - in the storage
+// read buffer or in memory - rather than copied into the response.
+#define MSG_IOV_MIN_VALUE_SZ (1024 * 4)
+
+// Beyond this many in-place values, the rest are copied.
+#define MSG_IOV_MAX_VALUES 64
+#define MSG_IOV_MAX ((MSG_IOV_MAX_VALUES * 2) + 1)
+
+// Send all of an iovec array, consuming it as we go.
+static int
+send_reply_iov(as_file_handle *fd_h, struct iovec *iov, int n_iov,
+		size_t msg_sz)
+{
+	size_t pos = 0;
+
+	while (pos < msg_sz) {
+		struct msghdr mh;
+
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_iov = iov;
+		mh.msg_iovlen = n_iov;
+
+		ssize_t rv = sendmsg(fd_h->fd, &mh, MSG_NOSIGNAL);
+
+		if (rv > 0) {
+			pos += rv;
+
+			// Skip what was sent.
+			while (rv > 0) {
+				if ((size_t)rv >= iov->iov_len) {
+					rv -= iov->iov_len;
+					iov++;
+					n_iov--;
+				}
+				else {
+					iov->iov_base = (uint8_t *)iov->iov_base + rv;
+					iov->iov_len -= rv;
+					rv = 0;
+				}
+			}
+		}
+		else if (rv < 0) {
+			if (errno != EWOULDBLOCK) {
+				// common message when a client aborts
+				cf_debug(AS_PROTO, "protocol write fail: fd %d sz %zd pos %zd rv %zd errno %d", fd_h->fd, msg_sz, pos, rv, errno);
+				as_end_of_transaction_force_close(fd_h);
+				return -1;
+			}
+			usleep(1); // Yield
+		} else {
+			cf_info(AS_PROTO, "protocol write fail zero return: fd %d sz %zu pos %zu ", fd_h->fd, msg_sz, pos);
+			as_end_of_transaction_force_close(fd_h);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+// Build a response whose big values are left where they are. The headers and
+// small values go in buf (of buf_sz), and iov gets alternate references into
+// buf and to the big values. Returns the number of iovecs, or 0 if buf is too
+// small.
+static int
+make_response_iov(uint32_t result_code, uint32_t generation,
+		uint32_t void_time, as_msg_op **ops, as_bin **bins, uint16_t bin_count,
+		as_namespace *ns, size_t msg_sz, uint64_t trid, const char *setname,
+		uint8_t *buf, size_t buf_sz, struct iovec *iov)
+{
+	uint8_t *end = buf + buf_sz;
+	int n_iov = 0;
+	int n_values = 0;
+
+	uint32_t setname_len = setname ? strlen(setname) : 0;
+	uint8_t *seg = buf;
+
+	buf = response_write_header(buf, msg_sz, result_code, generation,
+			void_time, bin_count, trid, setname, setname_len);
+
+	for (uint16_t i = 0; i < bin_count; i++) {
+		as_msg_op *op = (as_msg_op *)buf;
+		uint32_t name_sz = ops ? ops[i]->name_sz :
+				(ns->single_bin ? 0 :
+						strlen(as_bin_get_name_from_id(ns, bins[i]->id)));
+
+		if (buf + sizeof(as_msg_op) + name_sz > end) {
+			return 0;
+		}
+
+		op->version = 0;
+
+		if (ops) {
+			op->op = ops[i]->op;
+			memcpy(op->name, ops[i]->name, ops[i]->name_sz);
+			op->name_sz = ops[i]->name_sz;
+		}
+		else {
+			op->op = AS_MSG_OP_READ;
+			op->name_sz = as_bin_memcpy_name(ns, op->name, bins[i]);
+		}
+
+		op->op_sz = 4 + op->name_sz;
+
+		buf += sizeof(as_msg_op) + op->name_sz;
+
+		const uint8_t *value;
+		uint32_t value_sz = n_values < MSG_IOV_MAX_VALUES ?
+				as_bin_particle_wire_ptr(bins[i], &value) : 0;
+
+		if (value_sz >= MSG_IOV_MIN_VALUE_SZ) {
+			// Reference the value in place.
+			op->particle_type = as_bin_get_particle_type(bins[i]);
+			op->op_sz += value_sz;
+
+			iov[n_iov].iov_base = seg;
+			iov[n_iov].iov_len = buf - seg;
+			n_iov++;
+
+			iov[n_iov].iov_base = (void *)value;
+			iov[n_iov].iov_len = value_sz;
+			n_iov++;
+
+			n_values++;
+			seg = buf;
+		}
+		else {
+			if (bins[i] &&
+					buf + as_bin_particle_client_value_size(bins[i]) > end) {
+				return 0;
+			}
+
+			buf += as_bin_particle_to_client(bins[i], op);
+		}
+
+		as_msg_swap_op(op);
+	}
+
+	if (buf != seg) {
+		iov[n_iov].iov_base = seg;
+		iov[n_iov].iov_len = buf - seg;
+		n_iov++;
+	}
+
+	return n_iov;
+}
+
+// Send a response with any big values sent in place. The values' record (or
+// storage read buffer) is held by the caller until we return, and we don't
+// return until the socket has taken every byte.
+static int
+send_reply_in_place(as_file_handle *fd_h, uint32_t result_code,
+		uint32_t generation, uint32_t void_time, as_msg_op **ops, as_bin **bins,
+		uint16_t bin_count, as_namespace *ns, size_t msg_sz, size_t in_place_sz,
+		uint64_t trid, const char *setname)
+{
+	byte fb[MSG_STACK_BUFFER_SZ];
+	size_t buf_sz = msg_sz - in_place_sz;
+	uint8_t *buf = buf_sz <= sizeof(fb) ? fb : cf_malloc(buf_sz);
+
+	if (! buf) {
+		return -1;
+	}
+
+	struct iovec iov[MSG_IOV_MAX];
+	int n_iov = make_response_iov(result_code, generation, void_time, ops,
+			bins, bin_count, ns, msg_sz, trid, setname, buf, buf_sz, iov);
+
+	if (n_iov == 0) {
+		cf_crash(AS_PROTO, "response headers overflowed %zu byte buffer", buf_sz);
+	}
+
+	int rv = send_reply_iov(fd_h, iov, n_iov, msg_sz);
+
+	if (buf != fb) {
+		cf_free(buf);
+	}
+
+	return rv;
+}
+
 int
 as_msg_send_reply(as_file_handle *fd_h, uint32_t result_code, uint32_t generation,
 		uint32_t void_time, as_msg_op **ops, as_bin **bins, uint16_t bin_count,
@@ -679,6 +881,44 @@ as_msg_send_reply(as_file_handle *fd_h, uint32_t result_code, uint32_t generatio
 {
 	int rv = 0;
 
+	if (fd_h->fd == 0) {
+		cf_warning(AS_PROTO, "write to fd 0 internal error");
+		cf_crash(AS_PROTO, "send reply: can't write to fd 0");
+	}
+
+	// Big blob and string values don't need copying - add up what we can send
+	// in place.
+	size_t in_place_sz = 0;
+	int n_values = 0;
+
+	for (uint16_t i = 0; i < bin_count && n_values < MSG_IOV_MAX_VALUES; i++) {
+		const uint8_t *value;
+		uint32_t value_sz = as_bin_particle_wire_ptr(bins[i], &value);
+
+		if (value_sz >= MSG_IOV_MIN_VALUE_SZ) {
+			in_place_sz += value_sz;
+			n_values++;
+		}
+	}
+
+	if (in_place_sz != 0) {
+		size_t msg_sz = as_msg_response_msg_size(ops, bins, bin_count, ns,
+				trid, setname);
+
+		if ((rv = send_reply_in_place(fd_h, result_code, generation, void_time,
+				ops, bins, bin_count, ns, msg_sz, in_place_sz, trid,
+				setname)) != 0) {
+			return rv;
+		}
+
+		// good for stats as a higher layer
+		if (written_sz) *written_sz = msg_sz;
+
+		as_end_of_transaction_ok(fd_h);
+
+		return 0;
+	}
+
 	// most cases are small messages - try to stack alloc if we can
 	byte fb[MSG_STACK_BUFFER_SZ];
 	size_t msg_sz = sizeof(fb);
@@ -690,34 +930,12 @@ as_msg_send_reply(as_file_handle *fd_h, uint32_t result_code, uint32_t generatio
 
 	if (!msgp)	return(-1);
 
-	if (fd_h->fd == 0) {
-		cf_warning(AS_PROTO, "write to fd 0 internal error");
-		cf_crash(AS_PROTO, "send reply: can't write to fd 0");
-	}
-
 //	cf_detail(AS_PROTO, "write fd %d",fd);
 
-	size_t pos = 0;
-	while (pos < msg_sz) {
-		int rv = send(fd_h->fd, msgp + pos, msg_sz - pos, MSG_NOSIGNAL);
-		if (rv > 0) {
-			pos += rv;
-		}
-		else if (rv < 0) {
-			if (errno != EWOULDBLOCK) {
-				// common message when a client aborts
-				cf_debug(AS_PROTO, "protocol write fail: fd %d sz %zd pos %zd rv %d errno %d", fd_h->fd, msg_sz, pos, rv, errno);
-				as_end_of_transaction_force_close(fd_h);
-				rv = -1;
-				goto Exit;
-			}
-			usleep(1); // Yield
-		} else {
-			cf_info(AS_PROTO, "protocol write fail zero return: fd %d sz %zu pos %zu ", fd_h->fd, msg_sz, pos);
-			as_end_of_transaction_force_close(fd_h);
-			rv = -1;
-			goto Exit;
-		}
+	struct iovec iov = { .iov_base = msgp, .iov_len = msg_sz };
+
+	if ((rv = send_reply_iov(fd_h, &iov, 1, msg_sz)) != 0) {
+		goto Exit;
 	}
 
 	// good for stats as a higher layer
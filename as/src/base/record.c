@@ -929,7 +929,8 @@ as_record_flatten(as_partition_reservation *rsv, cf_digest *keyd,
 	// copy because the digest comes with the migrate_ldt_version already stamped
 	// in it. Even if it matches just go ahead and write it down.
 	if (!is_subrec) {
-		if (has_local_copy) {
+		// A repair replaces a corrupt local copy, so it doesn't compete.
+		if (has_local_copy && ! COMPONENT_IS_REPAIR(&components[0])) {
 			*winner_idx = as_record_component_winner(rsv, n_components, components, r);
 		} else {
 			*winner_idx = as_record_component_winner(rsv, n_components, components, NULL);
@@ -25,6 +25,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -396,6 +397,47 @@ log_as_proto_and_peeked_data(as_proto *proto, uint8_t *peekbuf, size_t peeked_da
 	cf_warning_binary(AS_DEMARSHAL, peekbuf, peeked_data_sz, CF_DISPLAY_HEX_SPACED, "peekbuf");
 }
 
+// Pin the calling demarshal thread to the thr_id'th CPU we're allowed on, so
+// the network work for its connections - and any transactions it processes
+// inline - stays on one core.
+static void
+thr_demarshal_pin(int thr_id)
+{
+	cpu_set_t allowed;
+
+	if (0 != sched_getaffinity(0, sizeof(allowed), &allowed)) {
+		cf_warning(AS_DEMARSHAL, "demarshal thread %d can't get CPU affinity: %s",
+				thr_id, cf_strerror(errno));
+		return;
+	}
+
+	int nth = thr_id % CPU_COUNT(&allowed);
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (! CPU_ISSET(cpu, &allowed) || nth-- != 0) {
+			continue;
+		}
+
+		cpu_set_t pin;
+
+		CPU_ZERO(&pin);
+		CPU_SET(cpu, &pin);
+
+		int rv = pthread_setaffinity_np(pthread_self(), sizeof(pin), &pin);
+
+		if (rv != 0) {
+			cf_warning(AS_DEMARSHAL, "demarshal thread %d can't pin to CPU %d: %s",
+					thr_id, cpu, cf_strerror(rv));
+		}
+		else {
+			cf_info(AS_DEMARSHAL, "demarshal thread %d pinned to CPU %d",
+					thr_id, cpu);
+		}
+
+		return;
+	}
+}
+
 // Set of threads which talk to client over the connection for doing the needful
 // processing. Note that once fd is assigned to a thread all the work on that fd
 // is done by that thread. Fair fd usage is expected of the client. First thread
@@ -442,6 +484,10 @@ thr_demarshal(void *arg)
 		return(0);
 	}
 
+	if (g_config.pin_service_threads) {
+		thr_demarshal_pin(thr_id);
+	}
+
 	// First thread accepts new connection at interface socket.
 	if (thr_id == 0) {
 		demarshal_file_handle_init();
@@ -464,10 +464,22 @@ info_get_stats(char *name, cf_dyn_buf *db)
 	APPEND_STAT_COUNTER(db, migrate_partitions_remaining);
 	cf_dyn_buf_append_string(db, ";migrate_partitions_remaining=");
 	APPEND_STAT_COUNTER(db, migrate_partitions_remaining);
+	cf_dyn_buf_append_string(db, ";migrate_rate_pct=");
+	cf_dyn_buf_append_uint32(db, as_migrate_get_rate_pct());
 
 	cf_dyn_buf_append_string(db, ";queue=");
 	cf_dyn_buf_append_int(db, thr_tsvc_queue_get_size() );
 
+	uint32_t queue_max_depth;
+	uint64_t queue_steals;
+
+	thr_tsvc_queue_get_steal_stats(&queue_max_depth, &queue_steals);
+
+	cf_dyn_buf_append_string(db, ";queue_max_depth=");
+	cf_dyn_buf_append_uint32(db, queue_max_depth);
+	cf_dyn_buf_append_string(db, ";queue_steals=");
+	cf_dyn_buf_append_uint64(db, queue_steals);
+
 	cf_dyn_buf_append_string(db, ";transactions=");
 	APPEND_STAT_COUNTER(db, g_config.proto_transactions);
 
@@ -586,6 +598,9 @@ info_get_stats(char *name, cf_dyn_buf *db)
 	cf_dyn_buf_append_string(db, ";record_locks=");
 	APPEND_STAT_COUNTER(db, g_config.global_record_lock_count);
 
+	cf_dyn_buf_append_string(db, ";record_lock_contended=");
+	cf_dyn_buf_append_uint64(db, cf_atomic64_get(g_config.record_locks->n_contended));
+
 	cf_dyn_buf_append_string(db, ";ongoing_write_reqs=");
 	APPEND_STAT_COUNTER(db, g_config.write_req_object_count);
 
@@ -2130,6 +2145,8 @@ info_service_config_get(cf_dyn_buf *db)
 	cf_dyn_buf_append_int(db, g_config.n_transaction_queues);
 	cf_dyn_buf_append_string(db, ";transaction-threads-per-queue=");
 	cf_dyn_buf_append_int(db, g_config.n_transaction_threads_per_queue);
+	cf_dyn_buf_append_string(db, ";transaction-queue-stealing=");
+	cf_dyn_buf_append_string(db, g_config.transaction_queue_stealing ? "true" : "false");
 	cf_dyn_buf_append_string(db, ";transaction-pending-limit=");
 	cf_dyn_buf_append_int(db, g_config.transaction_pending_limit);
 	cf_dyn_buf_append_string(db, ";migrate-threads=");
@@ -2138,6 +2155,10 @@ info_service_config_get(cf_dyn_buf *db)
 	cf_dyn_buf_append_int(db, g_config.migrate_max_num_incoming);
 	cf_dyn_buf_append_string(db, ";migrate-rx-lifetime-ms=");
 	cf_dyn_buf_append_int(db, g_config.migrate_rx_lifetime_ms);
+	cf_dyn_buf_append_string(db, ";migrate-node-max-bytes-per-sec=");
+	cf_dyn_buf_append_uint64(db, g_config.migrate_node_max_bytes_per_sec);
+	cf_dyn_buf_append_string(db, ";migrate-latency-target-ms=");
+	cf_dyn_buf_append_uint32(db, g_config.migrate_latency_target_ms);
 	cf_dyn_buf_append_string(db, ";proto-fd-max=");
 	cf_dyn_buf_append_int(db, g_config.n_proto_fd_max);
 	cf_dyn_buf_append_string(db, ";proto-fd-idle-ms=");
@@ -2215,6 +2236,8 @@ info_service_config_get(cf_dyn_buf *db)
 	cf_dyn_buf_append_int(db, g_config.n_info_threads);
 	cf_dyn_buf_append_string(db, ";allow-inline-transactions=");
 	cf_dyn_buf_append_string(db, g_config.allow_inline_transactions ? "true" : "false");
+	cf_dyn_buf_append_string(db, ";pin-service-threads=");
+	cf_dyn_buf_append_string(db, g_config.pin_service_threads ? "true" : "false");
 	cf_dyn_buf_append_string(db, ";use-queue-per-device=");
 	cf_dyn_buf_append_string(db, g_config.use_queue_per_device ? "true" : "false");
 	cf_dyn_buf_append_string(db, ";snub-nodes=");
@@ -2260,6 +2283,10 @@ info_service_config_get(cf_dyn_buf *db)
 		cf_dyn_buf_append_string(db, "ULONG_MAX");
 	}
 
+	cf_dyn_buf_append_string(db, ";record-locks=");
+	cf_dyn_buf_append_uint32(db, g_config.n_record_locks);
+	cf_dyn_buf_append_string(db, ";record-lock-type=");
+	cf_dyn_buf_append_string(db, g_config.record_lock_type == OLOCK_TYPE_ADAPTIVE ? "adaptive" : "mutex");
 	cf_dyn_buf_append_string(db, ";query-threads=");
 	cf_dyn_buf_append_int(db, g_config.query_threads);
 	cf_dyn_buf_append_string(db, ";query-worker-threads=");
@@ -2387,19 +2414,91 @@ info_namespace_config_get(char* context, cf_dyn_buf *db)
 	cf_dyn_buf_append_string(db, ";migrate-sleep=");
 	cf_dyn_buf_append_uint32(db, ns->migrate_sleep);
 
+	cf_dyn_buf_append_string(db, ";partition-tree-sprigs=");
+	cf_dyn_buf_append_uint32(db, ns->partition_tree_sprigs);
+
+	cf_dyn_buf_append_string(db, ";index-engine=");
+	cf_dyn_buf_append_string(db, ns->index_engine == AS_INDEX_ENGINE_BTREE ?
+			"btree" : "rbtree");
+
+	cf_dyn_buf_append_string(db, ";index-huge-pages=");
+	switch (ns->index_huge_pages) {
+	case CF_ARENAX_HUGE_PAGES_THP:
+		cf_dyn_buf_append_string(db, "thp");
+		break;
+	case CF_ARENAX_HUGE_PAGES_2M:
+		cf_dyn_buf_append_string(db, "2m");
+		break;
+	case CF_ARENAX_HUGE_PAGES_1G:
+		cf_dyn_buf_append_string(db, "1g");
+		break;
+	default:
+		cf_dyn_buf_append_string(db, "false");
+		break;
+	}
+
+	cf_dyn_buf_append_string(db, ";index-numa-policy=");
+	switch (ns->index_numa_policy) {
+	case CF_ARENAX_NUMA_INTERLEAVE:
+		cf_dyn_buf_append_string(db, "interleave");
+		break;
+	case CF_ARENAX_NUMA_STRIPE:
+		cf_dyn_buf_append_string(db, "stripe");
+		break;
+	default:
+		cf_dyn_buf_append_string(db, "none");
+		break;
+	}
+
 	// if storage, lots of information about the storage
 	if (ns->storage_type == AS_STORAGE_ENGINE_SSD) {
 
 		info_append_uint64("", "total-bytes-disk", ns->ssd_size, db);
+
+		info_append_uint64("", "cold-start-threads", ns->storage_cold_start_threads, db);
+		info_append_uint64("", "cold-stream-ttl", ns->storage_cold_stream_ttl, db);
+
+		cf_dyn_buf_append_string(db, ";compression=");
+		cf_dyn_buf_append_string(db, as_compression_type_str(ns->storage_compression));
+
+		info_append_uint64("", "compression-level", ns->storage_compression_level, db);
+		info_append_uint64("", "compression-threshold", ns->storage_compression_threshold, db);
 		info_append_uint64("", "defrag-lwm-pct", ns->storage_defrag_lwm_pct, db);
 		info_append_uint64("", "defrag-queue-min", ns->storage_defrag_queue_min, db);
 		info_append_uint64("", "defrag-sleep", ns->storage_defrag_sleep, db);
 		info_append_uint64("", "defrag-startup-minimum", ns->storage_defrag_startup_minimum, db);
 		info_append_uint64("", "flush-max-ms", ns->storage_flush_max_us / 1000, db);
 		info_append_uint64("", "fsync-max-sec", ns->storage_fsync_max_us / 1000000, db);
+		info_append_uint64("", "hot-tier-size", ns->storage_hot_tier_size, db);
+		if (ns->storage_index_snapshot_file) {
+			cf_dyn_buf_append_string(db, ";index-snapshot-file=");
+			cf_dyn_buf_append_string(db, ns->storage_index_snapshot_file);
+		}
+
+		info_append_uint64("", "io-depth", ns->storage_io_depth, db);
+
+		cf_dyn_buf_append_string(db, ";io-engine=");
+		cf_dyn_buf_append_string(db, cf_ioring_type_str(ns->storage_io_engine));
+
+		info_append_uint64("", "io-threads", ns->storage_io_threads, db);
+
 		info_append_uint64("", "max-write-cache", ns->storage_max_write_cache, db);
 		info_append_uint64("", "min-avail-pct", ns->storage_min_avail_pct, db);
 		info_append_uint64("", "post-write-queue", (uint64_t)ns->storage_post_write_queue, db);
+		info_append_uint64("", "read-cache-size", ns->storage_read_cache_size, db);
+		info_append_uint64("", "scrub-sleep", ns->storage_scrub_sleep, db);
+
+		cf_dyn_buf_append_string(db, ";enable-checksum=");
+		cf_dyn_buf_append_string(db, ns->storage_enable_checksum ? "true" : "false");
+
+		cf_dyn_buf_append_string(db, ";load-older-on-checksum-error=");
+		cf_dyn_buf_append_string(db, ns->storage_load_older_on_checksum_error ? "true" : "false");
+
+		cf_dyn_buf_append_string(db, ";defrag-adaptive=");
+		cf_dyn_buf_append_string(db, ns->storage_defrag_adaptive ? "true" : "false");
+
+		cf_dyn_buf_append_string(db, ";write-hints=");
+		cf_dyn_buf_append_string(db, ns->storage_write_hints ? "true" : "false");
 
 		if (ns->storage_data_in_memory)
 			cf_dyn_buf_append_string(db, ";data-in-memory=true");
@@ -2911,6 +3010,19 @@ info_command_config_set(char *name, char *params, cf_dyn_buf *db)
 			cf_info(AS_INFO, "Changing value of migrate-rx-lifetime-ms from %d to %d ", g_config.migrate_rx_lifetime_ms, val);
 			g_config.migrate_rx_lifetime_ms = val;
 		}
+		else if (0 == as_info_parameter_get(params, "migrate-node-max-bytes-per-sec", context, &context_len)) {
+			uint64_t val64;
+			if (0 != cf_str_atoi_u64(context, &val64))
+				goto Error;
+			cf_info(AS_INFO, "Changing value of migrate-node-max-bytes-per-sec from %lu to %lu ", g_config.migrate_node_max_bytes_per_sec, val64);
+			g_config.migrate_node_max_bytes_per_sec = val64;
+		}
+		else if (0 == as_info_parameter_get(params, "migrate-latency-target-ms", context, &context_len)) {
+			if (0 != cf_str_atoi(context, &val) || (0 > val))
+				goto Error;
+			cf_info(AS_INFO, "Changing value of migrate-latency-target-ms from %u to %d ", g_config.migrate_latency_target_ms, val);
+			g_config.migrate_latency_target_ms = (uint32_t)val;
+		}
 		else if (0 == as_info_parameter_get(params, "migrate-threads", context, &context_len)) {
 			if (0 != cf_str_atoi(context, &val) || (0 > val) || (MAX_NUM_MIGRATE_XMIT_THREADS < val))
 				goto Error;
@@ -2967,6 +3079,10 @@ info_command_config_set(char *name, char *params, cf_dyn_buf *db)
 		}
 		else if (0 == as_info_parameter_get(params, "use-queue-per-device", context, &context_len)) {
 			if (strncmp(context, "true", 4) == 0 || strncmp(context, "yes", 3) == 0) {
+				if (g_config.transaction_queue_stealing) {
+					cf_warning(AS_INFO, "can't set use-queue-per-device with transaction-queue-stealing");
+					goto Error;
+				}
 				cf_info(AS_INFO, "Changing value of use-queue-per-device from %s to %s", bool_val[g_config.use_queue_per_device], context);
 				g_config.use_queue_per_device = true;
 			}
@@ -3562,6 +3678,48 @@ info_command_config_set(char *name, char *params, cf_dyn_buf *db)
 			cf_info(AS_INFO, "Changing value of defrag-sleep of ns %s from %u to %d", ns->name, ns->storage_defrag_sleep, val);
 			ns->storage_defrag_sleep = (uint32_t)val;
 		}
+		else if (0 == as_info_parameter_get(params, "defrag-adaptive", context, &context_len)) {
+			if (strncmp(context, "true", 4) == 0 || strncmp(context, "yes", 3) == 0) {
+				cf_info(AS_INFO, "Changing value of defrag-adaptive of ns %s to true", ns->name);
+				ns->storage_defrag_adaptive = true;
+			}
+			else if (strncmp(context, "false", 5) == 0 || strncmp(context, "no", 2) == 0) {
+				cf_info(AS_INFO, "Changing value of defrag-adaptive of ns %s to false", ns->name);
+				ns->storage_defrag_adaptive = false;
+			}
+			else {
+				goto Error;
+			}
+		}
+		else if (0 == as_info_parameter_get(params, "cold-stream-ttl", context, &context_len)) {
+			uint64_t val64 = 0;
+
+			if (0 != cf_str_atoi_seconds(context, &val64) || val64 > UINT32_MAX) {
+				goto Error;
+			}
+			cf_info(AS_INFO, "Changing value of cold-stream-ttl of ns %s from %u to %"PRIu64, ns->name, ns->storage_cold_stream_ttl, val64);
+			ns->storage_cold_stream_ttl = (uint32_t)val64;
+		}
+		else if (0 == as_info_parameter_get(params, "scrub-sleep", context, &context_len)) {
+			if (0 != cf_str_atoi(context, &val)) {
+				goto Error;
+			}
+			cf_info(AS_INFO, "Changing value of scrub-sleep of ns %s from %u to %d", ns->name, ns->storage_scrub_sleep, val);
+			ns->storage_scrub_sleep = (uint32_t)val;
+		}
+		else if (0 == as_info_parameter_get(params, "enable-checksum", context, &context_len)) {
+			if (strncmp(context, "true", 4) == 0 || strncmp(context, "yes", 3) == 0) {
+				cf_info(AS_INFO, "Changing value of enable-checksum of ns %s to true", ns->name);
+				ns->storage_enable_checksum = true;
+			}
+			else if (strncmp(context, "false", 5) == 0 || strncmp(context, "no", 2) == 0) {
+				cf_info(AS_INFO, "Changing value of enable-checksum of ns %s to false", ns->name);
+				ns->storage_enable_checksum = false;
+			}
+			else {
+				goto Error;
+			}
+		}
 		else if (0 == as_info_parameter_get(params, "flush-max-ms", context, &context_len)) {
 			if (0 != cf_str_atoi(context, &val)) {
 				goto Error;
@@ -4868,10 +5026,53 @@ info_debug_ticker_fn(void *unused)
 
 					cf_info(AS_INFO, "{%s} disk bytes used %"PRIu64" : avail pct %d : cache-read pct %.2f",
 							ns->name, inuse_disk_bytes, available_pct, ns->cache_read_pct);
+
+					if (ns->storage_read_cache_size != 0) {
+						uint64_t n_hits = cf_atomic64_get(ns->n_read_cache_hits);
+						uint64_t n_lookups = n_hits + cf_atomic64_get(ns->n_read_cache_misses);
+
+						cf_info(AS_INFO, "{%s} read-cache bytes used %"PRIu64" : hits %"PRIu64" : misses %"PRIu64" : evictions %"PRIu64" : hit pct %.2f",
+								ns->name, cf_atomic64_get(ns->read_cache_bytes), n_hits, n_lookups - n_hits,
+								cf_atomic64_get(ns->n_read_cache_evictions),
+								(double)(100 * n_hits) / (double)(n_lookups == 0 ? 1 : n_lookups));
+					}
+					if (ns->storage_hot_tier_size != 0) {
+						uint64_t n_hits = cf_atomic64_get(ns->n_hot_tier_hits);
+						uint64_t n_lookups = n_hits + cf_atomic64_get(ns->n_hot_tier_misses);
+
+						cf_info(AS_INFO, "{%s} hot-tier bytes used %"PRIu64" : hits %"PRIu64" : misses %"PRIu64" : promotions %"PRIu64" : demotions %"PRIu64" : hit pct %.2f",
+								ns->name, cf_atomic64_get(ns->hot_tier_bytes), n_hits, n_lookups - n_hits,
+								cf_atomic64_get(ns->n_hot_tier_promotions),
+								cf_atomic64_get(ns->n_hot_tier_demotions),
+								(double)(100 * n_hits) / (double)(n_lookups == 0 ? 1 : n_lookups));
+					}
 					cf_info(AS_INFO, "{%s} memory bytes used %"PRIu64" (index %"PRIu64" : sindex %"PRIu64") : used pct %.2lf",
 							ns->name, ns_total_mem, ns_index_mem, ns_sindex_mem, mem_used_pct);
 				}
 
+				if (ns->storage_compression != COMPRESSION_NONE) {
+					uint64_t orig_bytes = cf_atomic64_get(ns->compression_orig_bytes);
+					uint64_t n_compressions = cf_atomic64_get(ns->n_compressions) +
+							cf_atomic64_get(ns->n_compression_fails);
+					uint64_t n_decompressions = cf_atomic64_get(ns->n_decompressions);
+
+					cf_info(AS_INFO, "{%s} compression ratio %.3f : compress avg-us %.2f : decompress avg-us %.2f",
+							ns->name,
+							(double)cf_atomic64_get(ns->compression_stored_bytes) / (double)(orig_bytes == 0 ? 1 : orig_bytes),
+							(double)cf_atomic64_get(ns->compression_ns) / 1000.0 / (double)(n_compressions == 0 ? 1 : n_compressions),
+							(double)cf_atomic64_get(ns->decompression_ns) / 1000.0 / (double)(n_decompressions == 0 ? 1 : n_decompressions));
+				}
+
+				if (ns->storage_type == AS_STORAGE_ENGINE_SSD) {
+					uint64_t reclaimed = cf_atomic64_get(ns->defrag_bytes_reclaimed);
+
+					if (reclaimed != 0) {
+						cf_info(AS_INFO, "{%s} defrag bytes moved %"PRIu64" : reclaimed %"PRIu64" : moved per reclaimed %.3f",
+								ns->name, cf_atomic64_get(ns->defrag_bytes_moved), reclaimed,
+								(double)cf_atomic64_get(ns->defrag_bytes_moved) / (double)reclaimed);
+					}
+				}
+
 				if (ns->ldt_enabled) {
 					uint64_t cnt              = cf_atomic_int_get(ns->lstats.ldt_gc_processed);
 					uint64_t io               = cf_atomic_int_get(ns->lstats.ldt_gc_io);
@@ -4991,6 +5192,11 @@ info_debug_ticker_fn(void *unused)
 					histogram_dump(g_config.prole_fabric_send_hist);
 			}
 
+			// Only populated when a record lock is found held - always dump.
+			if (g_config.record_lock_wait_hist) {
+				histogram_dump(g_config.record_lock_wait_hist);
+			}
+
 			if (g_config.storage_benchmarks) {
 				as_storage_ticker_stats();
 			}
@@ -5905,6 +6111,25 @@ info_get_namespace_info(as_namespace *ns, cf_dyn_buf *db)
 	info_append_uint64("", "index-used-bytes-memory", pindex_memory,   db);
 	info_append_uint64("", "sindex-used-bytes-memory", sindex_memory,   db);
 
+	// where the index arena stages are
+	cf_arenax_placement placement;
+	cf_arenax_get_placement(ns->arena, &placement);
+
+	info_append_uint64("", "index-arena-stages", placement.stages, db);
+	info_append_uint64("", "index-arena-stages-thp", placement.stages_thp, db);
+	info_append_uint64("", "index-arena-stages-huge-2m", placement.stages_huge_2m, db);
+	info_append_uint64("", "index-arena-stages-huge-1g", placement.stages_huge_1g, db);
+	info_append_uint64("", "index-arena-stages-interleaved", placement.stages_interleaved, db);
+
+	for (int n = 0; n < CF_ARENAX_MAX_NUMA_NODES; n++) {
+		if (placement.stages_per_node[n] != 0) {
+			char name[64];
+
+			sprintf(name, "index-arena-stages-node-%d", n);
+			info_append_uint64("", name, placement.stages_per_node[n], db);
+		}
+	}
+
 	free_pct = (ns->memory_size && (ns->memory_size > used_memory))
 			   ? (((ns->memory_size - used_memory) * 100L) / ns->memory_size)
 			   : 0;
@@ -5965,6 +6190,24 @@ info_get_namespace_info(as_namespace *ns, cf_dyn_buf *db)
 	cf_dyn_buf_append_string(db, ";migrate-record-receives=");
 	cf_dyn_buf_append_uint64(db, ns->migrate_record_receives);
 
+	cf_dyn_buf_append_string(db, ";migrate-record-batches-transmitted=");
+	cf_dyn_buf_append_uint64(db, ns->migrate_record_batches_transmitted);
+
+	cf_dyn_buf_append_string(db, ";migrate-record-batch-receives=");
+	cf_dyn_buf_append_uint64(db, ns->migrate_record_batch_receives);
+
+	cf_dyn_buf_append_string(db, ";migrate-tx-bytes=");
+	cf_dyn_buf_append_uint64(db, ns->migrate_tx_bytes);
+
+	cf_dyn_buf_append_string(db, ";migrate-tx-bytes-per-sec=");
+	cf_dyn_buf_append_uint64(db, ns->migrate_tx_bytes_per_sec);
+
+	cf_dyn_buf_append_string(db, ";migrate-tx-records-per-sec=");
+	cf_dyn_buf_append_uint64(db, ns->migrate_tx_records_per_sec);
+
+	cf_dyn_buf_append_string(db, ";migrate-tx-eta-sec=");
+	cf_dyn_buf_append_uint64(db, ns->migrate_tx_eta_sec);
+
 	// LDT operational statistics
 	//
 	// print only if LDT is enabled
@@ -6073,7 +6316,34 @@ info_get_namespace_info(as_namespace *ns, cf_dyn_buf *db)
 		if (! ns->storage_data_in_memory) {
 			cf_dyn_buf_append_string(db, ";cache-read-pct=");
 			cf_dyn_buf_append_int(db, (int)(ns->cache_read_pct + 0.5));
+
+			info_append_uint64("", "read-cache-used-bytes", cf_atomic64_get(ns->read_cache_bytes), db);
+			info_append_uint64("", "read-cache-hits", cf_atomic64_get(ns->n_read_cache_hits), db);
+			info_append_uint64("", "read-cache-misses", cf_atomic64_get(ns->n_read_cache_misses), db);
+			info_append_uint64("", "read-cache-evictions", cf_atomic64_get(ns->n_read_cache_evictions), db);
+
+			info_append_uint64("", "hot-tier-used-bytes", cf_atomic64_get(ns->hot_tier_bytes), db);
+			info_append_uint64("", "hot-tier-hits", cf_atomic64_get(ns->n_hot_tier_hits), db);
+			info_append_uint64("", "hot-tier-misses", cf_atomic64_get(ns->n_hot_tier_misses), db);
+			info_append_uint64("", "hot-tier-promotions", cf_atomic64_get(ns->n_hot_tier_promotions), db);
+			info_append_uint64("", "hot-tier-demotions", cf_atomic64_get(ns->n_hot_tier_demotions), db);
 		}
+
+		info_append_uint64("", "storage-checksum-errors", cf_atomic64_get(ns->n_storage_checksum_errors), db);
+		info_append_uint64("", "storage-checksum-repairs", cf_atomic64_get(ns->n_storage_checksum_repairs), db);
+		info_append_uint64("", "defrag-bytes-moved", cf_atomic64_get(ns->defrag_bytes_moved), db);
+		info_append_uint64("", "defrag-bytes-reclaimed", cf_atomic64_get(ns->defrag_bytes_reclaimed), db);
+
+		if (ns->storage_compression != COMPRESSION_NONE) {
+			info_append_uint64("", "compression-orig-bytes", cf_atomic64_get(ns->compression_orig_bytes), db);
+			info_append_uint64("", "compression-stored-bytes", cf_atomic64_get(ns->compression_stored_bytes), db);
+		}
+
+		info_append_uint64("", "compressions", cf_atomic64_get(ns->n_compressions), db);
+		info_append_uint64("", "compression-fails", cf_atomic64_get(ns->n_compression_fails), db);
+		info_append_uint64("", "compression-ns", cf_atomic64_get(ns->compression_ns), db);
+		info_append_uint64("", "decompressions", cf_atomic64_get(ns->n_decompressions), db);
+		info_append_uint64("", "decompression-ns", cf_atomic64_get(ns->decompression_ns), db);
 	} // SSD
 }
 
@@ -6366,6 +6636,7 @@ clear_microbenchmark_histograms()
 	histogram_clear(g_config.write_storage_close_hist);
 	histogram_clear(g_config.write_sindex_hist);
 	histogram_clear(g_config.prole_fabric_send_hist);
+	histogram_clear(g_config.record_lock_wait_hist);
 }
 
 // SINDEX wire protocol examples:
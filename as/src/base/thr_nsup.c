@@ -1387,6 +1387,9 @@ thr_nsup(void *arg)
 					evict_ttl, n_set_waits, n_clear_waits, n_general_waits,
 					start_ms);
 
+			// Demote records that have gone cold from the storage hot tier.
+			as_storage_demote_hot(ns);
+
 			// Delete non-master records from set(s) being deleted.
 			if (do_set_deletion && g_config.non_master_sets_delete) {
 				non_master_sets_delete(ns, sets_deleting);
@@ -118,6 +118,7 @@
 #include "base/aggr.h"
 #include "base/as_stap.h"
 #include "base/datamodel.h"
+#include "base/index.h"
 #include "base/secondary_index.h"
 #include "base/thr_tsvc.h"
 #include "base/transaction.h"
@@ -1542,6 +1543,35 @@ query_record_matches(as_query_transaction *qtr, as_storage_rd *rd, as_sindex_key
 
 
 
+/*
+ * Warm the primary index for the next group of digests before query_io() looks
+ * them up one at a time. Only done when partitions are pre-reserved, so the
+ * trees are already held.
+ */
+static void
+query_io_prefetch(as_query_transaction *qtr, cf_digest *digs, int n)
+{
+	if (!qtr->qctx.partitions_pre_reserved) {
+		return;
+	}
+
+	as_index_tree *trees[AS_INDEX_PREFETCH_GROUP];
+	cf_digest keyds[AS_INDEX_PREFETCH_GROUP];
+	uint32_t n_keys = 0;
+
+	for (int i = 0; i < n && i < AS_INDEX_PREFETCH_GROUP; i++) {
+		as_partition_id pid = as_partition_getid(digs[i]);
+
+		if (qtr->qctx.can_partition_query[pid]) {
+			trees[n_keys] = qtr->rsv[pid].tree;
+			keyds[n_keys] = digs[i];
+			n_keys++;
+		}
+	}
+
+	as_index_prefetch_multi(trees, keyds, n_keys);
+}
+
 static int
 query_io(as_query_transaction *qtr, cf_digest *dig, as_sindex_key * skey)
 {
@@ -1920,6 +1950,10 @@ query_process_ioreq(query_work *qio)
 		}
 		node->keys_arr     = NULL;
 		for (int i = 0; i < keys_arr->num; i++) {
+			if (i % AS_INDEX_PREFETCH_GROUP == 0) {
+				query_io_prefetch(qtr, &keys_arr->pindex_digs[i], keys_arr->num - i);
+			}
+
 			if (AS_QUERY_OK != query_io(qtr, &keys_arr->pindex_digs[i], &keys_arr->sindex_keys[i])) {
 				as_index_keys_release_arr_to_queue(keys_arr);
 				goto Cleanup;
@@ -738,7 +738,8 @@ internal_rw_start(as_transaction *tr, write_request *wr, bool *delete)
 	bool dupl_resolved = true;
 	int rv             = 0;
 	bool is_delete     = (tr->msgp->msg.info2 & AS_MSG_INFO2_DELETE);
-	bool fast_dupl_resolve = true;
+	// A repair needs the other copies even if they're no newer than ours.
+	bool fast_dupl_resolve = (tr->from_flags & FROM_FLAG_SCRUB_REPAIR) == 0;
 
 	if ((wr->dupl_trans_complete == 0) && (tr->rsv.n_dupl > 0)) {
 		dupl_resolved = false;
@@ -818,6 +819,15 @@ internal_rw_start(as_transaction *tr, write_request *wr, bool *delete)
 	// 3. Duplicates are either unnecessary or resolved.
 	// Start the actual operation
 	else {
+		// A repair is done once the duplicate phase has replaced the corrupt
+		// local copy - there's nothing to write, replicate or reply.
+		if ((tr->from_flags & FROM_FLAG_SCRUB_REPAIR) != 0) {
+			WR_TRACK_INFO(wr, "internal_rw_start: repair done");
+			rw_cleanup(wr, tr, first_time, false, __LINE__);
+			*delete = true;
+			return (0);
+		}
+
 		// Short circuit for reads, after duplicate resolution record will
 		// already be open.
 		if ((wr->is_read == true)
@@ -1368,6 +1378,63 @@ int as_read_start(as_transaction *tr) {
 	}
 }
 
+// Queue an internal transaction to replace a corrupt local copy of a record
+// with the best copy on the partition's other replicas. It goes through the
+// duplicate resolution phase only - nothing is written to the other replicas.
+void
+as_write_queue_repair(as_namespace *ns, cf_digest *keyd)
+{
+	size_t ns_name_len = strlen(ns->name);
+	size_t sz = sizeof(cl_msg) +
+			sizeof(as_msg_field) + ns_name_len +
+			sizeof(as_msg_field) + sizeof(cf_digest);
+
+	cl_msg *msgp = cf_malloc(sz);
+
+	if (! msgp) {
+		cf_crash(AS_RW, "cf_malloc");
+	}
+
+	msgp->proto.version = PROTO_VERSION;
+	msgp->proto.type = PROTO_TYPE_AS_MSG;
+	msgp->proto.sz = sz - sizeof(as_proto);
+	msgp->msg.header_sz = sizeof(as_msg);
+	msgp->msg.info1 = 0;
+	msgp->msg.info2 = AS_MSG_INFO2_WRITE;
+	msgp->msg.info3 = 0;
+	msgp->msg.unused = 0;
+	msgp->msg.generation = 0;
+	msgp->msg.record_ttl = 0;
+	msgp->msg.transaction_ttl = 0;
+	msgp->msg.n_fields = 2;
+	msgp->msg.n_ops = 0;
+
+	uint8_t *buf = msgp->msg.data;
+	as_msg_field *fp;
+
+	fp = (as_msg_field*)buf;
+	fp->type = AS_MSG_FIELD_TYPE_NAMESPACE;
+	fp->field_sz = 1 + ns_name_len; // 1 for the type field
+	memcpy(fp->data, ns->name, ns_name_len);
+	buf += sizeof(as_msg_field) + ns_name_len;
+
+	fp = (as_msg_field*)buf;
+	fp->type = AS_MSG_FIELD_TYPE_DIGEST_RIPE;
+	fp->field_sz = 1 + sizeof(cf_digest); // 1 for the type field
+	*(cf_digest*)fp->data = *keyd;
+
+	// INIT_TR
+	as_transaction tr;
+	as_transaction_init_head(&tr, NULL, msgp);
+	tr.origin = FROM_NSUP;
+	tr.from_flags |= FROM_FLAG_SCRUB_REPAIR;
+	tr.start_time = cf_getns();
+	as_transaction_set_msg_field_flag(&tr, AS_MSG_FIELD_TYPE_NAMESPACE);
+	as_transaction_set_msg_field_flag(&tr, AS_MSG_FIELD_TYPE_DIGEST_RIPE);
+
+	thr_tsvc_enqueue(&tr);
+}
+
 void rw_msg_get_ldt_dupinfo(as_record_merge_component *c, msg *m) {
 	uint32_t info = 0;
 	c->flag = AS_COMPONENT_FLAG_DUP;
@@ -1544,6 +1611,14 @@ finish_rw_process_dup_ack(write_request *wr)
 		comp_sz++;
 	}
 
+	bool is_repair = (wr->from_flags & FROM_FLAG_SCRUB_REPAIR) != 0;
+
+	if (is_repair) {
+		for (int i = 0; i < comp_sz; i++) {
+			components[i].flag |= AS_COMPONENT_FLAG_REPAIR;
+		}
+	}
+
 	// updates the local in-memory representation
 	int rv         = 0;
 	int winner_idx = -1;
@@ -1552,6 +1627,23 @@ finish_rw_process_dup_ack(write_request *wr)
 				&winner_idx);
 	}
 
+	if (is_repair) {
+		if (comp_sz == 0) {
+			cf_warning_digest(AS_RW, &wr->keyd, "{%s} repair: no other copy found - corrupt copy left in place ",
+					wr->rsv.ns->name);
+		}
+		else if (rv != 0 || winner_idx < 0) {
+			cf_warning_digest(AS_RW, &wr->keyd, "{%s} repair: failed to replace corrupt copy (%d) ",
+					wr->rsv.ns->name, rv);
+		}
+		else {
+			cf_atomic64_incr(&wr->rsv.ns->n_storage_checksum_repairs);
+			cf_info_digest(AS_RW, &wr->keyd, "{%s} repair: replaced corrupt copy with gen %u lut %lu ",
+					wr->rsv.ns->name, components[winner_idx].generation,
+					components[winner_idx].last_update_time);
+		}
+	}
+
 	// Free up the dup messages
 	for (uint i = 0; i < wr->dest_sz; i++) {
 		if (wr->dup_msg[i]) {
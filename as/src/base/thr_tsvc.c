@@ -22,12 +22,15 @@
 
 #include "base/thr_tsvc.h"
 
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "citrusleaf/alloc.h"
@@ -37,6 +40,7 @@
 #include "citrusleaf/cf_queue.h"
 
 #include "fault.h"
+#include "mpmc_ring.h"
 #include "util.h"
 
 #include "base/cfg.h"
@@ -271,6 +275,18 @@ process_transaction(as_transaction *tr)
 
 		rv = 0;
 	}
+	else if ((tr->from_flags & FROM_FLAG_SCRUB_REPAIR) != 0) {
+		// A repair runs wherever the corrupt copy is, master or not - fetch
+		// the other replicas' copies as if they were duplicates.
+		as_partition_reserve_migrate(ns, pid, &tr->rsv, &dest);
+
+		cf_atomic_int_incr(&g_config.rw_tree_count);
+
+		tr->rsv.n_dupl = (uint8_t)as_partition_getreplica_readall(ns, pid,
+				tr->rsv.dupl_nodes);
+
+		rv = 0;
+	}
 	else if (is_write) {
 		if (should_security_check_data_op(tr) &&
 				! as_security_check_data_op(tr, ns, PERM_WRITE)) {
@@ -431,6 +447,208 @@ thr_tsvc(void *arg)
 } // end thr_tsvc()
 
 
+//------------------------------------------------
+// Work-stealing transaction queues - one lock-free
+// ring per queue, fed from the enqueuing thread's
+// CPU. Service threads whose queue runs dry steal
+// from the others before parking.
+//
+
+// Ring slots per queue - if a ring fills, the excess goes to a locked
+// overflow queue, and so does everything after it until the overflow drains.
+// Transactions in the ring are then always older than those in the overflow,
+// so popping the ring first keeps the queue FIFO and can't starve overflow.
+#define TSVC_RING_SIZE (4 * 1024)
+
+// Parked threads wake at least this often to look for work to steal.
+#define TSVC_PARK_NS (10 * 1000 * 1000)
+
+typedef struct tsvc_queue_s {
+	cf_mpmc_ring		ring;
+
+	cf_queue*			overflow;
+	cf_atomic32			n_overflow;
+
+	pthread_mutex_t		park_lock;
+	pthread_cond_t		park_cond;
+	cf_atomic32			n_parked;
+
+	// Transactions taken from this queue by other queues' threads.
+	cf_atomic64			n_stolen;
+} __attribute__ ((aligned(CF_MPMC_RING_CACHE_LINE_SIZE))) tsvc_queue;
+
+static tsvc_queue* g_tsvc_queues = NULL;
+
+static inline bool
+tsvc_queue_is_empty(tsvc_queue* tq)
+{
+	return cf_mpmc_ring_sz(&tq->ring) == 0 &&
+			cf_atomic32_get(tq->n_overflow) == 0;
+}
+
+static inline bool
+tsvc_queue_pop(tsvc_queue* tq, as_transaction* tr)
+{
+	if (cf_mpmc_ring_pop(&tq->ring, tr)) {
+		return true;
+	}
+
+	if (cf_atomic32_get(tq->n_overflow) != 0 &&
+			cf_queue_pop(tq->overflow, tr, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		cf_atomic32_decr(&tq->n_overflow);
+		return true;
+	}
+
+	return false;
+}
+
+static inline void
+tsvc_queue_wake(tsvc_queue* tq)
+{
+	pthread_mutex_lock(&tq->park_lock);
+	pthread_cond_signal(&tq->park_cond);
+	pthread_mutex_unlock(&tq->park_lock);
+}
+
+static void
+tsvc_queue_push(uint32_t n_q, as_transaction* tr)
+{
+	tsvc_queue* tq = &g_tsvc_queues[n_q];
+
+	if (cf_atomic32_get(tq->n_overflow) != 0 ||
+			! cf_mpmc_ring_push(&tq->ring, tr)) {
+		// Count first so a parking thread never sees the queue as empty.
+		cf_atomic32_incr(&tq->n_overflow);
+
+		if (cf_queue_push(tq->overflow, tr) != 0) {
+			cf_crash(AS_TSVC, "transaction queue push failed - out of memory?");
+		}
+	}
+
+	// Pairs with the barrier in tsvc_queue_park() - either we see the parked
+	// thread, or it sees our transaction.
+	__sync_synchronize();
+
+	if (cf_atomic32_get(tq->n_parked) != 0) {
+		tsvc_queue_wake(tq);
+		return;
+	}
+
+	// All this queue's threads are busy - prod a parked neighbour to steal.
+	tsvc_queue* ntq = &g_tsvc_queues[(n_q + 1) % g_config.n_transaction_queues];
+
+	if (ntq != tq && cf_atomic32_get(ntq->n_parked) != 0) {
+		tsvc_queue_wake(ntq);
+	}
+}
+
+static bool
+tsvc_queue_steal(uint32_t n_q, as_transaction* tr)
+{
+	uint32_t n_queues = (uint32_t)g_config.n_transaction_queues;
+
+	for (uint32_t i = 1; i < n_queues; i++) {
+		tsvc_queue* victim = &g_tsvc_queues[(n_q + i) % n_queues];
+
+		// Don't pay for the CAS on queues that look empty.
+		if (! tsvc_queue_is_empty(victim) && tsvc_queue_pop(victim, tr)) {
+			cf_atomic64_incr(&victim->n_stolen);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void
+tsvc_queue_park(tsvc_queue* tq)
+{
+	pthread_mutex_lock(&tq->park_lock);
+
+	cf_atomic32_incr(&tq->n_parked); // full barrier
+
+	if (tsvc_queue_is_empty(tq)) {
+		struct timespec ts;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += TSVC_PARK_NS;
+
+		if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000 * 1000 * 1000;
+		}
+
+		pthread_cond_timedwait(&tq->park_cond, &tq->park_lock, &ts);
+	}
+
+	cf_atomic32_decr(&tq->n_parked);
+
+	pthread_mutex_unlock(&tq->park_lock);
+}
+
+// Service transactions - arg is the index of our home queue.
+static void *
+thr_tsvc_stealing(void *arg)
+{
+	uint32_t n_q = (uint32_t)(uint64_t)arg;
+	tsvc_queue* tq = &g_tsvc_queues[n_q];
+
+	for ( ; ; ) {
+		as_transaction tr;
+
+		if (! tsvc_queue_pop(tq, &tr) && ! tsvc_queue_steal(n_q, &tr)) {
+			tsvc_queue_park(tq);
+			continue;
+		}
+
+		MICROBENCHMARK_HIST_INSERT_AND_RESET(q_wait_hist);
+
+		process_transaction(&tr);
+	}
+
+	return NULL;
+} // end thr_tsvc_stealing()
+
+static void
+tsvc_queues_create()
+{
+	g_tsvc_queues = cf_valloc(sizeof(tsvc_queue) * g_config.n_transaction_queues);
+
+	if (! g_tsvc_queues) {
+		cf_crash(AS_TSVC, "tsvc queue array allocation failed");
+	}
+
+	for (int i = 0; i < g_config.n_transaction_queues; i++) {
+		tsvc_queue* tq = &g_tsvc_queues[i];
+
+		memset(tq, 0, sizeof(tsvc_queue));
+
+		if (! cf_mpmc_ring_init(&tq->ring, AS_TRANSACTION_HEAD_SIZE, TSVC_RING_SIZE)) {
+			cf_crash(AS_TSVC, "tsvc queue ring allocation failed");
+		}
+
+		tq->overflow = cf_queue_create(AS_TRANSACTION_HEAD_SIZE, true);
+
+		pthread_mutex_init(&tq->park_lock, NULL);
+		pthread_cond_init(&tq->park_cond, NULL);
+	}
+}
+
+// Keep transactions on the queue (and so the service threads) of the CPU
+// they were received on.
+static inline uint32_t
+tsvc_queue_select()
+{
+	int cpu = sched_getcpu();
+
+	if (cpu < 0) {
+		return (g_config.transactionq_current++) % g_config.n_transaction_queues;
+	}
+
+	return (uint32_t)cpu % g_config.n_transaction_queues;
+}
+
+
 pthread_t* g_transaction_threads;
 
 static inline pthread_t*
@@ -472,14 +690,27 @@ as_tsvc_init()
 		g_config.n_transaction_queues = n_queues;
 		cf_info(AS_TSVC, "device queues: %d queues with %d threads each",
 				g_config.n_transaction_queues, g_config.n_transaction_threads_per_queue);
+
+		if (g_config.transaction_queue_stealing) {
+			cf_warning(AS_TSVC, "use-queue-per-device set - ignoring transaction-queue-stealing");
+			g_config.transaction_queue_stealing = false;
+		}
+	} else if (g_config.transaction_queue_stealing) {
+		cf_info(AS_TSVC, "work-stealing queues: %d queues with %d threads each",
+				g_config.n_transaction_queues, g_config.n_transaction_threads_per_queue);
 	} else {
 		cf_info(AS_TSVC, "shared queues: %d queues with %d threads each",
 				g_config.n_transaction_queues, g_config.n_transaction_threads_per_queue);
 	}
 
 	// Create the transaction queues.
-	for (int i = 0; i < g_config.n_transaction_queues ; i++) {
-		g_config.transactionq_a[i] = cf_queue_create(AS_TRANSACTION_HEAD_SIZE, true);
+	if (g_config.transaction_queue_stealing) {
+		tsvc_queues_create();
+	}
+	else {
+		for (int i = 0; i < g_config.n_transaction_queues ; i++) {
+			g_config.transactionq_a[i] = cf_queue_create(AS_TRANSACTION_HEAD_SIZE, true);
+		}
 	}
 
 	// Allocate the transaction threads that service all the queues.
@@ -492,7 +723,11 @@ as_tsvc_init()
 	// Start all the transaction threads.
 	for (int i = 0; i < g_config.n_transaction_queues; i++) {
 		for (int j = 0; j < g_config.n_transaction_threads_per_queue; j++) {
-			if (0 != pthread_create(transaction_thread(i, j), NULL, thr_tsvc, (void*)g_config.transactionq_a[i])) {
+			int rv = g_config.transaction_queue_stealing ?
+					pthread_create(transaction_thread(i, j), NULL, thr_tsvc_stealing, (void*)(uint64_t)i) :
+					pthread_create(transaction_thread(i, j), NULL, thr_tsvc, (void*)g_config.transactionq_a[i]);
+
+			if (0 != rv) {
 				cf_crash(AS_TSVC, "tsvc thread %d:%d create failed", i, j);
 			}
 		}
@@ -529,6 +764,12 @@ thr_tsvc_enqueue(as_transaction *tr)
 	if ((tr->proto_fd == 0) && (tr->proxy_msg == 0)) raise(SIGINT);
 #endif
 
+	if (g_config.transaction_queue_stealing) {
+		// In work-stealing mode, stay local - idle threads will steal.
+		tsvc_queue_push(tsvc_queue_select(), tr);
+		return 0;
+	}
+
 	uint32_t n_q = 0;
 
 	if (g_config.use_queue_per_device) {
@@ -584,6 +825,15 @@ thr_tsvc_queue_get_size()
 {
 	int qs = 0;
 
+	if (g_tsvc_queues) {
+		for (int i = 0; i < g_config.n_transaction_queues; i++) {
+			qs += (int)cf_mpmc_ring_sz(&g_tsvc_queues[i].ring) +
+					(int)cf_atomic32_get(g_tsvc_queues[i].n_overflow);
+		}
+
+		return qs;
+	}
+
 	for (int i = 0; i < g_config.n_transaction_queues; i++) {
 		if (g_config.transactionq_a[i]) {
 			qs += cf_queue_sz(g_config.transactionq_a[i]);
@@ -595,3 +845,29 @@ thr_tsvc_queue_get_size()
 
 	return qs;
 } // end thr_tsvc_queue_get_size()
+
+
+// Work-stealing statistics: the deepest queue, and the total number of
+// transactions executed by a thread other than their home queue's.
+void
+thr_tsvc_queue_get_steal_stats(uint32_t *max_depth, uint64_t *n_stolen)
+{
+	*max_depth = 0;
+	*n_stolen = 0;
+
+	if (! g_tsvc_queues) {
+		return;
+	}
+
+	for (int i = 0; i < g_config.n_transaction_queues; i++) {
+		tsvc_queue* tq = &g_tsvc_queues[i];
+		uint32_t depth = cf_mpmc_ring_sz(&tq->ring) +
+				cf_atomic32_get(tq->n_overflow);
+
+		if (depth > *max_depth) {
+			*max_depth = depth;
+		}
+
+		*n_stolen += cf_atomic64_get(tq->n_stolen);
+	}
+} // end thr_tsvc_queue_get_steal_stats()
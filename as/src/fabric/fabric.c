@@ -264,6 +264,9 @@ typedef enum fb_status_e {
 // Inplace size
 #define FB_INPLACE_SZ (1024 * 128)
 
+// Overflow write buffers up to this size are kept for the next big message.
+#define FB_W_BUF_KEEP_SZ (1024 * 1024)
+
 typedef struct {
 
 	int fd;
@@ -280,12 +283,15 @@ typedef struct {
 
 	bool failed;                    // This fb has failed and is unusable.
 
-	// this is the write section
+	// this is the write section - messages are serialized back to back into
+	// w_data, and one that doesn't fit goes after them in w_buf, so everything
+	// goes out in one sendmsg()
 	size_t		w_total_len;		// total size to write
 	size_t		w_len;				// current size we've written
-	bool		w_in_place;
+	size_t		w_in_place_len;		// how much of w_total_len is in w_data
 	byte		w_data[ FB_INPLACE_SZ ];
-	byte		*w_buf;
+	byte		*w_buf;				// overflow - kept if not too big
+	size_t		w_buf_sz;			// capacity of w_buf
 
 	// This is the read section
 	uint32_t	r_msg_size; 		// size of the incoming message
@@ -294,7 +300,7 @@ typedef struct {
 	byte		*r_parse;			// parse from here
 	byte		*r_end;				// the end of r_buf
 	byte 		r_stack_buf[ FB_INPLACE_SZ ];
-	byte 		*r_buf;				// may be r_stack_buf or allocated big buffer
+	byte 		*r_buf;				// may be r_stack_buf or cf_rc_alloc()'d big buffer
 
 } fabric_buffer;
 
@@ -480,8 +486,9 @@ fabric_buffer_create(int fd)
 
 	fb->w_total_len = 0;
 	fb->w_len = 0;
-	fb->w_in_place = true;
+	fb->w_in_place_len = 0;
 	fb->w_buf = NULL;
+	fb->w_buf_sz = 0;
 
 	fb->r_msg_size = 0;
 	fb->r_type = M_TYPE_FABRIC; // since we don't have an "invalid"
@@ -574,10 +581,10 @@ fabric_buffer_release(fabric_buffer *fb)
 			cf_debug(AS_FABRIC, "dropping message: TCP connection close with writable bytes %zu", fb->w_total_len - fb->w_len);
 
 		if (fb->r_buf != fb->r_stack_buf) {
-			cf_free(fb->r_buf);
+			cf_rc_releaseandfree(fb->r_buf);
 		}
 
-		if (fb->w_in_place == false && fb->w_buf) cf_free(fb->w_buf);
+		if (fb->w_buf) cf_free(fb->w_buf);
 
 #ifdef EXTRA_CHECKS
 		// DEBUG - this is a large memset - not good for production
@@ -592,6 +599,29 @@ fabric_buffer_release(fabric_buffer *fb)
 
 }
 
+//
+// Serialize a message into the overflow buffer, behind everything in w_data.
+// The buffer is kept between messages, so only growing it costs a malloc.
+// Caller must make sure the overflow buffer is not already in use.
+
+static bool
+fabric_buffer_fill_overflow( fabric_buffer *fb, msg *m, size_t msg_sz )
+{
+	if (msg_sz > fb->w_buf_sz) {
+		if (fb->w_buf) cf_free(fb->w_buf);
+
+		fb->w_buf = cf_malloc(msg_sz);
+		fb->w_buf_sz = fb->w_buf ? msg_sz : 0;
+
+		if (! fb->w_buf) return(false);
+	}
+
+	msg_fillbuf(m, fb->w_buf, &msg_sz);
+	fb->w_total_len += msg_sz;
+
+	return(true);
+}
+
 //
 // Fill the write buffer from the fabric node element's stash
 // return false if there's nothing in this buffer
@@ -602,54 +632,33 @@ fabric_buffer_write_fill( fabric_buffer *fb )
 {
 	fabric_node_element *fne = fb->fne;
 
-	// check for fullness
-	if (fb->w_total_len >= FB_INPLACE_SZ)	return(true);
-
-	// See if we can fit any more
-	int q_rv;
-	do {
+	// Nothing may follow an overflow message - it would be sent out of order.
+	while (fb->w_total_len == fb->w_in_place_len && fb->w_in_place_len < FB_INPLACE_SZ) {
 		msg *m;
-		q_rv = cf_queue_priority_pop(fne->xmit_msg_queue, &m, CF_QUEUE_NOWAIT);
-		if (q_rv == 0)
-		{
-			size_t	remain = FB_INPLACE_SZ - fb->w_total_len;
-			if (0 != msg_fillbuf(m, &fb->w_data[fb->w_total_len], &remain)) {
-
-				// this is OK in normal operation. It's the way we tell there's not enough
-				// data left in the buffer
-				cf_detail(AS_FABRIC, "write fill: fb %p return bad, either malloc or push back", fb);
-
-				// not enough room left. If it's the first part of a message,
-				// then malloc a new buffer
-				if (remain > FB_INPLACE_SZ && fb->w_total_len == 0) {
-					cf_debug(AS_FABRIC, "msg fillbuf returned fail, allocating new size %zu", remain);
-					fb->w_buf = cf_malloc(remain);
-					if (fb->w_buf) {
-						cf_atomic_int_incr(&g_config.fabric_msgs_sent);
-						msg_fillbuf(m, fb->w_buf, &remain);
-						fb->w_in_place = false;
-						fb->w_total_len = remain;
-					}
-					as_fabric_msg_put(m); // this will drop, but we're out of memory
-				}
-				else {
-					// a partially full buffer, kick it out and let this large one hit
-					// an empty case. Hope that's OK.
-					// put it back on the queue - don't know the priority, make it high
-					cf_queue_priority_push(fne->xmit_msg_queue, &m, CF_QUEUE_PRIORITY_HIGH);
-				}
 
-				cf_detail(AS_FABRIC, "+ tot %zu len %zu", fb->w_total_len, fb->w_len);
+		if (0 != cf_queue_priority_pop(fne->xmit_msg_queue, &m, CF_QUEUE_NOWAIT)) {
+			break;
+		}
+
+		size_t	remain = FB_INPLACE_SZ - fb->w_in_place_len;
 
-				return(true);
-			}
-			cf_atomic_int_incr(&g_config.fabric_msgs_sent);
+		if (0 == msg_fillbuf(m, &fb->w_data[fb->w_in_place_len], &remain)) {
+			fb->w_in_place_len += remain;
 			fb->w_total_len += remain;
+		}
+		// not enough room left - remain is now the size needed, so put it in
+		// the overflow buffer, to go out in the same write
+		else if (! fabric_buffer_fill_overflow(fb, m, remain)) {
+			cf_warning(AS_FABRIC, "write fill: fb %p failed overflow alloc %zu - dropping msg", fb, remain);
 			as_fabric_msg_put(m);
+			continue;
 		}
-	} while(q_rv == 0 );
 
-	cf_detail(AS_FABRIC, "fabric_buffer_write_fill: fb %p inplace %d ( %zu : %zu )", fb, fb->w_in_place, fb->w_total_len, fb->w_len);
+		cf_atomic_int_incr(&g_config.fabric_msgs_sent);
+		as_fabric_msg_put(m);
+	}
+
+	cf_detail(AS_FABRIC, "fabric_buffer_write_fill: fb %p in place %zu ( %zu : %zu )", fb, fb->w_in_place_len, fb->w_total_len, fb->w_len);
 
 	return ( (fb->w_total_len == fb->w_len) ? false : true );
 
@@ -667,21 +676,24 @@ fabric_buffer_set_write_msg( fabric_buffer *fb, msg *m )
 
 	// Parse out the message to the inplace buffer
 	fb->w_len = 0;
-	fb->w_total_len = FB_INPLACE_SZ; // set the maximum for msg_fillbuf
-	if (0 != msg_fillbuf(m, &fb->w_data[0], &fb->w_total_len)) {
+	fb->w_total_len = 0;
+	fb->w_in_place_len = FB_INPLACE_SZ; // set the maximum for msg_fillbuf
+	if (0 != msg_fillbuf(m, &fb->w_data[0], &fb->w_in_place_len)) {
 		// msg_fillbuf says we don't have enough data, but has graciously suggested
 		// the real amount of size we need
-		cf_detail(AS_FABRIC, "msg fillbuf returned long buffer: allocating not-in-place %zu", fb->w_total_len);
-		fb->w_buf = cf_malloc(fb->w_total_len);
-		if (fb->w_buf == 0)	return(false);
-		msg_fillbuf(m, fb->w_buf, &fb->w_total_len);
-		fb->w_in_place = false;
+		size_t msg_sz = fb->w_in_place_len;
+
+		cf_detail(AS_FABRIC, "msg fillbuf returned long buffer: using overflow buffer %zu", msg_sz);
+		fb->w_in_place_len = 0;
+		if (! fabric_buffer_fill_overflow(fb, m, msg_sz)) {
+			as_fabric_msg_put(m);
+			return(false);
+		}
 	}
 	else {
-		fb->w_in_place = true;
-		fb->w_buf = 0;
-		fb->status = FB_STATUS_WRITE;
+		fb->w_total_len = fb->w_in_place_len;
 	}
+	fb->status = FB_STATUS_WRITE;
 	as_fabric_msg_put(m);
 	return(true);
 }
@@ -820,10 +832,13 @@ fabric_write_complete(fabric_buffer *fb)
 	// Reset the write components
 	fb->w_len = 0;
 	fb->w_total_len = 0;
-	fb->w_in_place = true;
-	if (fb->w_buf) {
+	fb->w_in_place_len = 0;
+
+	// Keep the overflow buffer for the next big message, unless it's huge.
+	if (fb->w_buf_sz > FB_W_BUF_KEEP_SZ) {
 		cf_free(fb->w_buf);
 		fb->w_buf = 0;
+		fb->w_buf_sz = 0;
 	}
 
 	if (fb->fne->live == false) {
@@ -900,9 +915,27 @@ fabric_process_writable(fabric_buffer *fb)
 
 	fabric_set_keepalive_options(fb);
 
-	byte *send_buf = fb->w_in_place ? fb->w_data : fb->w_buf;
+	// The rest of w_data, then any overflow message - one syscall.
+	struct iovec iov[2];
+	struct msghdr mh;
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+
+	if (fb->w_len < fb->w_in_place_len) {
+		iov[0].iov_base = fb->w_data + fb->w_len;
+		iov[0].iov_len = fb->w_in_place_len - fb->w_len;
+		iov[1].iov_base = fb->w_buf;
+		iov[1].iov_len = fb->w_total_len - fb->w_in_place_len;
+		mh.msg_iovlen = iov[1].iov_len == 0 ? 1 : 2;
+	}
+	else {
+		iov[0].iov_base = fb->w_buf + (fb->w_len - fb->w_in_place_len);
+		iov[0].iov_len = fb->w_total_len - fb->w_len;
+		mh.msg_iovlen = 1;
+	}
 
-	if (0 > (w_sz = send(fb->fd, send_buf + fb->w_len, w_len, MSG_NOSIGNAL))) {
+	if (0 > (w_sz = sendmsg(fb->fd, &mh, MSG_NOSIGNAL))) {
 		if (errno == EAGAIN) {
 			return 0;
 		}
@@ -1030,7 +1063,9 @@ fabric_process_read_msg(fabric_buffer *fb)
 		cf_detail(AS_FABRIC, "length required: %u", fb->r_msg_size);
 
 		if (fb->r_msg_size > FB_INPLACE_SZ) {
-			fb->r_buf = cf_malloc(fb->r_msg_size);
+			// Reference counted, so the msg parsed from it can hold on to it
+			// instead of copying fields out.
+			fb->r_buf = cf_rc_alloc(fb->r_msg_size);
 			fb->r_end = fb->r_buf + fb->r_msg_size;
 			fabric_buffer_shift(fb, parsable_size);
 			return false;
@@ -1144,7 +1179,11 @@ Next:
 			return false;
 		}
 
-		if (msg_parse(m, fb->r_parse, fb->r_msg_size) != 0) {
+		int parse_rv = fb->r_buf == fb->r_stack_buf ?
+				msg_parse(m, fb->r_parse, fb->r_msg_size) :
+				msg_parse_rc(m, fb->r_parse, fb->r_msg_size, fb->r_buf);
+
+		if (parse_rv != 0) {
 			cf_warning(AS_FABRIC, "msg_parse failed regular message, not supposed to happen: fb %p", fb);
 			shutdown(fb->fd, SHUT_WR);
 			return false;
@@ -1180,10 +1219,10 @@ Next:
 
 	fb->status = FB_STATUS_IDLE;
 
-	// If we used an allocated big buffer, we're done with it here - free it and
-	// restore stack buffer mode.
+	// If we used an allocated big buffer, we're done with it here - release it
+	// (a msg may still hold it) and restore stack buffer mode.
 	if (fb->r_buf != fb->r_stack_buf) {
-		cf_free(fb->r_buf);
+		cf_rc_releaseandfree(fb->r_buf);
 		fb->r_buf = fb->r_stack_buf;
 		fb->r_end = fb->r_buf + FB_INPLACE_SZ;
 	}
@@ -48,6 +48,7 @@
 #include "citrusleaf/cf_shash.h"
 
 #include "fault.h"
+#include "hist.h"
 #include "msg.h"
 #include "rchash.h"
 #include "util.h"
@@ -90,7 +91,9 @@ const msg_template migrate_mt[] = {
 		{ MIG_FIELD_PARTITION_SIZE, M_FT_UINT32 },
 		{ MIG_FIELD_META_RECORDS, M_FT_BUF },
 		{ MIG_FIELD_META_SEQUENCE, M_FT_UINT32 },
-		{ MIG_FIELD_META_SEQUENCE_FINAL, M_FT_UINT32 }
+		{ MIG_FIELD_META_SEQUENCE_FINAL, M_FT_UINT32 },
+		{ MIG_FIELD_BATCH_RECORDS, M_FT_BUF },
+		{ MIG_FIELD_BATCH_N_RECORDS, M_FT_UINT32 }
 };
 
 COMPILER_ASSERT(sizeof(migrate_mt) / sizeof (msg_template) == NUM_MIG_FIELDS);
@@ -106,6 +109,22 @@ COMPILER_ASSERT(sizeof(migrate_mt) / sizeof (msg_template) == NUM_MIG_FIELDS);
 #define MIGRATE_RETRANSMIT_STARTDONE_MS (g_config.transaction_retry_ms)
 #define MAX_BYTES_EMIGRATING (16 * 1024 * 1024)
 
+// Batched records - keep each batch within the fabric's in-place receive
+// buffer, and bound the number of unacked batches per emigration.
+#define MIGRATE_BATCH_MAX_SZ (120 * 1024)
+#define MIGRATE_BATCH_WINDOW 32
+
+// Bandwidth scheduling - each destination node's token bucket can save up at
+// most this much unused time, and a debt is slept off in steps no longer than
+// this, to stay responsive to rate changes.
+#define MIGRATE_BUCKET_MAX_US (100 * 1000)
+
+// Latency feedback - halve the rate when client p99 reaches the target, else
+// win it back a step at a time. Ignore intervals with too few transactions.
+#define MIGRATE_RATE_PCT_MIN 5
+#define MIGRATE_RATE_PCT_STEP 5
+#define MIGRATE_RATE_MIN_SAMPLES 100
+
 typedef struct pickled_record_s {
 	cf_digest     keyd;
 	uint32_t      generation;
@@ -139,6 +158,33 @@ typedef struct emigration_reinsert_ctrl_s {
 	msg *m;
 } emigration_reinsert_ctrl;
 
+// Header for each record packed in an OPERATION_INSERT_BATCH message. The
+// rec-props and then the pickled record follow it.
+typedef struct batch_record_s {
+	cf_digest     keyd;
+	uint32_t      generation;
+	uint32_t      void_time;
+	uint64_t      last_update_time;
+	uint32_t      rec_props_sz;
+	uint32_t      record_sz;
+	uint8_t       data[];
+} __attribute__ ((__packed__)) batch_record;
+
+typedef struct migrate_node_bucket_s {
+	cf_node  node;
+	uint64_t refill_us;
+	int64_t  tokens; // bytes - negative is debt
+	uint64_t refilled; // total bytes ever refilled - waiters' clock
+} migrate_node_bucket;
+
+// Scheduler's per-namespace state, between ticks.
+typedef struct migrate_ns_progress_s {
+	uint64_t tx_bytes;
+	uint64_t tx_records;
+	int64_t  tx_partitions_initial;
+	uint64_t tx_start_ms;
+} migrate_ns_progress;
+
 typedef struct immigration_ldt_version_s {
 	uint64_t        incoming_ldt_version;
 	as_partition_id pid;
@@ -157,6 +203,11 @@ static cf_atomic32 g_emigration_insert_id = 0;
 static cf_queue *g_emigration_q = NULL;
 static shash *g_immigration_ldt_version_hash;
 
+static migrate_node_bucket g_node_buckets[AS_CLUSTER_SZ];
+static pthread_mutex_t g_node_buckets_lock = PTHREAD_MUTEX_INITIALIZER;
+static cf_atomic32 g_migrate_rate_pct = 100;
+static migrate_ns_progress g_ns_progress[AS_NAMESPACE_SZ];
+
 
 //==========================================================
 // Forward declarations and inlines.
@@ -177,6 +228,10 @@ as_migrate_state emigrate_tree(emigration *emig);
 void *run_emigration_reinserter(void *arg);
 void emigrate_tree_reduce_fn(as_index_ref *r_ref, void *udata);
 bool emigrate_record(emigration *emig, msg *m);
+void emigration_record_sent(emigration *emig, uint64_t n_bytes);
+bool emigration_batch_add(emigration *emig, const pickled_record *pr);
+bool emigration_batch_flush(emigration *emig);
+void emigration_set_throughput(emigration *emig);
 int emigration_reinsert_reduce_fn(void *key, void *data, void *udata);
 as_migrate_state emigration_send_start(emigration *emig);
 as_migrate_state emigration_send_done(emigration *emig);
@@ -185,10 +240,21 @@ as_migrate_state emigration_send_done(emigration *emig);
 void *run_immigration_reaper(void *unused);
 int immigration_reaper_reduce_fn(void *key, uint32_t keylen, void *object, void *udata);
 
+// Bandwidth scheduling.
+void *run_migrate_scheduler(void *unused);
+void migrate_adjust_rate(uint64_t *prev_counts);
+void migrate_update_ns_progress(as_namespace *ns, migrate_ns_progress *prog, uint64_t now_ms, uint64_t elapsed_ms);
+void migrate_bandwidth_charge(cf_node dest, uint32_t n_bytes);
+uint64_t migrate_bandwidth_rate(uint64_t max_rate);
+migrate_node_bucket *migrate_node_bucket_get(cf_node node, uint64_t now_us);
+void migrate_node_bucket_refill(migrate_node_bucket *bucket, uint64_t rate, uint64_t now_us);
+
 // Migrate fabric message handling.
 int migrate_receive_msg_cb(cf_node src, msg *m, void *udata);
 void immigration_handle_start_request(cf_node src, msg *m);
 void immigration_handle_insert_request(cf_node src, msg *m);
+void immigration_handle_insert_batch_request(cf_node src, msg *m);
+bool immigration_merge_record(immigration *immig, cf_digest *keyd, as_record_merge_component *c);
 void immigration_handle_done_request(cf_node src, msg *m);
 void emigration_handle_insert_ack(cf_node src, msg *m);
 void emigration_handle_ctrl_ack(cf_node src, msg *m, uint32_t op);
@@ -269,6 +335,10 @@ as_migrate_init()
 		cf_crash(AS_MIGRATE, "failed to create immigration reaper thread");
 	}
 
+	if (pthread_create(&thread, &attrs, run_migrate_scheduler, NULL) != 0) {
+		cf_crash(AS_MIGRATE, "failed to create migrate scheduler thread");
+	}
+
 	if (shash_create(&g_immigration_ldt_version_hash,
 			immigration_ldt_version_hashfn, sizeof(immigration_ldt_version),
 			sizeof(void *), 64, SHASH_CR_MT_MANYLOCK) != SHASH_OK) {
@@ -301,6 +371,16 @@ as_migrate_emigrate(const partition_migrate_record *pmr)
 	emig->ctrl_q = NULL;
 	emig->meta_q = NULL;
 
+	emig->use_batch = false;
+	emig->batch_buf = NULL;
+	emig->batch_sz = 0;
+	emig->batch_capacity = 0;
+	emig->batch_n_records = 0;
+
+	emig->start_ms = 0;
+	emig->n_records_sent = 0;
+	emig->n_bytes_sent = 0;
+
 	AS_PARTITION_RESERVATION_INIT(emig->rsv);
 	as_partition_reserve_migrate(pmr->ns, pmr->pid, &emig->rsv, NULL);
 	cf_atomic_int_incr(&g_config.migtx_tree_count);
@@ -436,6 +516,15 @@ as_migrate_dump(bool verbose)
 }
 
 
+// Current share (percent) of migrate-node-max-bytes-per-sec in use, after
+// backing off for client latency.
+uint32_t
+as_migrate_get_rate_pct()
+{
+	return (uint32_t)cf_atomic32_get(g_migrate_rate_pct);
+}
+
+
 //==========================================================
 // Local helpers - emigration, immigration, & pickled record destructors.
 //
@@ -460,6 +549,10 @@ emigration_destroy(void *parm)
 		emig_meta_q_destroy(emig->meta_q);
 	}
 
+	if (emig->batch_buf) {
+		cf_free(emig->batch_buf);
+	}
+
 	if (emig->rsv.p) {
 		cf_atomic_int_decr(&emig->rsv.ns->migrate_tx_instance_count);
 
@@ -564,6 +657,10 @@ run_emigration(void *arg)
 
 		as_migrate_state result = emigrate(emig);
 
+		if (result == AS_MIGRATE_STATE_DONE) {
+			emigration_set_throughput(emig);
+		}
+
 		as_partition_emigrate_done(result, emig->rsv.ns, emig->rsv.pid,
 				emig->cluster_key, emig->tx_flags);
 
@@ -662,6 +759,13 @@ emigrate(emigration *emig)
 		return result;
 	}
 
+	// Wait for the destination's record summaries, if it's sending them.
+	if (emig->meta_q) {
+		emig_meta_q_collect(emig);
+	}
+
+	emig->start_ms = cf_getms();
+
 	//--------------------------------------------
 	// Send whole sub-tree - may block a while.
 	//
@@ -707,6 +811,14 @@ emigrate_tree(emigration *emig)
 
 	as_index_reduce(tree, emigrate_tree_reduce_fn, emig);
 
+	// Send whatever the reduce left in the last batch.
+	if (! emig->aborted && ! emigration_batch_flush(emig)) {
+		cf_warning(AS_MIGRATE, "imbalance: failed to emigrate record batch");
+		cf_atomic_int_incr(&emig->rsv.ns->migrate_tx_partitions_imbalance);
+		emig->aborted = true;
+		cf_atomic32_set(&emig->state, EMIG_STATE_ABORTED);
+	}
+
 	// Sets EMIG_STATE_FINISHED only if not already EMIG_STATE_ABORTED.
 	cf_atomic32_setmax(&emig->state, EMIG_STATE_FINISHED);
 
@@ -815,8 +927,31 @@ emigrate_tree_reduce_fn(as_index_ref *r_ref, void *udata)
 	as_storage_record_close(r, &rd);
 	as_record_done(r_ref, ns);
 
+	uint64_t pr_sz = pr.record_len + pr.rec_props.size;
+
+	//--------------------------------------------
+	// Either add the record to the current batch ...
+	//
+
+	if (emig->use_batch) {
+		bool added = emigration_batch_add(emig, &pr);
+
+		pickled_record_destroy(&pr);
+
+		if (! added) {
+			cf_warning(AS_MIGRATE, "imbalance: failed to emigrate record batch");
+			cf_atomic_int_incr(&ns->migrate_tx_partitions_imbalance);
+			emig->aborted = true;
+			cf_atomic32_set(&emig->state, EMIG_STATE_ABORTED);
+			return;
+		}
+
+		emigration_record_sent(emig, pr_sz);
+		return;
+	}
+
 	//--------------------------------------------
-	// Fill and send the fabric message.
+	// ... or fill and send a fabric message for it alone.
 	//
 
 	msg *m = as_fabric_msg_get(M_TYPE_MIGRATE);
@@ -866,15 +1001,32 @@ emigrate_tree_reduce_fn(as_index_ref *r_ref, void *udata)
 		return;
 	}
 
+	emigration_record_sent(emig, pr_sz);
+}
+
+
+// Accounts for a record sent (or batched), then throttles.
+void
+emigration_record_sent(emigration *emig, uint64_t n_bytes)
+{
+	as_namespace *ns = emig->rsv.ns;
+
 	cf_atomic_int_incr(&ns->migrate_records_transmitted);
 
+	emig->n_records_sent++;
+	emig->n_bytes_sent += n_bytes;
+
 	if (ns->migrate_sleep != 0) {
 		usleep(ns->migrate_sleep);
 	}
 
 	uint32_t waits = 0;
 
-	while (cf_atomic32_get(emig->bytes_emigrating) > MAX_BYTES_EMIGRATING &&
+	// Unacked batches also form a sliding window - each ack lets another
+	// batch go.
+	while ((cf_atomic32_get(emig->bytes_emigrating) > MAX_BYTES_EMIGRATING ||
+			(emig->use_batch && shash_get_size(emig->reinsert_hash) >=
+					MIGRATE_BATCH_WINDOW)) &&
 			emig->cluster_key == as_paxos_get_cluster_key()) {
 		usleep(1000);
 
@@ -906,7 +1058,13 @@ emigrate_record(emigration *emig, msg *m)
 		return false;
 	}
 
-	cf_atomic32_add(&emig->bytes_emigrating, (int32_t)msg_get_wire_size(m));
+	uint32_t wire_sz = msg_get_wire_size(m);
+
+	cf_atomic32_add(&emig->bytes_emigrating, (int32_t)wire_sz);
+	cf_atomic_int_add(&emig->rsv.ns->migrate_tx_bytes, wire_sz);
+
+	// Emigrations to the same node share its bandwidth.
+	migrate_bandwidth_charge(emig->dest, wire_sz);
 
 	if (as_fabric_send(emig->dest, m, AS_FABRIC_PRIORITY_LOW) !=
 			AS_FABRIC_SUCCESS) {
@@ -917,6 +1075,128 @@ emigrate_record(emigration *emig, msg *m)
 }
 
 
+// Appends a pickled record to the current batch, first sending the batch if
+// the record won't fit.
+bool
+emigration_batch_add(emigration *emig, const pickled_record *pr)
+{
+	uint32_t br_sz = (uint32_t)(sizeof(batch_record) + pr->rec_props.size +
+			pr->record_len);
+
+	if (emig->batch_sz != 0 && emig->batch_sz + br_sz > MIGRATE_BATCH_MAX_SZ &&
+			! emigration_batch_flush(emig)) {
+		return false;
+	}
+
+	uint32_t needed_sz = emig->batch_sz + br_sz;
+
+	if (needed_sz > emig->batch_capacity) {
+		// A record bigger than the budget goes in a batch of its own.
+		uint32_t capacity = needed_sz > MIGRATE_BATCH_MAX_SZ ?
+				needed_sz : MIGRATE_BATCH_MAX_SZ;
+		uint8_t *buf = cf_realloc(emig->batch_buf, capacity);
+
+		if (! buf) {
+			cf_warning(AS_MIGRATE, "failed batch buffer alloc");
+			return false;
+		}
+
+		emig->batch_buf = buf;
+		emig->batch_capacity = capacity;
+	}
+
+	batch_record *br = (batch_record *)(emig->batch_buf + emig->batch_sz);
+
+	br->keyd = pr->keyd;
+	br->generation = pr->generation;
+	br->void_time = pr->void_time;
+	br->last_update_time = pr->last_update_time;
+	br->rec_props_sz = pr->rec_props.size;
+	br->record_sz = (uint32_t)pr->record_len;
+
+	if (pr->rec_props.size != 0) {
+		memcpy(br->data, pr->rec_props.p_data, pr->rec_props.size);
+	}
+
+	memcpy(br->data + pr->rec_props.size, pr->record_buf, pr->record_len);
+
+	emig->batch_sz += br_sz;
+	emig->batch_n_records++;
+
+	return true;
+}
+
+
+// Sends the current batch (if any) as one message, acked and retransmitted as
+// a unit via the reinsert hash.
+bool
+emigration_batch_flush(emigration *emig)
+{
+	if (emig->batch_n_records == 0) {
+		return true;
+	}
+
+	msg *m = as_fabric_msg_get(M_TYPE_MIGRATE);
+
+	if (! m) {
+		cf_warning(AS_MIGRATE, "failed to get fabric msg");
+		return false;
+	}
+
+	msg_set_uint32(m, MIG_FIELD_OP, OPERATION_INSERT_BATCH);
+	msg_set_uint32(m, MIG_FIELD_EMIG_ID, emig->id);
+	msg_set_uint32(m, MIG_FIELD_BATCH_N_RECORDS, emig->batch_n_records);
+	msg_set_buf(m, MIG_FIELD_BATCH_RECORDS, emig->batch_buf, emig->batch_sz,
+			MSG_SET_HANDOFF_MALLOC);
+
+	// The message owns the buffer now - the next record starts a new one.
+	emig->batch_buf = NULL;
+	emig->batch_sz = 0;
+	emig->batch_capacity = 0;
+	emig->batch_n_records = 0;
+
+	if (! emigrate_record(emig, m)) {
+		return false;
+	}
+
+	cf_atomic_int_incr(&emig->rsv.ns->migrate_record_batches_transmitted);
+
+	return true;
+}
+
+
+// Records this emigration's throughput on the partition, for partition-info.
+void
+emigration_set_throughput(emigration *emig)
+{
+	if (emig->start_ms == 0 || emig->n_records_sent == 0) {
+		return;
+	}
+
+	uint64_t elapsed_ms = cf_getms() - emig->start_ms;
+
+	if (elapsed_ms == 0) {
+		elapsed_ms = 1;
+	}
+
+	uint64_t records_per_sec = (emig->n_records_sent * 1000) / elapsed_ms;
+	uint64_t bytes_per_sec = (emig->n_bytes_sent * 1000) / elapsed_ms;
+	as_partition *p = emig->rsv.p;
+
+	pthread_mutex_lock(&p->lock);
+
+	p->emig_records_per_sec = records_per_sec;
+	p->emig_bytes_per_sec = bytes_per_sec;
+
+	pthread_mutex_unlock(&p->lock);
+
+	cf_detail(AS_MIGRATE, "{%s:%u} emigrated %lu records in %lu ms - %lu rec/s %.3f MB/s",
+			emig->rsv.ns->name, emig->rsv.pid, emig->n_records_sent,
+			elapsed_ms, records_per_sec,
+			(double)bytes_per_sec / (1024 * 1024));
+}
+
+
 int
 emigration_reinsert_reduce_fn(void *key, void *data, void *udata)
 {
@@ -954,7 +1234,7 @@ emigration_send_start(emigration *emig)
 	uint32_t partition_size = emig->rsv.tree->elements;
 
 	msg_set_uint32(m, MIG_FIELD_OP, OPERATION_START);
-	msg_set_uint32(m, MIG_FIELD_FEATURES, MY_MIG_FEATURES);
+	msg_set_uint32(m, MIG_FIELD_FEATURES, MY_MIG_FEATURES | MIG_FEATURE_BATCH);
 	msg_set_uint32(m, MIG_FIELD_PARTITION_SIZE, partition_size);
 	msg_set_uint32(m, MIG_FIELD_EMIG_ID, emig->id);
 	msg_set_uint64(m, MIG_FIELD_CLUSTER_KEY, emig->cluster_key);
@@ -1128,6 +1408,303 @@ immigration_reaper_reduce_fn(void *key, uint32_t keylen, void *object,
 }
 
 
+//==========================================================
+// Local helpers - bandwidth scheduling.
+//
+
+// Adjusts the migration rate for client latency, and refreshes the
+// per-namespace progress stats, once a second.
+void *
+run_migrate_scheduler(void *unused)
+{
+	uint64_t prev_counts[N_BUCKETS] = { 0 };
+	uint64_t prev_ms = cf_getms();
+
+	while (true) {
+		sleep(1);
+
+		migrate_adjust_rate(prev_counts);
+
+		uint64_t now_ms = cf_getms();
+		uint64_t elapsed_ms = now_ms > prev_ms ? now_ms - prev_ms : 1;
+
+		for (uint32_t i = 0; i < g_config.n_namespaces; i++) {
+			migrate_update_ns_progress(g_config.namespaces[i],
+					&g_ns_progress[i], now_ms, elapsed_ms);
+		}
+
+		prev_ms = now_ms;
+	}
+
+	return NULL;
+}
+
+
+// AIMD on client p99 over the last interval, reads and writes combined.
+void
+migrate_adjust_rate(uint64_t *prev_counts)
+{
+	uint64_t counts[N_BUCKETS] = { 0 };
+	uint64_t hist_counts[N_BUCKETS];
+
+	// cf_hist_track is a histogram underneath.
+	if (g_config.rt_hist) {
+		histogram_get_counts((histogram *)g_config.rt_hist, hist_counts);
+
+		for (int b = 0; b < N_BUCKETS; b++) {
+			counts[b] += hist_counts[b];
+		}
+	}
+
+	if (g_config.wt_hist) {
+		histogram_get_counts((histogram *)g_config.wt_hist, hist_counts);
+
+		for (int b = 0; b < N_BUCKETS; b++) {
+			counts[b] += hist_counts[b];
+		}
+	}
+
+	uint64_t deltas[N_BUCKETS];
+	uint64_t total = 0;
+
+	for (int b = 0; b < N_BUCKETS; b++) {
+		// Histograms may have been cleared since the last snapshot.
+		deltas[b] = counts[b] >= prev_counts[b] ? counts[b] - prev_counts[b] : 0;
+		total += deltas[b];
+		prev_counts[b] = counts[b];
+	}
+
+	uint32_t target_ms = g_config.migrate_latency_target_ms;
+	int32_t pct = cf_atomic32_get(g_migrate_rate_pct);
+
+	if (target_ms == 0) {
+		pct = 100;
+	}
+	else if (total >= MIGRATE_RATE_MIN_SAMPLES) {
+		// Bucket b holds latencies in [2^(b-1), 2^b) ms, so p99 is only known
+		// to a power of 2 - use the bucket's floor.
+		uint64_t threshold = total - (total / 100);
+		uint64_t sum = 0;
+		int b = 0;
+
+		while (b < N_BUCKETS - 1 && (sum += deltas[b]) < threshold) {
+			b++;
+		}
+
+		uint64_t p99_ms = b == 0 ? 0 : 1UL << (b - 1);
+
+		if (p99_ms >= target_ms) {
+			pct /= 2;
+
+			if (pct < MIGRATE_RATE_PCT_MIN) {
+				pct = MIGRATE_RATE_PCT_MIN;
+			}
+		}
+		else if ((pct += MIGRATE_RATE_PCT_STEP) > 100) {
+			pct = 100;
+		}
+	}
+
+	int32_t prev_pct = cf_atomic32_get(g_migrate_rate_pct);
+
+	if (pct < prev_pct) {
+		cf_detail(AS_MIGRATE, "client latency over %u ms - migrate rate %d%% -> %d%%",
+				target_ms, prev_pct, pct);
+	}
+
+	cf_atomic32_set(&g_migrate_rate_pct, pct);
+}
+
+
+// Live send rate over the last interval, and an ETA from the average pace of
+// partitions finished since this round of migrations began.
+void
+migrate_update_ns_progress(as_namespace *ns, migrate_ns_progress *prog,
+		uint64_t now_ms, uint64_t elapsed_ms)
+{
+	uint64_t tx_bytes = (uint64_t)cf_atomic_int_get(ns->migrate_tx_bytes);
+	uint64_t tx_records =
+			(uint64_t)cf_atomic_int_get(ns->migrate_records_transmitted);
+
+	ns->migrate_tx_bytes_per_sec =
+			((tx_bytes - prog->tx_bytes) * 1000) / elapsed_ms;
+	ns->migrate_tx_records_per_sec =
+			((tx_records - prog->tx_records) * 1000) / elapsed_ms;
+
+	prog->tx_bytes = tx_bytes;
+	prog->tx_records = tx_records;
+
+	int64_t initial = cf_atomic_int_get(ns->migrate_tx_partitions_initial);
+	int64_t remaining = cf_atomic_int_get(ns->migrate_tx_partitions_remaining);
+
+	// A rebalance resets the initial count - start timing afresh.
+	if (initial != prog->tx_partitions_initial) {
+		prog->tx_partitions_initial = initial;
+		prog->tx_start_ms = now_ms;
+		ns->migrate_tx_eta_sec = 0;
+	}
+
+	int64_t done = initial - remaining;
+
+	if (remaining <= 0) {
+		ns->migrate_tx_eta_sec = 0;
+	}
+	else if (done > 0) {
+		ns->migrate_tx_eta_sec = ((now_ms - prog->tx_start_ms) *
+				(uint64_t)remaining) / ((uint64_t)done * 1000);
+	}
+}
+
+
+// Takes a message's bytes from its destination's token bucket, then sleeps
+// until the bucket has refilled enough to pay off the debt as it stood after
+// this charge - concurrent emigrations to the node queue up behind each other
+// at the node's rate. Sleeps in steps of at most MIGRATE_BUCKET_MAX_US, picking
+// up rate changes (config or latency back-off) at each step.
+void
+migrate_bandwidth_charge(cf_node dest, uint32_t n_bytes)
+{
+	uint64_t max_rate = g_config.migrate_node_max_bytes_per_sec;
+
+	if (max_rate == 0) {
+		return;
+	}
+
+	uint64_t rate = migrate_bandwidth_rate(max_rate);
+	uint64_t now_us = cf_getus();
+
+	pthread_mutex_lock(&g_node_buckets_lock);
+
+	migrate_node_bucket *bucket = migrate_node_bucket_get(dest, now_us);
+
+	migrate_node_bucket_refill(bucket, rate, now_us);
+	bucket->tokens -= n_bytes;
+
+	if (bucket->tokens >= 0) {
+		pthread_mutex_unlock(&g_node_buckets_lock);
+		return;
+	}
+
+	// Paid off when the bucket has refilled by our debt.
+	uint64_t start_refilled = bucket->refilled;
+	uint64_t paid_refilled = start_refilled + (uint64_t)-bucket->tokens;
+
+	while (true) {
+		uint64_t owed = paid_refilled - bucket->refilled;
+
+		pthread_mutex_unlock(&g_node_buckets_lock);
+
+		uint64_t sleep_us = (owed * 1000000) / rate;
+
+		usleep(sleep_us > MIGRATE_BUCKET_MAX_US ?
+				MIGRATE_BUCKET_MAX_US : (sleep_us == 0 ? 1 : sleep_us));
+
+		// Limit may have been lifted while we slept.
+		if ((max_rate = g_config.migrate_node_max_bytes_per_sec) == 0) {
+			return;
+		}
+
+		rate = migrate_bandwidth_rate(max_rate);
+		now_us = cf_getus();
+
+		pthread_mutex_lock(&g_node_buckets_lock);
+
+		bucket = migrate_node_bucket_get(dest, now_us);
+		migrate_node_bucket_refill(bucket, rate, now_us);
+
+		// Done if paid off, or if the bucket was recycled under us.
+		if (bucket->refilled >= paid_refilled ||
+				bucket->refilled < start_refilled) {
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&g_node_buckets_lock);
+}
+
+
+// Per-node rate in bytes/sec, after latency back-off.
+uint64_t
+migrate_bandwidth_rate(uint64_t max_rate)
+{
+	uint64_t rate = (max_rate * (uint64_t)cf_atomic32_get(g_migrate_rate_pct)) /
+			100;
+
+	return rate == 0 ? 1 : rate;
+}
+
+
+// Call under g_node_buckets_lock. Nodes that left the cluster get their
+// buckets recycled, oldest first.
+migrate_node_bucket *
+migrate_node_bucket_get(cf_node node, uint64_t now_us)
+{
+	migrate_node_bucket *oldest = &g_node_buckets[0];
+
+	for (int i = 0; i < AS_CLUSTER_SZ; i++) {
+		migrate_node_bucket *bucket = &g_node_buckets[i];
+
+		if (bucket->node == node) {
+			return bucket;
+		}
+
+		if (bucket->node == 0 || (oldest->node != 0 &&
+				bucket->refill_us < oldest->refill_us)) {
+			oldest = bucket;
+		}
+	}
+
+	oldest->node = node;
+	oldest->refill_us = now_us;
+	oldest->tokens = 0;
+	oldest->refilled = 0;
+
+	return oldest;
+}
+
+
+// Call under g_node_buckets_lock. A bucket holds at most MIGRATE_BUCKET_MAX_US
+// worth of tokens, so an idle node can't save up a big burst.
+void
+migrate_node_bucket_refill(migrate_node_bucket *bucket, uint64_t rate,
+		uint64_t now_us)
+{
+	if (now_us <= bucket->refill_us) {
+		return;
+	}
+
+	int64_t max_tokens = (int64_t)((rate * MIGRATE_BUCKET_MAX_US) / 1000000);
+
+	if (bucket->tokens >= max_tokens) {
+		bucket->refill_us = now_us;
+		return;
+	}
+
+	// Bound elapsed time so the multiply can't overflow - the bucket is full
+	// long before this anyway.
+	uint64_t elapsed_us = now_us - bucket->refill_us;
+
+	if (elapsed_us > 100 * 1000000UL) {
+		elapsed_us = 100 * 1000000UL;
+	}
+
+	int64_t added = (int64_t)((rate * elapsed_us) / 1000000);
+
+	// Too soon for a whole byte - leave refill_us so the time isn't lost.
+	if (added == 0) {
+		return;
+	}
+
+	if (bucket->tokens + added > max_tokens) {
+		added = max_tokens - bucket->tokens;
+	}
+
+	bucket->tokens += added;
+	bucket->refilled += (uint64_t)added;
+	bucket->refill_us = now_us;
+}
+
+
 //==========================================================
 // Local helpers - migrate fabric message handling.
 //
@@ -1156,6 +1733,9 @@ migrate_receive_msg_cb(cf_node src, msg *m, void *udata)
 	case OPERATION_INSERT:
 		immigration_handle_insert_request(src, m);
 		break;
+	case OPERATION_INSERT_BATCH:
+		immigration_handle_insert_batch_request(src, m);
+		break;
 	case OPERATION_CANCEL: // deprecated case
 	case OPERATION_DONE:
 		immigration_handle_done_request(src, m);
@@ -1165,6 +1745,7 @@ migrate_receive_msg_cb(cf_node src, msg *m, void *udata)
 	// Emigration - handle acknowledgments:
 	//
 	case OPERATION_INSERT_ACK:
+	case OPERATION_INSERT_BATCH_ACK:
 		emigration_handle_insert_ack(src, m);
 		break;
 	case OPERATION_START_ACK_OK:
@@ -1307,6 +1888,11 @@ immigration_handle_start_request(cf_node src, msg *m) {
 
 	uint32_t mig_features_in_use = MY_MIG_FEATURES | MIG_FEATURES_SEEN;
 
+	// Batches don't carry the LDT fields.
+	if ((emig_features & MIG_FEATURE_BATCH) != 0 && ! ns->ldt_enabled) {
+		mig_features_in_use |= MIG_FEATURE_BATCH;
+	}
+
 	as_partition_reserve_migrate(ns, pid, &immig->rsv, NULL);
 	cf_atomic_int_incr(&g_config.migrx_tree_count);
 
@@ -1441,32 +2027,134 @@ immigration_handle_insert_request(cf_node src, msg *m) {
 			return;
 		}
 
-		// TODO - should have inline wrapper to peek pickled bin count.
-		if (*(uint16_t *)c.record_buf == 0) {
-			cf_warning_digest(AS_MIGRATE, keyd, "handle insert: binless pickle, dropping ");
+		if (! immigration_merge_record(immig, keyd, &c)) {
+			immigration_release(immig);
+			as_fabric_msg_put(m);
+			return;
 		}
-		else {
-			int winner_idx  = -1;
-			int rv = as_record_flatten(&immig->rsv, keyd, 1, &c, &winner_idx);
-
-			if (rv != 0) {
-				if (rv != -3) {
-					// -3 is not a failure. It is get_create failure inside
-					// as_record_flatten which is possible in case of race.
-					cf_warning_digest(AS_MIGRATE, keyd, "handle insert: record flatten failed %d ", rv);
-					immigration_release(immig);
-					as_fabric_msg_put(m);
-					return;
-				}
+
+		immigration_release(immig);
+	}
+
+	msg_preserve_fields(m, 2, MIG_FIELD_EMIG_INSERT_ID, MIG_FIELD_EMIG_ID);
+
+	msg_set_uint32(m, MIG_FIELD_OP, OPERATION_INSERT_ACK);
+
+	if (as_fabric_send(src, m, AS_FABRIC_PRIORITY_MEDIUM) !=
+			AS_FABRIC_SUCCESS) {
+		as_fabric_msg_put(m);
+		return;
+	}
+}
+
+
+// Applies all the records of a batch in one pass, then acks the batch once.
+// Any failure leaves the batch unacked, so it will be retransmitted whole -
+// merging the records already applied again is harmless.
+void
+immigration_handle_insert_batch_request(cf_node src, msg *m) {
+	uint32_t emig_id;
+
+	if (msg_get_uint32(m, MIG_FIELD_EMIG_ID, &emig_id) != 0) {
+		cf_warning(AS_MIGRATE, "handle insert batch: msg get for emig id failed");
+		as_fabric_msg_put(m);
+		return;
+	}
+
+	uint8_t *buf;
+	size_t buf_sz;
+
+	if (msg_get_buf(m, MIG_FIELD_BATCH_RECORDS, &buf, &buf_sz,
+			MSG_GET_DIRECT) != 0) {
+		cf_warning(AS_MIGRATE, "handle insert batch: got no records");
+		as_fabric_msg_put(m);
+		return;
+	}
+
+	uint32_t n_records = 0;
+
+	msg_get_uint32(m, MIG_FIELD_BATCH_N_RECORDS, &n_records);
+
+	immigration_hkey hkey;
+
+	hkey.src = src;
+	hkey.emig_id = emig_id;
+
+	immigration *immig;
+
+	if (rchash_get(g_immigration_hash, (void *)&hkey, sizeof(hkey),
+			(void **)&immig) == RCHASH_OK) {
+		as_namespace *ns = immig->rsv.ns;
+
+		cf_atomic_int_incr(&ns->migrate_record_batch_receives);
+
+		if (immig->cluster_key != as_paxos_get_cluster_key()) {
+			immigration_release(immig);
+			as_fabric_msg_put(m);
+			return;
+		}
+
+		const uint8_t *at = buf;
+		const uint8_t *end = buf + buf_sz;
+		uint32_t n_merged = 0;
+
+		while (at < end) {
+			const batch_record *br = (const batch_record *)at;
+
+			if ((size_t)(end - at) < sizeof(batch_record) ||
+					(size_t)(end - br->data) <
+							(size_t)br->rec_props_sz + br->record_sz ||
+					br->record_sz < sizeof(uint16_t)) {
+				cf_warning(AS_MIGRATE, "handle insert batch: bad record at %u",
+						n_merged);
+				immigration_release(immig);
+				as_fabric_msg_put(m);
+				return;
 			}
+
+			as_record_merge_component c;
+
+			c.record_buf = (uint8_t *)br->data + br->rec_props_sz;
+			c.record_buf_sz = br->record_sz;
+			c.generation = br->generation == 0 ? 1 : br->generation;
+			c.void_time = br->void_time;
+			c.last_update_time = br->last_update_time;
+			c.rec_props.size = br->rec_props_sz;
+			c.rec_props.p_data = br->rec_props_sz == 0 ?
+					NULL : (uint8_t *)br->data;
+
+			// Never LDT - see immigration_handle_start_request().
+			c.flag = AS_COMPONENT_FLAG_MIG;
+			c.pdigest = cf_digest_zero;
+			c.edigest = cf_digest_zero;
+			c.pgeneration = 0;
+			c.pvoid_time = 0;
+			c.version = 0;
+
+			if (! immigration_merge_record(immig, (cf_digest *)&br->keyd,
+					&c)) {
+				immigration_release(immig);
+				as_fabric_msg_put(m);
+				return;
+			}
+
+			at = br->data + br->rec_props_sz + br->record_sz;
+			n_merged++;
 		}
 
+		if (n_merged != n_records) {
+			cf_warning(AS_MIGRATE, "handle insert batch: expected %u records, got %u",
+					n_records, n_merged);
+		}
+
+		cf_atomic_int_add(&ns->migrate_record_receives, n_merged);
+
 		immigration_release(immig);
 	}
 
 	msg_preserve_fields(m, 2, MIG_FIELD_EMIG_INSERT_ID, MIG_FIELD_EMIG_ID);
 
-	msg_set_uint32(m, MIG_FIELD_OP, OPERATION_INSERT_ACK);
+	msg_set_uint32(m, MIG_FIELD_OP, OPERATION_INSERT_BATCH_ACK);
 
 	if (as_fabric_send(src, m, AS_FABRIC_PRIORITY_MEDIUM) !=
 			AS_FABRIC_SUCCESS) {
@@ -1476,6 +2164,32 @@ immigration_handle_insert_request(cf_node src, msg *m) {
 }
 
 
+// Returns false if the record wasn't applied and the insert shouldn't be
+// acked.
+bool
+immigration_merge_record(immigration *immig, cf_digest *keyd,
+		as_record_merge_component *c)
+{
+	// TODO - should have inline wrapper to peek pickled bin count.
+	if (*(uint16_t *)c->record_buf == 0) {
+		cf_warning_digest(AS_MIGRATE, keyd, "handle insert: binless pickle, dropping ");
+		return true;
+	}
+
+	int winner_idx  = -1;
+	int rv = as_record_flatten(&immig->rsv, keyd, 1, c, &winner_idx);
+
+	if (rv != 0 && rv != -3) {
+		// -3 is not a failure. It is get_create failure inside
+		// as_record_flatten which is possible in case of race.
+		cf_warning_digest(AS_MIGRATE, keyd, "handle insert: record flatten failed %d ", rv);
+		return false;
+	}
+
+	return true;
+}
+
+
 void
 immigration_handle_done_request(cf_node src, msg *m) {
 	uint32_t emig_id;
@@ -1614,6 +2328,14 @@ emigration_handle_ctrl_ack(cf_node src, msg *m, uint32_t op)
 	if (rchash_get(g_emigration_hash, (void *)&emig_id, sizeof(emig_id),
 			(void **)&emig) == RCHASH_OK) {
 		if (emig->dest == src) {
+			if (op == OPERATION_START_ACK_OK &&
+					(immig_features & MIG_FEATURES_SEEN) != 0 &&
+					(immig_features & MIG_FEATURE_BATCH) != 0 &&
+					! emig->rsv.ns->ldt_enabled) {
+				// Set before the push - emigrate thread reads it after pop.
+				emig->use_batch = true;
+			}
+
 			if ((immig_features & MIG_FEATURES_SEEN) == 0 ||
 					(immig_features & MIG_FEATURE_MERGE) == 0) {
 				// TODO - rethink where this should go after further refactor.
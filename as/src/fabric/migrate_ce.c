@@ -20,20 +20,41 @@
  */
 
 
+// Delta migration - before an emigration sends any records, the destination
+// sends back a summary (digest, generation, last-update-time) of every record
+// it already has in the partition. Emigration then skips records the
+// destination would keep anyway, so a node returning after a brief absence
+// only receives what changed.
+
+
 //==========================================================
 // Includes.
 //
 
 #include "fabric/migrate.h"
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_clock.h"
+#include "citrusleaf/cf_digest.h"
+#include "citrusleaf/cf_queue.h"
 
 #include "fault.h"
 #include "msg.h"
+#include "rchash.h"
 #include "util.h"
 
+#include "base/cfg.h"
 #include "base/datamodel.h"
+#include "base/index.h"
 #include "fabric/fabric.h"
 
 
@@ -41,62 +62,483 @@
 // Constants.
 //
 
-const uint32_t MY_MIG_FEATURES = 0;
+const uint32_t MY_MIG_FEATURES = MIG_FEATURE_MERGE;
+
+// Keep each meta batch within the fabric's in-place receive buffer.
+#define META_BATCH_MAX_RECORDS 4000
+
+#define META_RETRANSMIT_MS (g_config.transaction_retry_ms)
+
+// Past this, emigrate using whatever summaries have arrived.
+#define META_COLLECT_MAX_MS (60 * 1000)
+
+
+//==========================================================
+// Typedefs.
+//
+
+typedef struct meta_collect_info_s {
+	as_namespace *ns;
+	immig_meta_q *imq;
+} meta_collect_info;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static int meta_record_compare(const void *pa, const void *pb);
+static void *run_immigration_meta_sender(void *arg);
+static void immigration_meta_collect_reduce_fn(as_index_ref *r_ref, void *udata);
+static bool immigration_send_meta_batch(immigration *immig, const meta_batch *batch, uint32_t sequence);
 
 
 //==========================================================
 // Community Edition API.
 //
 
+// Skip records the destination has the same or a newer version of.
 bool
 should_emigrate_record(emigration *emig, as_index_ref *r_ref)
 {
-	return true;
+	emig_meta_q *emq = emig->meta_q;
+
+	if (! emq || emq->n_records == 0) {
+		return true;
+	}
+
+	as_index *r = r_ref->r;
+	const meta_record *mr = bsearch(&r->key, emq->records, emq->n_records,
+			sizeof(meta_record), meta_record_compare);
+
+	if (! mr) {
+		return true;
+	}
+
+	// Void-time isn't in the summary - a tie on generation and
+	// last-update-time means the destination already has this write.
+	return as_record_resolve_conflict(emig->rsv.ns->conflict_resolution_policy,
+			r->generation, r->last_update_time, 0,
+			mr->generation, mr->last_update_time, 0) == -1;
 }
 
 emig_meta_q *
 emig_meta_q_create()
 {
-	return NULL;
+	emig_meta_q *emq = cf_malloc(sizeof(emig_meta_q));
+
+	cf_assert(emq, AS_MIGRATE, CF_CRITICAL, "malloc");
+
+	memset(emq, 0, sizeof(emig_meta_q));
+
+	emq->batch_q = cf_queue_create(sizeof(meta_batch), true);
+
+	cf_assert(emq->batch_q, AS_MIGRATE, CF_CRITICAL, "queue create");
+
+	return emq;
 }
 
 void
 emig_meta_q_destroy(emig_meta_q *emq)
 {
+	meta_batch batch;
+
+	while (cf_queue_pop(emq->batch_q, &batch, CF_QUEUE_NOWAIT) ==
+			CF_QUEUE_OK) {
+		if (batch.records) {
+			cf_free(batch.records);
+		}
+	}
+
+	cf_queue_destroy(emq->batch_q);
+
+	if (emq->records) {
+		cf_free(emq->records);
+	}
+
+	cf_free(emq);
 }
 
 void
 emig_meta_q_push_batch(emig_meta_q *emq, const meta_batch *batch)
 {
+	cf_queue_push(emq->batch_q, (void *)batch);
+
+	if (batch->is_final) {
+		emq->is_done = true;
+	}
+}
+
+// Wait for the destination's summaries, then sort them for lookup. If the
+// destination isn't sending any, is_done is already set.
+void
+emig_meta_q_collect(emigration *emig)
+{
+	emig_meta_q *emq = emig->meta_q;
+	uint64_t start_ms = cf_getms();
+
+	while (! emq->is_done) {
+		if (emig->cluster_key != as_paxos_get_cluster_key()) {
+			return;
+		}
+
+		if (cf_getms() > start_ms + META_COLLECT_MAX_MS) {
+			cf_warning(AS_MIGRATE, "{%s:%u} timed out waiting for record summaries from node %lx",
+					emig->rsv.ns->name, emig->rsv.pid, emig->dest);
+			break;
+		}
+
+		usleep(1000);
+	}
+
+	meta_batch batch;
+
+	while (cf_queue_pop(emq->batch_q, &batch, CF_QUEUE_NOWAIT) ==
+			CF_QUEUE_OK) {
+		if (batch.n_records == 0) {
+			continue;
+		}
+
+		meta_record *records = cf_realloc(emq->records,
+				(emq->n_records + batch.n_records) * sizeof(meta_record));
+
+		cf_assert(records, AS_MIGRATE, CF_CRITICAL, "realloc");
+
+		memcpy(records + emq->n_records, batch.records,
+				batch.n_records * sizeof(meta_record));
+
+		emq->records = records;
+		emq->n_records += batch.n_records;
+
+		cf_free(batch.records);
+	}
+
+	qsort(emq->records, emq->n_records, sizeof(meta_record),
+			meta_record_compare);
+
+	cf_detail(AS_MIGRATE, "{%s:%u} have %u record summaries from node %lx",
+			emig->rsv.ns->name, emig->rsv.pid, emq->n_records, emig->dest);
 }
 
 void
 emigration_handle_meta_batch_request(cf_node src, msg *m)
 {
-	cf_warning(AS_MIGRATE, "CE node received meta-batch request - unexpected");
-	as_fabric_msg_put(m);
+	uint32_t emig_id;
+
+	if (msg_get_uint32(m, MIG_FIELD_EMIG_ID, &emig_id) != 0) {
+		cf_warning(AS_MIGRATE, "meta batch: msg get for emig id failed");
+		as_fabric_msg_put(m);
+		return;
+	}
+
+	uint32_t sequence;
+
+	if (msg_get_uint32(m, MIG_FIELD_META_SEQUENCE, &sequence) != 0) {
+		cf_warning(AS_MIGRATE, "meta batch: msg get for sequence failed");
+		as_fabric_msg_put(m);
+		return;
+	}
+
+	emigration *emig;
+
+	if (rchash_get(g_emigration_hash, (void *)&emig_id, sizeof(emig_id),
+			(void **)&emig) != RCHASH_OK) {
+		// Probably came from a migration prior to the latest rebalance.
+		as_fabric_msg_put(m);
+		return;
+	}
+
+	emig_meta_q *emq = emig->meta_q;
+
+	if (emig->dest != src || ! emq) {
+		cf_warning(AS_MIGRATE, "meta batch: unexpected source %lx", src);
+		emigration_release(emig);
+		as_fabric_msg_put(m);
+		return;
+	}
+
+	// Batches come one at a time, each only after the previous one is acked.
+	int32_t prev = (int32_t)sequence - 1;
+
+	if (cf_atomic32_cas(&emq->last_acked, prev, (int32_t)sequence) == prev) {
+		uint8_t *buf = NULL;
+		size_t buf_sz = 0;
+		uint32_t is_final = 0;
+
+		msg_get_buf(m, MIG_FIELD_META_RECORDS, &buf, &buf_sz, MSG_GET_DIRECT);
+		msg_get_uint32(m, MIG_FIELD_META_SEQUENCE_FINAL, &is_final);
+
+		meta_batch batch;
+
+		batch.is_final = is_final != 0;
+		batch.n_records = (uint32_t)(buf_sz / sizeof(meta_record));
+		batch.records = NULL;
+
+		if (batch.n_records != 0) {
+			batch.records = cf_malloc(batch.n_records * sizeof(meta_record));
+
+			cf_assert(batch.records, AS_MIGRATE, CF_CRITICAL, "malloc");
+
+			memcpy(batch.records, buf, batch.n_records * sizeof(meta_record));
+		}
+
+		emig_meta_q_push_batch(emq, &batch);
+	}
+	else if ((int32_t)sequence > cf_atomic32_get(emq->last_acked)) {
+		// Not the next batch - don't ack, it will be retransmitted.
+		emigration_release(emig);
+		as_fabric_msg_put(m);
+		return;
+	}
+	// else - retransmitted batch, ack it again.
+
+	emigration_release(emig);
+
+	msg_preserve_fields(m, 2, MIG_FIELD_EMIG_ID, MIG_FIELD_META_SEQUENCE);
+
+	msg_set_uint32(m, MIG_FIELD_OP, OPERATION_MERGE_META_ACK);
+
+	if (as_fabric_send(src, m, AS_FABRIC_PRIORITY_MEDIUM) !=
+			AS_FABRIC_SUCCESS) {
+		as_fabric_msg_put(m);
+	}
 }
 
 void
 immigration_handle_meta_batch_ack(cf_node src, msg *m)
 {
-	cf_warning(AS_MIGRATE, "CE node received meta-batch ack - unexpected");
+	uint32_t emig_id;
+
+	if (msg_get_uint32(m, MIG_FIELD_EMIG_ID, &emig_id) != 0) {
+		cf_warning(AS_MIGRATE, "meta batch ack: msg get for emig id failed");
+		as_fabric_msg_put(m);
+		return;
+	}
+
+	uint32_t sequence;
+
+	if (msg_get_uint32(m, MIG_FIELD_META_SEQUENCE, &sequence) != 0) {
+		cf_warning(AS_MIGRATE, "meta batch ack: msg get for sequence failed");
+		as_fabric_msg_put(m);
+		return;
+	}
+
 	as_fabric_msg_put(m);
+
+	immigration_hkey hkey;
+
+	hkey.src = src;
+	hkey.emig_id = emig_id;
+
+	immigration *immig;
+
+	if (rchash_get(g_immigration_hash, (void *)&hkey, sizeof(hkey),
+			(void **)&immig) == RCHASH_OK) {
+		cf_atomic32_setmax(&immig->meta_q.last_acked, (int32_t)sequence);
+		immigration_release(immig);
+	}
 }
 
+// Start sending summaries of our records, if the source can use them and we
+// have any.
 bool
 immigration_start_meta_sender(immigration *immig, uint32_t emig_features,
 		uint32_t emig_partition_sz)
 {
-	return false;
+	if ((emig_features & MIG_FEATURE_MERGE) == 0 || emig_partition_sz == 0 ||
+			immig->rsv.ns->ldt_enabled ||
+			as_index_tree_size(immig->rsv.tree) == 0) {
+		return false;
+	}
+
+	immig->meta_q.batch_q = cf_queue_create(sizeof(meta_batch), false);
+
+	if (! immig->meta_q.batch_q) {
+		cf_warning(AS_MIGRATE, "failed to create meta batch queue");
+		return false;
+	}
+
+	pthread_t thread;
+	pthread_attr_t attrs;
+
+	pthread_attr_init(&attrs);
+	pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+
+	cf_rc_reserve(immig); // released by the sender thread
+
+	if (pthread_create(&thread, &attrs, run_immigration_meta_sender,
+			immig) != 0) {
+		cf_warning(AS_MIGRATE, "failed to create meta sender thread");
+		immigration_release(immig);
+		return false;
+	}
+
+	return true;
 }
 
 void
 immig_meta_q_init(immig_meta_q *imq)
 {
+	memset(imq, 0, sizeof(immig_meta_q));
 }
 
 void
 immig_meta_q_destroy(immig_meta_q *imq)
 {
+	if (imq->current_batch.records) {
+		cf_free(imq->current_batch.records);
+	}
+
+	if (! imq->batch_q) {
+		return;
+	}
+
+	meta_batch batch;
+
+	while (cf_queue_pop(imq->batch_q, &batch, CF_QUEUE_NOWAIT) ==
+			CF_QUEUE_OK) {
+		if (batch.records) {
+			cf_free(batch.records);
+		}
+	}
+
+	cf_queue_destroy(imq->batch_q);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+// Also compares a bare digest against a meta_record - keyd comes first.
+static int
+meta_record_compare(const void *pa, const void *pb)
+{
+	return memcmp(pa, pb, sizeof(cf_digest));
+}
+
+// Summarizes the partition's records into batches, then sends them one at a
+// time, each waiting for its ack. Records won't immigrate until the source
+// has all the batches, so the summary is consistent.
+static void *
+run_immigration_meta_sender(void *arg)
+{
+	immigration *immig = (immigration *)arg;
+	immig_meta_q *imq = &immig->meta_q;
+	meta_collect_info info = { .ns = immig->rsv.ns, .imq = imq };
+
+	as_index_reduce(immig->rsv.tree, immigration_meta_collect_reduce_fn,
+			&info);
+
+	// Last batch may be empty, just to say we're done.
+	imq->current_batch.is_final = true;
+	cf_queue_push(imq->batch_q, &imq->current_batch);
+	imq->current_batch.records = NULL;
+	imq->current_batch.n_records = 0;
+
+	meta_batch batch;
+
+	while (cf_queue_pop(imq->batch_q, &batch, CF_QUEUE_NOWAIT) ==
+			CF_QUEUE_OK) {
+		bool sent = immigration_send_meta_batch(immig, &batch,
+				++imq->sequence);
+
+		if (batch.records) {
+			cf_free(batch.records);
+		}
+
+		if (! sent) {
+			break;
+		}
+	}
+
+	immigration_release(immig);
+
+	return NULL;
+}
+
+static void
+immigration_meta_collect_reduce_fn(as_index_ref *r_ref, void *udata)
+{
+	meta_collect_info *info = (meta_collect_info *)udata;
+	meta_batch *batch = &info->imq->current_batch;
+
+	if (! batch->records) {
+		batch->records = cf_malloc(META_BATCH_MAX_RECORDS *
+				sizeof(meta_record));
+
+		cf_assert(batch->records, AS_MIGRATE, CF_CRITICAL, "malloc");
+
+		batch->n_records = 0;
+		batch->is_final = false;
+	}
+
+	as_index *r = r_ref->r;
+	meta_record *mr = &batch->records[batch->n_records++];
+
+	mr->keyd = r->key;
+	mr->generation = r->generation;
+	mr->last_update_time = r->last_update_time;
+
+	as_record_done(r_ref, info->ns);
+
+	if (batch->n_records == META_BATCH_MAX_RECORDS) {
+		cf_queue_push(info->imq->batch_q, batch);
+		batch->records = NULL;
+		batch->n_records = 0;
+	}
+}
+
+static bool
+immigration_send_meta_batch(immigration *immig, const meta_batch *batch,
+		uint32_t sequence)
+{
+	msg *m = as_fabric_msg_get(M_TYPE_MIGRATE);
+
+	if (! m) {
+		cf_warning(AS_MIGRATE, "failed to get fabric msg");
+		return false;
+	}
+
+	msg_set_uint32(m, MIG_FIELD_OP, OPERATION_MERGE_META);
+	msg_set_uint32(m, MIG_FIELD_EMIG_ID, immig->emig_id);
+	msg_set_uint32(m, MIG_FIELD_META_SEQUENCE, sequence);
+
+	if (batch->is_final) {
+		msg_set_uint32(m, MIG_FIELD_META_SEQUENCE_FINAL, 1);
+	}
+
+	if (batch->n_records != 0) {
+		msg_set_buf(m, MIG_FIELD_META_RECORDS, (uint8_t *)batch->records,
+				batch->n_records * sizeof(meta_record), MSG_SET_COPY);
+	}
+
+	uint64_t xmit_ms = 0;
+
+	while (cf_atomic32_get(immig->meta_q.last_acked) < (int32_t)sequence) {
+		if (immig->cluster_key != as_paxos_get_cluster_key() ||
+				cf_atomic32_get(immig->done_recv) != 0) {
+			as_fabric_msg_put(m);
+			return false;
+		}
+
+		uint64_t now = cf_getms();
+
+		if (xmit_ms + META_RETRANSMIT_MS < now) {
+			msg_incr_ref(m);
+
+			if (as_fabric_send(immig->src, m, AS_FABRIC_PRIORITY_MEDIUM) !=
+					AS_FABRIC_SUCCESS) {
+				as_fabric_msg_put(m);
+			}
+
+			xmit_ms = now;
+		}
+
+		usleep(1000);
+	}
+
+	as_fabric_msg_put(m);
+
+	return true;
 }
@@ -398,7 +398,8 @@ as_partition_reinit(as_partition *p, as_namespace *ns, int pid)
 
 		p->vp = as_index_tree_resume(ns->arena,
 				(as_index_value_destructor)&as_record_destroy, ns,
-				&ns->tree_roots[pid]);
+				ns->index_engine, ns->partition_tree_sprigs,
+				as_treex_get(ns->tree_roots, ns->partition_tree_sprigs, pid));
 
 		// There's no going back to cold start now - do so the harsh way.
 		if (! p->vp) {
@@ -409,7 +410,8 @@ as_partition_reinit(as_partition *p, as_namespace *ns, int pid)
 	else {
 		p->vp = as_index_tree_create(ns->arena,
 				(as_index_value_destructor)&as_record_destroy, ns,
-				ns->tree_roots ? &ns->tree_roots[pid] : NULL);
+				ns->index_engine, ns->partition_tree_sprigs,
+				as_treex_get(ns->tree_roots, ns->partition_tree_sprigs, pid));
 	}
 
 	if (t) {
@@ -427,7 +429,8 @@ as_partition_reinit(as_partition *p, as_namespace *ns, int pid)
 
 		p->sub_vp = as_index_tree_resume(ns->arena,
 				(as_index_value_destructor)&as_record_destroy, ns,
-				&ns->sub_tree_roots[pid]);
+				ns->index_engine, ns->partition_tree_sprigs,
+				as_treex_get(ns->sub_tree_roots, ns->partition_tree_sprigs, pid));
 
 		// There's no going back to cold start now - do so the harsh way.
 		if (! p->sub_vp) {
@@ -438,7 +441,8 @@ as_partition_reinit(as_partition *p, as_namespace *ns, int pid)
 	else {
 		p->sub_vp = as_index_tree_create(ns->arena,
 				(as_index_value_destructor)&as_record_destroy, ns,
-				ns->sub_tree_roots ? &ns->sub_tree_roots[pid] : NULL);
+				ns->index_engine, ns->partition_tree_sprigs,
+				as_treex_get(ns->sub_tree_roots, ns->partition_tree_sprigs, pid));
 	}
 
 	if (sub_t) {
@@ -460,14 +464,16 @@ set_partition_desync_lockfree(as_partition *p, as_partition_vinfo *vinfo,
 
 	p->vp = as_index_tree_create(ns->arena,
 			(as_index_value_destructor)&as_record_destroy, ns,
-			ns->tree_roots ? &ns->tree_roots[pid] : NULL);
+			ns->index_engine, ns->partition_tree_sprigs,
+			as_treex_get(ns->tree_roots, ns->partition_tree_sprigs, pid));
 	as_index_tree_release(t, ns);
 
 	as_index_tree *sub_t = p->sub_vp;
 
 	p->sub_vp = as_index_tree_create(ns->arena,
 			(as_index_value_destructor)&as_record_destroy, ns,
-			ns->sub_tree_roots ? &ns->sub_tree_roots[pid] : NULL);
+			ns->index_engine, ns->partition_tree_sprigs,
+			as_treex_get(ns->sub_tree_roots, ns->partition_tree_sprigs, pid));
 	as_index_tree_release(sub_t, ns);
 
 	clear_partition_version_in_storage(ns, pid, flush);
@@ -483,7 +489,7 @@ set_partition_absent_lockfree(as_partition *p, as_partition_vinfo *vinfo, as_nam
 {
 	as_index_tree *t = p->vp;
 
-	p->vp = as_index_tree_create(ns->arena, (as_index_value_destructor)&as_record_destroy, ns, ns->tree_roots ? &ns->tree_roots[pid] : NULL);
+	p->vp = as_index_tree_create(ns->arena, (as_index_value_destructor)&as_record_destroy, ns, ns->index_engine, ns->partition_tree_sprigs, as_treex_get(ns->tree_roots, ns->partition_tree_sprigs, pid));
 	// A Change:  Set the State BEFORE the tree release, just in case that
 	// is opening too large of a time window.
 	p->state = AS_PARTITION_STATE_ABSENT; // Move the state setting ABOVE the tree release.
@@ -494,7 +500,7 @@ set_partition_absent_lockfree(as_partition *p, as_partition_vinfo *vinfo, as_nam
 
 	as_index_tree *sub_t = p->sub_vp;
 
-	p->sub_vp = as_index_tree_create(ns->arena, (as_index_value_destructor)&as_record_destroy, ns, ns->sub_tree_roots ? &ns->sub_tree_roots[pid] : NULL);
+	p->sub_vp = as_index_tree_create(ns->arena, (as_index_value_destructor)&as_record_destroy, ns, ns->index_engine, ns->partition_tree_sprigs, as_treex_get(ns->sub_tree_roots, ns->partition_tree_sprigs, pid));
 
 	if (sub_t) {
 		as_index_tree_release(sub_t, ns);
@@ -1121,6 +1127,38 @@ as_partition_release(as_partition_reservation *rsv)
 }
 
 
+// Reserve just a partition's current tree, without any state checks - only
+// good for looking at the tree, e.g. to prefetch it, not for transactions.
+as_index_tree *
+as_partition_reserve_tree(as_namespace *ns, as_partition_id pid)
+{
+	as_partition *p = &ns->partitions[pid];
+
+	pthread_mutex_lock(&p->lock);
+
+	as_index_tree *tree = p->vp;
+
+	cf_rc_reserve(tree);
+
+	pthread_mutex_unlock(&p->lock);
+
+	return tree;
+}
+
+
+// Release a tree reserved by as_partition_reserve_tree().
+void
+as_partition_release_tree(as_namespace *ns, as_partition_id pid,
+		as_index_tree *tree)
+{
+	as_partition *p = &ns->partitions[pid];
+
+	pthread_mutex_lock(&p->lock);
+	as_index_tree_release(tree, ns);
+	pthread_mutex_unlock(&p->lock);
+}
+
+
 // Get the node ID of a read replica for a given partition in a namespace;
 // preferentially return the local node if possible.
 cf_node
@@ -1473,7 +1511,8 @@ as_partition_getinfo_str(cf_dyn_buf *db)
 
 	cf_dyn_buf_append_string(db, "namespace:partition:state:n_dupl");
 	cf_dyn_buf_append_string(db, ":replica:origin:target:emigrates:immigrates");
-	cf_dyn_buf_append_string(db, ":records:sub_records:ldt_version:version;");
+	cf_dyn_buf_append_string(db, ":records:sub_records:ldt_version:version");
+	cf_dyn_buf_append_string(db, ":emig_records_per_sec:emig_bytes_per_sec;");
 
 	for (uint i = 0 ; i < g_config.n_namespaces ; i++ ) {
 		as_namespace *ns = g_config.namespaces[i];
@@ -1527,6 +1566,10 @@ as_partition_getinfo_str(cf_dyn_buf *db)
 			cf_dyn_buf_append_uint64(db, p->version_info.vtp[0]);
 			cf_dyn_buf_append_char(db, '-');
 			cf_dyn_buf_append_uint64(db, p->version_info.vtp[8]);
+			cf_dyn_buf_append_char(db, ':');
+			cf_dyn_buf_append_uint64(db, p->emig_records_per_sec);
+			cf_dyn_buf_append_char(db, ':');
+			cf_dyn_buf_append_uint64(db, p->emig_bytes_per_sec);
 			cf_dyn_buf_append_char(db, ';');
 
 			pthread_mutex_unlock(&p->lock);
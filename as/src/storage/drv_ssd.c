@@ -41,12 +41,14 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <linux/fs.h> // for BLKGETSIZE64
 #include <sys/ioctl.h>
 #include <sys/param.h> // for MAX()
+#include <sys/uio.h>
 
 #include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_atomic.h"
@@ -55,6 +57,7 @@
 #include "citrusleaf/cf_queue.h"
 #include "citrusleaf/cf_random.h"
 
+#include "crc32c.h"
 #include "fault.h"
 #include "hist.h"
 #include "jem.h"
@@ -64,8 +67,10 @@
 #include "base/cfg.h"
 #include "base/index.h"
 #include "base/ldt.h"
+#include "base/packet_compression.h"
 #include "base/rec_props.h"
 #include "base/secondary_index.h"
+#include "base/thr_write.h"
 
 
 //==========================================================
@@ -95,9 +100,36 @@ extern bool as_cold_start_evict_if_needed(as_namespace* ns);
 #define SSD_BLOCK_MAGIC		0x037AF200
 #define LENGTH_BASE			offsetof(struct drv_ssd_block_s, keyd)
 
+// Blocks written with enable-checksum carry this in checksum_magic. (Older
+// blocks have 0 here - the field used to be a deprecated signature.)
+#define SSD_BLOCK_CHECKSUM_MAGIC	0xC5C32C00
+#define CHECKSUM_BASE				offsetof(struct drv_ssd_block_s, magic)
+
 #define DEFRAG_STARTUP_RESERVE	4
 #define DEFRAG_RUNTIME_RESERVE	4
 
+// Most swbs a write worker drains from the write queue in one pass.
+#define MAX_WRITE_BATCH		16
+
+// Per-inode write lifetime hints - may be missing from older system headers.
+// (The per-file F_SET_FILE_RW_HINT was removed in Linux 5.17.)
+#ifndef F_SET_RW_HINT
+#define F_SET_RW_HINT		(1024 + 12)
+#endif
+
+#define RWH_HINT_SHORT		2
+#define RWH_HINT_MEDIUM		3
+#define RWH_HINT_LONG		4
+#define RWH_HINT_EXTREME	5
+
+// Lifetime hint for each ssd_stream_id.
+static const uint64_t STREAM_WRITE_HINTS[SSD_N_STREAMS] = {
+		RWH_HINT_SHORT,
+		RWH_HINT_LONG,
+		RWH_HINT_MEDIUM,
+		RWH_HINT_EXTREME
+};
+
 
 //==========================================================
 // Typedefs.
@@ -114,19 +146,32 @@ typedef struct {
 // Per-record metadata on device.
 //
 typedef struct drv_ssd_block_s {
-	cf_signature	sig;			// deprecated
+	uint32_t		checksum_magic;	// SSD_BLOCK_CHECKSUM_MAGIC if checksum is set
+	uint32_t		checksum;		// CRC32C of everything from magic on
 	uint32_t		magic;
 	uint32_t		length;			// total after this field - this struct's pointer + 16
 	cf_digest		keyd;
 	as_generation	generation;
 	cf_clock		void_time;
-	uint32_t		bins_offset;	// offset to bins from data
-	uint32_t		n_bins;
+	uint32_t		bins_offset;	// offset to bins from data (uncompressed)
+	uint16_t		n_bins;
+	uint8_t			compression;	// compression_type of data, if any
+	uint8_t			unused;
 	uint64_t		last_update_time;
-	uint8_t			data[];
+	uint8_t			data[];			// ssd_compressed_data if compressed
 } __attribute__ ((__packed__)) drv_ssd_block;
 
 
+//------------------------------------------------
+// Data area of a compressed block.
+//
+typedef struct ssd_compressed_data_s {
+	uint32_t		data_size;		// size of data area when uncompressed
+	uint32_t		comp_size;
+	uint8_t			data[];
+} __attribute__ ((__packed__)) ssd_compressed_data;
+
+
 //------------------------------------------------
 // Per-bin metadata on device.
 //
@@ -197,6 +242,102 @@ ssd_shadow_fd_put(drv_ssd *ssd, int fd)
 }
 
 
+// Tag writes to fd's inode with a stream's expected data lifetime, so a device
+// that supports placement by hint (e.g. NVMe streams) can keep streams apart.
+// The hint applies to every fd on the inode, so this locks out other hinted
+// writes until ssd_write_hint_end() - returns true if it locked. Stops trying
+// (and stops locking) if the kernel doesn't support it.
+static bool
+ssd_write_hint_begin(drv_ssd *ssd, ssd_write_hint *wh, const char *name,
+		int fd, uint8_t stream)
+{
+	if (! ssd->write_hints) {
+		return false;
+	}
+
+	pthread_mutex_lock(&wh->lock);
+
+	uint64_t hint = STREAM_WRITE_HINTS[stream];
+
+	if (hint == wh->hint) {
+		return true;
+	}
+
+	if (fcntl(fd, F_SET_RW_HINT, &hint) != 0) {
+		cf_warning(AS_DRV_SSD, "%s: write hints not supported: errno %d (%s)",
+				name, errno, cf_strerror(errno));
+		ssd->write_hints = false;
+		pthread_mutex_unlock(&wh->lock);
+		return false;
+	}
+
+	wh->hint = hint;
+
+	return true;
+}
+
+
+static inline void
+ssd_write_hint_end(ssd_write_hint *wh, bool locked)
+{
+	if (locked) {
+		pthread_mutex_unlock(&wh->lock);
+	}
+}
+
+
+// Read an entire wblock from the device.
+bool
+ssd_read_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf)
+{
+	int fd = ssd_fd_get(ssd);
+	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
+
+	uint64_t start_ns = g_config.storage_benchmarks ? cf_getns() : 0;
+
+	ssize_t rlen = pread(fd, read_buf, ssd->write_block_size,
+			(off_t)file_offset);
+
+	if (rlen != (ssize_t)ssd->write_block_size) {
+		cf_warning(AS_DRV_SSD, "%s: read failed (%ld): offset %lu: errno %d (%s)",
+				ssd->name, rlen, file_offset, errno, cf_strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	if (start_ns != 0) {
+		histogram_insert_data_point(ssd->hist_large_block_read, start_ns);
+	}
+
+	ssd_fd_put(ssd, fd);
+
+	return true;
+}
+
+
+// Checksum of a block, which must have a sane length.
+static inline uint32_t
+ssd_block_checksum(const drv_ssd_block *block)
+{
+	return cf_crc32c(0, (const uint8_t*)block + CHECKSUM_BASE,
+			LENGTH_BASE + block->length - CHECKSUM_BASE);
+}
+
+
+// Blocks written without a checksum have both fields zeroed and always pass.
+// Any other checksum_magic is itself corrupt, so the block fails.
+static inline bool
+ssd_block_checksum_ok(const drv_ssd_block *block)
+{
+	if (block->checksum_magic == 0) {
+		return block->checksum == 0;
+	}
+
+	return block->checksum_magic == SSD_BLOCK_CHECKSUM_MAGIC &&
+			block->checksum == ssd_block_checksum(block);
+}
+
+
 // Decide which device a record belongs on.
 static inline int
 ssd_get_file_id(drv_ssds *ssds, cf_digest *keyd)
@@ -231,11 +372,11 @@ push_wblock_to_free_q(drv_ssd *ssd, uint32_t wblock_id, e_free_to free_to)
 
 // Put a wblock on the defrag queue.
 static inline void
-push_wblock_to_defrag_q(drv_ssd *ssd, uint32_t wblock_id)
+push_wblock_to_defrag_q(drv_ssd *ssd, uint32_t wblock_id, uint32_t inuse_sz)
 {
 	if (ssd->defrag_wblock_q) { // null until devices are loaded at startup
 		ssd->alloc_table->wblock_state[wblock_id].state = WBLOCK_STATE_DEFRAG;
-		cf_queue_push(ssd->defrag_wblock_q, &wblock_id);
+		ssd_defrag_q_push(ssd->defrag_wblock_q, wblock_id, inuse_sz);
 		cf_atomic_int_incr(&ssd->n_defrag_wblock_reads);
 	}
 }
@@ -346,7 +487,7 @@ swb_dereference_and_release(drv_ssd *ssd, uint32_t wblock_id,
 		}
 		// Queue wblock for defrag if applicable.
 		else if (inuse_sz < ssd->ns->defrag_lwm_size) {
-			push_wblock_to_defrag_q(ssd, wblock_id);
+			push_wblock_to_defrag_q(ssd, wblock_id, inuse_sz);
 		}
 	}
 	else {
@@ -358,7 +499,7 @@ swb_dereference_and_release(drv_ssd *ssd, uint32_t wblock_id,
 }
 
 ssd_write_buf *
-swb_get(drv_ssd *ssd)
+swb_get(drv_ssd *ssd, ssd_stream_id stream_id)
 {
 	ssd_write_buf *swb;
 
@@ -407,6 +548,8 @@ swb_get(drv_ssd *ssd)
 
 	pthread_mutex_unlock(&p_wblock_state->LOCK);
 
+	swb->stream = (uint8_t)stream_id;
+
 	return swb;
 }
 
@@ -415,6 +558,23 @@ swb_get(drv_ssd *ssd)
 //------------------------------------------------
 
 
+// Pick the write stream for a record by how long it has left to live - if
+// cold-stream-ttl isn't configured, all writes (or defrag moves) share one.
+static inline ssd_stream_id
+ssd_stream_id_get(drv_ssd *ssd, cf_clock void_time, bool defrag)
+{
+	uint32_t cold_ttl = ssd->ns->storage_cold_stream_ttl;
+	bool cold = cold_ttl != 0 && (void_time == 0 ||
+			(uint64_t)void_time > (uint64_t)as_record_void_time_get() + cold_ttl);
+
+	if (defrag) {
+		return cold ? SSD_STREAM_DEFRAG_COLD : SSD_STREAM_DEFRAG_HOT;
+	}
+
+	return cold ? SSD_STREAM_COLD : SSD_STREAM_HOT;
+}
+
+
 // Reduce wblock's used size, if result is 0 put it in the "free" pool, if it's
 // below the defrag threshold put it in the defrag queue.
 void
@@ -441,6 +601,13 @@ ssd_block_free(drv_ssd *ssd, uint64_t rblock_id, uint64_t n_rblocks, char *msg)
 		return;
 	}
 
+	// Cached copy must go before the space can be reused.
+	ssd_read_cache *read_cache = ((drv_ssds*)ssd->ns->storage_private)->read_cache;
+
+	if (read_cache) {
+		ssd_read_cache_remove(read_cache, ssd->file_id, rblock_id);
+	}
+
 	cf_atomic64_sub(&ssd->inuse_size, size);
 
 	ssd_wblock_state *p_wblock_state = &at->wblock_state[wblock_id];
@@ -468,9 +635,16 @@ ssd_block_free(drv_ssd *ssd, uint64_t rblock_id, uint64_t n_rblocks, char *msg)
 		}
 		// Queue wblock for defrag if appropriate.
 		else if (resulting_inuse_sz < ssd->ns->defrag_lwm_size) {
-			push_wblock_to_defrag_q(ssd, wblock_id);
+			push_wblock_to_defrag_q(ssd, wblock_id, resulting_inuse_sz);
 		}
 	}
+	else if (p_wblock_state->state == WBLOCK_STATE_DEFRAG &&
+			ssd->defrag_wblock_q) {
+		// Still queued (or being defragged) - let it move up the queue.
+		ssd_defrag_q_shrink(ssd->defrag_wblock_q, wblock_id,
+				(uint32_t)(resulting_inuse_sz + (int64_t)size),
+				(uint32_t)resulting_inuse_sz);
+	}
 
 	pthread_mutex_unlock(&p_wblock_state->LOCK);
 }
@@ -563,18 +737,20 @@ defrag_move_record(drv_ssd *ssd, drv_ssd_block *block, as_index *r)
 	}
 
 	uint32_t write_size = block->length + LENGTH_BASE;
+	ssd_stream_id stream_id = ssd_stream_id_get(ssd, block->void_time, true);
+	ssd_write_stream *stream = &ssd->streams[stream_id];
 
-	pthread_mutex_lock(&ssd->defrag_lock);
+	pthread_mutex_lock(&stream->lock);
 
-	ssd_write_buf *swb = ssd->defrag_swb;
+	ssd_write_buf *swb = stream->swb;
 
 	if (! swb) {
-		swb = swb_get(ssd);
-		ssd->defrag_swb = swb;
+		swb = swb_get(ssd, stream_id);
+		stream->swb = swb;
 
 		if (! swb) {
 			cf_warning(AS_DRV_SSD, "defrag_move_record: couldn't get swb");
-			pthread_mutex_unlock(&ssd->defrag_lock);
+			pthread_mutex_unlock(&stream->lock);
 			return;
 		}
 	}
@@ -592,14 +768,15 @@ defrag_move_record(drv_ssd *ssd, drv_ssd_block *block, as_index *r)
 		swb->skip_post_write_q = true;
 		cf_queue_push(ssd->swb_write_q, &swb);
 		cf_atomic_int_incr(&ssd->n_defrag_wblock_writes);
+		cf_atomic_int_incr(&stream->n_wblock_writes);
 
 		// Get the new buffer.
-		swb = swb_get(ssd);
-		ssd->defrag_swb = swb;
+		swb = swb_get(ssd, stream_id);
+		stream->swb = swb;
 
 		if (! swb) {
 			cf_warning(AS_DRV_SSD, "defrag_move_record: couldn't get swb");
-			pthread_mutex_unlock(&ssd->defrag_lock);
+			pthread_mutex_unlock(&stream->lock);
 			return;
 		}
 	}
@@ -615,7 +792,7 @@ defrag_move_record(drv_ssd *ssd, drv_ssd_block *block, as_index *r)
 	cf_atomic64_add(&ssd->inuse_size, (int64_t)write_size);
 	cf_atomic32_add(&ssd->alloc_table->wblock_state[swb->wblock_id].inuse_sz, (int32_t)write_size);
 
-	pthread_mutex_unlock(&ssd->defrag_lock);
+	pthread_mutex_unlock(&stream->lock);
 
 	ssd_block_free(old_ssd, old_rblock_id, old_n_rblocks, "defrag-write");
 }
@@ -693,7 +870,9 @@ ssd_is_full(drv_ssd *ssd, uint32_t wblock_id)
 
 	pthread_mutex_lock(&p_wblock_state->LOCK);
 
-	if (cf_atomic32_get(p_wblock_state->inuse_sz) == 0) {
+	uint32_t inuse_sz = cf_atomic32_get(p_wblock_state->inuse_sz);
+
+	if (inuse_sz == 0) {
 		// Lucky - wblock is empty, let ssd_defrag_wblock() free it.
 		pthread_mutex_unlock(&p_wblock_state->LOCK);
 
@@ -705,7 +884,7 @@ ssd_is_full(drv_ssd *ssd, uint32_t wblock_id)
 
 	// Not using push_wblock_to_defrag_q() - state is already DEFRAG, we
 	// definitely have a queue, and it's better to push back to head.
-	cf_queue_push_head(ssd->defrag_wblock_q, &wblock_id);
+	ssd_defrag_q_push_head(ssd->defrag_wblock_q, wblock_id, inuse_sz);
 
 	pthread_mutex_unlock(&p_wblock_state->LOCK);
 
@@ -718,8 +897,10 @@ ssd_is_full(drv_ssd *ssd, uint32_t wblock_id)
 }
 
 
+// If read_done is true, caller has already read the wblock into read_buf.
 int
-ssd_defrag_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf)
+ssd_defrag_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf,
+		bool read_done)
 {
 	if (ssd_is_full(ssd, wblock_id)) {
 		return 0;
@@ -729,6 +910,7 @@ ssd_defrag_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf)
 	int num_old_records = 0;
 	int num_deleted_records = 0;
 	int record_err_count = 0;
+	uint64_t bytes_moved = 0;
 
 	ssd_wblock_state* p_wblock_state = &ssd->alloc_table->wblock_state[wblock_id];
 
@@ -736,35 +918,11 @@ ssd_defrag_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf)
 		goto Finished;
 	}
 
-	int fd = ssd_fd_get(ssd);
-	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
-
-	uint64_t start_ns = g_config.storage_benchmarks ? cf_getns() : 0;
-
-	if (lseek(fd, (off_t)file_offset, SEEK_SET) != (off_t)file_offset) {
-		cf_warning(AS_DRV_SSD, "%s: seek failed: offset %lu: errno %d (%s)",
-				ssd->name, file_offset, errno, cf_strerror(errno));
-		close(fd);
-		fd = -1;
+	if (! read_done && ! ssd_read_wblock(ssd, wblock_id, read_buf)) {
 		goto Finished;
 	}
 
-	ssize_t rlen = read(fd, read_buf, ssd->write_block_size);
-
-	if (rlen != (ssize_t)ssd->write_block_size) {
-		cf_warning(AS_DRV_SSD, "%s: read failed (%ld): errno %d (%s)",
-				ssd->name, rlen, errno, cf_strerror(errno));
-		close(fd);
-		fd = -1;
-		goto Finished;
-	}
-
-	if (start_ns != 0) {
-		histogram_insert_data_point(ssd->hist_large_block_read, start_ns);
-	}
-
-	ssd_fd_put(ssd, fd);
-
+	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
 	size_t wblock_offset = 0; // current offset within the wblock, in bytes
 
 	while (wblock_offset < ssd->write_block_size &&
@@ -795,6 +953,17 @@ ssd_defrag_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf)
 			break;
 		}
 
+		// A bad checksum is counted, but the record is still moved if it's
+		// current - otherwise the index would point into a freed wblock. Reads
+		// of the moved copy will go on failing the checksum.
+		if (! ssd_block_checksum_ok(block)) {
+			cf_warning_digest(AS_DRV_SSD, &block->keyd, "device %s defrag: checksum mismatch on wblock %u offset %lu ",
+					ssd->name, wblock_id, wblock_offset);
+			cf_atomic64_incr(&ssd->ns->n_storage_checksum_errors);
+			cf_atomic_int_incr(&g_config.err_storage_defrag_corrupt_record);
+			record_err_count++;
+		}
+
 		// Found a good record, move it if it's current.
 		int rv = ssd_record_defrag(ssd, block,
 				BYTES_TO_RBLOCKS(file_offset + wblock_offset),
@@ -803,6 +972,7 @@ ssd_defrag_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf)
 
 		if (rv == 0) {
 			record_count++;
+			bytes_moved += next_wblock_offset - wblock_offset;
 		}
 		else if (rv == -1) {
 			num_old_records++;
@@ -855,14 +1025,177 @@ Finished:
 	if (cf_atomic32_get(p_wblock_state->inuse_sz) == 0 &&
 			! p_wblock_state->swb) {
 		push_wblock_to_free_q(ssd, wblock_id, FREE_TO_HEAD);
+		cf_atomic_int_incr(&ssd->n_defrag_wblocks_freed);
+
+		// Net space gained - what was moved must be written again elsewhere.
+		cf_atomic64_add(&ssd->ns->defrag_bytes_reclaimed,
+				(int64_t)(ssd->write_block_size - bytes_moved));
 	}
 
 	pthread_mutex_unlock(&p_wblock_state->LOCK);
 
+	if (bytes_moved != 0) {
+		cf_atomic64_add(&ssd->ns->defrag_bytes_moved, (int64_t)bytes_moved);
+	}
+
 	return record_count;
 }
 
 
+// Get the next wblock to defrag, if any. Returns 0 if we got one, 1 if there
+// is nothing to defrag yet, -1 on queue error.
+static int
+defrag_pop_wblock(drv_ssd *ssd, uint32_t *p_wblock_id, bool wait)
+{
+	uint32_t q_min = ssd->ns->storage_defrag_queue_min;
+
+	if (q_min != 0) {
+		if (ssd_defrag_q_sz(ssd->defrag_wblock_q) <= q_min) {
+			if (wait) {
+				usleep(1000 * 50);
+			}
+
+			return 1;
+		}
+
+		return ssd_defrag_q_pop(ssd->defrag_wblock_q, p_wblock_id, 0) ? 0 : 1;
+	}
+
+	// Wake periodically so the adaptive throttle sees fresh rates.
+	return ssd_defrag_q_pop(ssd->defrag_wblock_q, p_wblock_id,
+			wait ? 1000 : 0) ? 0 : 1;
+}
+
+
+// With an asynchronous io-engine, the next queued wblock is read while the
+// current one is being defragged.
+typedef struct defrag_read_ahead_s {
+	bool			active;
+	uint32_t		wblock_id;
+	uint8_t			*buf;
+	int				fd;
+	uint64_t		start_ns;
+	cf_ioring_op	op;
+} defrag_read_ahead;
+
+static void
+defrag_read_ahead_start(drv_ssd *ssd, defrag_read_ahead *ra)
+{
+	if (defrag_pop_wblock(ssd, &ra->wblock_id, false) != 0) {
+		return;
+	}
+
+	ra->fd = ssd_fd_get(ssd);
+	ra->start_ns = g_config.storage_benchmarks ? cf_getns() : 0;
+
+	cf_ioring_read_submit(ssd->ioring, &ra->op, ra->fd, ra->buf,
+			ssd->write_block_size,
+			(off_t)WBLOCK_ID_TO_BYTES(ssd, ra->wblock_id));
+
+	ra->active = true;
+}
+
+// With defrag-adaptive, the configured defrag-sleep is only a baseline - defrag
+// backs off when the device is busy and speeds up when it's falling behind.
+typedef struct defrag_throttle_s {
+	uint64_t	last_ms;
+	uint64_t	last_client_writes;
+	uint64_t	last_freed;
+	uint32_t	sleep_us;
+} defrag_throttle;
+
+static uint32_t
+defrag_throttle_sleep(drv_ssd *ssd, defrag_throttle *dt)
+{
+	as_namespace *ns = ssd->ns;
+	uint32_t configured = ns->storage_defrag_sleep;
+
+	// Zero during startup, or configured to run flat out.
+	if (! ns->storage_defrag_adaptive || configured == 0) {
+		dt->sleep_us = configured;
+		ssd->defrag_sleep = configured;
+		return configured;
+	}
+
+	uint64_t now = cf_getms();
+
+	if (dt->last_ms == 0) {
+		dt->sleep_us = configured;
+	}
+	else if (now - dt->last_ms < 1000) {
+		return dt->sleep_us;
+	}
+
+	uint64_t client_writes = cf_atomic_int_get(ssd->n_wblock_writes);
+	uint64_t freed = cf_atomic_int_get(ssd->n_defrag_wblocks_freed);
+	uint64_t new_client_writes = client_writes - dt->last_client_writes;
+	uint64_t new_freed = freed - dt->last_freed;
+	bool first = dt->last_ms == 0;
+
+	dt->last_ms = now;
+	dt->last_client_writes = client_writes;
+	dt->last_freed = freed;
+
+	uint32_t sleep_us = dt->sleep_us;
+	uint64_t avail_pct = (available_size(ssd) * 100) / ssd->file_size;
+	uint32_t in_flight = cf_ioring_in_flight(ssd->ioring);
+
+	if (avail_pct <= 2 * (uint64_t)ns->storage_min_avail_pct) {
+		// Running out of free wblocks - go flat out regardless.
+		sleep_us = 0;
+	}
+	else if (cf_queue_sz(ssd->swb_write_q) > ns->storage_max_write_q / 2 ||
+			in_flight > ns->storage_io_depth / 2) {
+		// Device is busy - back off to leave room for client I/O.
+		sleep_us = sleep_us == 0 ? (configured + 3) / 4 : sleep_us * 2;
+
+		if (sleep_us > configured * 4) {
+			sleep_us = configured * 4;
+		}
+	}
+	else if (! first && new_client_writes > new_freed) {
+		// Falling behind client writes - speed up.
+		sleep_us /= 2;
+	}
+	else if (sleep_us < configured) {
+		sleep_us += (configured - sleep_us + 1) / 2;
+	}
+	else if (sleep_us > configured) {
+		sleep_us -= (sleep_us - configured) / 2;
+	}
+
+	dt->sleep_us = sleep_us;
+	ssd->defrag_sleep = sleep_us;
+
+	return sleep_us;
+}
+
+
+// Returns true if the read-ahead wblock is now in ra->buf.
+static bool
+defrag_read_ahead_finish(drv_ssd *ssd, defrag_read_ahead *ra)
+{
+	ssize_t rlen = cf_ioring_wait(&ra->op);
+
+	ra->active = false;
+
+	if (rlen != (ssize_t)ssd->write_block_size) {
+		cf_warning(AS_DRV_SSD, "%s: defrag read-ahead failed (%ld): wblock-id %u: errno %d (%s)",
+				ssd->name, rlen, ra->wblock_id, errno, cf_strerror(errno));
+		close(ra->fd);
+		return false;
+	}
+
+	if (ra->start_ns != 0) {
+		histogram_insert_data_point(ssd->hist_large_block_read, ra->start_ns);
+	}
+
+	ssd_fd_put(ssd, ra->fd);
+
+	return true;
+}
+
+
 // Thread "run" function to service a device's defrag queue.
 void*
 run_defrag(void *pv_data)
@@ -875,35 +1208,48 @@ run_defrag(void *pv_data)
 		cf_crash(AS_DRV_SSD, "device %s: defrag valloc failed", ssd->name);
 	}
 
+	bool read_ahead = cf_ioring_get_type(ssd->ioring) != CF_IORING_SYNC;
+	defrag_read_ahead ra = { .active = false };
+	defrag_throttle dt = { 0 };
+
+	if (read_ahead && ! (ra.buf = cf_valloc(ssd->write_block_size))) {
+		cf_crash(AS_DRV_SSD, "device %s: defrag valloc failed", ssd->name);
+	}
+
 	while (true) {
-		uint32_t q_min = ssd->ns->storage_defrag_queue_min;
-
-		if (q_min != 0) {
-			if (cf_queue_sz(ssd->defrag_wblock_q) > q_min) {
-				if (CF_QUEUE_OK !=
-						cf_queue_pop(ssd->defrag_wblock_q, &wblock_id,
-								CF_QUEUE_NOWAIT)) {
-					// Should never get here!
-					break;
-				}
-			}
-			else {
-				usleep(1000 * 50);
-				continue;
+		bool read_done = false;
+
+		if (ra.active) {
+			wblock_id = ra.wblock_id;
+
+			if (defrag_read_ahead_finish(ssd, &ra)) {
+				uint8_t *swap_buf = read_buf;
+
+				read_buf = ra.buf;
+				ra.buf = swap_buf;
+				read_done = true;
 			}
 		}
 		else {
-			if (CF_QUEUE_OK !=
-					cf_queue_pop(ssd->defrag_wblock_q, &wblock_id,
-							CF_QUEUE_FOREVER)) {
+			int rv = defrag_pop_wblock(ssd, &wblock_id, true);
+
+			if (rv == 1) {
+				continue;
+			}
+
+			if (rv != 0) {
 				// Should never get here!
 				break;
 			}
 		}
 
-		ssd_defrag_wblock(ssd, wblock_id, read_buf);
+		if (read_ahead) {
+			defrag_read_ahead_start(ssd, &ra);
+		}
+
+		ssd_defrag_wblock(ssd, wblock_id, read_buf, read_done);
 
-		uint32_t sleep_us = ssd->ns->storage_defrag_sleep;
+		uint32_t sleep_us = defrag_throttle_sleep(ssd, &dt);
 
 		if (sleep_us != 0) {
 			usleep(sleep_us);
@@ -911,6 +1257,10 @@ run_defrag(void *pv_data)
 	}
 
 	// Although we ever expect to get here...
+	if (ra.buf) {
+		cf_free(ra.buf);
+	}
+
 	cf_free(read_buf);
 	cf_warning(AS_DRV_SSD, "device %s: quit defrag - queue error", ssd->name);
 
@@ -934,87 +1284,25 @@ ssd_start_defrag_threads(drv_ssds *ssds)
 }
 
 
-//------------------------------------------------
-// defrag_pen class.
-//
-
-#define DEFRAG_PEN_INIT_CAPACITY (8 * 1024)
-
-typedef struct defrag_pen_s {
-	uint32_t n_ids;
-	uint32_t capacity;
-	uint32_t *ids;
-	uint32_t stack_ids[DEFRAG_PEN_INIT_CAPACITY];
-} defrag_pen;
-
-static void
-defrag_pen_init(defrag_pen *pen)
-{
-	pen->n_ids = 0;
-	pen->capacity = DEFRAG_PEN_INIT_CAPACITY;
-	pen->ids = pen->stack_ids;
-}
-
-static void
-defrag_pen_destroy(defrag_pen *pen)
-{
-	if (pen->ids != pen->stack_ids) {
-		cf_free(pen->ids);
-	}
-}
-
-static void
-defrag_pen_add(defrag_pen *pen, uint32_t wblock_id)
-{
-	if (pen->n_ids == pen->capacity) {
-		if (pen->capacity == DEFRAG_PEN_INIT_CAPACITY) {
-			pen->capacity <<= 2;
-			pen->ids = cf_malloc(pen->capacity * sizeof(uint32_t));
-			memcpy(pen->ids, pen->stack_ids, sizeof(pen->stack_ids));
-		}
-		else {
-			pen->capacity <<= 1;
-			pen->ids = cf_realloc(pen->ids, pen->capacity * sizeof(uint32_t));
-		}
-	}
-
-	pen->ids[pen->n_ids++] = wblock_id;
-}
-
-static void
-defrag_pen_transfer(defrag_pen *pen, drv_ssd *ssd)
-{
-	// For speed, "customize" instead of using push_wblock_to_defrag_q()...
-	for (uint32_t i = 0; i < pen->n_ids; i++) {
-		uint32_t wblock_id = pen->ids[i];
-
-		ssd->alloc_table->wblock_state[wblock_id].state = WBLOCK_STATE_DEFRAG;
-		cf_queue_push(ssd->defrag_wblock_q, &wblock_id);
-	}
-}
-
 static void
-defrag_pens_dump(defrag_pen pens[], uint32_t n_pens, const char* ssd_name)
+defrag_profile_dump(const uint32_t counts[], uint32_t n_counts,
+		const char* ssd_name)
 {
 	char buf[2048];
 	uint32_t n = 0;
-	int pos = sprintf(buf, "%u", pens[n++].n_ids);
+	int pos = sprintf(buf, "%u", counts[n++]);
 
-	while (n < n_pens) {
-		pos += sprintf(buf + pos, ",%u", pens[n++].n_ids);
+	while (n < n_counts) {
+		pos += sprintf(buf + pos, ",%u", counts[n++]);
 	}
 
 	cf_info(AS_DRV_SSD, "%s init defrag profile: %s", ssd_name, buf);
 }
 
-//
-// END - defrag_pen class.
-//------------------------------------------------
-
 
 // Thread "run" function to create and load a device's (wblock) free & defrag
-// queues at startup. Sorts defrag-eligible wblocks so the most depleted ones
-// are at the head of the defrag queue.
+// queues at startup. The defrag queue keeps the most depleted wblocks at its
+// head.
 void*
 run_load_queues(void *pv_data)
 {
@@ -1025,18 +1313,19 @@ run_load_queues(void *pv_data)
 		cf_crash(AS_DRV_SSD, "%s free wblock queue create failed", ssd->name);
 	}
 
-	if (! (ssd->defrag_wblock_q = cf_queue_create(sizeof(uint32_t), true))) {
-		cf_crash(AS_DRV_SSD, "%s defrag queue create failed", ssd->name);
+	ssd_defrag_q* defrag_q = ssd_defrag_q_create(ssd->write_block_size,
+			ssd->alloc_table->n_wblocks);
+
+	if (! defrag_q) {
+		cf_crash(AS_DRV_SSD, "%s defrag wblock queue create failed", ssd->name);
 	}
 
 	as_namespace *ns = ssd->ns;
 	uint32_t lwm_pct = ns->storage_defrag_lwm_pct;
 	uint32_t lwm_size = ns->defrag_lwm_size;
-	defrag_pen pens[lwm_pct];
+	uint32_t profile[lwm_pct];
 
-	for (uint32_t n = 0; n < lwm_pct; n++) {
-		defrag_pen_init(&pens[n]);
-	}
+	memset(profile, 0, sizeof(profile));
 
 	ssd_alloc_table* at = ssd->alloc_table;
 	uint32_t first_id = BYTES_TO_WBLOCK_ID(ssd, ssd->header_size);
@@ -1050,18 +1339,17 @@ run_load_queues(void *pv_data)
 			cf_queue_push(ssd->free_wblock_q, &wblock_id);
 		}
 		else if (inuse_sz < lwm_size) {
-			defrag_pen_add(&pens[(inuse_sz * lwm_pct) / lwm_size], wblock_id);
+			// Queue is ordered by inuse_sz, so no need to sort here.
+			at->wblock_state[wblock_id].state = WBLOCK_STATE_DEFRAG;
+			ssd_defrag_q_push(defrag_q, wblock_id, inuse_sz);
+			profile[(inuse_sz * lwm_pct) / lwm_size]++;
 		}
 	}
 
-	defrag_pens_dump(pens, lwm_pct, ssd->name);
+	defrag_profile_dump(profile, lwm_pct, ssd->name);
 
-	for (uint32_t n = 0; n < lwm_pct; n++) {
-		defrag_pen_transfer(&pens[n], ssd);
-		defrag_pen_destroy(&pens[n]);
-	}
-
-	ssd->n_defrag_wblock_reads = (uint64_t)cf_queue_sz(ssd->defrag_wblock_q);
+	ssd->n_defrag_wblock_reads = (uint64_t)ssd_defrag_q_sz(defrag_q);
+	ssd->defrag_wblock_q = defrag_q;
 
 	return NULL;
 }
@@ -1092,9 +1380,9 @@ ssd_load_wblock_queues(drv_ssds *ssds)
 	for (int i = 0; i < ssds->n_ssds; i++) {
 		drv_ssd *ssd = &ssds->ssds[i];
 
-		cf_info(AS_DRV_SSD, "%s init wblock free-q %d, defrag-q %d", ssd->name,
+		cf_info(AS_DRV_SSD, "%s init wblock free-q %d, defrag-q %u", ssd->name,
 				cf_queue_sz(ssd->free_wblock_q),
-				cf_queue_sz(ssd->defrag_wblock_q));
+				ssd_defrag_q_sz(ssd->defrag_wblock_q));
 	}
 }
 
@@ -1127,6 +1415,16 @@ ssd_wblock_init(drv_ssd *ssd)
 // Storage API implementation: reading records.
 //
 
+// Identifies a hot-tier image - the record's location and generation.
+static inline uint64_t
+ssd_hot_version(const as_record *r)
+{
+	return (uint64_t)r->storage_key.ssd.rblock_id |
+			((uint64_t)r->storage_key.ssd.file_id << 34) |
+			((uint64_t)r->generation << 40);
+}
+
+
 inline uint16_t
 as_storage_record_get_n_bins_ssd(as_storage_rd *rd)
 {
@@ -1134,6 +1432,59 @@ as_storage_record_get_n_bins_ssd(as_storage_rd *rd)
 }
 
 
+// Make a cf_malloc()'d uncompressed copy of a compressed block. Returns NULL
+// if the compressed data is corrupt.
+static drv_ssd_block*
+ssd_decompress_block(as_namespace *ns, drv_ssd_block *block)
+{
+	const ssd_compressed_data *cd = (const ssd_compressed_data*)block->data;
+	uint64_t stored_size = (uint64_t)block->length + LENGTH_BASE;
+
+	if (stored_size < sizeof(drv_ssd_block) + sizeof(ssd_compressed_data) ||
+			sizeof(drv_ssd_block) + sizeof(ssd_compressed_data) +
+				(uint64_t)cd->comp_size > stored_size ||
+			sizeof(drv_ssd_block) + (uint64_t)cd->data_size >
+				ns->storage_write_block_size) {
+		cf_warning_digest(AS_DRV_SSD, &block->keyd, "{%s} bad compressed sizes %u:%u ",
+				ns->name, cd->comp_size, cd->data_size);
+		return NULL;
+	}
+
+	drv_ssd_block *flat_block = cf_malloc(sizeof(drv_ssd_block) +
+			cd->data_size);
+
+	if (! flat_block) {
+		return NULL;
+	}
+
+	size_t data_size = cd->data_size;
+
+	uint64_t start_ns = cf_getns();
+
+	int rv = as_decompress((compression_type)block->compression, cd->comp_size,
+			cd->data, &data_size, flat_block->data);
+
+	cf_atomic64_add(&ns->decompression_ns, (int64_t)(cf_getns() - start_ns));
+	cf_atomic64_incr(&ns->n_decompressions);
+
+	if (rv != 0 || data_size != cd->data_size) {
+		cf_warning_digest(AS_DRV_SSD, &block->keyd, "{%s} failed to decompress block type %u (%d) ",
+				ns->name, block->compression, rv);
+		cf_free(flat_block);
+		return NULL;
+	}
+
+	memcpy(flat_block, block, sizeof(drv_ssd_block));
+	flat_block->length = (uint32_t)(sizeof(drv_ssd_block) + data_size -
+			LENGTH_BASE);
+	flat_block->compression = COMPRESSION_NONE;
+	flat_block->checksum_magic = 0; // checksum was of the compressed block
+	flat_block->checksum = 0;
+
+	return flat_block;
+}
+
+
 int
 as_storage_record_read_ssd(as_storage_rd *rd)
 {
@@ -1145,6 +1496,25 @@ as_storage_record_read_ssd(as_storage_rd *rd)
 		return -1;
 	}
 
+	ssd_hot_tier *hot_tier = ((drv_ssds*)rd->ns->storage_private)->hot_tier;
+	uint64_t hot_version = 0;
+
+	if (hot_tier) {
+		hot_version = ssd_hot_version(r);
+
+		const uint8_t *image = ssd_hot_tier_get(hot_tier, &rd->keyd,
+				hot_version, &rd->u.ssd.hot_rec);
+
+		if (image) {
+			// Hot record - use the image in place, it's never modified.
+			rd->u.ssd.block = (drv_ssd_block*)image;
+			rd->u.ssd.must_free_block = NULL;
+			rd->have_device_block = true;
+
+			return 0;
+		}
+	}
+
 	uint64_t record_offset = RBLOCKS_TO_BYTES(r->storage_key.ssd.rblock_id);
 	uint64_t record_size = RBLOCKS_TO_BYTES(r->storage_key.ssd.n_rblocks);
 
@@ -1152,6 +1522,7 @@ as_storage_record_read_ssd(as_storage_rd *rd)
 	drv_ssd_block *block = NULL;
 
 	drv_ssd *ssd = rd->u.ssd.ssd;
+	ssd_read_cache *read_cache = ((drv_ssds*)rd->ns->storage_private)->read_cache;
 	ssd_write_buf *swb = 0;
 	uint32_t wblock = RBLOCK_ID_TO_WBLOCK_ID(ssd, r->storage_key.ssd.rblock_id);
 
@@ -1173,6 +1544,12 @@ as_storage_record_read_ssd(as_storage_rd *rd)
 		memcpy(read_buf, swb->buf + swb_offset, record_size);
 		swb_release(swb);
 	}
+	else if (read_cache && (read_buf = ssd_read_cache_get(read_cache,
+			ssd->file_id, r->storage_key.ssd.rblock_id,
+			(uint32_t)record_size)) != NULL) {
+		// Data is in read cache - already verified when it was read.
+		block = (drv_ssd_block*)read_buf;
+	}
 	else {
 		// Normal case - data is read from device.
 		cf_atomic32_incr(&rd->ns->n_reads_from_device);
@@ -1193,19 +1570,14 @@ as_storage_record_read_ssd(as_storage_rd *rd)
 
 		uint64_t start_ns = g_config.storage_benchmarks ? cf_getns() : 0;
 
-		if (lseek(fd, (off_t)read_offset, SEEK_SET) != (off_t)read_offset) {
-			cf_warning(AS_DRV_SSD, "%s: seek failed: offset %lu: errno %d (%s)",
-					ssd->name, read_offset, errno, cf_strerror(errno));
-			cf_free(read_buf);
-			close(fd);
-			return -1;
-		}
-
-		ssize_t rv = read(fd, read_buf, read_size);
+		// The transaction waits for this read whatever the io-engine, so don't
+		// pay for a hand-off to the engine - read inline.
+		ssize_t rv = pread(fd, read_buf, read_size, (off_t)read_offset);
 
 		if (rv != (ssize_t)read_size) {
-			cf_warning(AS_DRV_SSD, "%s: read failed (%ld): size %lu: errno %d (%s)",
-					ssd->name, rv, read_size, errno, cf_strerror(errno));
+			cf_warning(AS_DRV_SSD, "%s: read failed (%ld): offset %lu size %lu: errno %d (%s)",
+					ssd->name, rv, read_offset, read_size, errno,
+					cf_strerror(errno));
 			cf_free(read_buf);
 			close(fd);
 			return -1;
@@ -1232,6 +1604,43 @@ as_storage_record_read_ssd(as_storage_rd *rd)
 			cf_free(read_buf);
 			return -1;
 		}
+		if ((uint64_t)block->length + LENGTH_BASE > record_size) {
+			cf_warning(AS_DRV_SSD, "read: bad block length %u offset %"PRIu64,
+					block->length, record_offset);
+			cf_free(read_buf);
+			return -1;
+		}
+		if (! ssd_block_checksum_ok(block)) {
+			cf_warning_digest(AS_DRV_SSD, &rd->keyd, "{%s} read: checksum mismatch device %s offset %"PRIu64" ",
+					rd->ns->name, ssd->name, record_offset);
+			cf_atomic64_incr(&rd->ns->n_storage_checksum_errors);
+			cf_free(read_buf);
+			return -1;
+		}
+
+		if (read_cache) {
+			ssd_read_cache_put(read_cache, ssd->file_id,
+					r->storage_key.ssd.rblock_id, (const uint8_t*)block,
+					(uint32_t)record_size);
+		}
+	}
+
+	if (block->compression != COMPRESSION_NONE) {
+		drv_ssd_block *flat_block = ssd_decompress_block(rd->ns, block);
+
+		cf_free(read_buf);
+
+		if (! flat_block) {
+			return -1;
+		}
+
+		block = flat_block;
+		read_buf = (uint8_t*)flat_block;
+	}
+
+	if (hot_tier) {
+		ssd_hot_tier_promote(hot_tier, &rd->keyd, hot_version,
+				(const uint8_t*)block, block->length + LENGTH_BASE);
 	}
 
 	rd->u.ssd.block = block;
@@ -1316,18 +1725,18 @@ ssd_flush_swb(drv_ssd *ssd, ssd_write_buf *swb)
 	int fd = ssd_fd_get(ssd);
 	off_t write_offset = (off_t)WBLOCK_ID_TO_BYTES(ssd, swb->wblock_id);
 
+	bool hinted = ssd_write_hint_begin(ssd, &ssd->write_hint, ssd->name, fd,
+			swb->stream);
+
 	uint64_t start_ns = g_config.storage_benchmarks ? cf_getns() : 0;
 
-	if (lseek(fd, write_offset, SEEK_SET) != write_offset) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED seek: offset %ld: errno %d (%s)",
-				ssd->name, write_offset, errno, cf_strerror(errno));
-	}
+	ssize_t rv_s = pwrite(fd, swb->buf, ssd->write_block_size, write_offset);
 
-	ssize_t rv_s = write(fd, swb->buf, ssd->write_block_size);
+	ssd_write_hint_end(&ssd->write_hint, hinted);
 
 	if (rv_s != (ssize_t)ssd->write_block_size) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: errno %d (%s)",
-				ssd->name, errno, cf_strerror(errno));
+		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: offset %ld: errno %d (%s)",
+				ssd->name, write_offset, errno, cf_strerror(errno));
 	}
 
 	if (start_ns != 0) {
@@ -1338,24 +1747,149 @@ ssd_flush_swb(drv_ssd *ssd, ssd_write_buf *swb)
 }
 
 
+static int
+swb_wblock_id_compare(const void *pa, const void *pb)
+{
+	uint32_t a = (*(const ssd_write_buf**)pa)->wblock_id;
+	uint32_t b = (*(const ssd_write_buf**)pb)->wblock_id;
+
+	return a < b ? -1 : (a == b ? 0 : 1);
+}
+
+
+static int
+swb_stream_wblock_id_compare(const void *pa, const void *pb)
+{
+	uint8_t a = (*(const ssd_write_buf**)pa)->stream;
+	uint8_t b = (*(const ssd_write_buf**)pb)->stream;
+
+	return a != b ? (a < b ? -1 : 1) : swb_wblock_id_compare(pa, pb);
+}
+
+
+// Flush a batch of swbs. Runs of adjacent wblocks are coalesced into single
+// vectored writes, and all the writes are put in flight before waiting on any.
+// If write hints are on, swbs are grouped by stream - a stream's runs are all
+// in flight together under its hint, but must complete before the next
+// stream's hint can be set. Note - sorts swbs in place.
+void
+ssd_flush_swbs(drv_ssd *ssd, ssd_write_buf **swbs, uint32_t n_swbs)
+{
+	if (n_swbs == 1) {
+		ssd_flush_swb(ssd, swbs[0]);
+		return;
+	}
+
+	// If hints get turned off mid-batch, the stream grouping just goes unused.
+	qsort(swbs, n_swbs, sizeof(ssd_write_buf*), ssd->write_hints ?
+			swb_stream_wblock_id_compare : swb_wblock_id_compare);
+
+	for (uint32_t i = 0; i < n_swbs; i++) {
+		// Wait for all writers to finish.
+		while (cf_atomic32_get(swbs[i]->n_writers) != 0) {
+			;
+		}
+	}
+
+	struct iovec iov[MAX_WRITE_BATCH];
+	cf_ioring_op ops[MAX_WRITE_BATCH];
+	int fds[MAX_WRITE_BATCH];
+	off_t offsets[MAX_WRITE_BATCH];
+	size_t sizes[MAX_WRITE_BATCH];
+	ssize_t results[MAX_WRITE_BATCH];
+	uint32_t n_ops = 0;
+	uint32_t n_waited = 0;
+	bool hinted = false;
+
+	uint64_t start_ns = g_config.storage_benchmarks ? cf_getns() : 0;
+	uint32_t i = 0;
+
+	while (i < n_swbs) {
+		uint32_t run_start = i;
+
+		do {
+			iov[i].iov_base = swbs[i]->buf;
+			iov[i].iov_len = ssd->write_block_size;
+			i++;
+		} while (i < n_swbs &&
+				swbs[i]->wblock_id == swbs[i - 1]->wblock_id + 1 &&
+				(! ssd->write_hints ||
+						swbs[i]->stream == swbs[run_start]->stream));
+
+		fds[n_ops] = ssd_fd_get(ssd);
+		offsets[n_ops] =
+				(off_t)WBLOCK_ID_TO_BYTES(ssd, swbs[run_start]->wblock_id);
+		sizes[n_ops] = (size_t)(i - run_start) * ssd->write_block_size;
+
+		if (run_start == 0 ||
+				swbs[run_start]->stream != swbs[run_start - 1]->stream) {
+			if (hinted) {
+				// Previous stream's writes must land before its hint changes.
+				while (n_waited < n_ops) {
+					results[n_waited] = cf_ioring_wait(&ops[n_waited]);
+					n_waited++;
+				}
+
+				ssd_write_hint_end(&ssd->write_hint, true);
+			}
+
+			hinted = ssd_write_hint_begin(ssd, &ssd->write_hint, ssd->name,
+					fds[n_ops], swbs[run_start]->stream);
+		}
+
+		cf_ioring_writev_submit(ssd->ioring, &ops[n_ops], fds[n_ops],
+				&iov[run_start], (int)(i - run_start), offsets[n_ops]);
+
+		n_ops++;
+	}
+
+	if (hinted) {
+		while (n_waited < n_ops) {
+			results[n_waited] = cf_ioring_wait(&ops[n_waited]);
+			n_waited++;
+		}
+
+		ssd_write_hint_end(&ssd->write_hint, true);
+	}
+
+	for (uint32_t n = 0; n < n_ops; n++) {
+		ssize_t rv_s = n < n_waited ? results[n] : cf_ioring_wait(&ops[n]);
+
+		if (rv_s != (ssize_t)sizes[n]) {
+			cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write (%ld): offset %ld size %lu: errno %d (%s)",
+					ssd->name, rv_s, offsets[n], sizes[n], errno,
+					cf_strerror(errno));
+		}
+
+		if (start_ns != 0) {
+			histogram_insert_data_point(ssd->hist_write, start_ns);
+		}
+
+		ssd_fd_put(ssd, fds[n]);
+	}
+
+	cf_atomic_int_add(&ssd->n_coalesced_wblock_writes, n_swbs - n_ops);
+}
+
+
 void
 ssd_shadow_flush_swb(drv_ssd *ssd, ssd_write_buf *swb)
 {
 	int fd = ssd_shadow_fd_get(ssd);
 	off_t write_offset = (off_t)WBLOCK_ID_TO_BYTES(ssd, swb->wblock_id);
 
+	bool hinted = ssd_write_hint_begin(ssd, &ssd->shadow_write_hint,
+			ssd->shadow_name, fd, swb->stream);
+
 	uint64_t start_ns = g_config.storage_benchmarks ? cf_getns() : 0;
 
-	if (lseek(fd, write_offset, SEEK_SET) != write_offset) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED seek: offset %ld: errno %d (%s)",
-				ssd->shadow_name, write_offset, errno, cf_strerror(errno));
-	}
+	ssize_t rv_s = pwrite(fd, swb->buf, ssd->write_block_size, write_offset);
 
-	ssize_t rv_s = write(fd, swb->buf, ssd->write_block_size);
+	ssd_write_hint_end(&ssd->shadow_write_hint, hinted);
 
 	if (rv_s != (ssize_t)ssd->write_block_size) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: errno %d (%s)",
-				ssd->shadow_name, errno, cf_strerror(errno));
+		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: offset %ld: errno %d (%s)",
+				ssd->shadow_name, write_offset, errno, cf_strerror(errno));
 	}
 
 	if (start_ns != 0) {
@@ -1422,27 +1956,39 @@ void *
 ssd_write_worker(void *arg)
 {
 	drv_ssd *ssd = (drv_ssd*)arg;
+	ssd_write_buf *swbs[MAX_WRITE_BATCH];
 
 	while (ssd->running) {
-		ssd_write_buf *swb;
-
-		if (CF_QUEUE_OK != cf_queue_pop(ssd->swb_write_q, &swb, 100)) {
+		if (CF_QUEUE_OK != cf_queue_pop(ssd->swb_write_q, &swbs[0], 100)) {
 			continue;
 		}
 
+		uint32_t n_swbs = 1;
+
+		// Take whatever else is already waiting, so it's written together.
+		while (n_swbs < MAX_WRITE_BATCH &&
+				CF_QUEUE_OK == cf_queue_pop(ssd->swb_write_q, &swbs[n_swbs],
+						CF_QUEUE_NOWAIT)) {
+			n_swbs++;
+		}
+
 		// Sanity checks (optional).
-		ssd_write_sanity_checks(ssd, swb);
+		for (uint32_t i = 0; i < n_swbs; i++) {
+			ssd_write_sanity_checks(ssd, swbs[i]);
+		}
 
 		// Flush to the device.
-		ssd_flush_swb(ssd, swb);
+		ssd_flush_swbs(ssd, swbs, n_swbs);
 
-		if (ssd->shadow_name) {
-			// Queue for shadow device write.
-			cf_queue_push(ssd->swb_shadow_q, &swb);
-		}
-		else {
-			// Transfer to post-write queue, or release swb, as appropriate.
-			ssd_post_write(ssd, swb);
+		for (uint32_t i = 0; i < n_swbs; i++) {
+			if (ssd->shadow_name) {
+				// Queue for shadow device write.
+				cf_queue_push(ssd->swb_shadow_q, &swbs[i]);
+			}
+			else {
+				// Transfer to post-write queue, or release swb, as appropriate.
+				ssd_post_write(ssd, swbs[i]);
+			}
 		}
 	} // infinite event loop waiting for block to write
 
@@ -1558,6 +2104,134 @@ ssd_write_calculate_size(as_record *r, as_storage_rd *rd)
 }
 
 
+// Flatten rec-props and bins into a block's data area. Sets n_bins, returns
+// number of bytes from start of block to end of last bin.
+static uint32_t
+ssd_flatten_bins(as_storage_rd *rd, drv_ssd_block *block)
+{
+	uint8_t *buf_start = (uint8_t*)block;
+	uint8_t *buf = block->data;
+
+	// Properties list goes just before bins.
+	if (rd->rec_props.p_data) {
+		memcpy(buf, rd->rec_props.p_data, rd->rec_props.size);
+		buf += rd->rec_props.size;
+	}
+
+	drv_ssd_bin *ssd_bin = 0;
+	uint16_t write_nbins = 0;
+
+	for (uint16_t i = 0; i < rd->n_bins; i++) {
+		as_bin *bin = &rd->bins[i];
+
+		if (as_bin_inuse(bin)) {
+			ssd_bin = (drv_ssd_bin*)buf;
+			buf += sizeof(drv_ssd_bin);
+
+			ssd_bin->version = 0;
+
+			if (! rd->ns->single_bin) {
+				strcpy(ssd_bin->name, as_bin_get_name_from_id(rd->ns, bin->id));
+			}
+			else {
+				ssd_bin->name[0] = 0;
+			}
+
+			ssd_bin->offset = buf - buf_start;
+
+			uint32_t particle_flat_size = as_bin_particle_to_flat(bin, buf);
+
+			buf += particle_flat_size;
+			ssd_bin->len = particle_flat_size;
+			ssd_bin->next = buf - buf_start;
+
+			write_nbins++;
+		}
+	}
+
+	block->n_bins = write_nbins;
+
+	return (uint32_t)(buf - buf_start);
+}
+
+
+// Flatten and compress a record into a cf_malloc()'d block image. Returns
+// NULL if the record doesn't compress by at least one rblock, else sets
+// *p_write_size to the (rounded) size of the image. Only the data area is
+// compressed - the block header stays readable by defrag and cold start.
+static uint8_t*
+ssd_compress_record(as_storage_rd *rd, uint32_t *p_write_size)
+{
+	as_namespace *ns = rd->ns;
+	uint32_t write_size = *p_write_size;
+
+	// Must save at least one rblock, else it's not worth it.
+	if (write_size < sizeof(drv_ssd_block) + sizeof(ssd_compressed_data) +
+			RBLOCK_SIZE) {
+		return NULL;
+	}
+
+	size_t max_comp_size = write_size - RBLOCK_SIZE - sizeof(drv_ssd_block) -
+			sizeof(ssd_compressed_data);
+
+	uint8_t *flat = cf_malloc(write_size);
+
+	if (! flat) {
+		return NULL;
+	}
+
+	uint8_t *image = cf_malloc(write_size);
+
+	if (! image) {
+		cf_free(flat);
+		return NULL;
+	}
+
+	drv_ssd_block *flat_block = (drv_ssd_block*)flat;
+	uint32_t flat_size = ssd_flatten_bins(rd, flat_block);
+	uint32_t data_size = flat_size - (uint32_t)sizeof(drv_ssd_block);
+
+	drv_ssd_block *block = (drv_ssd_block*)image;
+	ssd_compressed_data *cd = (ssd_compressed_data*)block->data;
+	size_t comp_size = max_comp_size;
+
+	uint64_t start_ns = cf_getns();
+
+	int rv = as_compress_buf(ns->storage_compression,
+			(int)ns->storage_compression_level, data_size, flat_block->data,
+			&comp_size, cd->data);
+
+	cf_atomic64_add(&ns->compression_ns, (int64_t)(cf_getns() - start_ns));
+
+	if (rv != 0) {
+		// Didn't fit - store it uncompressed.
+		cf_atomic64_incr(&ns->n_compression_fails);
+		cf_free(image);
+		cf_free(flat);
+		return NULL;
+	}
+
+	cf_atomic64_incr(&ns->n_compressions);
+
+	memcpy(block, flat_block, sizeof(drv_ssd_block));
+	block->compression = (uint8_t)ns->storage_compression;
+	cd->data_size = data_size;
+	cd->comp_size = (uint32_t)comp_size;
+
+	uint32_t image_size = (uint32_t)(sizeof(drv_ssd_block) +
+			sizeof(ssd_compressed_data) + comp_size);
+
+	*p_write_size = BYTES_TO_RBLOCK_BYTES(image_size);
+
+	// Don't write stale heap contents to the device.
+	memset(image + image_size, 0, *p_write_size - image_size);
+
+	cf_free(flat);
+
+	return image;
+}
+
+
 int
 ssd_write_bins(as_record *r, as_storage_rd *rd)
 {
@@ -1570,18 +2244,42 @@ ssd_write_bins(as_record *r, as_storage_rd *rd)
 		return -AS_PROTO_RESULT_FAIL_RECORD_TOO_BIG;
 	}
 
+	if (0 == rd->bins) {
+		// TODO - just crash?
+		cf_warning(AS_DRV_SSD, "write bins: no bins array");
+		return -AS_PROTO_RESULT_FAIL_UNKNOWN;
+	}
+
+	as_namespace *ns = rd->ns;
+	uint8_t *image = NULL;
+
+	if (ns->storage_compression != COMPRESSION_NONE) {
+		cf_atomic64_add(&ns->compression_orig_bytes, (int64_t)write_size);
+
+		if (write_size >= ns->storage_compression_threshold) {
+			// If this succeeds, write_size is reduced.
+			image = ssd_compress_record(rd, &write_size);
+		}
+
+		cf_atomic64_add(&ns->compression_stored_bytes, (int64_t)write_size);
+	}
+
+	ssd_stream_id stream_id = ssd_stream_id_get(ssd, r->void_time, false);
+	ssd_write_stream *stream = &ssd->streams[stream_id];
+
 	// Reserve the portion of the current swb where this record will be written.
-	pthread_mutex_lock(&ssd->write_lock);
+	pthread_mutex_lock(&stream->lock);
 
-	ssd_write_buf *swb = ssd->current_swb;
+	ssd_write_buf *swb = stream->swb;
 
 	if (! swb) {
-		swb = swb_get(ssd);
-		ssd->current_swb = swb;
+		swb = swb_get(ssd, stream_id);
+		stream->swb = swb;
 
 		if (! swb) {
 			cf_warning(AS_DRV_SSD, "write bins: couldn't get swb");
-			pthread_mutex_unlock(&ssd->write_lock);
+			pthread_mutex_unlock(&stream->lock);
+			cf_free(image);
 			return -AS_PROTO_RESULT_FAIL_PARTITION_OUT_OF_SPACE;
 		}
 	}
@@ -1598,14 +2296,16 @@ ssd_write_bins(as_record *r, as_storage_rd *rd)
 		// Enqueue the buffer, to be flushed to device.
 		cf_queue_push(ssd->swb_write_q, &swb);
 		cf_atomic_int_incr(&ssd->n_wblock_writes);
+		cf_atomic_int_incr(&stream->n_wblock_writes);
 
 		// Get the new buffer.
-		swb = swb_get(ssd);
-		ssd->current_swb = swb;
+		swb = swb_get(ssd, stream_id);
+		stream->swb = swb;
 
 		if (! swb) {
 			cf_warning(AS_DRV_SSD, "write bins: couldn't get swb");
-			pthread_mutex_unlock(&ssd->write_lock);
+			pthread_mutex_unlock(&stream->lock);
+			cf_free(image);
 			return -AS_PROTO_RESULT_FAIL_PARTITION_OUT_OF_SPACE;
 		}
 	}
@@ -1617,72 +2317,42 @@ ssd_write_bins(as_record *r, as_storage_rd *rd)
 	swb->pos += write_size;
 	cf_atomic32_incr(&swb->n_writers);
 
-	pthread_mutex_unlock(&ssd->write_lock);
+	pthread_mutex_unlock(&stream->lock);
 	// May now write this record concurrently with others in this swb.
 
-	// Flatten data into the block.
-
-	uint8_t *buf = &swb->buf[swb_pos];
-	uint8_t *buf_start = buf;
-
-	drv_ssd_block *block = (drv_ssd_block*)buf;
-
-	buf += sizeof(drv_ssd_block);
+	drv_ssd_block *block = (drv_ssd_block*)&swb->buf[swb_pos];
 
-	// Properties list goes just before bins.
-	if (rd->rec_props.p_data) {
-		memcpy(buf, rd->rec_props.p_data, rd->rec_props.size);
-		buf += rd->rec_props.size;
-	}
-
-	drv_ssd_bin *ssd_bin = 0;
-	uint32_t write_nbins = 0;
-
-	if (0 == rd->bins) {
-		// TODO - just crash?
-		cf_warning(AS_DRV_SSD, "write bins: no bins array");
-		cf_atomic32_decr(&swb->n_writers);
-		return -AS_PROTO_RESULT_FAIL_UNKNOWN;
+	if (image) {
+		// Already flattened and compressed - n_bins and compression are set.
+		memcpy(block, image, write_size);
+		cf_free(image);
 	}
-
-	for (uint16_t i = 0; i < rd->n_bins; i++) {
-		as_bin *bin = &rd->bins[i];
-
-		if (as_bin_inuse(bin)) {
-			ssd_bin = (drv_ssd_bin*)buf;
-			buf += sizeof(drv_ssd_bin);
-
-			ssd_bin->version = 0;
-
-			if (! rd->ns->single_bin) {
-				strcpy(ssd_bin->name, as_bin_get_name_from_id(rd->ns, bin->id));
-			}
-			else {
-				ssd_bin->name[0] = 0;
-			}
-
-			ssd_bin->offset = buf - buf_start;
-
-			uint32_t particle_flat_size = as_bin_particle_to_flat(bin, buf);
-
-			buf += particle_flat_size;
-			ssd_bin->len = particle_flat_size;
-			ssd_bin->next = buf - buf_start;
-
-			write_nbins++;
-		}
+	else {
+		// Flatten data into the block.
+		ssd_flatten_bins(rd, block);
+		block->compression = COMPRESSION_NONE;
 	}
 
-	block->sig = 0; // deprecated
+	block->unused = 0;
 	block->length = write_size - LENGTH_BASE;
 	block->magic = SSD_BLOCK_MAGIC;
 	block->keyd = rd->keyd;
 	block->generation = r->generation;
 	block->void_time = r->void_time;
 	block->bins_offset = rd->rec_props.p_data ? rd->rec_props.size : 0;
-	block->n_bins = write_nbins;
 	block->last_update_time = r->last_update_time;
 
+	// Must be last - covers everything else written to the block. Defrag
+	// copies blocks verbatim, so the checksum stays valid when moved.
+	if (ns->storage_enable_checksum) {
+		block->checksum_magic = SSD_BLOCK_CHECKSUM_MAGIC;
+		block->checksum = ssd_block_checksum(block);
+	}
+	else {
+		block->checksum_magic = 0;
+		block->checksum = 0;
+	}
+
 	r->storage_key.ssd.file_id = ssd->file_id;
 	r->storage_key.ssd.rblock_id = BYTES_TO_RBLOCKS(WBLOCK_ID_TO_BYTES(ssd, swb->wblock_id) + swb_pos);
 	r->storage_key.ssd.n_rblocks = BYTES_TO_RBLOCKS(write_size);
@@ -1928,28 +2598,12 @@ as_storage_analyze_wblock(as_namespace* ns, int device_index,
 		return -1;
 	}
 
-	int fd = ssd_fd_get(ssd);
-	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
-
-	if (lseek(fd, (off_t)file_offset, SEEK_SET) != (off_t)file_offset) {
-		cf_warning(AS_DRV_SSD, "%s: seek failed: offset %lu: errno %d (%s)",
-				ssd->name, file_offset, errno, cf_strerror(errno));
-		cf_free(read_buf);
-		close(fd);
-		return -1;
-	}
-
-	ssize_t rlen = read(fd, read_buf, ssd->write_block_size);
-
-	if (rlen != (ssize_t)ssd->write_block_size) {
-		cf_warning(AS_DRV_SSD, "%s: read failed (%ld): errno %d (%s)",
-				ssd->name, rlen, errno, cf_strerror(errno));
+	if (! ssd_read_wblock(ssd, wblock_id, read_buf)) {
 		cf_free(read_buf);
-		close(fd);
 		return -1;
 	}
 
-	ssd_fd_put(ssd, fd);
+	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
 
 	uint32_t living_populations[AS_PARTITIONS];
 	uint32_t zombie_populations[AS_PARTITIONS];
@@ -2078,15 +2732,31 @@ ssd_log_stats(drv_ssd *ssd, uint64_t *p_prev_n_total_writes,
 	float defrag_write_rate = (float)(n_defrag_writes - *p_prev_n_defrag_writes) /
 			(float)LOG_STATS_INTERVAL_sec;
 
-	cf_info(AS_DRV_SSD, "device %s: used %lu, contig-free %luM (%d wblocks), swb-free %d, w-q %d w-tot %lu (%.1f/s), defrag-q %d defrag-tot %lu (%.1f/s) defrag-w-tot %lu (%.1f/s)",
+	cf_info(AS_DRV_SSD, "device %s: used %lu, contig-free %luM (%d wblocks), swb-free %d, w-q %d w-tot %lu (%.1f/s) w-coalesced %lu, defrag-q %u defrag-tot %lu (%.1f/s) defrag-w-tot %lu (%.1f/s)",
 			ssd->name, ssd->inuse_size,
 			available_size(ssd) >> 20,
 			cf_queue_sz(ssd->free_wblock_q),
 			cf_queue_sz(ssd->swb_free_q),
 			cf_queue_sz(ssd->swb_write_q), n_total_writes, total_write_rate,
-			cf_queue_sz(ssd->defrag_wblock_q), n_defrag_reads, defrag_read_rate,
+			cf_atomic_int_get(ssd->n_coalesced_wblock_writes),
+			ssd_defrag_q_sz(ssd->defrag_wblock_q), n_defrag_reads, defrag_read_rate,
 			n_defrag_writes, defrag_write_rate);
 
+	if (ssd->ns->storage_cold_stream_ttl != 0) {
+		cf_info(AS_DRV_SSD, "device %s: stream wblocks hot %lu cold %lu defrag-hot %lu defrag-cold %lu",
+				ssd->name,
+				cf_atomic_int_get(ssd->streams[SSD_STREAM_HOT].n_wblock_writes),
+				cf_atomic_int_get(ssd->streams[SSD_STREAM_COLD].n_wblock_writes),
+				cf_atomic_int_get(ssd->streams[SSD_STREAM_DEFRAG_HOT].n_wblock_writes),
+				cf_atomic_int_get(ssd->streams[SSD_STREAM_DEFRAG_COLD].n_wblock_writes));
+	}
+
+	if (ssd->ns->storage_defrag_adaptive) {
+		cf_info(AS_DRV_SSD, "device %s: defrag-sleep %u defrag-freed %lu",
+				ssd->name, ssd->defrag_sleep,
+				cf_atomic_int_get(ssd->n_defrag_wblocks_freed));
+	}
+
 	if (ssd->shadow_name) {
 		cf_info(AS_DRV_SSD, "shadow device %s: w-q %d",
 				ssd->shadow_name, cf_queue_sz(ssd->swb_shadow_q));
@@ -2120,10 +2790,10 @@ ssd_free_swbs(drv_ssd *ssd)
 
 
 void
-ssd_flush_current_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
-		uint32_t *p_prev_size)
+ssd_flush_stream_swb(drv_ssd *ssd, ssd_write_stream *stream,
+		uint64_t *p_prev_n_writes, uint32_t *p_prev_size)
 {
-	uint64_t n_writes = cf_atomic_int_get(ssd->n_wblock_writes);
+	uint64_t n_writes = cf_atomic_int_get(stream->n_wblock_writes);
 
 	// If there's an active write load, we don't need to flush.
 	if (n_writes != *p_prev_n_writes) {
@@ -2132,14 +2802,14 @@ ssd_flush_current_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
 		return;
 	}
 
-	pthread_mutex_lock(&ssd->write_lock);
+	pthread_mutex_lock(&stream->lock);
 
-	n_writes = cf_atomic_int_get(ssd->n_wblock_writes);
+	n_writes = cf_atomic_int_get(stream->n_wblock_writes);
 
 	// Must check under the lock, could be racing a current swb just queued.
 	if (n_writes != *p_prev_n_writes) {
 
-		pthread_mutex_unlock(&ssd->write_lock);
+		pthread_mutex_unlock(&stream->lock);
 
 		*p_prev_n_writes = n_writes;
 		*p_prev_size = 0;
@@ -2149,55 +2819,7 @@ ssd_flush_current_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
 	// Flush the current swb if it isn't empty, and has been written to since
 	// last flushed.
 
-	ssd_write_buf *swb = ssd->current_swb;
-
-	if (swb && swb->pos != *p_prev_size) {
-		*p_prev_size = swb->pos;
-
-		// Clean the end of the buffer before flushing.
-		if (ssd->write_block_size != swb->pos) {
-			memset(&swb->buf[swb->pos], 0, ssd->write_block_size - swb->pos);
-		}
-
-		// Flush it.
-		ssd_flush_swb(ssd, swb);
-	}
-
-	pthread_mutex_unlock(&ssd->write_lock);
-}
-
-
-void
-ssd_flush_defrag_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
-		uint32_t *p_prev_size)
-{
-	uint64_t n_writes = cf_atomic_int_get(ssd->n_defrag_wblock_writes);
-
-	// If there's an active write load, we don't need to flush.
-	if (n_writes != *p_prev_n_writes) {
-		*p_prev_n_writes = n_writes;
-		*p_prev_size = 0;
-		return;
-	}
-
-	pthread_mutex_lock(&ssd->defrag_lock);
-
-	n_writes = cf_atomic_int_get(ssd->n_defrag_wblock_writes);
-
-	// Must check under the lock, could be racing a defrag swb just queued.
-	if (n_writes != *p_prev_n_writes) {
-
-		pthread_mutex_unlock(&ssd->defrag_lock);
-
-		*p_prev_n_writes = n_writes;
-		*p_prev_size = 0;
-		return;
-	}
-
-	// Flush the defrag swb if it isn't empty, and has been written to since
-	// last flushed.
-
-	ssd_write_buf *swb = ssd->defrag_swb;
+	ssd_write_buf *swb = stream->swb;
 
 	if (swb && swb->pos != *p_prev_size) {
 		*p_prev_size = swb->pos;
@@ -2211,7 +2833,7 @@ ssd_flush_defrag_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
 		ssd_flush_swb(ssd, swb);
 	}
 
-	pthread_mutex_unlock(&ssd->defrag_lock);
+	pthread_mutex_unlock(&stream->lock);
 }
 
 
@@ -2253,7 +2875,7 @@ ssd_defrag_sweep(drv_ssd *ssd)
 				p_wblock_state->state != WBLOCK_STATE_DEFRAG &&
 					inuse_sz != 0 &&
 						inuse_sz < ssd->ns->defrag_lwm_size) {
-			push_wblock_to_defrag_q(ssd, wblock_id);
+			push_wblock_to_defrag_q(ssd, wblock_id, inuse_sz);
 			n_queued++;
 		}
 
@@ -2265,6 +2887,194 @@ ssd_defrag_sweep(drv_ssd *ssd)
 }
 
 
+// Re-read a record whose checksum failed during a scrub, with the record
+// locked so it can't be moved or replaced under us. Returns true if the record
+// is current and really is corrupt on the device.
+static bool
+ssd_scrub_confirm_record(drv_ssd *ssd, const cf_digest *keyd,
+		uint64_t rblock_id)
+{
+	as_namespace *ns = ssd->ns;
+	as_partition_reservation rsv;
+	as_partition_id pid = as_partition_getid(*keyd);
+
+	as_partition_reserve_migrate(ns, pid, &rsv, 0);
+	cf_atomic_int_incr(&g_config.ssdr_tree_count);
+
+	as_index_ref r_ref;
+	r_ref.skip_lock = false;
+
+	bool found = 0 == as_record_get(rsv.tree, (cf_digest*)keyd, &r_ref, ns);
+
+	if (ns->ldt_enabled && ! found) {
+		found = 0 == as_record_get(rsv.sub_tree, (cf_digest*)keyd, &r_ref, ns);
+	}
+
+	bool corrupt = false;
+
+	if (found) {
+		as_index *r = r_ref.r;
+
+		if (r->storage_key.ssd.file_id == ssd->file_id &&
+				r->storage_key.ssd.rblock_id == rblock_id) {
+			uint64_t record_offset = RBLOCKS_TO_BYTES(rblock_id);
+			uint64_t record_size = RBLOCKS_TO_BYTES(r->storage_key.ssd.n_rblocks);
+			uint64_t read_offset = BYTES_DOWN_TO_IO_MIN(ssd, record_offset);
+			size_t read_size = BYTES_UP_TO_IO_MIN(ssd,
+					record_offset + record_size) - read_offset;
+			uint8_t *read_buf = cf_valloc(read_size);
+
+			if (read_buf) {
+				int fd = ssd_fd_get(ssd);
+
+				ssize_t rv = pread(fd, read_buf, read_size,
+						(off_t)read_offset);
+
+				ssd_fd_put(ssd, fd);
+
+				drv_ssd_block *block = (drv_ssd_block*)
+						(read_buf + (record_offset - read_offset));
+
+				corrupt = rv == (ssize_t)read_size &&
+						block->magic == SSD_BLOCK_MAGIC &&
+						(uint64_t)block->length + LENGTH_BASE <= record_size &&
+						! ssd_block_checksum_ok(block);
+
+				cf_free(read_buf);
+			}
+		}
+
+		as_record_done(&r_ref, ns);
+	}
+
+	as_partition_release(&rsv);
+	cf_atomic_int_decr(&g_config.ssdr_tree_count);
+
+	return corrupt;
+}
+
+
+// Verify the checksums of all records in a wblock. The wblock isn't locked, so
+// it may be freed and rewritten while we read it - failures are confirmed
+// against the index before being reported. Returns number of bad records.
+static uint32_t
+ssd_scrub_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf)
+{
+	ssd_wblock_state *p_wblock_state = &ssd->alloc_table->wblock_state[wblock_id];
+
+	if (p_wblock_state->swb || p_wblock_state->state == WBLOCK_STATE_DEFRAG ||
+			cf_atomic32_get(p_wblock_state->inuse_sz) == 0) {
+		return 0;
+	}
+
+	if (! ssd_read_wblock(ssd, wblock_id, read_buf)) {
+		return 0;
+	}
+
+	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
+	size_t wblock_offset = 0;
+	uint32_t n_bad = 0;
+
+	while (wblock_offset < ssd->write_block_size) {
+		drv_ssd_block *block = (drv_ssd_block*)&read_buf[wblock_offset];
+
+		if (block->magic != SSD_BLOCK_MAGIC) {
+			wblock_offset += RBLOCK_SIZE;
+			continue;
+		}
+
+		size_t next_wblock_offset = wblock_offset +
+				BYTES_TO_RBLOCK_BYTES(block->length + LENGTH_BASE);
+
+		if (next_wblock_offset > ssd->write_block_size) {
+			break;
+		}
+
+		uint64_t rblock_id = BYTES_TO_RBLOCKS(file_offset + wblock_offset);
+
+		if (! ssd_block_checksum_ok(block) &&
+				ssd_scrub_confirm_record(ssd, &block->keyd, rblock_id)) {
+			cf_warning_digest(AS_DRV_SSD, &block->keyd, "device %s scrub: checksum mismatch on wblock %u offset %lu ",
+					ssd->name, wblock_id, wblock_offset);
+			cf_atomic64_incr(&ssd->ns->n_storage_checksum_errors);
+			n_bad++;
+
+			// Replace the corrupt copy with the best copy on the other
+			// replicas. LDT records are only reported.
+			if (! ssd->ns->ldt_enabled &&
+					as_partition_balance_is_multi_node_cluster()) {
+				cf_digest keyd = block->keyd;
+
+				as_write_queue_repair(ssd->ns, &keyd);
+			}
+		}
+
+		wblock_offset = next_wblock_offset;
+	}
+
+	return n_bad;
+}
+
+
+// Thread "run" function to continuously verify a device's record checksums.
+// Bad records are replaced from the other replicas, if there are any. Until
+// then, a client read of one fails.
+void*
+run_scrub(void *pv_data)
+{
+	drv_ssd *ssd = (drv_ssd*)pv_data;
+	uint8_t *read_buf = cf_valloc(ssd->write_block_size);
+
+	if (! read_buf) {
+		cf_crash(AS_DRV_SSD, "device %s: scrub valloc failed", ssd->name);
+	}
+
+	uint32_t first_id = BYTES_TO_WBLOCK_ID(ssd, ssd->header_size);
+	uint32_t wblock_id = first_id;
+	uint32_t n_bad = 0;
+
+	while (true) {
+		uint32_t sleep_us = ssd->ns->storage_scrub_sleep;
+
+		if (sleep_us == 0) {
+			// Scrubbing is off - check again later.
+			sleep(1);
+			continue;
+		}
+
+		n_bad += ssd_scrub_wblock(ssd, wblock_id, read_buf);
+
+		if (++wblock_id == ssd->alloc_table->n_wblocks) {
+			cf_info(AS_DRV_SSD, "device %s: scrub pass complete - %u bad records",
+					ssd->name, n_bad);
+
+			wblock_id = first_id;
+			n_bad = 0;
+		}
+
+		usleep(sleep_us);
+	}
+
+	cf_free(read_buf);
+
+	return NULL;
+}
+
+
+static void
+ssd_start_scrub_threads(drv_ssds *ssds)
+{
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		drv_ssd *ssd = &ssds->ssds[i];
+
+		if (pthread_create(&ssd->scrub_thread, NULL, run_scrub,
+				(void*)ssd) != 0) {
+			cf_crash(AS_DRV_SSD, "%s scrub thread failed", ssd->name);
+		}
+	}
+}
+
+
 static inline uint64_t
 next_time(uint64_t now, uint64_t job_interval, uint64_t next)
 {
@@ -2290,10 +3100,8 @@ run_ssd_maintenance(void *udata)
 	uint64_t prev_n_defrag_reads = 0;
 	uint64_t prev_n_defrag_writes = 0;
 
-	uint64_t prev_n_writes_flush = 0;
-	uint32_t prev_size_flush = 0;
-	uint64_t prev_n_writes_defrag_flush = 0;
-	uint32_t prev_size_defrag_flush = 0;
+	uint64_t prev_n_writes_flush[SSD_N_STREAMS] = { 0 };
+	uint32_t prev_size_flush[SSD_N_STREAMS] = { 0 };
 
 	uint64_t now = cf_getus();
 	uint64_t next = now + MAX_INTERVAL;
@@ -2301,7 +3109,6 @@ run_ssd_maintenance(void *udata)
 	uint64_t prev_log_stats = now;
 	uint64_t prev_free_swbs = now;
 	uint64_t prev_flush = now;
-	uint64_t prev_defrag_flush = now;
 	uint64_t prev_fsync = now;
 
 	// If any job's (initial) interval is less than MAX_INTERVAL and we want it
@@ -2332,14 +3139,12 @@ run_ssd_maintenance(void *udata)
 		uint64_t flush_max_us = ns->storage_flush_max_us;
 
 		if (flush_max_us != 0 && now >= prev_flush + flush_max_us) {
-			ssd_flush_current_swb(ssd, &prev_n_writes_flush, &prev_size_flush);
-			prev_flush = now;
-			next = next_time(now, flush_max_us, next);
-		}
+			for (int i = 0; i < SSD_N_STREAMS; i++) {
+				ssd_flush_stream_swb(ssd, &ssd->streams[i],
+						&prev_n_writes_flush[i], &prev_size_flush[i]);
+			}
 
-		if (flush_max_us != 0 && now >= prev_defrag_flush + flush_max_us) {
-			ssd_flush_defrag_swb(ssd, &prev_n_writes_defrag_flush, &prev_size_defrag_flush);
-			prev_defrag_flush = now;
+			prev_flush = now;
 			next = next_time(now, flush_max_us, next);
 		}
 
@@ -2620,7 +3425,62 @@ as_storage_write_header(drv_ssd *ssd, ssd_device_header *header, size_t size)
 				ssd->shadow_name, errno, cf_strerror(errno));
 	}
 
-	ssd_shadow_fd_put(ssd, fd);
+	ssd_shadow_fd_put(ssd, fd);
+}
+
+
+// Read the device headers before the storage engine is set up. Returns false
+// unless all configured devices have valid headers for this namespace with the
+// same signature, which is returned in *random.
+bool
+as_storage_peek_random_ssd(as_namespace *ns, uint64_t *random)
+{
+	char **names = ns->storage_devices[0] ?
+			ns->storage_devices : ns->storage_files;
+	int max_names = ns->storage_devices[0] ?
+			AS_STORAGE_MAX_DEVICES : AS_STORAGE_MAX_FILES;
+	uint16_t devices_n = 0;
+	int n_names;
+
+	for (n_names = 0; n_names < max_names && names[n_names]; n_names++) {
+		int fd = open(names[n_names], O_RDONLY);
+
+		if (fd == -1) {
+			cf_warning(AS_DRV_SSD, "%s: can't open to peek header: errno %d (%s)",
+					names[n_names], errno, cf_strerror(errno));
+			return false;
+		}
+
+		ssd_device_header header;
+		ssize_t sz = pread(fd, &header, sizeof(header), 0);
+
+		close(fd);
+
+		if (sz != (ssize_t)sizeof(header) || header.magic != SSD_HEADER_MAGIC ||
+				header.version != SSD_VERSION ||
+				strncmp(header.namespace, ns->name,
+						sizeof(header.namespace)) != 0) {
+			return false;
+		}
+
+		if (n_names == 0) {
+			*random = header.random;
+			devices_n = header.devices_n;
+		}
+		else if (header.random != *random || header.devices_n != devices_n) {
+			return false;
+		}
+	}
+
+	return n_names != 0 && devices_n == n_names;
+}
+
+
+// Current signature of the namespace's devices.
+uint64_t
+as_storage_random_ssd(as_namespace *ns)
+{
+	return ((drv_ssds*)ns->storage_private)->header->random;
 }
 
 
@@ -2770,7 +3630,7 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 		// Record already existed. Ignore this one if existing record is newer.
 		if (prefer_existing_record(ssd, wblock_id, block, r)) {
 			as_record_done(&r_ref, ns);
-			ssd->record_add_older_counter++;
+			cf_atomic64_incr(&ssd->record_add_older_counter);
 			return -1;
 		}
 	}
@@ -2802,7 +3662,7 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 
 			as_index_delete(p_partition->vp, &block->keyd);
 			as_record_done(&r_ref, ns);
-			ssd->record_add_expired_counter++;
+			cf_atomic64_incr(&ssd->record_add_expired_counter);
 			return -1;
 		}
 
@@ -2812,7 +3672,7 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 					r->void_time, ns->cold_start_max_void_time);
 
 			r->void_time = ns->cold_start_max_void_time;
-			ssd->record_add_max_ttl_counter++;
+			cf_atomic64_incr(&ssd->record_add_max_ttl_counter);
 		}
 	}
 
@@ -2988,18 +3848,20 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 		ssd_block_free(&ssds->ssds[r->storage_key.ssd.file_id],
 				r->storage_key.ssd.rblock_id, r->storage_key.ssd.n_rblocks,
 				"record-add");
-		ssd->record_add_replace_counter++;
+		cf_atomic64_incr(&ssd->record_add_replace_counter);
 	}
 	else {
-		ssd->record_add_unique_counter++;
+		cf_atomic64_incr(&ssd->record_add_unique_counter);
 	}
 
-	// Update storage accounting to include this record.
+	// Update storage accounting to include this record. (Atomic - a device
+	// is swept by several load workers.)
 	// TODO - pass in size instead of n_rblocks.
 	uint32_t size = (uint32_t)RBLOCKS_TO_BYTES(n_rblocks);
 
-	ssd->inuse_size += size;
-	ssd->alloc_table->wblock_state[wblock_id].inuse_sz += size;
+	cf_atomic64_add(&ssd->inuse_size, (int64_t)size);
+	cf_atomic32_add(&ssd->alloc_table->wblock_state[wblock_id].inuse_sz,
+			(int32_t)size);
 
 	// Set/reset the record's storage information.
 	r->storage_key.ssd.file_id = ssd->file_id;
@@ -3017,6 +3879,345 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 }
 
 
+//------------------------------------------------
+// Cold start sweep pipeline. One reader per device
+// reads ahead and hands each LOAD_BUF_SIZE buffer to
+// all the device's load workers. Each worker scans
+// every buffer but only indexes records in its own
+// partitions, so a digest's versions are always
+// added by the same worker, in device order.
+//
+
+#define MAX_LOAD_WORKERS	32
+#define MAX_LOAD_READ_AHEAD	64
+
+typedef struct load_buf_s {
+	uint8_t			*buf;
+	off_t			file_offset;
+	cf_atomic32		n_users;	// workers not yet done with buf
+	cf_ioring_op	op;
+} load_buf;
+
+typedef struct load_worker_s {
+	drv_ssds		*ssds;
+	drv_ssd			*ssd;
+	uint32_t		id;
+	uint32_t		n_workers;
+	cf_queue		*buf_q;		// load_buf pointers, in device order
+	cf_queue		*free_q;	// shared - back to reader
+	pthread_t		thread;
+} load_worker;
+
+
+//------------------------------------------------
+// Records that fail checksum during cold start. The
+// sweep can't tell whether a corrupt copy is newer
+// than a good copy it has loaded (or will load), so
+// it notes the version the corrupt header claims and
+// decides after all devices are loaded. The claim is
+// part of the corrupt data, so only plausible claims
+// are noted.
+//
+
+typedef struct checksum_fail_s {
+	uint64_t	last_update_time;	// claimed by newest plausible corrupt copy
+	uint32_t	generation;			// claimed by newest plausible corrupt copy
+	uint32_t	n_copies;
+	bool		has_claim;			// false if no copy made a plausible claim
+} checksum_fail;
+
+static uint32_t
+checksum_fail_hash_fn(void *value)
+{
+	cf_digest *keyd = (cf_digest*)value;
+
+	return ((uint32_t)keyd->digest[DIGEST_SCRAMBLE_BYTE1] << 16) |
+			((uint32_t)keyd->digest[DIGEST_SCRAMBLE_BYTE2] << 8) |
+			(uint32_t)keyd->digest[DIGEST_SCRAMBLE_BYTE3];
+}
+
+
+// Is the version with this last-update-time and generation older than r?
+// Same ordering as prefer_existing_record().
+static inline bool
+version_older_than_record(uint64_t last_update_time, uint32_t generation,
+		const as_index *r)
+{
+	if (last_update_time != 0 && r->last_update_time != 0 &&
+			last_update_time != r->last_update_time) {
+		return last_update_time < r->last_update_time;
+	}
+
+	return generation == r->generation ||
+			as_gen_less_than(generation, r->generation);
+}
+
+
+// Could a record really have been written with this header? A flipped high bit
+// in the last-update-time or generation usually fails this.
+static inline bool
+checksum_fail_claim_plausible(const drv_ssd_block *block, uint64_t now)
+{
+	return block->last_update_time != 0 && block->last_update_time <= now &&
+			block->generation != 0 && block->magic == SSD_BLOCK_MAGIC;
+}
+
+
+static void
+ssd_note_checksum_fail(drv_ssds *ssds, const drv_ssd_block *block)
+{
+	// Header fields are covered by the checksum too, so these are only the
+	// corrupt copy's claims - the digest may itself be wrong.
+	cf_digest keyd = block->keyd;
+	bool plausible = checksum_fail_claim_plausible(block,
+			cf_clepoch_milliseconds());
+	checksum_fail cf;
+
+	pthread_mutex_lock(&ssds->checksum_fail_lock);
+
+	if (shash_get(ssds->checksum_fail_hash, &keyd, &cf) != SHASH_OK) {
+		cf.last_update_time = 0;
+		cf.generation = 0;
+		cf.n_copies = 0;
+		cf.has_claim = false;
+	}
+
+	if (plausible && (! cf.has_claim ||
+			block->last_update_time > cf.last_update_time ||
+			(block->last_update_time == cf.last_update_time &&
+					as_gen_less_than(cf.generation, block->generation)))) {
+		cf.last_update_time = block->last_update_time;
+		cf.generation = block->generation;
+		cf.has_claim = true;
+	}
+
+	cf.n_copies++;
+
+	shash_put(ssds->checksum_fail_hash, &keyd, &cf);
+
+	pthread_mutex_unlock(&ssds->checksum_fail_lock);
+}
+
+
+typedef struct checksum_fail_resolve_s {
+	as_namespace	*ns;
+	uint64_t		n_dropped;
+	uint64_t		n_older_loaded;
+} checksum_fail_resolve;
+
+static int
+checksum_fail_resolve_reduce_fn(void *key, void *data, void *udata)
+{
+	cf_digest *keyd = (cf_digest*)key;
+	checksum_fail *cf = (checksum_fail*)data;
+	checksum_fail_resolve *cfr = (checksum_fail_resolve*)udata;
+	as_namespace *ns = cfr->ns;
+	as_partition *p_partition = &ns->partitions[as_partition_getid(*keyd)];
+
+	as_index_ref r_ref;
+	r_ref.skip_lock = false;
+
+	if (as_record_get(p_partition->vp, keyd, &r_ref, ns) != 0) {
+		// Either no good copy, or an LDT subrecord - nothing stale to drop.
+		cf_detail_digest(AS_DRV_SSD, keyd, "{%s} checksum failed for %u copies - no other copy loaded ",
+				ns->name, cf->n_copies);
+		return 0;
+	}
+
+	as_index *r = r_ref.r;
+	uint64_t loaded_lut = r->last_update_time;
+	uint32_t loaded_gen = r->generation;
+
+	if (! cf->has_claim) {
+		as_record_done(&r_ref, ns);
+
+		cf_warning_digest(AS_DRV_SSD, keyd, "{%s} checksum failed for %u copies with implausible headers - kept loaded copy gen %u lut %lu ",
+				ns->name, cf->n_copies, loaded_gen, loaded_lut);
+		return 0;
+	}
+
+	if (! version_older_than_record(cf->last_update_time, cf->generation, r)) {
+		as_record_done(&r_ref, ns);
+
+		if (ns->storage_load_older_on_checksum_error) {
+			cf_warning_digest(AS_DRV_SSD, keyd, "{%s} checksum failed on copy claiming gen %u lut %lu - kept loaded copy gen %u lut %lu ",
+					ns->name, cf->generation, cf->last_update_time, loaded_gen,
+					loaded_lut);
+			cfr->n_older_loaded++;
+			return 0;
+		}
+
+		// Destructor frees the storage and adjusts stats.
+		as_index_delete(p_partition->vp, keyd);
+
+		cf_warning_digest(AS_DRV_SSD, keyd, "{%s} checksum failed on copy claiming gen %u lut %lu - dropped older copy gen %u lut %lu ",
+				ns->name, cf->generation, cf->last_update_time, loaded_gen,
+				loaded_lut);
+		cfr->n_dropped++;
+		return 0;
+	}
+
+	as_record_done(&r_ref, ns);
+
+	cf_detail_digest(AS_DRV_SSD, keyd, "{%s} checksum failed on copy claiming gen %u lut %lu - loaded newer copy gen %u lut %lu ",
+			ns->name, cf->generation, cf->last_update_time, loaded_gen,
+			loaded_lut);
+
+	return 0;
+}
+
+
+// Called once all devices are loaded. By default the loaded copy is kept even if
+// a corrupt copy claims to be newer - the claim failed the checksum too. With
+// load-older-on-checksum-error false, a record whose newest plausible copy is
+// corrupt is dropped instead, and migration restores it if a replica has it.
+static void
+ssd_resolve_checksum_fails(drv_ssds *ssds)
+{
+	checksum_fail_resolve cfr = { .ns = ssds->ns };
+
+	shash_reduce(ssds->checksum_fail_hash, checksum_fail_resolve_reduce_fn,
+			&cfr);
+
+	if (cfr.n_dropped != 0 || cfr.n_older_loaded != 0) {
+		cf_warning(AS_DRV_SSD, "{%s} checksum errors: dropped %lu records, kept older copies of %lu records",
+				ssds->ns->name, cfr.n_dropped, cfr.n_older_loaded);
+	}
+
+	shash_destroy(ssds->checksum_fail_hash);
+	ssds->checksum_fail_hash = NULL;
+	pthread_mutex_destroy(&ssds->checksum_fail_lock);
+}
+
+
+// Index the records in a buffer that belong to this worker's partitions.
+static void
+ssd_load_buf_records(load_worker *lw, load_buf *lb)
+{
+	drv_ssds *ssds = lw->ssds;
+	drv_ssd *ssd = lw->ssd;
+	size_t block_offset = 0; // current offset within the 1M block, in bytes
+
+	while (block_offset < LOAD_BUF_SIZE) {
+		drv_ssd_block *block = (drv_ssd_block*)&lb->buf[block_offset];
+
+		// Look for record magic.
+		if (block->magic != SSD_BLOCK_MAGIC) {
+			// No record found here.
+			// (Includes normal case of nothing ever written here).
+			block_offset += RBLOCK_SIZE;
+			continue;
+		}
+
+		// Note - if block->length is sane, we don't need to round up to a
+		// multiple of RBLOCK_SIZE, but let's do it anyway just to be safe.
+		size_t next_block_offset = block_offset +
+				BYTES_TO_RBLOCK_BYTES(block->length + LENGTH_BASE);
+
+		// Sanity-check for 1M block overruns.
+		// TODO - check write_block_size boundaries!
+		if (next_block_offset > LOAD_BUF_SIZE) {
+			if (lw->id == 0) {
+				cf_warning(AS_DRV_SSD, "error: block extends over read size: foff %"PRIu64" boff %"PRIu64" blen %"PRIu64,
+						lb->file_offset, block_offset, (uint64_t)block->length);
+			}
+
+			return;
+		}
+
+		uint64_t file_offset = lb->file_offset;
+
+		if (as_partition_getid(block->keyd) % lw->n_workers != lw->id) {
+			block_offset = next_block_offset;
+			continue;
+		}
+
+		// Skip corrupt records - whether an older copy may stand in for them
+		// is decided once all devices are loaded.
+		if (! ssd_block_checksum_ok(block)) {
+			cf_warning_digest(AS_DRV_SSD, &block->keyd, "device %s: checksum mismatch at offset %lu - skipping record ",
+					ssd->name, file_offset + block_offset);
+			cf_atomic64_incr(&ssds->ns->n_storage_checksum_errors);
+			ssd_note_checksum_fail(ssds, block);
+			block_offset = next_block_offset;
+			continue;
+		}
+
+		drv_ssd_block *flat_block = NULL;
+
+		if (block->compression != COMPRESSION_NONE &&
+				! (flat_block = ssd_decompress_block(ssds->ns, block))) {
+			block_offset = next_block_offset;
+			continue;
+		}
+
+		// Found a record - try to add it to the index.
+		int add_rv = ssd_record_add(ssds, ssd, flat_block ? flat_block : block,
+				BYTES_TO_RBLOCKS(file_offset + block_offset),
+				(uint32_t)BYTES_TO_RBLOCKS(next_block_offset - block_offset));
+
+		if (flat_block) {
+			cf_free(flat_block);
+		}
+
+		if (add_rv == -2) {
+			cf_crash(AS_DRV_SSD, "hit stop-writes limit before drive scan completed");
+		}
+
+		// Note - unparseable records (-3) are just skipped.
+
+		block_offset = next_block_offset;
+	}
+}
+
+
+// Thread "run" function to index records from buffers read by the sweep.
+static void*
+run_load_worker(void *udata)
+{
+	load_worker *lw = (load_worker*)udata;
+
+#ifdef USE_JEM
+	// Allocate long-term storage in this namespace's JEMalloc arena.
+	jem_set_arena(lw->ssds->ns->jem_arena);
+#endif
+
+	load_buf *lb;
+
+	while (cf_queue_pop(lw->buf_q, &lb, CF_QUEUE_FOREVER) == CF_QUEUE_OK) {
+		if (! lb) {
+			break;
+		}
+
+		ssd_load_buf_records(lw, lb);
+
+		// Last worker done with the buffer gives it back to the reader.
+		if (cf_atomic32_decr(&lb->n_users) == 0) {
+			cf_atomic32_incr(&lw->ssd->cold_start_block_counter);
+			cf_queue_push(lw->free_q, &lb);
+		}
+	}
+
+	return NULL;
+}
+
+
+static uint32_t
+ssd_n_load_workers(drv_ssds *ssds)
+{
+	uint32_t n_workers = ssds->ns->storage_cold_start_threads;
+
+	if (n_workers == 0) {
+		// Spread the CPUs across the namespace's devices.
+		long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		n_workers = n_cpus > ssds->n_ssds ? (uint32_t)(n_cpus / ssds->n_ssds) : 1;
+	}
+
+	return n_workers > MAX_LOAD_WORKERS ? MAX_LOAD_WORKERS : n_workers;
+}
+
+
 // Sweep through storage devices and rebuild the index.
 //
 // If there are LDT records the sweep is done twice, once for LDT parent records
@@ -3024,48 +4225,122 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 int
 ssd_load_device_sweep(drv_ssds *ssds, drv_ssd *ssd)
 {
-	uint8_t *buf = cf_valloc(LOAD_BUF_SIZE);
+	uint32_t n_workers = ssd_n_load_workers(ssds);
+	uint32_t read_ahead = ssds->ns->storage_io_depth;
 
-	bool read_shadow = ssd->shadow_name && ! ssd->sub_sweep;
-	char *read_ssd_name = read_shadow ? ssd->shadow_name : ssd->name;
-	int fd = read_shadow ? ssd_shadow_fd_get(ssd) : ssd_fd_get(ssd);
-	int write_fd = read_shadow ? ssd_fd_get(ssd) : -1;
+	if (read_ahead > MAX_LOAD_READ_AHEAD) {
+		read_ahead = MAX_LOAD_READ_AHEAD;
+	}
 
-	// Seek past the header.
-	off_t file_offset = ssds->header->header_length;
+	// Enough buffers to keep all reads in flight while each worker holds one
+	// and has one more queued.
+	uint32_t n_bufs = read_ahead + (2 * n_workers);
+	load_buf *bufs = cf_malloc(n_bufs * sizeof(load_buf));
+	cf_queue *free_q = cf_queue_create(sizeof(load_buf*), true);
 
-	if (lseek(fd, file_offset, SEEK_SET) != file_offset) {
-		cf_warning(AS_DRV_SSD, "%s: seek failed: offset %ld: errno %d (%s)",
-				read_ssd_name, file_offset, errno, cf_strerror(errno));
-		close(fd);
-		fd = -1;
-		goto Finished;
+	if (! bufs || ! free_q) {
+		cf_crash(AS_DRV_SSD, "device %s: sweep alloc failed", ssd->name);
+	}
+
+	for (uint32_t i = 0; i < n_bufs; i++) {
+		load_buf *lb = &bufs[i];
+
+		if (! (lb->buf = cf_valloc(LOAD_BUF_SIZE))) {
+			cf_crash(AS_DRV_SSD, "device %s: sweep valloc failed", ssd->name);
+		}
+
+		cf_queue_push(free_q, &lb);
 	}
 
-	if (read_shadow && lseek(write_fd, file_offset, SEEK_SET) != file_offset) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED seek: offset %ld: errno %d (%s)",
-				ssd->name, file_offset, errno, cf_strerror(errno));
+	load_worker workers[n_workers];
+
+	for (uint32_t i = 0; i < n_workers; i++) {
+		load_worker *lw = &workers[i];
+
+		lw->ssds = ssds;
+		lw->ssd = ssd;
+		lw->id = i;
+		lw->n_workers = n_workers;
+		lw->free_q = free_q;
+
+		if (! (lw->buf_q = cf_queue_create(sizeof(load_buf*), true))) {
+			cf_crash(AS_DRV_SSD, "device %s: sweep alloc failed", ssd->name);
+		}
+
+		if (pthread_create(&lw->thread, NULL, run_load_worker, lw) != 0) {
+			cf_crash(AS_DRV_SSD, "device %s: sweep worker thread failed",
+					ssd->name);
+		}
 	}
 
-	int error_count = 0;
+	cf_info(AS_DRV_SSD, "device %s: sweeping with %u load workers, read-ahead %u",
+			ssd->name, n_workers, read_ahead);
+
+	bool read_shadow = ssd->shadow_name && ! ssd->sub_sweep;
+	char *read_ssd_name = read_shadow ? ssd->shadow_name : ssd->name;
+	int fd = read_shadow ? ssd_shadow_fd_get(ssd) : ssd_fd_get(ssd);
+	int write_fd = read_shadow ? ssd_fd_get(ssd) : -1;
+
+	// Start past the header.
+	off_t file_offset = ssds->header->header_length;
+	off_t next_read_offset = file_offset;
 
 	ssd->cold_start_block_counter = file_offset / LOAD_BUF_SIZE;
+	ssd->cold_start_start_ms = cf_getms();
+
+	load_buf *pending[MAX_LOAD_READ_AHEAD];
+	uint32_t n_pending = 0;
+	uint32_t pending_head = 0;
+	int empty_count = 0;
+	bool stop = false;
 
 	// Loop over all blocks in device.
 	while (true) {
-		ssize_t rlen = read(fd, buf, LOAD_BUF_SIZE);
+		// Keep read-ahead full, unless we're winding down.
+		while (! stop && n_pending < read_ahead &&
+				next_read_offset + LOAD_BUF_SIZE <= ssd->file_size) {
+			load_buf *lb;
+
+			cf_queue_pop(free_q, &lb, CF_QUEUE_FOREVER);
+
+			lb->file_offset = next_read_offset;
+			cf_ioring_read_submit(ssd->ioring, &lb->op, fd, lb->buf,
+					LOAD_BUF_SIZE, next_read_offset);
+
+			pending[(pending_head + n_pending) % MAX_LOAD_READ_AHEAD] = lb;
+			n_pending++;
+			next_read_offset += LOAD_BUF_SIZE;
+		}
+
+		if (n_pending == 0) {
+			break;
+		}
+
+		load_buf *lb = pending[pending_head];
+
+		pending_head = (pending_head + 1) % MAX_LOAD_READ_AHEAD;
+		n_pending--;
+
+		ssize_t rlen = cf_ioring_wait(&lb->op);
+
+		if (stop) {
+			// Draining reads issued before we stopped.
+			cf_queue_push(free_q, &lb);
+			continue;
+		}
 
 		if (rlen != LOAD_BUF_SIZE) {
 			cf_warning(AS_DRV_SSD, "%s: read failed (%ld): errno %d (%s)",
 					read_ssd_name, rlen, errno, cf_strerror(errno));
-			close(fd);
-			fd = -1;
-			goto Finished;
+			cf_queue_push(free_q, &lb);
+			stop = true;
+			continue;
 		}
 
 		if (read_shadow) {
 			// TODO - ok to always write 1Mb blocks?
-			ssize_t sz = write(write_fd, (void*)buf, LOAD_BUF_SIZE);
+			ssize_t sz = pwrite(write_fd, (void*)lb->buf, LOAD_BUF_SIZE,
+					lb->file_offset);
 
 			if (sz != LOAD_BUF_SIZE) {
 				cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: errno %d (%s)",
@@ -3073,87 +4348,61 @@ ssd_load_device_sweep(drv_ssds *ssds, drv_ssd *ssd)
 			}
 		}
 
-		size_t block_offset = 0; // current offset within the 1M block, in bytes
-
-		while (block_offset < LOAD_BUF_SIZE) {
-			drv_ssd_block *block = (drv_ssd_block*)&buf[block_offset];
-
-			// Look for record magic.
-			if (block->magic != SSD_BLOCK_MAGIC) {
-				// No record found here.
-				// (Includes normal case of nothing ever written here).
-
-				block_offset += RBLOCK_SIZE;
-
-				// We always write some at the start of a 1M block.
-				if (block_offset == RBLOCK_SIZE) {
-					error_count++;
-					goto NextBlock;
-				}
-				else {
-					// Otherwise check the next rblock, looking for magic.
-					continue;
-				}
-			}
-
-			// Note - if block->length is sane, we don't need to round up to a
-			// multiple of RBLOCK_SIZE, but let's do it anyway just to be safe.
-			size_t next_block_offset = block_offset +
-					BYTES_TO_RBLOCK_BYTES(block->length + LENGTH_BASE);
-
-			// Sanity-check for 1M block overruns.
-			// TODO - check write_block_size boundaries!
-			if (next_block_offset > LOAD_BUF_SIZE) {
-				cf_warning(AS_DRV_SSD, "error: block extends over read size: foff %"PRIu64" boff %"PRIu64" blen %"PRIu64,
-					file_offset, block_offset, (uint64_t)block->length);
+		// We always write some at the start of a 1M block. If we encounter
+		// enough 1M blocks that have no records, assume we've read all our
+		// data and we're done.
+		if (((drv_ssd_block*)lb->buf)->magic != SSD_BLOCK_MAGIC) {
+			cf_atomic32_incr(&ssd->cold_start_block_counter);
+			cf_queue_push(free_q, &lb);
 
-				error_count++;
-				goto NextBlock;
+			if (++empty_count > 10) {
+				stop = true;
 			}
 
-			// Found a record - try to add it to the index.
-			int add_rv = ssd_record_add(ssds, ssd, block,
-					BYTES_TO_RBLOCKS(file_offset + block_offset),
-					(uint32_t)BYTES_TO_RBLOCKS(next_block_offset - block_offset));
+			continue;
+		}
 
-			if (add_rv == -2) {
-				cf_crash(AS_DRV_SSD, "hit stop-writes limit before drive scan completed");
-			}
+		empty_count = 0;
 
-			if (add_rv == -3) {
-				error_count++;
-				goto NextBlock;
-			}
+		cf_atomic32_set(&lb->n_users, n_workers);
 
-			error_count = 0;
-			block_offset = next_block_offset;
+		for (uint32_t i = 0; i < n_workers; i++) {
+			cf_queue_push(workers[i].buf_q, &lb);
 		}
+	}
 
-NextBlock:
+	// A null buffer tells a worker to exit.
+	load_buf *null_lb = NULL;
 
-		// If we encounter enough 1M blocks that have no records, assume we've
-		// read all our data and we're done.
-		if (error_count > 10) {
-			goto Finished;
-		}
+	for (uint32_t i = 0; i < n_workers; i++) {
+		cf_queue_push(workers[i].buf_q, &null_lb);
+	}
 
-		file_offset += LOAD_BUF_SIZE;
-		ssd->cold_start_block_counter++;
+	for (uint32_t i = 0; i < n_workers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		cf_queue_destroy(workers[i].buf_q);
 	}
 
-Finished:
+	uint64_t elapsed_ms = cf_getms() - ssd->cold_start_start_ms;
+
+	cf_info(AS_DRV_SSD, "device %s: sweep read %lu MB in %lu ms",
+			ssd->name, (next_read_offset - file_offset) / (1024 * 1024),
+			elapsed_ms);
 
 	ssd->cold_start_block_counter = ssd->file_size / LOAD_BUF_SIZE;
 
-	if (fd != -1) {
-		read_shadow ? ssd_shadow_fd_put(ssd, fd) : ssd_fd_put(ssd, fd);
-	}
+	read_shadow ? ssd_shadow_fd_put(ssd, fd) : ssd_fd_put(ssd, fd);
 
 	if (write_fd != -1) {
 		ssd_fd_put(ssd, write_fd);
 	}
 
-	cf_free(buf);
+	for (uint32_t i = 0; i < n_bufs; i++) {
+		cf_free(bufs[i].buf);
+	}
+
+	cf_free(bufs);
+	cf_queue_destroy(free_q);
 
 	return 0;
 }
@@ -3223,6 +4472,7 @@ ssd_load_devices_fn(void *udata)
 		// All drives are done reading.
 
 		ssds->ns->cold_start_loading = false;
+		ssd_resolve_checksum_fails(ssds);
 		ssd_load_wblock_queues(ssds);
 
 		pthread_mutex_destroy(&ssds->ns->cold_start_evict_lock);
@@ -3233,6 +4483,7 @@ ssd_load_devices_fn(void *udata)
 		ssd_start_maintenance_threads(ssds);
 		ssd_start_write_worker_threads(ssds);
 		ssd_start_defrag_threads(ssds);
+		ssd_start_scrub_threads(ssds);
 	}
 
 	return 0;
@@ -3244,6 +4495,14 @@ ssd_load_devices_load(drv_ssds *ssds, cf_queue *complete_q, void *udata)
 {
 	ssds->ns->cold_start_loading = true;
 
+	pthread_mutex_init(&ssds->checksum_fail_lock, NULL);
+
+	if (shash_create(&ssds->checksum_fail_hash, checksum_fail_hash_fn,
+			sizeof(cf_digest), sizeof(checksum_fail), 1024, 0) != SHASH_OK) {
+		cf_crash(AS_DRV_SSD, "{%s} failed to create checksum fail hash",
+				ssds->ns->name);
+	}
+
 	void *p = cf_rc_alloc(1);
 
 	for (int i = 1; i < ssds->n_ssds; i++) {
@@ -3865,6 +5124,28 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 
 	ns->storage_private = (void*)ssds;
 
+	if (ns->storage_read_cache_size != 0) {
+		if (ns->storage_data_in_memory) {
+			cf_warning(AS_DRV_SSD, "{%s} data-in-memory - ignoring read-cache-size",
+					ns->name);
+		}
+		else if (! (ssds->read_cache = ssd_read_cache_create(ns,
+				ns->storage_read_cache_size))) {
+			cf_crash(AS_DRV_SSD, "{%s} can't create read cache", ns->name);
+		}
+	}
+
+	if (ns->storage_hot_tier_size != 0) {
+		if (ns->storage_data_in_memory) {
+			cf_warning(AS_DRV_SSD, "{%s} data-in-memory - ignoring hot-tier-size",
+					ns->name);
+		}
+		else if (! (ssds->hot_tier = ssd_hot_tier_create(ns,
+				ns->storage_hot_tier_size))) {
+			cf_crash(AS_DRV_SSD, "{%s} can't create hot tier", ns->name);
+		}
+	}
+
 	// Finish initializing drv_ssd structures (non-zero-value members).
 	for (int i = 0; i < ssds->n_ssds; i++) {
 		drv_ssd *ssd = &ssds->ssds[i];
@@ -3872,8 +5153,13 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 		ssd->ns = ns;
 		ssd->file_id = i;
 
-		pthread_mutex_init(&ssd->write_lock, 0);
-		pthread_mutex_init(&ssd->defrag_lock, 0);
+		for (int j = 0; j < SSD_N_STREAMS; j++) {
+			pthread_mutex_init(&ssd->streams[j].lock, 0);
+		}
+
+		ssd->write_hints = ns->storage_write_hints;
+		pthread_mutex_init(&ssd->write_hint.lock, NULL);
+		pthread_mutex_init(&ssd->shadow_write_hint.lock, NULL);
 
 		ssd->running = true;
 
@@ -3893,6 +5179,11 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 			cf_crash(AS_DRV_SSD, "can't create shadow fd queue");
 		}
 
+		if (! (ssd->ioring = cf_ioring_create(ns->storage_io_engine,
+				ns->storage_io_depth, ns->storage_io_threads))) {
+			cf_crash(AS_DRV_SSD, "%s: can't create io-engine", ssd->name);
+		}
+
 		if (! (ssd->swb_write_q = cf_queue_create(sizeof(void*), true))) {
 			cf_crash(AS_DRV_SSD, "can't create swb-write queue");
 		}
@@ -3961,6 +5252,7 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 		ssd_start_maintenance_threads(ssds);
 		ssd_start_write_worker_threads(ssds);
 		ssd_start_defrag_threads(ssds);
+		ssd_start_scrub_threads(ssds);
 	}
 
 	return 0;
@@ -3980,10 +5272,17 @@ as_storage_cold_start_ticker_ssd()
 
 			for (int j = 0; j < ssds->n_ssds; j++) {
 				drv_ssd *ssd = &ssds->ssds[j];
-				uint32_t pct = (ssd->cold_start_block_counter * 100) /
+				uint32_t n_blocks = cf_atomic32_get(ssd->cold_start_block_counter);
+				uint32_t pct = (n_blocks * 100) /
 						(ssd->file_size / LOAD_BUF_SIZE);
-
-				pos += sprintf(buf + pos, ", %s %u%%", ssd->name, pct);
+				uint64_t elapsed_ms = cf_getms() - ssd->cold_start_start_ms;
+				uint64_t header_blocks = ssd->header_size / LOAD_BUF_SIZE;
+				uint64_t mb_per_sec = n_blocks > header_blocks && elapsed_ms != 0 ?
+						((n_blocks - header_blocks) * (LOAD_BUF_SIZE / 1024) * 1000) /
+								(elapsed_ms * 1024) : 0;
+
+				pos += sprintf(buf + pos, ", %s %u%% (%lu MB/s)", ssd->name, pct,
+						mb_per_sec);
 			}
 
 			cf_info(AS_DRV_SSD, "{%s} loaded %lu records, %lu subrecords%s",
@@ -4045,6 +5344,7 @@ as_storage_record_create_ssd(as_namespace *ns, as_record *r, as_storage_rd *rd,
 	rd->u.ssd.block = 0;
 	rd->u.ssd.must_free_block = NULL;
 	rd->u.ssd.ssd = 0;
+	rd->u.ssd.hot_rec = NULL;
 
 	// Should already look like this, but ...
 	r->storage_key.ssd.file_id = STORAGE_INVALID_FILE_ID;
@@ -4064,6 +5364,7 @@ as_storage_record_open_ssd(as_namespace *ns, as_record *r, as_storage_rd *rd,
 	rd->u.ssd.block = 0;
 	rd->u.ssd.must_free_block = NULL;
 	rd->u.ssd.ssd = &ssds->ssds[r->storage_key.ssd.file_id];
+	rd->u.ssd.hot_rec = NULL;
 
 	return 0;
 }
@@ -4078,6 +5379,12 @@ as_storage_record_close_ssd(as_record *r, as_storage_rd *rd)
 		rd->u.ssd.block = NULL;
 	}
 
+	if (rd->u.ssd.hot_rec) {
+		ssd_hot_tier_release(rd->u.ssd.hot_rec);
+		rd->u.ssd.hot_rec = NULL;
+		rd->u.ssd.block = NULL;
+	}
+
 	return 0;
 }
 
@@ -4228,6 +5535,17 @@ as_storage_defrag_sweep_ssd(as_namespace *ns)
 }
 
 
+void
+as_storage_demote_hot_ssd(as_namespace *ns)
+{
+	drv_ssds* ssds = (drv_ssds*)ns->storage_private;
+
+	if (ssds->hot_tier) {
+		ssd_hot_tier_demote(ssds->hot_tier);
+	}
+}
+
+
 //==========================================================
 // Storage API implementation: data in device headers.
 //
@@ -4431,32 +5749,23 @@ as_storage_shutdown_ssd(as_namespace *ns)
 	for (int i = 0; i < ssds->n_ssds; i++) {
 		drv_ssd *ssd = &ssds->ssds[i];
 
-		// Stop the maintenance thread from (also) flushing the swbs.
-		pthread_mutex_lock(&ssd->write_lock);
-		pthread_mutex_lock(&ssd->defrag_lock);
+		for (int j = 0; j < SSD_N_STREAMS; j++) {
+			ssd_write_stream *stream = &ssd->streams[j];
 
-		// Flush current swb by pushing it to write-q.
-		if (ssd->current_swb) {
-			// Clean the end of the buffer before pushing to write-q.
-			if (ssd->write_block_size > ssd->current_swb->pos) {
-				memset(&ssd->current_swb->buf[ssd->current_swb->pos], 0,
-						ssd->write_block_size - ssd->current_swb->pos);
-			}
+			// Stop the maintenance thread from (also) flushing the swbs.
+			pthread_mutex_lock(&stream->lock);
 
-			cf_queue_push(ssd->swb_write_q, &ssd->current_swb);
-			ssd->current_swb = NULL;
-		}
+			// Flush stream's swb by pushing it to write-q.
+			if (stream->swb) {
+				// Clean the end of the buffer before pushing to write-q.
+				if (ssd->write_block_size > stream->swb->pos) {
+					memset(&stream->swb->buf[stream->swb->pos], 0,
+							ssd->write_block_size - stream->swb->pos);
+				}
 
-		// Flush defrag swb by pushing it to write-q.
-		if (ssd->defrag_swb) {
-			// Clean the end of the buffer before pushing to write-q.
-			if (ssd->write_block_size > ssd->defrag_swb->pos) {
-				memset(&ssd->defrag_swb->buf[ssd->defrag_swb->pos], 0,
-						ssd->write_block_size - ssd->defrag_swb->pos);
+				cf_queue_push(ssd->swb_write_q, &stream->swb);
+				stream->swb = NULL;
 			}
-
-			cf_queue_push(ssd->swb_write_q, &ssd->defrag_swb);
-			ssd->defrag_swb = NULL;
 		}
 	}
 
@@ -0,0 +1,484 @@
+/*
+ * drv_ssd_cache.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Read-through cache of record blocks for data-not-in-memory namespaces.
+ *
+ * Eviction is S3-FIFO, per shard. New blocks enter a small FIFO. Blocks read
+ * again before they reach its tail are promoted to the main FIFO, others are
+ * evicted but leave a "ghost" key behind. A block whose ghost is found when
+ * it's next inserted goes straight to main. Main is a CLOCK-like FIFO - hits
+ * earn blocks extra trips around. One-hit wonders (e.g. scans, migrations)
+ * therefore never displace the hot set.
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "storage/drv_ssd_cache.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+
+#include "fault.h"
+
+#include "base/datamodel.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define LOG_2_N_SHARDS		6
+#define N_SHARDS			(1 << LOG_2_N_SHARDS)
+#define SMALL_PCT			10	// small FIFO's share of each shard's bytes
+#define MAX_FREQ			3
+#define MIN_BUCKETS			1024
+#define EST_BLOCK_SIZE		1024
+
+// Don't let a single block take more than this fraction of a shard.
+#define MAX_BLOCK_SHARD_FRACTION	8
+
+typedef enum {
+	Q_SMALL,
+	Q_MAIN,
+	Q_GHOST
+} cache_q_id;
+
+typedef struct cache_entry_s {
+	uint64_t				key;
+	struct cache_entry_s	*hash_next;
+	struct cache_entry_s	*prev;		// toward queue head (newer)
+	struct cache_entry_s	*next;		// toward queue tail (older)
+	uint8_t					*data;		// NULL for ghosts
+	uint32_t				size;
+	uint8_t					q_id;
+	uint8_t					freq;
+} cache_entry;
+
+typedef struct cache_q_s {
+	cache_entry	*head;
+	cache_entry	*tail;
+	uint64_t	n_entries;
+	uint64_t	n_bytes;
+} cache_q;
+
+typedef struct cache_shard_s {
+	pthread_mutex_t	lock;
+
+	uint64_t		max_bytes;
+	uint64_t		small_max_bytes;
+	uint64_t		ghost_max_entries;
+
+	uint32_t		bucket_mask;
+	cache_entry		**buckets;
+
+	cache_q			qs[3];	// indexed by cache_q_id
+} __attribute__ ((aligned(64))) cache_shard;
+
+struct ssd_read_cache_s {
+	as_namespace	*ns;
+	uint32_t		max_block_size;
+	cache_shard		shards[N_SHARDS];
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static inline uint64_t cache_key(uint32_t file_id, uint64_t rblock_id);
+static inline cache_shard* key_shard(ssd_read_cache* cache, uint64_t key);
+static inline uint32_t key_bucket(cache_shard* shard, uint64_t key);
+static cache_entry* hash_find(cache_shard* shard, uint64_t key);
+static void hash_delete(cache_shard* shard, cache_entry* e);
+static void q_push_head(cache_q* q, cache_entry* e);
+static void q_unlink(cache_q* q, cache_entry* e);
+static void entry_destroy(ssd_read_cache* cache, cache_shard* shard,
+		cache_entry* e);
+static void evict(ssd_read_cache* cache, cache_shard* shard);
+static void evict_small(ssd_read_cache* cache, cache_shard* shard);
+static void evict_main(ssd_read_cache* cache, cache_shard* shard);
+
+static inline uint64_t
+entry_bytes(uint32_t size)
+{
+	return sizeof(cache_entry) + size;
+}
+
+
+//==========================================================
+// Public API.
+//
+
+ssd_read_cache*
+ssd_read_cache_create(as_namespace* ns, uint64_t max_size)
+{
+	ssd_read_cache* cache = cf_malloc(sizeof(ssd_read_cache));
+
+	if (! cache) {
+		return NULL;
+	}
+
+	memset(cache, 0, sizeof(ssd_read_cache));
+
+	uint64_t shard_bytes = max_size / N_SHARDS;
+	uint64_t n_buckets = MIN_BUCKETS;
+
+	while (n_buckets < shard_bytes / EST_BLOCK_SIZE) {
+		n_buckets <<= 1;
+	}
+
+	cache->ns = ns;
+	cache->max_block_size = (uint32_t)(shard_bytes / MAX_BLOCK_SHARD_FRACTION);
+
+	for (int i = 0; i < N_SHARDS; i++) {
+		cache_shard* shard = &cache->shards[i];
+
+		pthread_mutex_init(&shard->lock, NULL);
+
+		shard->max_bytes = shard_bytes;
+		shard->small_max_bytes = (shard_bytes * SMALL_PCT) / 100;
+		shard->ghost_max_entries = shard_bytes / EST_BLOCK_SIZE;
+
+		shard->bucket_mask = (uint32_t)(n_buckets - 1);
+		shard->buckets = cf_calloc(n_buckets, sizeof(cache_entry*));
+
+		if (! shard->buckets) {
+			cf_crash(AS_DRV_SSD, "{%s} failed read-cache buckets alloc",
+					ns->name);
+		}
+	}
+
+	cf_info(AS_DRV_SSD, "{%s} read-cache size %lu, %d shards, %lu buckets per shard",
+			ns->name, max_size, N_SHARDS, n_buckets);
+
+	return cache;
+}
+
+uint8_t*
+ssd_read_cache_get(ssd_read_cache* cache, uint32_t file_id,
+		uint64_t rblock_id, uint32_t size)
+{
+	uint64_t key = cache_key(file_id, rblock_id);
+	cache_shard* shard = key_shard(cache, key);
+	uint8_t* buf = NULL;
+
+	pthread_mutex_lock(&shard->lock);
+
+	cache_entry* e = hash_find(shard, key);
+
+	if (e && e->q_id != Q_GHOST && e->size == size) {
+		if (e->freq < MAX_FREQ) {
+			e->freq++;
+		}
+
+		if ((buf = cf_malloc(size)) != NULL) {
+			memcpy(buf, e->data, size);
+		}
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+
+	if (buf) {
+		cf_atomic64_incr(&cache->ns->n_read_cache_hits);
+	}
+	else {
+		cf_atomic64_incr(&cache->ns->n_read_cache_misses);
+	}
+
+	return buf;
+}
+
+void
+ssd_read_cache_put(ssd_read_cache* cache, uint32_t file_id,
+		uint64_t rblock_id, const uint8_t* data, uint32_t size)
+{
+	if (size > cache->max_block_size) {
+		return;
+	}
+
+	uint8_t* copy = cf_malloc(size);
+
+	if (! copy) {
+		return;
+	}
+
+	memcpy(copy, data, size);
+
+	uint64_t key = cache_key(file_id, rblock_id);
+	cache_shard* shard = key_shard(cache, key);
+
+	pthread_mutex_lock(&shard->lock);
+
+	cache_entry* e = hash_find(shard, key);
+	cache_q_id q_id = Q_SMALL;
+
+	if (e) {
+		if (e->q_id != Q_GHOST) {
+			// Another reader beat us to it.
+			pthread_mutex_unlock(&shard->lock);
+			cf_free(copy);
+			return;
+		}
+
+		// Evicted from small recently - this time it goes to main.
+		q_unlink(&shard->qs[Q_GHOST], e);
+		q_id = Q_MAIN;
+	}
+	else {
+		if (! (e = cf_malloc(sizeof(cache_entry)))) {
+			pthread_mutex_unlock(&shard->lock);
+			cf_free(copy);
+			return;
+		}
+
+		uint32_t b = key_bucket(shard, key);
+
+		e->key = key;
+		e->hash_next = shard->buckets[b];
+		shard->buckets[b] = e;
+	}
+
+	e->data = copy;
+	e->size = size;
+	e->q_id = (uint8_t)q_id;
+	e->freq = 0;
+
+	q_push_head(&shard->qs[q_id], e);
+	cf_atomic64_add(&cache->ns->read_cache_bytes, (int64_t)entry_bytes(size));
+
+	evict(cache, shard);
+
+	pthread_mutex_unlock(&shard->lock);
+}
+
+void
+ssd_read_cache_remove(ssd_read_cache* cache, uint32_t file_id,
+		uint64_t rblock_id)
+{
+	uint64_t key = cache_key(file_id, rblock_id);
+	cache_shard* shard = key_shard(cache, key);
+
+	pthread_mutex_lock(&shard->lock);
+
+	cache_entry* e = hash_find(shard, key);
+
+	if (e) {
+		entry_destroy(cache, shard, e);
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+}
+
+
+//==========================================================
+// Local helpers - hashing.
+//
+
+static inline uint64_t
+cache_key(uint32_t file_id, uint64_t rblock_id)
+{
+	return ((uint64_t)file_id << 40) | rblock_id;
+}
+
+static inline uint64_t
+key_hash(uint64_t key)
+{
+	// Fibonacci hashing - rblock ids are sequential, spread them out.
+	return key * 0x9E3779B97F4A7C15UL;
+}
+
+static inline cache_shard*
+key_shard(ssd_read_cache* cache, uint64_t key)
+{
+	return &cache->shards[key_hash(key) >> (64 - LOG_2_N_SHARDS)];
+}
+
+static inline uint32_t
+key_bucket(cache_shard* shard, uint64_t key)
+{
+	return (uint32_t)(key_hash(key) >> 16) & shard->bucket_mask;
+}
+
+static cache_entry*
+hash_find(cache_shard* shard, uint64_t key)
+{
+	cache_entry* e = shard->buckets[key_bucket(shard, key)];
+
+	while (e && e->key != key) {
+		e = e->hash_next;
+	}
+
+	return e;
+}
+
+static void
+hash_delete(cache_shard* shard, cache_entry* e)
+{
+	cache_entry** p_e = &shard->buckets[key_bucket(shard, e->key)];
+
+	while (*p_e != e) {
+		p_e = &(*p_e)->hash_next;
+	}
+
+	*p_e = e->hash_next;
+}
+
+
+//==========================================================
+// Local helpers - queues.
+//
+
+static void
+q_push_head(cache_q* q, cache_entry* e)
+{
+	e->prev = NULL;
+	e->next = q->head;
+
+	if (q->head) {
+		q->head->prev = e;
+	}
+	else {
+		q->tail = e;
+	}
+
+	q->head = e;
+	q->n_entries++;
+	q->n_bytes += entry_bytes(e->size);
+}
+
+static void
+q_unlink(cache_q* q, cache_entry* e)
+{
+	if (e->prev) {
+		e->prev->next = e->next;
+	}
+	else {
+		q->head = e->next;
+	}
+
+	if (e->next) {
+		e->next->prev = e->prev;
+	}
+	else {
+		q->tail = e->prev;
+	}
+
+	q->n_entries--;
+	q->n_bytes -= entry_bytes(e->size);
+}
+
+// Remove entry from everything and free it.
+static void
+entry_destroy(ssd_read_cache* cache, cache_shard* shard, cache_entry* e)
+{
+	q_unlink(&shard->qs[e->q_id], e);
+	hash_delete(shard, e);
+
+	if (e->data) {
+		cf_atomic64_sub(&cache->ns->read_cache_bytes,
+				(int64_t)entry_bytes(e->size));
+		cf_free(e->data);
+	}
+
+	cf_free(e);
+}
+
+
+//==========================================================
+// Local helpers - S3-FIFO eviction.
+//
+
+static void
+evict(ssd_read_cache* cache, cache_shard* shard)
+{
+	cache_q* small_q = &shard->qs[Q_SMALL];
+	cache_q* main_q = &shard->qs[Q_MAIN];
+
+	while (small_q->n_bytes + main_q->n_bytes > shard->max_bytes) {
+		if (small_q->n_bytes > shard->small_max_bytes || ! main_q->tail) {
+			evict_small(cache, shard);
+		}
+		else {
+			evict_main(cache, shard);
+		}
+	}
+
+	cache_q* ghost_q = &shard->qs[Q_GHOST];
+
+	while (ghost_q->n_entries > shard->ghost_max_entries) {
+		entry_destroy(cache, shard, ghost_q->tail);
+	}
+}
+
+static void
+evict_small(ssd_read_cache* cache, cache_shard* shard)
+{
+	cache_q* small_q = &shard->qs[Q_SMALL];
+	cache_entry* e = small_q->tail;
+
+	q_unlink(small_q, e);
+
+	if (e->freq != 0) {
+		// Read again while in small - promote to main.
+		e->q_id = Q_MAIN;
+		e->freq = 0;
+		q_push_head(&shard->qs[Q_MAIN], e);
+		return;
+	}
+
+	// Leave a ghost behind - sized 0 so it doesn't count against our bytes.
+	cf_atomic64_sub(&cache->ns->read_cache_bytes,
+			(int64_t)entry_bytes(e->size));
+	cf_atomic64_incr(&cache->ns->n_read_cache_evictions);
+
+	cf_free(e->data);
+	e->data = NULL;
+	e->size = 0;
+	e->q_id = Q_GHOST;
+
+	q_push_head(&shard->qs[Q_GHOST], e);
+}
+
+static void
+evict_main(ssd_read_cache* cache, cache_shard* shard)
+{
+	cache_q* main_q = &shard->qs[Q_MAIN];
+	cache_entry* e;
+
+	// Bounded - each trip around decrements freq.
+	while ((e = main_q->tail)->freq != 0) {
+		q_unlink(main_q, e);
+		e->freq--;
+		q_push_head(main_q, e);
+	}
+
+	cf_atomic64_incr(&cache->ns->n_read_cache_evictions);
+	entry_destroy(cache, shard, e);
+}
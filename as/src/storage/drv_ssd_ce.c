@@ -21,11 +21,133 @@
  */
 
 #include "storage/drv_ssd.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "citrusleaf/cf_atomic.h"
+
 #include "fault.h"
+#include "vmapx.h"
+
+#include "base/datamodel.h"
+#include "base/index.h"
+#include "base/ldt.h"
+
+
+typedef struct resume_info_s {
+	drv_ssds		*ssds;
+	as_partition	*p;
+	uint64_t		n_records;
+} resume_info;
+
+
+// Redo a loaded record's accounting, as ssd_record_add() would on cold start.
+static void
+resume_record(as_index *r, void *udata)
+{
+	resume_info *ri = (resume_info*)udata;
+	drv_ssds *ssds = ri->ssds;
+	as_namespace *ns = ssds->ns;
+
+	// References held when the snapshot was written are long gone. (The tree's
+	// element counts are rebuilt by as_index_reduce_sync() itself.)
+	r->rc = 1;
+	ri->n_records++;
+
+	if (as_ldt_record_is_sub(r)) {
+		cf_atomic_int_incr(&ns->n_sub_objects);
+	}
+	else {
+		cf_atomic_int_incr(&ns->n_objects);
+	}
+
+	uint16_t set_id = as_index_get_set_id(r);
+	as_set *p_set;
+
+	if (set_id != INVALID_SET_ID &&
+			cf_vmapx_get_by_index(ns->p_sets_vmap, set_id - 1,
+					(void**)&p_set) == CF_VMAPX_OK) {
+		cf_atomic64_incr(&p_set->num_elements);
+	}
+
+	cf_atomic_int_setmax(&ri->p->max_void_time, r->void_time);
+	cf_atomic_int_setmax(&ns->max_void_time, r->void_time);
+
+	if (r->storage_key.ssd.file_id >= ssds->n_ssds) {
+		cf_crash(AS_DRV_SSD, "ns %s resumed record has bad file-id %u",
+				ns->name, r->storage_key.ssd.file_id);
+	}
+
+	drv_ssd *ssd = &ssds->ssds[r->storage_key.ssd.file_id];
+	uint32_t wblock_id = RBLOCK_ID_TO_WBLOCK_ID(ssd,
+			r->storage_key.ssd.rblock_id);
+	uint32_t size = (uint32_t)RBLOCKS_TO_BYTES(r->storage_key.ssd.n_rblocks);
 
+	if (wblock_id >= ssd->alloc_table->n_wblocks) {
+		cf_crash(AS_DRV_SSD, "ns %s resumed record has bad rblock-id %lu",
+				ns->name, (uint64_t)r->storage_key.ssd.rblock_id);
+	}
+
+	cf_atomic64_add(&ssd->inuse_size, (int64_t)size);
+	cf_atomic32_add(&ssd->alloc_table->wblock_state[wblock_id].inuse_sz,
+			(int32_t)size);
+	cf_atomic64_incr(&ssd->record_add_unique_counter);
+}
+
+
+static void
+resume_tree(drv_ssds *ssds, as_partition *p, as_index_tree *tree,
+		uint64_t *p_n_records)
+{
+	resume_info ri = {
+			.ssds = ssds,
+			.p = p,
+			.n_records = 0
+	};
+
+	as_index_reduce_sync(tree, resume_record, &ri);
+
+	*p_n_records += ri.n_records;
+}
+
+
+// Warm restart from an index snapshot - imitate device loading by reducing the
+// resumed index to rebuild object counts and storage accounting.
 void
 ssd_resume_devices(drv_ssds *ssds)
 {
-	// Should not get here - for enterprise version only.
-	cf_crash(AS_DRV_SSD, "cold start called ssd_resume_devices()");
+	as_namespace *ns = ssds->ns;
+	uint64_t n_records = 0;
+	uint64_t n_sub_records = 0;
+
+	for (uint32_t pid = 0; pid < AS_PARTITIONS; pid++) {
+		as_partition *p = &ns->partitions[pid];
+
+		resume_tree(ssds, p, p->vp, &n_records);
+		resume_tree(ssds, p, p->sub_vp, &n_sub_records);
+
+		// Drop partitions the devices don't have state for, as a cold start
+		// would - releasing the trees undoes the accounting above.
+		if (! ssds->get_state_from_storage[pid] &&
+				(p->vp->elements != 0 || p->sub_vp->elements != 0)) {
+			as_index_tree *t = p->vp;
+			as_index_tree *sub_t = p->sub_vp;
+
+			p->vp = as_index_tree_create(ns->arena,
+					(as_index_value_destructor)&as_record_destroy, ns,
+					ns->index_engine, ns->partition_tree_sprigs,
+					as_treex_get(ns->tree_roots, ns->partition_tree_sprigs, pid));
+			p->sub_vp = as_index_tree_create(ns->arena,
+					(as_index_value_destructor)&as_record_destroy, ns,
+					ns->index_engine, ns->partition_tree_sprigs,
+					as_treex_get(ns->sub_tree_roots, ns->partition_tree_sprigs, pid));
+
+			as_index_tree_release(t, ns);
+			as_index_tree_release(sub_t, ns);
+		}
+	}
+
+	cf_info(AS_DRV_SSD, "ns %s resumed %lu records (%lu subrecords) from index snapshot",
+			ns->name, n_records, n_sub_records);
 }
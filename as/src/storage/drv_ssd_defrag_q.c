@@ -0,0 +1,270 @@
+/*
+ * drv_ssd_defrag_q.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Queue of wblocks waiting to be defragged. Wblocks are kept in FIFO buckets
+ * by in-use size when queued, and popped from the lowest occupied bucket - a
+ * bitmap of occupied buckets makes that O(1).
+ *
+ * A wblock's in-use size can only shrink while it's queued, so left in its
+ * enqueue-time bucket it could be popped later than ideal, never earlier. When
+ * it shrinks across a bucket boundary it's pushed again to the lower bucket -
+ * the entry left behind is stale, and is skipped when it reaches the front.
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "storage/drv_ssd_defrag_q.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_queue.h"
+
+#include "fault.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define N_BUCKETS 64 // one bit each in occupied
+#define NOT_QUEUED 0xFF
+
+struct ssd_defrag_q_s {
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+
+	uint32_t		write_block_size;
+	uint32_t		size;
+	uint64_t		occupied;	// bit set for each non-empty bucket
+
+	cf_queue		*buckets[N_BUCKETS];
+
+	uint32_t		n_wblocks;
+	uint8_t			*wblock_buckets; // current bucket per wblock, or NOT_QUEUED
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static inline uint32_t bucket_of(const ssd_defrag_q* q, uint32_t inuse_sz);
+static void push(ssd_defrag_q* q, uint32_t wblock_id, uint32_t inuse_sz,
+		bool to_head);
+static bool wait_for_push(ssd_defrag_q* q, int ms_wait);
+
+
+//==========================================================
+// Public API.
+//
+
+ssd_defrag_q*
+ssd_defrag_q_create(uint32_t write_block_size, uint32_t n_wblocks)
+{
+	ssd_defrag_q* q = cf_malloc(sizeof(ssd_defrag_q));
+
+	if (! q) {
+		return NULL;
+	}
+
+	if (! (q->wblock_buckets = cf_malloc(n_wblocks))) {
+		cf_free(q);
+		return NULL;
+	}
+
+	memset(q->wblock_buckets, NOT_QUEUED, n_wblocks);
+	q->n_wblocks = n_wblocks;
+
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+
+	q->write_block_size = write_block_size;
+	q->size = 0;
+	q->occupied = 0;
+
+	// Buckets aren't thread safe - all access is under q->lock.
+	for (uint32_t b = 0; b < N_BUCKETS; b++) {
+		if (! (q->buckets[b] = cf_queue_create(sizeof(uint32_t), false))) {
+			cf_crash(AS_DRV_SSD, "failed defrag queue bucket create");
+		}
+	}
+
+	return q;
+}
+
+void
+ssd_defrag_q_push(ssd_defrag_q* q, uint32_t wblock_id, uint32_t inuse_sz)
+{
+	push(q, wblock_id, inuse_sz, false);
+}
+
+void
+ssd_defrag_q_push_head(ssd_defrag_q* q, uint32_t wblock_id, uint32_t inuse_sz)
+{
+	push(q, wblock_id, inuse_sz, true);
+}
+
+void
+ssd_defrag_q_shrink(ssd_defrag_q* q, uint32_t wblock_id, uint32_t old_inuse_sz,
+		uint32_t new_inuse_sz)
+{
+	uint32_t b = bucket_of(q, new_inuse_sz);
+
+	if (b == bucket_of(q, old_inuse_sz)) {
+		return;
+	}
+
+	pthread_mutex_lock(&q->lock);
+
+	// Might not be queued - e.g. popped and being defragged.
+	if (q->wblock_buckets[wblock_id] != NOT_QUEUED &&
+			b < q->wblock_buckets[wblock_id]) {
+		cf_queue_push(q->buckets[b], &wblock_id);
+		q->occupied |= 1ULL << b;
+		q->wblock_buckets[wblock_id] = (uint8_t)b;
+	}
+
+	pthread_mutex_unlock(&q->lock);
+}
+
+bool
+ssd_defrag_q_pop(ssd_defrag_q* q, uint32_t* p_wblock_id, int ms_wait)
+{
+	pthread_mutex_lock(&q->lock);
+
+	if (q->size == 0 && ! wait_for_push(q, ms_wait)) {
+		pthread_mutex_unlock(&q->lock);
+		return false;
+	}
+
+	// Size counts only live entries, so there's one before the buckets run out.
+	while (true) {
+		uint32_t b = (uint32_t)__builtin_ctzll(q->occupied);
+		cf_queue* bucket = q->buckets[b];
+
+		cf_queue_pop(bucket, p_wblock_id, CF_QUEUE_NOWAIT);
+
+		if (cf_queue_sz(bucket) == 0) {
+			q->occupied &= ~(1ULL << b);
+		}
+
+		// Skip stale entries - wblock was re-bucketed lower.
+		if (q->wblock_buckets[*p_wblock_id] == b) {
+			q->wblock_buckets[*p_wblock_id] = NOT_QUEUED;
+			break;
+		}
+	}
+
+	q->size--;
+
+	pthread_mutex_unlock(&q->lock);
+
+	return true;
+}
+
+uint32_t
+ssd_defrag_q_sz(ssd_defrag_q* q)
+{
+	return q->size;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static inline uint32_t
+bucket_of(const ssd_defrag_q* q, uint32_t inuse_sz)
+{
+	uint64_t b = ((uint64_t)inuse_sz * N_BUCKETS) / q->write_block_size;
+
+	return b < N_BUCKETS ? (uint32_t)b : N_BUCKETS - 1;
+}
+
+static void
+push(ssd_defrag_q* q, uint32_t wblock_id, uint32_t inuse_sz, bool to_head)
+{
+	uint32_t b = bucket_of(q, inuse_sz);
+
+	pthread_mutex_lock(&q->lock);
+
+	if (to_head) {
+		cf_queue_push_head(q->buckets[b], &wblock_id);
+	}
+	else {
+		cf_queue_push(q->buckets[b], &wblock_id);
+	}
+
+	q->occupied |= 1ULL << b;
+	q->wblock_buckets[wblock_id] = (uint8_t)b;
+
+	if (q->size++ == 0) {
+		pthread_cond_signal(&q->cond);
+	}
+
+	pthread_mutex_unlock(&q->lock);
+}
+
+// Called under q->lock with q empty. Returns true if something was pushed.
+static bool
+wait_for_push(ssd_defrag_q* q, int ms_wait)
+{
+	if (ms_wait == 0) {
+		return false;
+	}
+
+	if (ms_wait < 0) {
+		while (q->size == 0) {
+			pthread_cond_wait(&q->cond, &q->lock);
+		}
+
+		return true;
+	}
+
+	struct timespec tp;
+
+	clock_gettime(CLOCK_REALTIME, &tp);
+	tp.tv_sec += ms_wait / 1000;
+	tp.tv_nsec += (ms_wait % 1000) * 1000000;
+
+	if (tp.tv_nsec >= 1000000000) {
+		tp.tv_sec++;
+		tp.tv_nsec -= 1000000000;
+	}
+
+	while (q->size == 0) {
+		if (pthread_cond_timedwait(&q->cond, &q->lock, &tp) == ETIMEDOUT) {
+			return q->size != 0;
+		}
+	}
+
+	return true;
+}
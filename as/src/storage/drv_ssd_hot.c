@@ -0,0 +1,403 @@
+/*
+ * drv_ssd_hot.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Hot tier of record images for data-not-in-memory namespaces.
+ *
+ * Unlike the read cache, which holds raw device blocks, this holds verified,
+ * decompressed record images keyed by digest. Readers reference an image in
+ * place instead of copying it, so a hot record is read with no allocation,
+ * decompression or device I/O. An image is only valid for the version of the
+ * record it was made from - the version encodes the record's location and
+ * generation, so stale images simply miss and are replaced or aged out.
+ *
+ * Records are promoted when read. Each shard is an LRU list - promoting into a
+ * full shard demotes from its tail, and nsup periodically demotes records that
+ * haven't been read since its previous pass.
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "storage/drv_ssd_hot.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_digest.h"
+
+#include "fault.h"
+
+#include "base/datamodel.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define LOG_2_N_SHARDS		6
+#define N_SHARDS			(1 << LOG_2_N_SHARDS)
+#define MIN_BUCKETS			1024
+#define EST_REC_SIZE		1024
+
+// Don't let a single record take more than this fraction of a shard.
+#define MAX_REC_SHARD_FRACTION	8
+
+struct ssd_hot_rec_s {
+	cf_atomic32				rc;			// one for the tier, one per reader
+	uint32_t				size;
+	cf_digest				keyd;
+	uint64_t				version;
+	struct ssd_hot_rec_s	*hash_next;
+	struct ssd_hot_rec_s	*prev;		// toward list head (more recent)
+	struct ssd_hot_rec_s	*next;		// toward list tail (less recent)
+	bool					read;		// read since nsup's last pass
+	uint8_t					data[];
+};
+
+typedef struct hot_shard_s {
+	pthread_mutex_t	lock;
+
+	uint32_t		bucket_mask;
+	ssd_hot_rec		**buckets;
+
+	ssd_hot_rec		*head;
+	ssd_hot_rec		*tail;
+	uint64_t		n_bytes;
+} __attribute__ ((aligned(64))) hot_shard;
+
+struct ssd_hot_tier_s {
+	as_namespace	*ns;
+	uint64_t		shard_max_bytes;
+	uint32_t		max_rec_size;
+	hot_shard		shards[N_SHARDS];
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static inline hot_shard* digest_shard(ssd_hot_tier* tier, const cf_digest* keyd);
+static inline uint32_t digest_bucket(hot_shard* shard, const cf_digest* keyd);
+static ssd_hot_rec* hash_find(hot_shard* shard, const cf_digest* keyd);
+static void hash_delete(hot_shard* shard, ssd_hot_rec* rec);
+static void list_push_head(hot_shard* shard, ssd_hot_rec* rec);
+static void list_unlink(hot_shard* shard, ssd_hot_rec* rec);
+static void rec_demote(ssd_hot_tier* tier, hot_shard* shard, ssd_hot_rec* rec);
+
+static inline uint64_t
+rec_bytes(uint32_t size)
+{
+	return sizeof(ssd_hot_rec) + size;
+}
+
+
+//==========================================================
+// Public API.
+//
+
+ssd_hot_tier*
+ssd_hot_tier_create(as_namespace* ns, uint64_t max_size)
+{
+	ssd_hot_tier* tier = cf_malloc(sizeof(ssd_hot_tier));
+
+	if (! tier) {
+		return NULL;
+	}
+
+	memset(tier, 0, sizeof(ssd_hot_tier));
+
+	uint64_t shard_bytes = max_size / N_SHARDS;
+	uint64_t n_buckets = MIN_BUCKETS;
+
+	while (n_buckets < shard_bytes / EST_REC_SIZE) {
+		n_buckets <<= 1;
+	}
+
+	tier->ns = ns;
+	tier->shard_max_bytes = shard_bytes;
+	tier->max_rec_size = (uint32_t)(shard_bytes / MAX_REC_SHARD_FRACTION);
+
+	for (int i = 0; i < N_SHARDS; i++) {
+		hot_shard* shard = &tier->shards[i];
+
+		pthread_mutex_init(&shard->lock, NULL);
+
+		shard->bucket_mask = (uint32_t)(n_buckets - 1);
+		shard->buckets = cf_calloc(n_buckets, sizeof(ssd_hot_rec*));
+
+		if (! shard->buckets) {
+			cf_crash(AS_DRV_SSD, "{%s} failed hot-tier buckets alloc",
+					ns->name);
+		}
+	}
+
+	cf_info(AS_DRV_SSD, "{%s} hot-tier size %lu, %d shards, %lu buckets per shard",
+			ns->name, max_size, N_SHARDS, n_buckets);
+
+	return tier;
+}
+
+const uint8_t*
+ssd_hot_tier_get(ssd_hot_tier* tier, const cf_digest* keyd, uint64_t version,
+		ssd_hot_rec** p_rec)
+{
+	hot_shard* shard = digest_shard(tier, keyd);
+
+	pthread_mutex_lock(&shard->lock);
+
+	ssd_hot_rec* rec = hash_find(shard, keyd);
+
+	if (! rec || rec->version != version) {
+		pthread_mutex_unlock(&shard->lock);
+		cf_atomic64_incr(&tier->ns->n_hot_tier_misses);
+		return NULL;
+	}
+
+	cf_atomic32_incr(&rec->rc);
+	rec->read = true;
+
+	if (shard->head != rec) {
+		list_unlink(shard, rec);
+		list_push_head(shard, rec);
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+
+	cf_atomic64_incr(&tier->ns->n_hot_tier_hits);
+	*p_rec = rec;
+
+	return rec->data;
+}
+
+void
+ssd_hot_tier_release(ssd_hot_rec* rec)
+{
+	if (cf_atomic32_decr(&rec->rc) == 0) {
+		cf_free(rec);
+	}
+}
+
+void
+ssd_hot_tier_promote(ssd_hot_tier* tier, const cf_digest* keyd,
+		uint64_t version, const uint8_t* data, uint32_t size)
+{
+	if (size > tier->max_rec_size) {
+		return;
+	}
+
+	ssd_hot_rec* rec = cf_malloc(rec_bytes(size));
+
+	if (! rec) {
+		return;
+	}
+
+	rec->rc = 1;
+	rec->size = size;
+	rec->keyd = *keyd;
+	rec->version = version;
+	rec->read = true;
+	memcpy(rec->data, data, size);
+
+	hot_shard* shard = digest_shard(tier, keyd);
+
+	pthread_mutex_lock(&shard->lock);
+
+	ssd_hot_rec* old_rec = hash_find(shard, keyd);
+
+	if (old_rec) {
+		if (old_rec->version == version) {
+			// Another reader beat us to it.
+			pthread_mutex_unlock(&shard->lock);
+			cf_free(rec);
+			return;
+		}
+
+		// Older version - no longer of any use.
+		rec_demote(tier, shard, old_rec);
+	}
+
+	// Make room, least recently read first.
+	while (shard->tail &&
+			shard->n_bytes + rec_bytes(size) > tier->shard_max_bytes) {
+		rec_demote(tier, shard, shard->tail);
+	}
+
+	uint32_t b = digest_bucket(shard, keyd);
+
+	rec->hash_next = shard->buckets[b];
+	shard->buckets[b] = rec;
+
+	list_push_head(shard, rec);
+
+	pthread_mutex_unlock(&shard->lock);
+
+	cf_atomic64_add(&tier->ns->hot_tier_bytes, (int64_t)rec_bytes(size));
+	cf_atomic64_incr(&tier->ns->n_hot_tier_promotions);
+}
+
+void
+ssd_hot_tier_demote(ssd_hot_tier* tier)
+{
+	uint64_t n_demoted = 0;
+
+	for (int i = 0; i < N_SHARDS; i++) {
+		hot_shard* shard = &tier->shards[i];
+
+		pthread_mutex_lock(&shard->lock);
+
+		ssd_hot_rec* rec = shard->tail;
+
+		while (rec) {
+			ssd_hot_rec* prev = rec->prev;
+
+			if (rec->read) {
+				// Survives this pass, but must be read again to survive next.
+				rec->read = false;
+			}
+			else {
+				rec_demote(tier, shard, rec);
+				n_demoted++;
+			}
+
+			rec = prev;
+		}
+
+		pthread_mutex_unlock(&shard->lock);
+	}
+
+	cf_detail(AS_DRV_SSD, "{%s} hot-tier demoted %lu records", tier->ns->name,
+			n_demoted);
+}
+
+
+//==========================================================
+// Local helpers - hashing.
+//
+
+static inline uint64_t
+digest_hash(const cf_digest* keyd)
+{
+	// Partition id comes from the start of the digest - use the middle.
+	uint64_t h;
+
+	memcpy(&h, &keyd->digest[8], sizeof(h));
+
+	return h;
+}
+
+static inline hot_shard*
+digest_shard(ssd_hot_tier* tier, const cf_digest* keyd)
+{
+	return &tier->shards[digest_hash(keyd) >> (64 - LOG_2_N_SHARDS)];
+}
+
+static inline uint32_t
+digest_bucket(hot_shard* shard, const cf_digest* keyd)
+{
+	return (uint32_t)digest_hash(keyd) & shard->bucket_mask;
+}
+
+static ssd_hot_rec*
+hash_find(hot_shard* shard, const cf_digest* keyd)
+{
+	ssd_hot_rec* rec = shard->buckets[digest_bucket(shard, keyd)];
+
+	while (rec && memcmp(&rec->keyd, keyd, sizeof(cf_digest)) != 0) {
+		rec = rec->hash_next;
+	}
+
+	return rec;
+}
+
+static void
+hash_delete(hot_shard* shard, ssd_hot_rec* rec)
+{
+	ssd_hot_rec** p_rec = &shard->buckets[digest_bucket(shard, &rec->keyd)];
+
+	while (*p_rec != rec) {
+		p_rec = &(*p_rec)->hash_next;
+	}
+
+	*p_rec = rec->hash_next;
+}
+
+
+//==========================================================
+// Local helpers - LRU list.
+//
+
+static void
+list_push_head(hot_shard* shard, ssd_hot_rec* rec)
+{
+	rec->prev = NULL;
+	rec->next = shard->head;
+
+	if (shard->head) {
+		shard->head->prev = rec;
+	}
+	else {
+		shard->tail = rec;
+	}
+
+	shard->head = rec;
+	shard->n_bytes += rec_bytes(rec->size);
+}
+
+static void
+list_unlink(hot_shard* shard, ssd_hot_rec* rec)
+{
+	if (rec->prev) {
+		rec->prev->next = rec->next;
+	}
+	else {
+		shard->head = rec->next;
+	}
+
+	if (rec->next) {
+		rec->next->prev = rec->prev;
+	}
+	else {
+		shard->tail = rec->prev;
+	}
+
+	shard->n_bytes -= rec_bytes(rec->size);
+}
+
+// Remove record from the tier - it's freed when its last reader is done.
+static void
+rec_demote(ssd_hot_tier* tier, hot_shard* shard, ssd_hot_rec* rec)
+{
+	list_unlink(shard, rec);
+	hash_delete(shard, rec);
+
+	cf_atomic64_sub(&tier->ns->hot_tier_bytes, (int64_t)rec_bytes(rec->size));
+	cf_atomic64_incr(&tier->ns->n_hot_tier_demotions);
+
+	ssd_hot_tier_release(rec);
+}
@@ -500,6 +500,26 @@ as_storage_defrag_sweep(as_namespace *ns)
 	}
 }
 
+//--------------------------------------
+// as_storage_demote_hot
+//
+
+typedef void (*as_storage_demote_hot_fn)(as_namespace *ns);
+static const as_storage_demote_hot_fn as_storage_demote_hot_table[AS_STORAGE_ENGINE_TYPES] = {
+	NULL,
+	0, // memory has no hot tier
+	as_storage_demote_hot_ssd,
+	0  // kv has no hot tier
+};
+
+void
+as_storage_demote_hot(as_namespace *ns)
+{
+	if (as_storage_demote_hot_table[ns->storage_type]) {
+		as_storage_demote_hot_table[ns->storage_type](ns);
+	}
+}
+
 //--------------------------------------
 // as_storage_info_set
 //
@@ -841,7 +861,7 @@ as_storage_shutdown(void)
 	olock* p_olock = g_config.record_locks;
 
 	for (uint32_t n = 0; n < p_olock->n_locks; n++) {
-		pthread_mutex_lock(&p_olock->locks[n]);
+		pthread_mutex_lock(&p_olock->locks[n].lock);
 	}
 
 	// Now flush everything outstanding to storage devices.
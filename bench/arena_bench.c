@@ -0,0 +1,297 @@
+/*
+ * arena_bench.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Index arena lookups under each stage placement - resolve-and-load latency
+ * and lookups/sec. Each element holds the handle of the next in one random
+ * cycle through the arena, so every lookup is a dependent load from a random
+ * element, as in a tree walk - TLB misses show up as they do in the index.
+ *
+ * Placements that aren't available fall back as they would in the server - the
+ * stage backing actually used is reported alongside.
+ *
+ * Usage: arena_bench [options] - see usage().
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arenax.h"
+
+#include "bench.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define MAX_THREADS 256
+
+typedef struct placement_s {
+	const char*	name;
+	uint32_t	flags;
+} placement;
+
+static const placement PLACEMENTS[] = {
+		{ "heap", 0 },
+		{ "thp", CF_ARENAX_HUGE_PAGES_THP },
+		{ "2m", CF_ARENAX_HUGE_PAGES_2M },
+		{ "1g", CF_ARENAX_HUGE_PAGES_1G },
+		{ "interleave", CF_ARENAX_NUMA_INTERLEAVE },
+		{ "stripe", CF_ARENAX_NUMA_STRIPE },
+		{ "2m+interleave", CF_ARENAX_HUGE_PAGES_2M | CF_ARENAX_NUMA_INTERLEAVE },
+		{ "2m+stripe", CF_ARENAX_HUGE_PAGES_2M | CF_ARENAX_NUMA_STRIPE }
+};
+
+#define NUM_PLACEMENTS (sizeof(PLACEMENTS) / sizeof(placement))
+
+typedef struct walker_s {
+	pthread_t			thread;
+	cf_arenax*			arena;
+	cf_arenax_handle	start_h;
+	uint64_t			elapsed_ns;
+	cf_arenax_handle	end_h; // keeps the walk from being optimized away
+} walker;
+
+
+//==========================================================
+// Globals.
+//
+
+static uint64_t g_n_elements = 32 * 1024 * 1024;
+static uint32_t g_element_size = 64; // sizeof(as_index)
+static uint32_t g_stage_capacity = 0; // arena default
+static uint32_t g_n_threads = 1;
+static uint64_t g_n_lookups = 10 * 1000 * 1000; // per thread
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void usage(const char* prog);
+static bool run_placement(const placement* pl);
+static void* run_walker(void* udata);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char* argv[])
+{
+	const char* placements = "heap,thp,2m";
+	int c;
+
+	while ((c = getopt(argc, argv, "n:e:c:t:l:P:h")) != -1) {
+		switch (c) {
+		case 'n':
+			g_n_elements = strtoull(optarg, NULL, 0);
+			break;
+		case 'e':
+			g_element_size = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			g_stage_capacity = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			g_n_threads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			g_n_lookups = strtoull(optarg, NULL, 0);
+			break;
+		case 'P':
+			placements = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (g_n_elements < 2 || g_element_size < sizeof(cf_arenax_handle) ||
+			g_n_threads == 0 || g_n_threads > MAX_THREADS) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("%lu x %u-byte elements, %u threads x %lu lookups\n",
+			g_n_elements, g_element_size, g_n_threads, g_n_lookups);
+
+	char* list = strdup(placements);
+	char* save = NULL;
+	bool ok = true;
+
+	for (char* name = strtok_r(list, ",", &save); name;
+			name = strtok_r(NULL, ",", &save)) {
+		uint32_t i;
+
+		for (i = 0; i < NUM_PLACEMENTS; i++) {
+			if (strcmp(name, PLACEMENTS[i].name) == 0) {
+				break;
+			}
+		}
+
+		if (i == NUM_PLACEMENTS) {
+			fprintf(stderr, "unknown placement %s\n", name);
+			ok = false;
+			continue;
+		}
+
+		ok = run_placement(&PLACEMENTS[i]) && ok;
+	}
+
+	free(list);
+
+	return ok ? 0 : 1;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static void
+usage(const char* prog)
+{
+	fprintf(stderr, "usage: %s [options]\n", prog);
+	fprintf(stderr, "  -n <n>      elements (default 33554432)\n");
+	fprintf(stderr, "  -e <bytes>  element size (default 64)\n");
+	fprintf(stderr, "  -c <n>      elements per stage (default %u)\n", MAX_STAGE_CAPACITY);
+	fprintf(stderr, "  -t <n>      walker threads, max %d (default 1)\n", MAX_THREADS);
+	fprintf(stderr, "  -l <n>      lookups per thread (default 10000000)\n");
+	fprintf(stderr, "  -P <list>   placements to compare (default heap,thp,2m), from:\n");
+
+	for (uint32_t i = 0; i < NUM_PLACEMENTS; i++) {
+		fprintf(stderr, "              %s\n", PLACEMENTS[i].name);
+	}
+}
+
+static bool
+run_placement(const placement* pl)
+{
+	cf_arenax* arena = malloc(cf_arenax_sizeof());
+	cf_arenax_err err = cf_arenax_create(arena, 0, g_element_size,
+			g_stage_capacity, 0, CF_ARENAX_BIGLOCK | pl->flags);
+
+	if (err != CF_ARENAX_OK) {
+		fprintf(stderr, "%s: can't create arena: %s\n", pl->name,
+				cf_arenax_errstr(err));
+		free(arena);
+		return false;
+	}
+
+	cf_arenax_handle* handles = malloc(g_n_elements * sizeof(cf_arenax_handle));
+
+	for (uint64_t i = 0; i < g_n_elements; i++) {
+		if ((handles[i] = cf_arenax_alloc(arena)) == 0) {
+			fprintf(stderr, "%s: arena full after %lu elements\n", pl->name, i);
+			exit(1);
+		}
+	}
+
+	// Sattolo's shuffle - a single cycle through every element.
+	uint64_t rand_state = 0x9E3779B97F4A7C15ULL;
+
+	for (uint64_t i = g_n_elements - 1; i > 0; i--) {
+		uint64_t j = bench_rand(&rand_state) % i;
+		cf_arenax_handle t = handles[i];
+
+		handles[i] = handles[j];
+		handles[j] = t;
+	}
+
+	for (uint64_t i = 0; i < g_n_elements; i++) {
+		cf_arenax_handle* next = cf_arenax_resolve(arena, handles[i]);
+
+		*next = handles[(i + 1) % g_n_elements];
+	}
+
+	walker* walkers = calloc(g_n_threads, sizeof(walker));
+
+	for (uint32_t i = 0; i < g_n_threads; i++) {
+		walkers[i].arena = arena;
+		walkers[i].start_h = handles[(g_n_elements / g_n_threads) * i];
+	}
+
+	free(handles);
+
+	for (uint32_t i = 0; i < g_n_threads; i++) {
+		pthread_create(&walkers[i].thread, NULL, run_walker, &walkers[i]);
+	}
+
+	uint64_t max_ns = 0;
+	uint64_t sum_ns = 0;
+
+	for (uint32_t i = 0; i < g_n_threads; i++) {
+		pthread_join(walkers[i].thread, NULL);
+		sum_ns += walkers[i].elapsed_ns;
+
+		if (walkers[i].elapsed_ns > max_ns) {
+			max_ns = walkers[i].elapsed_ns;
+		}
+	}
+
+	cf_arenax_placement where;
+
+	cf_arenax_get_placement(arena, &where);
+
+	printf("%-16s %12.0f lookups/sec   %6.1f ns/lookup   stages %u (thp %u, 2m %u, 1g %u, interleaved %u)\n",
+			pl->name,
+			(double)(g_n_lookups * g_n_threads) * 1e9 / (double)max_ns,
+			(double)sum_ns / (double)(g_n_lookups * g_n_threads),
+			where.stages, where.stages_thp, where.stages_huge_2m,
+			where.stages_huge_1g, where.stages_interleaved);
+
+	free(walkers);
+	cf_arenax_destroy(arena);
+	free(arena);
+
+	return true;
+}
+
+static void*
+run_walker(void* udata)
+{
+	walker* wk = (walker*)udata;
+	cf_arenax_handle h = wk->start_h;
+	uint64_t start_ns = bench_now_ns();
+
+	for (uint64_t i = 0; i < g_n_lookups; i++) {
+		h = *(cf_arenax_handle*)cf_arenax_resolve(wk->arena, h);
+	}
+
+	wk->elapsed_ns = bench_now_ns() - start_ns;
+	wk->end_h = h;
+
+	return NULL;
+}
@@ -0,0 +1,369 @@
+/*
+ * batch_prefetch_bench.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Batch sub-transaction index lookups, as as_batch_submit_group() does them
+ * for a data-in-memory namespace - groups of random existing keys, each looked
+ * up and record-locked. Compares:
+ *
+ *   plain          - a partition reservation and a lookup per key
+ *   prefetch/key   - a reservation per key, then as_index_prefetch_multi()
+ *   prefetch/part  - a reservation per distinct partition, then prefetch
+ *
+ * Reports keys/sec and p50/p99 per group. A partition reservation is modeled
+ * as the partition lock plus a tree ref-count, like as_partition_reserve_tree().
+ *
+ * Usage: batch_prefetch_bench [options] - see usage().
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_digest.h"
+
+#include "arenax.h"
+#include "olock.h"
+
+#include "base/cfg.h"
+#include "base/datamodel.h"
+#include "base/index.h"
+
+#include "bench.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define MAX_PARTITIONS 4096
+
+typedef struct partition_s {
+	pthread_mutex_t	lock;
+	as_index_tree*	tree;
+	cf_atomic32		n_reserved;
+} partition;
+
+typedef enum {
+	MODE_PLAIN,
+	MODE_PREFETCH_PER_KEY,
+	MODE_PREFETCH_PER_PARTITION,
+
+	NUM_MODES
+} bench_mode;
+
+static const char* MODE_NAMES[] = {
+		"plain",
+		"prefetch/key",
+		"prefetch/part"
+};
+
+
+//==========================================================
+// Globals.
+//
+
+as_config g_config;
+
+static uint64_t g_n_keys = 10 * 1000 * 1000;
+static uint32_t g_n_partitions = MAX_PARTITIONS;
+static uint32_t g_n_sprigs = 1;
+static uint32_t g_group_size = AS_INDEX_PREFETCH_GROUP;
+static uint64_t g_n_groups = 1000 * 1000;
+
+static partition g_partitions[MAX_PARTITIONS];
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void usage(const char* prog);
+static void make_digest(uint64_t i, cf_digest* keyd);
+static as_index_tree* reserve_tree(partition* p);
+static void release_tree(partition* p);
+static void lookup(as_index_tree* tree, cf_digest* keyd);
+static void run_mode(bench_mode mode);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char* argv[])
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "n:p:s:g:i:h")) != -1) {
+		switch (c) {
+		case 'n':
+			g_n_keys = strtoull(optarg, NULL, 0);
+			break;
+		case 'p':
+			g_n_partitions = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			g_n_sprigs = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			g_group_size = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			g_n_groups = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (g_n_keys == 0 || g_n_partitions == 0 ||
+			g_n_partitions > MAX_PARTITIONS || g_n_sprigs == 0 ||
+			(g_n_sprigs & (g_n_sprigs - 1)) != 0 ||
+			g_n_sprigs > MAX_PARTITION_TREE_SPRIGS || g_group_size == 0 ||
+			g_group_size > AS_INDEX_PREFETCH_GROUP) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	g_config.record_locks = olock_create(16 * 1024, OLOCK_TYPE_MUTEX, NULL);
+
+	cf_arenax* arena = malloc(cf_arenax_sizeof());
+	cf_arenax_err err = cf_arenax_create(arena, 0, sizeof(as_index),
+			MAX_STAGE_CAPACITY, CF_ARENAX_MAX_STAGES, 0);
+
+	if (err != CF_ARENAX_OK) {
+		fprintf(stderr, "can't create arena: %s\n", cf_arenax_errstr(err));
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < g_n_partitions; i++) {
+		partition* p = &g_partitions[i];
+
+		pthread_mutex_init(&p->lock, NULL);
+		p->tree = as_index_tree_create(arena, NULL, NULL,
+				AS_INDEX_ENGINE_RBTREE, g_n_sprigs, NULL);
+
+		if (! p->tree) {
+			fprintf(stderr, "can't create tree\n");
+			return 1;
+		}
+	}
+
+	printf("%lu keys in %u partitions x %u sprigs, %lu groups of %u\n",
+			g_n_keys, g_n_partitions, g_n_sprigs, g_n_groups, g_group_size);
+
+	for (uint64_t i = 0; i < g_n_keys; i++) {
+		cf_digest keyd;
+		as_index_ref r_ref;
+
+		make_digest(i, &keyd);
+		r_ref.skip_lock = false;
+
+		partition* p = &g_partitions[as_partition_getid(keyd) %
+				g_n_partitions];
+
+		if (as_index_get_insert_vlock(p->tree, &keyd, &r_ref) < 0) {
+			fprintf(stderr, "insert failed\n");
+			return 1;
+		}
+
+		pthread_mutex_unlock(r_ref.olock);
+		as_index_release(r_ref.r);
+	}
+
+	for (bench_mode mode = 0; mode < NUM_MODES; mode++) {
+		run_mode(mode);
+	}
+
+	return 0;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static void
+usage(const char* prog)
+{
+	fprintf(stderr, "usage: %s [options]\n", prog);
+	fprintf(stderr, "  -n <n>   keys in the index (default 10000000)\n");
+	fprintf(stderr, "  -p <n>   partitions, max %d (default %d)\n", MAX_PARTITIONS, MAX_PARTITIONS);
+	fprintf(stderr, "  -s <n>   sprigs per partition, power of 2 (default 1)\n");
+	fprintf(stderr, "  -g <n>   keys per group, max %d (default %d)\n", AS_INDEX_PREFETCH_GROUP, AS_INDEX_PREFETCH_GROUP);
+	fprintf(stderr, "  -i <n>   groups per mode (default 1000000)\n");
+}
+
+// Spread the key number over the whole digest, like RIPEMD-160 would.
+static void
+make_digest(uint64_t i, cf_digest* keyd)
+{
+	uint64_t state = (i + 1) * 0x9E3779B97F4A7C15ULL;
+
+	for (uint32_t n = 0; n < CF_DIGEST_KEY_SZ; n += sizeof(uint64_t)) {
+		uint64_t x = bench_rand(&state);
+		uint32_t sz = CF_DIGEST_KEY_SZ - n < sizeof(uint64_t) ?
+				CF_DIGEST_KEY_SZ - n : sizeof(uint64_t);
+
+		memcpy(&keyd->digest[n], &x, sz);
+	}
+}
+
+static as_index_tree*
+reserve_tree(partition* p)
+{
+	pthread_mutex_lock(&p->lock);
+	cf_atomic32_incr(&p->n_reserved);
+	pthread_mutex_unlock(&p->lock);
+
+	return p->tree;
+}
+
+static void
+release_tree(partition* p)
+{
+	pthread_mutex_lock(&p->lock);
+	cf_atomic32_decr(&p->n_reserved);
+	pthread_mutex_unlock(&p->lock);
+}
+
+static void
+lookup(as_index_tree* tree, cf_digest* keyd)
+{
+	as_index_ref r_ref;
+
+	r_ref.skip_lock = false;
+
+	if (as_index_get_vlock(tree, keyd, &r_ref) != 0) {
+		fprintf(stderr, "key not found\n");
+		exit(1);
+	}
+
+	pthread_mutex_unlock(r_ref.olock);
+	as_index_release(r_ref.r);
+}
+
+static void
+run_mode(bench_mode mode)
+{
+	bench_lat lat;
+	uint64_t rand_state = 0x2545F4914F6CDD1DULL;
+
+	bench_lat_init(&lat, g_n_groups < 4 * 1024 * 1024 ?
+			g_n_groups : 4 * 1024 * 1024);
+
+	for (uint64_t g = 0; g < g_n_groups; g++) {
+		cf_digest keyds[AS_INDEX_PREFETCH_GROUP];
+		partition* parts[AS_INDEX_PREFETCH_GROUP];
+		as_index_tree* trees[AS_INDEX_PREFETCH_GROUP];
+
+		// Pick the keys outside the timed section.
+		for (uint32_t i = 0; i < g_group_size; i++) {
+			make_digest(bench_rand(&rand_state) % g_n_keys, &keyds[i]);
+			parts[i] = &g_partitions[as_partition_getid(keyds[i]) %
+					g_n_partitions];
+		}
+
+		uint64_t group_start_ns = bench_now_ns();
+
+		switch (mode) {
+		case MODE_PLAIN:
+			for (uint32_t i = 0; i < g_group_size; i++) {
+				lookup(reserve_tree(parts[i]), &keyds[i]);
+				release_tree(parts[i]);
+			}
+			break;
+		case MODE_PREFETCH_PER_KEY:
+			for (uint32_t i = 0; i < g_group_size; i++) {
+				trees[i] = reserve_tree(parts[i]);
+			}
+
+			as_index_prefetch_multi(trees, keyds, g_group_size);
+
+			for (uint32_t i = 0; i < g_group_size; i++) {
+				lookup(trees[i], &keyds[i]);
+			}
+
+			for (uint32_t i = 0; i < g_group_size; i++) {
+				release_tree(parts[i]);
+			}
+			break;
+		case MODE_PREFETCH_PER_PARTITION: {
+			partition* res_parts[AS_INDEX_PREFETCH_GROUP];
+			uint32_t n_res = 0;
+
+			for (uint32_t i = 0; i < g_group_size; i++) {
+				uint32_t r = 0;
+
+				while (r < n_res && res_parts[r] != parts[i]) {
+					r++;
+				}
+
+				if (r == n_res) {
+					res_parts[n_res++] = parts[i];
+					reserve_tree(parts[i]);
+				}
+
+				trees[i] = parts[i]->tree;
+			}
+
+			as_index_prefetch_multi(trees, keyds, g_group_size);
+
+			for (uint32_t i = 0; i < g_group_size; i++) {
+				lookup(trees[i], &keyds[i]);
+			}
+
+			for (uint32_t r = 0; r < n_res; r++) {
+				release_tree(res_parts[r]);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+
+		bench_lat_add(&lat, bench_now_ns() - group_start_ns);
+	}
+
+	// Keys/sec counts only the timed lookups, not picking the keys.
+	uint64_t n = lat.n < lat.capacity ? lat.n : lat.capacity;
+	uint64_t timed_ns = 0;
+
+	for (uint64_t i = 0; i < n; i++) {
+		timed_ns += lat.ns[i];
+	}
+
+	bench_lat_report(MODE_NAMES[mode], &lat, n * g_group_size, timed_ns);
+
+	bench_lat_destroy(&lat);
+}
@@ -0,0 +1,153 @@
+/*
+ * bench.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Helpers shared by the standalone benchmarks - timing, latency samples and
+ * a fast per-thread random number generator.
+ */
+
+#pragma once
+
+//==========================================================
+// Includes.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Latency samples - a fixed-capacity array, sorted when reported. Once full,
+// later samples overwrite earlier ones round-robin.
+typedef struct bench_lat_s {
+	uint64_t*	ns;
+	uint64_t	capacity;
+	uint64_t	n;
+} bench_lat;
+
+
+//==========================================================
+// Public API.
+//
+
+static inline uint64_t
+bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64* - never seed with 0.
+static inline uint64_t
+bench_rand(uint64_t* state)
+{
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline bool
+bench_lat_init(bench_lat* lat, uint64_t capacity)
+{
+	lat->capacity = capacity;
+	lat->n = 0;
+
+	return (lat->ns = malloc(capacity * sizeof(uint64_t))) != NULL;
+}
+
+static inline void
+bench_lat_destroy(bench_lat* lat)
+{
+	free(lat->ns);
+}
+
+static inline void
+bench_lat_add(bench_lat* lat, uint64_t ns)
+{
+	lat->ns[lat->n++ % lat->capacity] = ns;
+}
+
+// Fold src into dst, keeping as many samples as fit.
+static inline void
+bench_lat_merge(bench_lat* dst, const bench_lat* src)
+{
+	uint64_t n = src->n < src->capacity ? src->n : src->capacity;
+
+	for (uint64_t i = 0; i < n; i++) {
+		bench_lat_add(dst, src->ns[i]);
+	}
+}
+
+static int
+bench_cmp_u64(const void* pa, const void* pb)
+{
+	uint64_t a = *(const uint64_t*)pa;
+	uint64_t b = *(const uint64_t*)pb;
+
+	return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// Sorts the samples - call when done adding.
+static inline uint64_t
+bench_lat_pct(bench_lat* lat, double pct)
+{
+	uint64_t n = lat->n < lat->capacity ? lat->n : lat->capacity;
+
+	if (n == 0) {
+		return 0;
+	}
+
+	qsort(lat->ns, n, sizeof(uint64_t), bench_cmp_u64);
+
+	uint64_t i = (uint64_t)((pct / 100.0) * (double)(n - 1));
+
+	return lat->ns[i];
+}
+
+// One line: label, operations per second, and p50/p99/p99.9 in microseconds.
+static inline void
+bench_lat_report(const char* label, bench_lat* lat, uint64_t n_ops,
+		uint64_t elapsed_ns)
+{
+	double ops_per_sec = elapsed_ns == 0 ? 0.0 :
+			(double)n_ops * 1e9 / (double)elapsed_ns;
+
+	printf("%-24s %12.0f ops/sec   p50 %8.1f us   p99 %8.1f us   p99.9 %8.1f us\n",
+			label, ops_per_sec,
+			(double)bench_lat_pct(lat, 50.0) / 1000.0,
+			(double)bench_lat_pct(lat, 99.0) / 1000.0,
+			(double)bench_lat_pct(lat, 99.9) / 1000.0);
+}
@@ -0,0 +1,414 @@
+/*
+ * checksum_read_bench.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Record read latency with and without checksum verification - IOPS and
+ * p50/p99 for random record reads, as a transaction does them (one blocking
+ * pread per record), then the same reads each followed by the CRC32C check
+ * enable-checksum adds. Modes alternate for -r rounds so drift in the device
+ * or page cache doesn't favor either.
+ *
+ * With -c, the file is first filled with checksummed records, laid out on
+ * io-min boundaries the way the storage layer reads them.
+ *
+ * Usage: checksum_read_bench -f <file-or-device> [options] - see usage().
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include "crc32c.h"
+
+#include "bench.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define MAX_READERS 256
+#define LAT_SAMPLES_PER_READER (1024 * 1024)
+#define IO_MIN_SIZE 512
+
+// Same as the storage layer's record header.
+#define CHECKSUM_MAGIC 0xC5C32C00
+
+typedef struct record_head_s {
+	uint32_t	checksum_magic;
+	uint32_t	checksum;	// CRC32C of everything after this header
+	uint32_t	length;		// bytes after this header
+} record_head;
+
+typedef struct bench_cfg_s {
+	const char*	path;
+	uint32_t	record_size;
+	uint32_t	slot_size;	// record_size rounded up to io-min
+	uint32_t	n_readers;
+	uint32_t	duration_sec;
+	uint32_t	n_rounds;
+	uint64_t	create_mb;
+	bool		direct;
+	uint64_t	n_slots;
+} bench_cfg;
+
+typedef struct reader_s {
+	pthread_t	thread;
+	bool		verify;
+	int			fd;
+	uint64_t	rand_state;
+	uint64_t	n_reads;
+	uint64_t	n_errors;
+	uint64_t	n_mismatches;
+	bench_lat	lat;
+} reader;
+
+
+//==========================================================
+// Globals.
+//
+
+static bench_cfg g_cfg = {
+		.record_size = 1536,
+		.n_readers = 8,
+		.duration_sec = 5,
+		.n_rounds = 2,
+		.direct = true
+};
+
+static volatile bool g_stop = false;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void usage(const char* prog);
+static uint64_t file_size(int fd);
+static bool fill_file(void);
+static bool run_mode(bool verify, bench_lat* all, uint64_t* p_reads,
+		uint64_t* p_elapsed_ns);
+static void* run_reader(void* udata);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char* argv[])
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "f:s:t:d:r:c:Bh")) != -1) {
+		switch (c) {
+		case 'f':
+			g_cfg.path = optarg;
+			break;
+		case 's':
+			g_cfg.record_size = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			g_cfg.n_readers = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			g_cfg.duration_sec = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			g_cfg.n_rounds = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			g_cfg.create_mb = strtoull(optarg, NULL, 0);
+			break;
+		case 'B':
+			g_cfg.direct = false;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (! g_cfg.path || g_cfg.record_size <= sizeof(record_head) ||
+			g_cfg.n_readers == 0 || g_cfg.n_readers > MAX_READERS ||
+			g_cfg.n_rounds == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	g_cfg.slot_size = (g_cfg.record_size + IO_MIN_SIZE - 1) &
+			~(uint32_t)(IO_MIN_SIZE - 1);
+
+	if (g_cfg.create_mb != 0 && ! fill_file()) {
+		return 1;
+	}
+
+	int fd = open(g_cfg.path, O_RDONLY);
+
+	if (fd < 0) {
+		fprintf(stderr, "can't open %s: %s\n", g_cfg.path, strerror(errno));
+		return 1;
+	}
+
+	g_cfg.n_slots = file_size(fd) / g_cfg.slot_size;
+	close(fd);
+
+	if (g_cfg.n_slots == 0) {
+		fprintf(stderr, "%s is smaller than one record\n", g_cfg.path);
+		return 1;
+	}
+
+	printf("%s: %lu x %u-byte records, %u readers, %u x %u sec per mode, %s, crc32c %s\n",
+			g_cfg.path, g_cfg.n_slots, g_cfg.record_size, g_cfg.n_readers,
+			g_cfg.n_rounds, g_cfg.duration_sec,
+			g_cfg.direct ? "O_DIRECT" : "buffered",
+			cf_crc32c_is_hw() ? "hardware" : "software");
+
+	bench_lat all[2];
+	uint64_t n_reads[2] = { 0, 0 };
+	uint64_t elapsed_ns[2] = { 0, 0 };
+	bool ok = true;
+
+	for (int v = 0; v < 2; v++) {
+		bench_lat_init(&all[v], LAT_SAMPLES_PER_READER * 4);
+	}
+
+	for (uint32_t round = 0; round < g_cfg.n_rounds; round++) {
+		// Alternate which mode goes first.
+		for (int i = 0; i < 2; i++) {
+			int v = (int)((round + i) % 2);
+
+			ok = run_mode(v == 1, &all[v], &n_reads[v], &elapsed_ns[v]) && ok;
+		}
+	}
+
+	uint64_t p99[2];
+
+	for (int v = 0; v < 2; v++) {
+		bench_lat_report(v == 1 ? "read + verify" : "read", &all[v],
+				n_reads[v], elapsed_ns[v]);
+		p99[v] = bench_lat_pct(&all[v], 99.0);
+		bench_lat_destroy(&all[v]);
+	}
+
+	printf("p99 change with verify: %+.1f us (%+.1f%%)\n",
+			((double)p99[1] - (double)p99[0]) / 1000.0,
+			p99[0] == 0 ? 0.0 :
+					((double)p99[1] - (double)p99[0]) * 100.0 / (double)p99[0]);
+
+	return ok ? 0 : 1;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static void
+usage(const char* prog)
+{
+	fprintf(stderr, "usage: %s -f <file-or-device> [options]\n", prog);
+	fprintf(stderr, "  -s <bytes>   record size, header included (default 1536)\n");
+	fprintf(stderr, "  -t <n>       reader threads (default 8, max %d)\n", MAX_READERS);
+	fprintf(stderr, "  -d <sec>     duration per mode per round (default 5)\n");
+	fprintf(stderr, "  -r <n>       rounds of both modes (default 2)\n");
+	fprintf(stderr, "  -c <MiB>     first create the file with this many MiB of records\n");
+	fprintf(stderr, "  -B           buffered reads instead of O_DIRECT\n");
+}
+
+static uint64_t
+file_size(int fd)
+{
+	struct stat st;
+
+	if (fstat(fd, &st) != 0) {
+		return 0;
+	}
+
+	if (S_ISBLK(st.st_mode)) {
+		uint64_t size = 0;
+
+		return ioctl(fd, BLKGETSIZE64, &size) == 0 ? size : 0;
+	}
+
+	return (uint64_t)st.st_size;
+}
+
+static bool
+fill_file(void)
+{
+	int fd = open(g_cfg.path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0) {
+		fprintf(stderr, "can't create %s: %s\n", g_cfg.path, strerror(errno));
+		return false;
+	}
+
+	uint64_t n_slots = (g_cfg.create_mb << 20) / g_cfg.slot_size;
+	uint8_t* slot = calloc(1, g_cfg.slot_size);
+	uint64_t rand_state = 0x9E3779B97F4A7C15ULL;
+	record_head* head = (record_head*)slot;
+	uint32_t length = g_cfg.record_size - (uint32_t)sizeof(record_head);
+
+	for (uint64_t i = 0; i < n_slots; i++) {
+		for (uint32_t b = sizeof(record_head); b + 8 <= g_cfg.record_size;
+				b += 8) {
+			uint64_t r = bench_rand(&rand_state);
+
+			memcpy(slot + b, &r, 8);
+		}
+
+		head->checksum_magic = CHECKSUM_MAGIC;
+		head->length = length;
+		head->checksum = cf_crc32c(0, slot + sizeof(record_head), length);
+
+		if (write(fd, slot, g_cfg.slot_size) != (ssize_t)g_cfg.slot_size) {
+			fprintf(stderr, "can't write %s: %s\n", g_cfg.path, strerror(errno));
+			free(slot);
+			close(fd);
+			return false;
+		}
+	}
+
+	free(slot);
+	fsync(fd);
+	close(fd);
+
+	return true;
+}
+
+static bool
+run_mode(bool verify, bench_lat* all, uint64_t* p_reads,
+		uint64_t* p_elapsed_ns)
+{
+	reader* readers = calloc(g_cfg.n_readers, sizeof(reader));
+
+	g_stop = false;
+
+	for (uint32_t i = 0; i < g_cfg.n_readers; i++) {
+		reader* rd = &readers[i];
+
+		rd->verify = verify;
+		rd->rand_state = 0x9E3779B97F4A7C15ULL * (i + 1) + *p_reads;
+		rd->fd = open(g_cfg.path, O_RDONLY | (g_cfg.direct ? O_DIRECT : 0));
+
+		if (rd->fd < 0 || ! bench_lat_init(&rd->lat, LAT_SAMPLES_PER_READER)) {
+			fprintf(stderr, "reader setup failed: %s\n", strerror(errno));
+			exit(1);
+		}
+	}
+
+	uint64_t start_ns = bench_now_ns();
+
+	for (uint32_t i = 0; i < g_cfg.n_readers; i++) {
+		pthread_create(&readers[i].thread, NULL, run_reader, &readers[i]);
+	}
+
+	sleep(g_cfg.duration_sec);
+	g_stop = true;
+
+	uint64_t n_errors = 0;
+	uint64_t n_mismatches = 0;
+
+	for (uint32_t i = 0; i < g_cfg.n_readers; i++) {
+		reader* rd = &readers[i];
+
+		pthread_join(rd->thread, NULL);
+
+		*p_reads += rd->n_reads;
+		n_errors += rd->n_errors;
+		n_mismatches += rd->n_mismatches;
+		bench_lat_merge(all, &rd->lat);
+		bench_lat_destroy(&rd->lat);
+		close(rd->fd);
+	}
+
+	*p_elapsed_ns += bench_now_ns() - start_ns;
+
+	free(readers);
+
+	if (n_errors != 0 || n_mismatches != 0) {
+		printf("%s: %lu read errors, %lu checksum mismatches\n",
+				verify ? "read + verify" : "read", n_errors, n_mismatches);
+	}
+
+	return n_errors == 0 && n_mismatches == 0;
+}
+
+static void*
+run_reader(void* udata)
+{
+	reader* rd = (reader*)udata;
+	uint8_t* buf;
+
+	if (posix_memalign((void**)&buf, 4096, g_cfg.slot_size) != 0) {
+		fprintf(stderr, "can't allocate read buffer\n");
+		exit(1);
+	}
+
+	const record_head* head = (const record_head*)buf;
+
+	while (! g_stop) {
+		off_t offset = (off_t)((bench_rand(&rd->rand_state) % g_cfg.n_slots) *
+				g_cfg.slot_size);
+		uint64_t start_ns = bench_now_ns();
+
+		if (pread(rd->fd, buf, g_cfg.slot_size, offset) !=
+				(ssize_t)g_cfg.slot_size) {
+			rd->n_errors++;
+			continue;
+		}
+
+		// What a storage read adds with enable-checksum - bounded by what
+		// was read, like the storage layer's length sanity check.
+		if (rd->verify) {
+			uint32_t length = head->length;
+
+			if (head->checksum_magic != CHECKSUM_MAGIC ||
+					length > g_cfg.slot_size - sizeof(record_head) ||
+					cf_crc32c(0, buf + sizeof(record_head), length) !=
+							head->checksum) {
+				rd->n_mismatches++;
+			}
+		}
+
+		bench_lat_add(&rd->lat, bench_now_ns() - start_ns);
+		rd->n_reads++;
+	}
+
+	free(buf);
+
+	return NULL;
+}
@@ -0,0 +1,440 @@
+/*
+ * fabric_write_bench.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Fabric buffer writes over TCP loopback - a stream of small messages with a
+ * big one every so often, serialized and sent the way fabric_buffer_write_fill()
+ * does it, compared against how it used to:
+ *
+ *   requeue   - a message that doesn't fit behind others is put back, the
+ *               in-place buffer is sent, then the message goes out alone from
+ *               a freshly allocated buffer - two syscalls and a malloc
+ *   vectored  - the message goes in a kept overflow buffer behind the in-place
+ *               buffer, and both go out in one sendmsg()
+ *
+ * Reports msgs/sec, MB/sec and send syscalls per message.
+ *
+ * Usage: fabric_write_bench [options] - see usage().
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "bench.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// As in fabric.c.
+#define INPLACE_SZ (1024 * 128)
+#define OVERFLOW_KEEP_SZ (1024 * 1024)
+
+#define READ_SZ (1024 * 1024)
+
+typedef enum {
+	MODE_REQUEUE,
+	MODE_VECTORED
+} bench_mode;
+
+typedef struct sender_s {
+	int			fd;
+	uint8_t		in_place[INPLACE_SZ];
+	size_t		in_place_len;
+	uint8_t*	overflow;
+	size_t		overflow_capacity;
+	uint64_t	n_syscalls;
+} sender;
+
+
+//==========================================================
+// Globals.
+//
+
+static uint32_t g_small_sz = 256;
+static uint32_t g_big_sz = 256 * 1024;
+static uint32_t g_big_every = 64;
+static uint64_t g_n_msgs = 1000 * 1000;
+
+static uint8_t* g_msg_src; // message bytes - g_big_sz of them
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void usage(const char* prog);
+static bool connect_pair(int* p_send_fd, int* p_recv_fd);
+static void run_mode(bench_mode mode);
+static void* run_receiver(void* udata);
+static uint32_t msg_sz(uint64_t i);
+static void send_all(sender* s, struct iovec* iov, int n_iov);
+static void send_requeue(sender* s);
+static void send_vectored(sender* s);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char* argv[])
+{
+	const char* modes = "requeue,vectored";
+	int c;
+
+	while ((c = getopt(argc, argv, "s:b:k:n:m:h")) != -1) {
+		switch (c) {
+		case 's':
+			g_small_sz = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			g_big_sz = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			g_big_every = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			g_n_msgs = strtoull(optarg, NULL, 0);
+			break;
+		case 'm':
+			modes = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (g_small_sz == 0 || g_small_sz > INPLACE_SZ || g_big_sz < g_small_sz ||
+			g_n_msgs == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	g_msg_src = malloc(g_big_sz);
+	memset(g_msg_src, 0xA5, g_big_sz);
+
+	printf("%lu msgs of %u bytes, every %u-th %u bytes, %u-byte in-place buffer\n",
+			g_n_msgs, g_small_sz, g_big_every, g_big_sz, INPLACE_SZ);
+
+	char* list = strdup(modes);
+	char* save = NULL;
+	bool ok = true;
+
+	for (char* name = strtok_r(list, ",", &save); name;
+			name = strtok_r(NULL, ",", &save)) {
+		if (strcmp(name, "requeue") == 0) {
+			run_mode(MODE_REQUEUE);
+		}
+		else if (strcmp(name, "vectored") == 0) {
+			run_mode(MODE_VECTORED);
+		}
+		else {
+			fprintf(stderr, "unknown mode %s\n", name);
+			ok = false;
+		}
+	}
+
+	free(list);
+	free(g_msg_src);
+
+	return ok ? 0 : 1;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static void
+usage(const char* prog)
+{
+	fprintf(stderr, "usage: %s [options]\n", prog);
+	fprintf(stderr, "  -s <bytes>  small message size, max %d (default 256)\n", INPLACE_SZ);
+	fprintf(stderr, "  -b <bytes>  big message size (default 262144)\n");
+	fprintf(stderr, "  -k <n>      every n-th message is big, 0 for none (default 64)\n");
+	fprintf(stderr, "  -n <n>      messages per mode (default 1000000)\n");
+	fprintf(stderr, "  -m <list>   modes to compare (default requeue,vectored)\n");
+}
+
+static bool
+connect_pair(int* p_send_fd, int* p_recv_fd)
+{
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr = {
+			.sin_family = AF_INET,
+			.sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+	};
+	socklen_t addr_len = sizeof(addr);
+
+	if (listen_fd < 0 ||
+			bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+			listen(listen_fd, 1) != 0 ||
+			getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len) != 0) {
+		return false;
+	}
+
+	int send_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (send_fd < 0 ||
+			connect(send_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		return false;
+	}
+
+	int recv_fd = accept(listen_fd, NULL, NULL);
+
+	close(listen_fd);
+
+	if (recv_fd < 0) {
+		return false;
+	}
+
+	// Like fabric connections.
+	int one = 1;
+
+	setsockopt(send_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	*p_send_fd = send_fd;
+	*p_recv_fd = recv_fd;
+
+	return true;
+}
+
+static void
+run_mode(bench_mode mode)
+{
+	int recv_fd;
+	sender* s = calloc(1, sizeof(sender));
+
+	if (! connect_pair(&s->fd, &recv_fd)) {
+		fprintf(stderr, "can't connect: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	pthread_t receiver;
+	uint64_t n_received = 0;
+	uint64_t n_bytes = 0;
+
+	for (uint64_t i = 0; i < g_n_msgs; i++) {
+		n_bytes += msg_sz(i);
+	}
+
+	void* args[2] = { &recv_fd, &n_received };
+
+	pthread_create(&receiver, NULL, run_receiver, args);
+
+	uint64_t start_ns = bench_now_ns();
+
+	if (mode == MODE_REQUEUE) {
+		send_requeue(s);
+	}
+	else {
+		send_vectored(s);
+	}
+
+	shutdown(s->fd, SHUT_WR);
+	pthread_join(receiver, NULL);
+
+	uint64_t elapsed_ns = bench_now_ns() - start_ns;
+
+	if (n_received != n_bytes) {
+		fprintf(stderr, "received %lu of %lu bytes\n", n_received, n_bytes);
+	}
+
+	printf("%-12s %12.0f msgs/sec   %8.1f MB/sec   %6.3f syscalls/msg\n",
+			mode == MODE_REQUEUE ? "requeue" : "vectored",
+			(double)g_n_msgs * 1e9 / (double)elapsed_ns,
+			(double)n_bytes * 1e9 / (double)elapsed_ns / (1024 * 1024),
+			(double)s->n_syscalls / (double)g_n_msgs);
+
+	close(s->fd);
+	close(recv_fd);
+	free(s->overflow);
+	free(s);
+}
+
+static void*
+run_receiver(void* udata)
+{
+	void** args = (void**)udata;
+	int fd = *(int*)args[0];
+	uint64_t* p_n_received = (uint64_t*)args[1];
+	uint8_t* buf = malloc(READ_SZ);
+	ssize_t rv;
+
+	while ((rv = read(fd, buf, READ_SZ)) > 0 || (rv < 0 && errno == EINTR)) {
+		if (rv > 0) {
+			*p_n_received += (uint64_t)rv;
+		}
+	}
+
+	free(buf);
+
+	return NULL;
+}
+
+static uint32_t
+msg_sz(uint64_t i)
+{
+	return g_big_every != 0 && i % g_big_every == g_big_every - 1 ?
+			g_big_sz : g_small_sz;
+}
+
+// Send everything, counting syscalls - picks up after partial writes.
+static void
+send_all(sender* s, struct iovec* iov, int n_iov)
+{
+	while (n_iov != 0) {
+		struct msghdr mh = { .msg_iov = iov, .msg_iovlen = (size_t)n_iov };
+		ssize_t rv = sendmsg(s->fd, &mh, MSG_NOSIGNAL);
+
+		s->n_syscalls++;
+
+		if (rv < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			fprintf(stderr, "send failed: %s\n", strerror(errno));
+			exit(1);
+		}
+
+		size_t sent = (size_t)rv;
+
+		while (n_iov != 0 && sent >= iov->iov_len) {
+			sent -= iov->iov_len;
+			iov++;
+			n_iov--;
+		}
+
+		if (n_iov != 0) {
+			iov->iov_base = (uint8_t*)iov->iov_base + sent;
+			iov->iov_len -= sent;
+		}
+	}
+}
+
+// The old way - a message that doesn't fit behind others waits for the next
+// write, and then goes out alone from its own allocation.
+static void
+send_requeue(sender* s)
+{
+	uint64_t i = 0;
+
+	while (i < g_n_msgs) {
+		s->in_place_len = 0;
+
+		uint32_t sz = msg_sz(i);
+
+		if (sz > INPLACE_SZ) {
+			uint8_t* buf = malloc(sz);
+
+			memcpy(buf, g_msg_src, sz);
+
+			struct iovec iov = { .iov_base = buf, .iov_len = sz };
+
+			send_all(s, &iov, 1);
+			free(buf);
+			i++;
+			continue;
+		}
+
+		while (i < g_n_msgs && (sz = msg_sz(i)) <= INPLACE_SZ - s->in_place_len) {
+			memcpy(&s->in_place[s->in_place_len], g_msg_src, sz);
+			s->in_place_len += sz;
+			i++;
+		}
+
+		struct iovec iov = { .iov_base = s->in_place, .iov_len = s->in_place_len };
+
+		send_all(s, &iov, 1);
+	}
+}
+
+// The current way - the message that doesn't fit goes in the kept overflow
+// buffer, and both go out together.
+static void
+send_vectored(sender* s)
+{
+	uint64_t i = 0;
+
+	while (i < g_n_msgs) {
+		s->in_place_len = 0;
+
+		size_t overflow_len = 0;
+
+		while (i < g_n_msgs) {
+			uint32_t sz = msg_sz(i++);
+
+			if (sz <= INPLACE_SZ - s->in_place_len) {
+				memcpy(&s->in_place[s->in_place_len], g_msg_src, sz);
+				s->in_place_len += sz;
+				continue;
+			}
+
+			if (sz > s->overflow_capacity) {
+				free(s->overflow);
+				s->overflow = malloc(sz);
+				s->overflow_capacity = sz;
+			}
+
+			memcpy(s->overflow, g_msg_src, sz);
+			overflow_len = sz;
+			break; // nothing may follow an overflow message
+		}
+
+		struct iovec iov[2] = {
+				{ .iov_base = s->in_place, .iov_len = s->in_place_len },
+				{ .iov_base = s->overflow, .iov_len = overflow_len }
+		};
+
+		if (s->in_place_len == 0) {
+			send_all(s, &iov[1], 1);
+		}
+		else {
+			send_all(s, iov, overflow_len == 0 ? 1 : 2);
+		}
+
+		if (s->overflow_capacity > OVERFLOW_KEEP_SZ) {
+			free(s->overflow);
+			s->overflow = NULL;
+			s->overflow_capacity = 0;
+		}
+	}
+}
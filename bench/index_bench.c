@@ -0,0 +1,324 @@
+/*
+ * index_bench.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Index engines compared - inserts/sec building an index of random digests,
+ * lookups/sec of random existing keys from one or more threads, and index
+ * bytes per record. Each key is inserted and looked up as a transaction does
+ * it, reserving the element and taking its record lock.
+ *
+ * Bytes/record counts the arena element each record has with either engine,
+ * plus the B+tree nodes for btree.
+ *
+ * Usage: index_bench [options] - see usage().
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_digest.h"
+
+#include "arenax.h"
+#include "olock.h"
+
+#include "base/cfg.h"
+#include "base/datamodel.h"
+#include "base/index.h"
+#include "base/index_btree.h"
+
+#include "bench.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define MAX_PARTITIONS 4096
+#define MAX_THREADS 256
+
+typedef struct looker_s {
+	pthread_t	thread;
+	uint64_t	rand_state;
+	uint64_t	n_lookups;
+} looker;
+
+
+//==========================================================
+// Globals.
+//
+
+as_config g_config;
+
+static uint64_t g_n_keys = 10 * 1000 * 1000;
+static uint32_t g_n_partitions = MAX_PARTITIONS;
+static uint32_t g_n_sprigs = 1;
+static uint32_t g_n_threads = 1;
+static uint64_t g_n_lookups = 10 * 1000 * 1000; // per thread
+
+static as_index_tree* g_trees[MAX_PARTITIONS];
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void usage(const char* prog);
+static void make_digest(uint64_t i, cf_digest* keyd);
+static as_index_tree* tree_of(cf_digest* keyd);
+static bool run_engine(as_index_engine engine);
+static void* run_looker(void* udata);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char* argv[])
+{
+	const char* engines = "rbtree,btree";
+	int c;
+
+	while ((c = getopt(argc, argv, "n:p:s:t:l:e:h")) != -1) {
+		switch (c) {
+		case 'n':
+			g_n_keys = strtoull(optarg, NULL, 0);
+			break;
+		case 'p':
+			g_n_partitions = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			g_n_sprigs = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			g_n_threads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			g_n_lookups = strtoull(optarg, NULL, 0);
+			break;
+		case 'e':
+			engines = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (g_n_keys == 0 || g_n_partitions == 0 ||
+			g_n_partitions > MAX_PARTITIONS || g_n_sprigs == 0 ||
+			(g_n_sprigs & (g_n_sprigs - 1)) != 0 ||
+			g_n_sprigs > MAX_PARTITION_TREE_SPRIGS || g_n_threads == 0 ||
+			g_n_threads > MAX_THREADS) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	g_config.record_locks = olock_create(16 * 1024, OLOCK_TYPE_MUTEX, NULL);
+
+	printf("%lu keys in %u partitions x %u sprigs, %u threads x %lu lookups\n",
+			g_n_keys, g_n_partitions, g_n_sprigs, g_n_threads, g_n_lookups);
+
+	char* list = strdup(engines);
+	char* save = NULL;
+	bool ok = true;
+
+	for (char* name = strtok_r(list, ",", &save); name;
+			name = strtok_r(NULL, ",", &save)) {
+		if (strcmp(name, "rbtree") == 0) {
+			ok = run_engine(AS_INDEX_ENGINE_RBTREE) && ok;
+		}
+		else if (strcmp(name, "btree") == 0) {
+			ok = run_engine(AS_INDEX_ENGINE_BTREE) && ok;
+		}
+		else {
+			fprintf(stderr, "unknown engine %s\n", name);
+			ok = false;
+		}
+	}
+
+	free(list);
+
+	return ok ? 0 : 1;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static void
+usage(const char* prog)
+{
+	fprintf(stderr, "usage: %s [options]\n", prog);
+	fprintf(stderr, "  -n <n>      keys in the index (default 10000000)\n");
+	fprintf(stderr, "  -p <n>      partitions, max %d (default %d)\n", MAX_PARTITIONS, MAX_PARTITIONS);
+	fprintf(stderr, "  -s <n>      sprigs per partition, power of 2 (default 1)\n");
+	fprintf(stderr, "  -t <n>      lookup threads, max %d (default 1)\n", MAX_THREADS);
+	fprintf(stderr, "  -l <n>      lookups per thread (default 10000000)\n");
+	fprintf(stderr, "  -e <list>   engines to compare (default rbtree,btree)\n");
+}
+
+// Spread the key number over the whole digest, like RIPEMD-160 would.
+static void
+make_digest(uint64_t i, cf_digest* keyd)
+{
+	uint64_t state = (i + 1) * 0x9E3779B97F4A7C15ULL;
+
+	for (uint32_t n = 0; n < CF_DIGEST_KEY_SZ; n += sizeof(uint64_t)) {
+		uint64_t x = bench_rand(&state);
+		uint32_t sz = CF_DIGEST_KEY_SZ - n < sizeof(uint64_t) ?
+				CF_DIGEST_KEY_SZ - n : sizeof(uint64_t);
+
+		memcpy(&keyd->digest[n], &x, sz);
+	}
+}
+
+static as_index_tree*
+tree_of(cf_digest* keyd)
+{
+	return g_trees[as_partition_getid(*keyd) % g_n_partitions];
+}
+
+static bool
+run_engine(as_index_engine engine)
+{
+	const char* label = engine == AS_INDEX_ENGINE_BTREE ? "btree" : "rbtree";
+	cf_arenax* arena = malloc(cf_arenax_sizeof());
+	cf_arenax_err err = cf_arenax_create(arena, 0, sizeof(as_index),
+			MAX_STAGE_CAPACITY, CF_ARENAX_MAX_STAGES, 0);
+
+	if (err != CF_ARENAX_OK) {
+		fprintf(stderr, "can't create arena: %s\n", cf_arenax_errstr(err));
+		return false;
+	}
+
+	for (uint32_t i = 0; i < g_n_partitions; i++) {
+		if (! (g_trees[i] = as_index_tree_create(arena, NULL, NULL, engine,
+				g_n_sprigs, NULL))) {
+			fprintf(stderr, "can't create tree\n");
+			return false;
+		}
+	}
+
+	// Build the index.
+	uint64_t start_ns = bench_now_ns();
+
+	for (uint64_t i = 0; i < g_n_keys; i++) {
+		cf_digest keyd;
+		as_index_ref r_ref;
+
+		make_digest(i, &keyd);
+		r_ref.skip_lock = false;
+
+		if (as_index_get_insert_vlock(tree_of(&keyd), &keyd, &r_ref) != 1) {
+			fprintf(stderr, "insert failed\n");
+			return false;
+		}
+
+		pthread_mutex_unlock(r_ref.olock);
+		as_index_release(r_ref.r);
+	}
+
+	uint64_t insert_ns = bench_now_ns() - start_ns;
+
+	// Look up existing keys.
+	looker* lookers = calloc(g_n_threads, sizeof(looker));
+
+	start_ns = bench_now_ns();
+
+	for (uint32_t i = 0; i < g_n_threads; i++) {
+		lookers[i].rand_state = 0x2545F4914F6CDD1DULL * (i + 1);
+		pthread_create(&lookers[i].thread, NULL, run_looker, &lookers[i]);
+	}
+
+	uint64_t n_lookups = 0;
+
+	for (uint32_t i = 0; i < g_n_threads; i++) {
+		pthread_join(lookers[i].thread, NULL);
+		n_lookups += lookers[i].n_lookups;
+	}
+
+	uint64_t lookup_ns = bench_now_ns() - start_ns;
+
+	// Every record has an arena element - B+tree nodes are extra.
+	uint64_t index_bytes = g_n_keys * sizeof(as_index);
+
+	for (uint32_t i = 0; i < g_n_partitions; i++) {
+		as_index_tree* tree = g_trees[i];
+
+		for (uint32_t s = 0; s < tree->n_sprigs; s++) {
+			if (engine == AS_INDEX_ENGINE_BTREE) {
+				index_bytes += as_btree_size(&tree->sprigs[s].btree);
+				as_btree_destroy(&tree->sprigs[s].btree);
+			}
+		}
+
+		cf_rc_free(tree);
+	}
+
+	printf("%-8s inserts %12.0f /sec   lookups %12.0f /sec   %6.1f bytes/record\n",
+			label, (double)g_n_keys * 1e9 / (double)insert_ns,
+			(double)n_lookups * 1e9 / (double)lookup_ns,
+			(double)index_bytes / (double)g_n_keys);
+
+	free(lookers);
+	cf_arenax_destroy(arena);
+	free(arena);
+
+	return n_lookups == (uint64_t)g_n_threads * g_n_lookups;
+}
+
+static void*
+run_looker(void* udata)
+{
+	looker* lk = (looker*)udata;
+
+	for (uint64_t i = 0; i < g_n_lookups; i++) {
+		cf_digest keyd;
+		as_index_ref r_ref;
+
+		make_digest(bench_rand(&lk->rand_state) % g_n_keys, &keyd);
+		r_ref.skip_lock = false;
+
+		if (as_index_get_vlock(tree_of(&keyd), &keyd, &r_ref) != 0) {
+			fprintf(stderr, "key not found\n");
+			break;
+		}
+
+		pthread_mutex_unlock(r_ref.olock);
+		as_index_release(r_ref.r);
+		lk->n_lookups++;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,445 @@
+/*
+ * index_read_bench.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Point reads of a red-black index while writers insert and delete in the same
+ * sprigs - reads/sec and p50/p99 read latency for the two read paths:
+ *
+ *   locked      - search under the sprig lock, as every read used to
+ *   optimistic  - as_index_get_vlock(), which first searches without the
+ *                 sprig lock and only takes it after losing repeated races
+ *
+ * Readers look up a stable key set, so every read must find its key - misses
+ * are reported as errors. Writers churn a disjoint key set.
+ *
+ * Usage: index_read_bench [options] - see usage().
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_digest.h"
+
+#include "arenax.h"
+#include "olock.h"
+
+#include "base/cfg.h"
+#include "base/datamodel.h"
+#include "base/index.h"
+
+#include "bench.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define MAX_PARTITIONS 4096
+#define MAX_THREADS 256
+#define LAT_SAMPLES_PER_READER (1024 * 1024)
+
+// Keys each writer keeps inserted while churning.
+#define CHURN_WINDOW 1024
+
+typedef struct reader_s {
+	pthread_t	thread;
+	bool		locked;
+	uint64_t	rand_state;
+	uint64_t	n_reads;
+	uint64_t	n_misses;
+	bench_lat	lat;
+} reader;
+
+typedef struct writer_s {
+	pthread_t	thread;
+	uint64_t	id;
+	uint64_t	n_writes;
+} writer;
+
+
+//==========================================================
+// Globals.
+//
+
+as_config g_config;
+
+static uint64_t g_n_keys = 1000 * 1000;
+static uint32_t g_n_partitions = 64;
+static uint32_t g_n_sprigs = 1;
+static uint32_t g_n_readers = 4;
+static uint32_t g_n_writers = 1;
+static uint32_t g_duration_sec = 10;
+
+static as_index_tree* g_trees[MAX_PARTITIONS];
+static volatile bool g_stop = false;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+// Not in index.h - the read paths being compared.
+int as_index_search_lockless(as_index_tree *tree, as_index_sprig *sprig, cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h);
+
+static void usage(const char* prog);
+static void make_digest(uint64_t i, cf_digest* keyd);
+static as_index_tree* tree_of(cf_digest* keyd);
+static void run_mode(bool locked);
+static void* run_reader(void* udata);
+static void* run_writer(void* udata);
+static bool read_locked(cf_digest* keyd);
+static bool read_optimistic(cf_digest* keyd);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char* argv[])
+{
+	const char* modes = "locked,optimistic";
+	int c;
+
+	while ((c = getopt(argc, argv, "n:p:s:r:w:d:m:h")) != -1) {
+		switch (c) {
+		case 'n':
+			g_n_keys = strtoull(optarg, NULL, 0);
+			break;
+		case 'p':
+			g_n_partitions = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			g_n_sprigs = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			g_n_readers = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			g_n_writers = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			g_duration_sec = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			modes = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (g_n_keys == 0 || g_n_partitions == 0 ||
+			g_n_partitions > MAX_PARTITIONS || g_n_sprigs == 0 ||
+			(g_n_sprigs & (g_n_sprigs - 1)) != 0 ||
+			g_n_sprigs > MAX_PARTITION_TREE_SPRIGS || g_n_readers == 0 ||
+			g_n_readers > MAX_THREADS || g_n_writers > MAX_THREADS) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	g_config.record_locks = olock_create(16 * 1024, OLOCK_TYPE_MUTEX, NULL);
+
+	cf_arenax* arena = malloc(cf_arenax_sizeof());
+	cf_arenax_err err = cf_arenax_create(arena, 0, sizeof(as_index),
+			MAX_STAGE_CAPACITY, CF_ARENAX_MAX_STAGES, 0);
+
+	if (err != CF_ARENAX_OK) {
+		fprintf(stderr, "can't create arena: %s\n", cf_arenax_errstr(err));
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < g_n_partitions; i++) {
+		if (! (g_trees[i] = as_index_tree_create(arena, NULL, NULL,
+				AS_INDEX_ENGINE_RBTREE, g_n_sprigs, NULL))) {
+			fprintf(stderr, "can't create tree\n");
+			return 1;
+		}
+	}
+
+	for (uint64_t i = 0; i < g_n_keys; i++) {
+		cf_digest keyd;
+		as_index_ref r_ref;
+
+		make_digest(i, &keyd);
+		r_ref.skip_lock = false;
+
+		if (as_index_get_insert_vlock(tree_of(&keyd), &keyd, &r_ref) != 1) {
+			fprintf(stderr, "insert failed\n");
+			return 1;
+		}
+
+		pthread_mutex_unlock(r_ref.olock);
+		as_index_release(r_ref.r);
+	}
+
+	printf("%lu keys in %u partitions x %u sprigs, %u readers, %u writers, %u sec\n",
+			g_n_keys, g_n_partitions, g_n_sprigs, g_n_readers, g_n_writers,
+			g_duration_sec);
+
+	char* list = strdup(modes);
+	char* save = NULL;
+	bool ok = true;
+
+	for (char* name = strtok_r(list, ",", &save); name;
+			name = strtok_r(NULL, ",", &save)) {
+		if (strcmp(name, "locked") == 0) {
+			run_mode(true);
+		}
+		else if (strcmp(name, "optimistic") == 0) {
+			run_mode(false);
+		}
+		else {
+			fprintf(stderr, "unknown mode %s\n", name);
+			ok = false;
+		}
+	}
+
+	free(list);
+
+	return ok ? 0 : 1;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static void
+usage(const char* prog)
+{
+	fprintf(stderr, "usage: %s [options]\n", prog);
+	fprintf(stderr, "  -n <n>      stable keys read (default 1000000)\n");
+	fprintf(stderr, "  -p <n>      partitions, max %d (default 64)\n", MAX_PARTITIONS);
+	fprintf(stderr, "  -s <n>      sprigs per partition, power of 2 (default 1)\n");
+	fprintf(stderr, "  -r <n>      reader threads, max %d (default 4)\n", MAX_THREADS);
+	fprintf(stderr, "  -w <n>      writer threads, max %d (default 1)\n", MAX_THREADS);
+	fprintf(stderr, "  -d <sec>    duration per mode (default 10)\n");
+	fprintf(stderr, "  -m <list>   modes to compare (default locked,optimistic)\n");
+}
+
+// Spread the key number over the whole digest, like RIPEMD-160 would.
+static void
+make_digest(uint64_t i, cf_digest* keyd)
+{
+	uint64_t state = (i + 1) * 0x9E3779B97F4A7C15ULL;
+
+	for (uint32_t n = 0; n < CF_DIGEST_KEY_SZ; n += sizeof(uint64_t)) {
+		uint64_t x = bench_rand(&state);
+		uint32_t sz = CF_DIGEST_KEY_SZ - n < sizeof(uint64_t) ?
+				CF_DIGEST_KEY_SZ - n : sizeof(uint64_t);
+
+		memcpy(&keyd->digest[n], &x, sz);
+	}
+}
+
+static as_index_tree*
+tree_of(cf_digest* keyd)
+{
+	return g_trees[as_partition_getid(*keyd) % g_n_partitions];
+}
+
+static void
+run_mode(bool locked)
+{
+	const char* label = locked ? "locked" : "optimistic";
+	reader* readers = calloc(g_n_readers, sizeof(reader));
+	writer* writers = calloc(g_n_writers, sizeof(writer));
+
+	g_stop = false;
+
+	for (uint32_t i = 0; i < g_n_writers; i++) {
+		writers[i].id = i;
+		pthread_create(&writers[i].thread, NULL, run_writer, &writers[i]);
+	}
+
+	uint64_t start_ns = bench_now_ns();
+
+	for (uint32_t i = 0; i < g_n_readers; i++) {
+		reader* rd = &readers[i];
+
+		rd->locked = locked;
+		rd->rand_state = 0x2545F4914F6CDD1DULL * (i + 1);
+		bench_lat_init(&rd->lat, LAT_SAMPLES_PER_READER);
+		pthread_create(&rd->thread, NULL, run_reader, rd);
+	}
+
+	sleep(g_duration_sec);
+	g_stop = true;
+
+	bench_lat all;
+	uint64_t n_reads = 0;
+	uint64_t n_misses = 0;
+	uint64_t n_writes = 0;
+
+	bench_lat_init(&all, LAT_SAMPLES_PER_READER * 4);
+
+	for (uint32_t i = 0; i < g_n_readers; i++) {
+		pthread_join(readers[i].thread, NULL);
+		n_reads += readers[i].n_reads;
+		n_misses += readers[i].n_misses;
+		bench_lat_merge(&all, &readers[i].lat);
+		bench_lat_destroy(&readers[i].lat);
+	}
+
+	uint64_t elapsed_ns = bench_now_ns() - start_ns;
+
+	for (uint32_t i = 0; i < g_n_writers; i++) {
+		pthread_join(writers[i].thread, NULL);
+		n_writes += writers[i].n_writes;
+	}
+
+	bench_lat_report(label, &all, n_reads, elapsed_ns);
+	printf("%-24s %12.0f writes/sec   %lu read misses\n", "",
+			(double)n_writes * 1e9 / (double)elapsed_ns, n_misses);
+
+	bench_lat_destroy(&all);
+	free(writers);
+	free(readers);
+}
+
+static void*
+run_reader(void* udata)
+{
+	reader* rd = (reader*)udata;
+
+	while (! g_stop) {
+		cf_digest keyd;
+
+		make_digest(bench_rand(&rd->rand_state) % g_n_keys, &keyd);
+
+		uint64_t start_ns = bench_now_ns();
+		bool found = rd->locked ? read_locked(&keyd) : read_optimistic(&keyd);
+
+		bench_lat_add(&rd->lat, bench_now_ns() - start_ns);
+
+		rd->n_reads++;
+
+		if (! found) {
+			rd->n_misses++;
+		}
+	}
+
+	return NULL;
+}
+
+// Insert new keys and delete old ones, keeping CHURN_WINDOW inserted. Writer
+// keys are numbered past the stable keys, so readers never look for them.
+static void*
+run_writer(void* udata)
+{
+	writer* wr = (writer*)udata;
+	uint64_t base = g_n_keys + (wr->id << 40);
+	uint64_t i = 0;
+
+	while (! g_stop) {
+		cf_digest keyd;
+		as_index_ref r_ref;
+
+		make_digest(base + i, &keyd);
+		r_ref.skip_lock = false;
+
+		if (as_index_get_insert_vlock(tree_of(&keyd), &keyd, &r_ref) >= 0) {
+			pthread_mutex_unlock(r_ref.olock);
+			as_index_release(r_ref.r);
+		}
+
+		if (i >= CHURN_WINDOW) {
+			make_digest(base + i - CHURN_WINDOW, &keyd);
+			as_index_delete(tree_of(&keyd), &keyd);
+		}
+
+		i++;
+		wr->n_writes += i > CHURN_WINDOW ? 2 : 1;
+	}
+
+	// Leave the trees as we found them for the next mode.
+	for (uint64_t j = i > CHURN_WINDOW ? i - CHURN_WINDOW : 0; j < i; j++) {
+		cf_digest keyd;
+
+		make_digest(base + j, &keyd);
+		as_index_delete(tree_of(&keyd), &keyd);
+	}
+
+	return NULL;
+}
+
+// The read path before lock-free search - the sprig lock around the search.
+static bool
+read_locked(cf_digest* keyd)
+{
+	as_index_tree* tree = tree_of(keyd);
+	as_index_sprig* sprig = &tree->sprigs[*(uint32_t*)&keyd->digest[8] &
+			(tree->n_sprigs - 1)];
+	as_index* r;
+	cf_arenax_handle r_h;
+
+	pthread_mutex_lock(&sprig->lock);
+
+	int rv = as_index_search_lockless(tree, sprig, keyd, &r, &r_h);
+
+	if (rv == 0) {
+		as_index_reserve(r);
+	}
+
+	pthread_mutex_unlock(&sprig->lock);
+
+	if (rv != 0) {
+		return false;
+	}
+
+	pthread_mutex_t* olock;
+
+	olock_vlock(g_config.record_locks, keyd, &olock);
+	pthread_mutex_unlock(olock);
+	as_index_release(r);
+
+	return true;
+}
+
+static bool
+read_optimistic(cf_digest* keyd)
+{
+	as_index_ref r_ref;
+
+	r_ref.skip_lock = false;
+
+	if (as_index_get_vlock(tree_of(keyd), keyd, &r_ref) != 0) {
+		return false;
+	}
+
+	pthread_mutex_unlock(r_ref.olock);
+	as_index_release(r_ref.r);
+
+	return true;
+}
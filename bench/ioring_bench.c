@@ -0,0 +1,506 @@
+/*
+ * ioring_bench.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Random device I/O through each cf_ioring engine, against the current inline
+ * path - IOPS and p50/p99 latency. The "pread" engine is the current path:
+ * blocking pread()/pwritev() in the calling thread, one at a time, as a
+ * transaction's record read does. The other engines keep up to -q operations
+ * in flight per thread, the way defrag and cold start read ahead (-s at the
+ * write-block-size) and the write queue flushes batched swbs (-W).
+ *
+ * Use -c to create a file-backed namespace's device file first.
+ *
+ * Usage: ioring_bench -f <file-or-device> [options] - see usage().
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include "ioring.h"
+
+#include "bench.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define MAX_READERS 256
+#define MAX_QUEUE_DEPTH 256
+#define LAT_SAMPLES_PER_READER (1024 * 1024)
+
+// Not a cf_ioring_type - the current inline path, without a ring.
+#define ENGINE_PREAD CF_IORING_NUM_TYPES
+
+typedef struct bench_cfg_s {
+	const char*	path;
+	uint32_t	io_size;
+	uint32_t	n_readers;
+	uint32_t	queue_depth;
+	uint32_t	duration_sec;
+	uint32_t	io_threads;
+	uint64_t	create_mb;
+	bool		write;
+	bool		direct;
+	uint64_t	n_blocks; // of io_size in the file
+} bench_cfg;
+
+typedef struct reader_s {
+	pthread_t	thread;
+	cf_ioring*	ring;
+	int			fd;
+	uint64_t	rand_state;
+	uint64_t	n_ops;
+	uint64_t	n_errors;
+	bench_lat	lat;
+} reader;
+
+
+//==========================================================
+// Globals.
+//
+
+static bench_cfg g_cfg = {
+		.io_size = 4096,
+		.n_readers = 8,
+		.queue_depth = 1,
+		.duration_sec = 10,
+		.io_threads = 4,
+		.direct = true
+};
+
+static volatile bool g_stop = false;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void usage(const char* prog);
+static uint64_t file_size(int fd);
+static bool create_file(void);
+static bool run_engine(cf_ioring_type type);
+static void* run_reader(void* udata);
+static void* run_inline(void* udata);
+static void submit_op(reader* rd, cf_ioring_op* op, uint8_t* buf,
+		struct iovec* iov);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char* argv[])
+{
+	const char* engines = "pread,sync,threads,io_uring";
+	int c;
+
+	while ((c = getopt(argc, argv, "f:s:t:q:d:w:e:c:WBh")) != -1) {
+		switch (c) {
+		case 'f':
+			g_cfg.path = optarg;
+			break;
+		case 's':
+			g_cfg.io_size = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			g_cfg.n_readers = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			g_cfg.queue_depth = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			g_cfg.duration_sec = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			g_cfg.io_threads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			engines = optarg;
+			break;
+		case 'c':
+			g_cfg.create_mb = strtoull(optarg, NULL, 0);
+			break;
+		case 'W':
+			g_cfg.write = true;
+			break;
+		case 'B':
+			g_cfg.direct = false;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (! g_cfg.path || g_cfg.io_size == 0 || g_cfg.io_size % 512 != 0 ||
+			g_cfg.n_readers == 0 || g_cfg.n_readers > MAX_READERS ||
+			g_cfg.queue_depth == 0 || g_cfg.queue_depth > MAX_QUEUE_DEPTH) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (g_cfg.create_mb != 0 && ! create_file()) {
+		return 1;
+	}
+
+	int fd = open(g_cfg.path, O_RDONLY);
+
+	if (fd < 0) {
+		fprintf(stderr, "can't open %s: %s\n", g_cfg.path, strerror(errno));
+		return 1;
+	}
+
+	g_cfg.n_blocks = file_size(fd) / g_cfg.io_size;
+	close(fd);
+
+	if (g_cfg.n_blocks == 0) {
+		fprintf(stderr, "%s is smaller than one I/O\n", g_cfg.path);
+		return 1;
+	}
+
+	printf("%s: %lu x %u-byte %s, %u threads x depth %u, %u sec, %s\n",
+			g_cfg.path, g_cfg.n_blocks, g_cfg.io_size,
+			g_cfg.write ? "writes" : "reads", g_cfg.n_readers,
+			g_cfg.queue_depth, g_cfg.duration_sec,
+			g_cfg.direct ? "O_DIRECT" : "buffered");
+
+	char* list = strdup(engines);
+	char* save = NULL;
+	bool ok = true;
+
+	for (char* name = strtok_r(list, ",", &save); name;
+			name = strtok_r(NULL, ",", &save)) {
+		cf_ioring_type type = ENGINE_PREAD;
+
+		if (strcmp(name, "pread") != 0) {
+			for (type = 0; type < CF_IORING_NUM_TYPES; type++) {
+				if (strcmp(name, cf_ioring_type_str(type)) == 0) {
+					break;
+				}
+			}
+		}
+
+		if (type == CF_IORING_NUM_TYPES && strcmp(name, "pread") != 0) {
+			fprintf(stderr, "unknown engine %s\n", name);
+			ok = false;
+			continue;
+		}
+
+		ok = run_engine(type) && ok;
+	}
+
+	free(list);
+
+	return ok ? 0 : 1;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static void
+usage(const char* prog)
+{
+	fprintf(stderr, "usage: %s -f <file-or-device> [options]\n", prog);
+	fprintf(stderr, "  -s <bytes>   I/O size, multiple of 512 (default 4096)\n");
+	fprintf(stderr, "  -t <n>       I/O threads (default 8, max %d)\n", MAX_READERS);
+	fprintf(stderr, "  -q <n>       I/Os in flight per thread (default 1, max %d)\n", MAX_QUEUE_DEPTH);
+	fprintf(stderr, "  -d <sec>     duration per engine (default 10)\n");
+	fprintf(stderr, "  -w <n>       worker threads for the threads engine (default 4)\n");
+	fprintf(stderr, "  -e <list>    engines to compare (default pread,sync,threads,io_uring)\n");
+	fprintf(stderr, "               - pread is the current inline path, one I/O at a time\n");
+	fprintf(stderr, "  -c <MiB>     first create the file with this many MiB, as for a file-backed namespace\n");
+	fprintf(stderr, "  -W           vectored writes instead of reads - overwrites the file or device\n");
+	fprintf(stderr, "  -B           buffered I/O instead of O_DIRECT\n");
+}
+
+static uint64_t
+file_size(int fd)
+{
+	struct stat st;
+
+	if (fstat(fd, &st) != 0) {
+		return 0;
+	}
+
+	if (S_ISBLK(st.st_mode)) {
+		uint64_t size = 0;
+
+		return ioctl(fd, BLKGETSIZE64, &size) == 0 ? size : 0;
+	}
+
+	return (uint64_t)st.st_size;
+}
+
+static bool
+create_file(void)
+{
+	int fd = open(g_cfg.path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0) {
+		fprintf(stderr, "can't create %s: %s\n", g_cfg.path, strerror(errno));
+		return false;
+	}
+
+	// Random contents, so nothing below us can shortcut zeroed blocks.
+	uint64_t chunk[(1024 * 1024) / sizeof(uint64_t)];
+	uint64_t rand_state = 0x9E3779B97F4A7C15ULL;
+
+	for (uint64_t mb = 0; mb < g_cfg.create_mb; mb++) {
+		for (size_t i = 0; i < sizeof(chunk) / sizeof(uint64_t); i++) {
+			chunk[i] = bench_rand(&rand_state);
+		}
+
+		if (write(fd, chunk, sizeof(chunk)) != (ssize_t)sizeof(chunk)) {
+			fprintf(stderr, "can't write %s: %s\n", g_cfg.path, strerror(errno));
+			close(fd);
+			return false;
+		}
+	}
+
+	fsync(fd);
+	close(fd);
+
+	return true;
+}
+
+static bool
+run_engine(cf_ioring_type type)
+{
+	cf_ioring* ring = NULL;
+	char label[64];
+
+	if (type == ENGINE_PREAD) {
+		snprintf(label, sizeof(label), "inline (current)");
+	}
+	// Ring depth covers everything the threads can have in flight.
+	else if (! (ring = cf_ioring_create(type,
+			g_cfg.n_readers * g_cfg.queue_depth, g_cfg.io_threads))) {
+		fprintf(stderr, "can't create %s engine\n", cf_ioring_type_str(type));
+		return false;
+	}
+	// Falls back to threads if io_uring isn't available - report what ran.
+	else if (cf_ioring_get_type(ring) == type) {
+		snprintf(label, sizeof(label), "%s", cf_ioring_type_str(type));
+	}
+	else {
+		snprintf(label, sizeof(label), "%s (as %s)", cf_ioring_type_str(type),
+				cf_ioring_type_str(cf_ioring_get_type(ring)));
+	}
+
+	reader* readers = calloc(g_cfg.n_readers, sizeof(reader));
+
+	g_stop = false;
+
+	for (uint32_t i = 0; i < g_cfg.n_readers; i++) {
+		reader* rd = &readers[i];
+
+		rd->ring = ring;
+		rd->rand_state = 0x9E3779B97F4A7C15ULL * (i + 1);
+		rd->fd = open(g_cfg.path, (g_cfg.write ? O_WRONLY : O_RDONLY) |
+				(g_cfg.direct ? O_DIRECT : 0));
+
+		if (rd->fd < 0 || ! bench_lat_init(&rd->lat, LAT_SAMPLES_PER_READER)) {
+			fprintf(stderr, "reader setup failed: %s\n", strerror(errno));
+			exit(1);
+		}
+	}
+
+	uint64_t start_ns = bench_now_ns();
+
+	for (uint32_t i = 0; i < g_cfg.n_readers; i++) {
+		pthread_create(&readers[i].thread, NULL,
+				ring ? run_reader : run_inline, &readers[i]);
+	}
+
+	sleep(g_cfg.duration_sec);
+	g_stop = true;
+
+	bench_lat all;
+	uint64_t n_ops = 0;
+	uint64_t n_errors = 0;
+
+	bench_lat_init(&all, LAT_SAMPLES_PER_READER * 4);
+
+	for (uint32_t i = 0; i < g_cfg.n_readers; i++) {
+		reader* rd = &readers[i];
+
+		pthread_join(rd->thread, NULL);
+
+		n_ops += rd->n_ops;
+		n_errors += rd->n_errors;
+		bench_lat_merge(&all, &rd->lat);
+		bench_lat_destroy(&rd->lat);
+		close(rd->fd);
+	}
+
+	uint64_t elapsed_ns = bench_now_ns() - start_ns;
+
+	bench_lat_report(label, &all, n_ops, elapsed_ns);
+
+	if (n_errors != 0) {
+		printf("%-24s %lu I/O errors\n", label, n_errors);
+	}
+
+	bench_lat_destroy(&all);
+	free(readers);
+
+	if (ring) {
+		cf_ioring_destroy(ring);
+	}
+
+	return n_errors == 0;
+}
+
+static void*
+run_reader(void* udata)
+{
+	reader* rd = (reader*)udata;
+	uint32_t depth = g_cfg.queue_depth;
+
+	cf_ioring_op ops[MAX_QUEUE_DEPTH];
+	uint8_t* bufs[MAX_QUEUE_DEPTH];
+	struct iovec iovs[MAX_QUEUE_DEPTH];
+	uint64_t submit_ns[MAX_QUEUE_DEPTH];
+
+	for (uint32_t i = 0; i < depth; i++) {
+		if (posix_memalign((void**)&bufs[i], 4096, g_cfg.io_size) != 0) {
+			fprintf(stderr, "can't allocate I/O buffer\n");
+			exit(1);
+		}
+
+		memset(bufs[i], 0xA5, g_cfg.io_size);
+	}
+
+	// Keep depth I/Os in flight - wait for the oldest, then replace it.
+	for (uint32_t i = 0; i < depth; i++) {
+		submit_ns[i] = bench_now_ns();
+		submit_op(rd, &ops[i], bufs[i], &iovs[i]);
+	}
+
+	uint32_t i = 0;
+
+	while (true) {
+		ssize_t rv = cf_ioring_wait(&ops[i]);
+		uint64_t now = bench_now_ns();
+
+		if (rv == (ssize_t)g_cfg.io_size) {
+			rd->n_ops++;
+			bench_lat_add(&rd->lat, now - submit_ns[i]);
+		}
+		else {
+			rd->n_errors++;
+		}
+
+		if (g_stop) {
+			break;
+		}
+
+		submit_ns[i] = now;
+		submit_op(rd, &ops[i], bufs[i], &iovs[i]);
+
+		i = (i + 1) % depth;
+	}
+
+	// Drain what's still in flight - i was just waited for.
+	for (uint32_t n = 1; n < depth; n++) {
+		cf_ioring_wait(&ops[(i + n) % depth]);
+	}
+
+	for (uint32_t n = 0; n < depth; n++) {
+		free(bufs[n]);
+	}
+
+	return NULL;
+}
+
+// The current path - blocking I/O in the calling thread, one at a time.
+static void*
+run_inline(void* udata)
+{
+	reader* rd = (reader*)udata;
+	uint8_t* buf;
+
+	if (posix_memalign((void**)&buf, 4096, g_cfg.io_size) != 0) {
+		fprintf(stderr, "can't allocate I/O buffer\n");
+		exit(1);
+	}
+
+	memset(buf, 0xA5, g_cfg.io_size);
+
+	struct iovec iov = { .iov_base = buf, .iov_len = g_cfg.io_size };
+
+	while (! g_stop) {
+		off_t offset = (off_t)((bench_rand(&rd->rand_state) % g_cfg.n_blocks) *
+				g_cfg.io_size);
+		uint64_t start_ns = bench_now_ns();
+		ssize_t rv = g_cfg.write ?
+				pwritev(rd->fd, &iov, 1, offset) :
+				pread(rd->fd, buf, g_cfg.io_size, offset);
+
+		if (rv == (ssize_t)g_cfg.io_size) {
+			rd->n_ops++;
+			bench_lat_add(&rd->lat, bench_now_ns() - start_ns);
+		}
+		else {
+			rd->n_errors++;
+		}
+	}
+
+	free(buf);
+
+	return NULL;
+}
+
+static void
+submit_op(reader* rd, cf_ioring_op* op, uint8_t* buf, struct iovec* iov)
+{
+	off_t offset = (off_t)((bench_rand(&rd->rand_state) % g_cfg.n_blocks) *
+			g_cfg.io_size);
+
+	if (g_cfg.write) {
+		iov->iov_base = buf;
+		iov->iov_len = g_cfg.io_size;
+		cf_ioring_writev_submit(rd->ring, op, rd->fd, iov, 1, offset);
+	}
+	else {
+		cf_ioring_read_submit(rd->ring, op, rd->fd, buf, g_cfg.io_size, offset);
+	}
+}
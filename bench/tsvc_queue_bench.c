@@ -0,0 +1,535 @@
+/*
+ * tsvc_queue_bench.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Transaction queue handoff - service threads pushing transactions to
+ * transaction threads, the two ways thr_tsvc.c can queue them:
+ *
+ *   locked    - mutex-protected cf_queues, chosen round-robin, with threads
+ *               blocking in cf_queue_pop() (the default)
+ *   stealing  - a cf_mpmc_ring per queue with a locked overflow, producers
+ *               staying on their own queue, and idle threads stealing from
+ *               other queues before parking (transaction-queue-stealing)
+ *
+ * Reports transactions/sec and p50/p99 queue wait - push to pop. Each producer
+ * keeps at most -o transactions outstanding, like a set of client connections.
+ * Every -S-th transaction takes 50 times the -u processing time, so a queue
+ * can back up behind a slow one - which stealing should absorb.
+ *
+ * Usage: tsvc_queue_bench [options] - see usage().
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_queue.h"
+
+#include "mpmc_ring.h"
+
+#include "bench.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define MAX_THREADS 256
+#define MAX_QUEUES 64
+#define RING_SIZE (16 * 1024)
+#define PARK_NS (10 * 1000 * 1000)
+#define LAT_SAMPLES_PER_CONSUMER (1024 * 1024)
+#define SLOW_MULTIPLIER 50
+
+// Stands in for the transaction head - 64 bytes.
+typedef struct job_s {
+	uint64_t	push_ns;
+	uint32_t	producer_id;
+	uint32_t	slow;
+	uint8_t		pad[48];
+} job;
+
+typedef struct queue_s {
+	// locked mode
+	cf_queue*		q;
+
+	// stealing mode
+	cf_mpmc_ring	ring;
+	cf_queue*		overflow;
+	cf_atomic32		n_overflow;
+	pthread_mutex_t	park_lock;
+	pthread_cond_t	park_cond;
+	cf_atomic32		n_parked;
+} __attribute__ ((aligned(CF_MPMC_RING_CACHE_LINE_SIZE))) queue;
+
+typedef struct producer_s {
+	pthread_t	thread;
+	uint32_t	id;
+	cf_atomic32	n_outstanding;
+	uint64_t	n_pushed;
+} __attribute__ ((aligned(CF_MPMC_RING_CACHE_LINE_SIZE))) producer;
+
+typedef struct consumer_s {
+	pthread_t	thread;
+	uint32_t	n_q;
+	uint64_t	n_popped;
+	uint64_t	n_stolen;
+	bench_lat	lat;
+} consumer;
+
+
+//==========================================================
+// Globals.
+//
+
+static uint32_t g_n_producers = 4;
+static uint32_t g_n_queues = 4;
+static uint32_t g_n_threads_per_queue = 1;
+static uint32_t g_n_outstanding = 64;
+static uint64_t g_work_ns = 1000;
+static uint32_t g_slow_every = 100;
+static uint32_t g_duration_sec = 10;
+
+static bool g_stealing;
+static volatile bool g_stop = false;
+static cf_atomic32 g_current_q = 0;
+
+static queue g_queues[MAX_QUEUES];
+static producer g_producers[MAX_THREADS];
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void usage(const char* prog);
+static void run_mode(bool stealing);
+static void* run_producer(void* udata);
+static void* run_consumer(void* udata);
+static void push(uint32_t n_q, const job* j);
+static bool pop_local(queue* q, job* j);
+static bool steal(uint32_t n_q, job* j);
+static void park(queue* q);
+static void wake(queue* q);
+static void process(const job* j);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char* argv[])
+{
+	const char* modes = "locked,stealing";
+	int c;
+
+	while ((c = getopt(argc, argv, "p:q:t:o:u:S:d:m:h")) != -1) {
+		switch (c) {
+		case 'p':
+			g_n_producers = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			g_n_queues = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			g_n_threads_per_queue = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			g_n_outstanding = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			g_work_ns = strtoull(optarg, NULL, 0);
+			break;
+		case 'S':
+			g_slow_every = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			g_duration_sec = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			modes = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (g_n_producers == 0 || g_n_producers > MAX_THREADS ||
+			g_n_queues == 0 || g_n_queues > MAX_QUEUES ||
+			g_n_threads_per_queue == 0 ||
+			g_n_queues * g_n_threads_per_queue > MAX_THREADS ||
+			g_n_outstanding == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("%u producers x %u outstanding, %u queues x %u threads, %lu ns work, every %u-th slow, %u sec\n",
+			g_n_producers, g_n_outstanding, g_n_queues, g_n_threads_per_queue,
+			g_work_ns, g_slow_every, g_duration_sec);
+
+	char* list = strdup(modes);
+	char* save = NULL;
+	bool ok = true;
+
+	for (char* name = strtok_r(list, ",", &save); name;
+			name = strtok_r(NULL, ",", &save)) {
+		if (strcmp(name, "locked") == 0) {
+			run_mode(false);
+		}
+		else if (strcmp(name, "stealing") == 0) {
+			run_mode(true);
+		}
+		else {
+			fprintf(stderr, "unknown mode %s\n", name);
+			ok = false;
+		}
+	}
+
+	free(list);
+
+	return ok ? 0 : 1;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static void
+usage(const char* prog)
+{
+	fprintf(stderr, "usage: %s [options]\n", prog);
+	fprintf(stderr, "  -p <n>      producer (service) threads, max %d (default 4)\n", MAX_THREADS);
+	fprintf(stderr, "  -q <n>      transaction queues, max %d (default 4)\n", MAX_QUEUES);
+	fprintf(stderr, "  -t <n>      transaction threads per queue (default 1)\n");
+	fprintf(stderr, "  -o <n>      outstanding transactions per producer (default 64)\n");
+	fprintf(stderr, "  -u <ns>     processing time per transaction (default 1000)\n");
+	fprintf(stderr, "  -S <n>      every n-th transaction is slow, 0 for none (default 100)\n");
+	fprintf(stderr, "  -d <sec>    duration per mode (default 10)\n");
+	fprintf(stderr, "  -m <list>   modes to compare (default locked,stealing)\n");
+}
+
+static void
+run_mode(bool stealing)
+{
+	uint32_t n_consumers = g_n_queues * g_n_threads_per_queue;
+	consumer* consumers = calloc(n_consumers, sizeof(consumer));
+
+	g_stealing = stealing;
+	g_stop = false;
+
+	for (uint32_t i = 0; i < g_n_queues; i++) {
+		queue* q = &g_queues[i];
+
+		if (stealing) {
+			cf_mpmc_ring_init(&q->ring, sizeof(job), RING_SIZE);
+			q->overflow = cf_queue_create(sizeof(job), true);
+			q->n_overflow = 0;
+			q->n_parked = 0;
+			pthread_mutex_init(&q->park_lock, NULL);
+			pthread_cond_init(&q->park_cond, NULL);
+		}
+		else {
+			q->q = cf_queue_create(sizeof(job), true);
+		}
+	}
+
+	for (uint32_t i = 0; i < n_consumers; i++) {
+		consumer* cn = &consumers[i];
+
+		cn->n_q = i % g_n_queues;
+		bench_lat_init(&cn->lat, LAT_SAMPLES_PER_CONSUMER);
+		pthread_create(&cn->thread, NULL, run_consumer, cn);
+	}
+
+	uint64_t start_ns = bench_now_ns();
+
+	for (uint32_t i = 0; i < g_n_producers; i++) {
+		producer* pr = &g_producers[i];
+
+		memset(pr, 0, sizeof(producer));
+		pr->id = i;
+		pthread_create(&pr->thread, NULL, run_producer, pr);
+	}
+
+	sleep(g_duration_sec);
+	g_stop = true;
+
+	for (uint32_t i = 0; i < g_n_producers; i++) {
+		pthread_join(g_producers[i].thread, NULL);
+	}
+
+	// Let the consumers drain what's left, then release them.
+	for (uint32_t i = 0; i < g_n_producers; i++) {
+		while (cf_atomic32_get(g_producers[i].n_outstanding) != 0) {
+			sched_yield();
+		}
+	}
+
+	uint64_t elapsed_ns = bench_now_ns() - start_ns;
+	bench_lat all;
+	uint64_t n_popped = 0;
+	uint64_t n_stolen = 0;
+
+	bench_lat_init(&all, LAT_SAMPLES_PER_CONSUMER * 4);
+
+	for (uint32_t i = 0; i < n_consumers; i++) {
+		job j = { .producer_id = UINT32_MAX };
+
+		// Wakes blocked or parked consumers so they see g_stop.
+		if (stealing) {
+			push(i % g_n_queues, &j);
+		}
+		else {
+			cf_queue_push(g_queues[i % g_n_queues].q, &j);
+		}
+	}
+
+	for (uint32_t i = 0; i < n_consumers; i++) {
+		consumer* cn = &consumers[i];
+
+		pthread_join(cn->thread, NULL);
+		n_popped += cn->n_popped;
+		n_stolen += cn->n_stolen;
+		bench_lat_merge(&all, &cn->lat);
+		bench_lat_destroy(&cn->lat);
+	}
+
+	bench_lat_report(stealing ? "stealing" : "locked", &all, n_popped,
+			elapsed_ns);
+
+	if (stealing) {
+		printf("%-24s %lu steals (%.1f%%)\n", "", n_stolen,
+				n_popped == 0 ? 0.0 : 100.0 * (double)n_stolen / (double)n_popped);
+	}
+
+	for (uint32_t i = 0; i < g_n_queues; i++) {
+		queue* q = &g_queues[i];
+
+		if (stealing) {
+			cf_mpmc_ring_destroy(&q->ring);
+			cf_queue_destroy(q->overflow);
+			pthread_mutex_destroy(&q->park_lock);
+			pthread_cond_destroy(&q->park_cond);
+		}
+		else {
+			cf_queue_destroy(q->q);
+		}
+	}
+
+	bench_lat_destroy(&all);
+	free(consumers);
+}
+
+static void*
+run_producer(void* udata)
+{
+	producer* pr = (producer*)udata;
+
+	while (! g_stop) {
+		if (cf_atomic32_get(pr->n_outstanding) >= g_n_outstanding) {
+			sched_yield();
+			continue;
+		}
+
+		job j = {
+				.push_ns = bench_now_ns(),
+				.producer_id = pr->id,
+				.slow = g_slow_every != 0 &&
+						++pr->n_pushed % g_slow_every == 0 ? 1 : 0
+		};
+
+		cf_atomic32_incr(&pr->n_outstanding);
+
+		if (g_stealing) {
+			// A producer's own queue - sched_getcpu() in the server.
+			push(pr->id % g_n_queues, &j);
+		}
+		else {
+			uint32_t n_q = cf_atomic32_incr(&g_current_q) % g_n_queues;
+
+			cf_queue_push(g_queues[n_q].q, &j);
+		}
+	}
+
+	return NULL;
+}
+
+static void*
+run_consumer(void* udata)
+{
+	consumer* cn = (consumer*)udata;
+	queue* q = &g_queues[cn->n_q];
+
+	while (true) {
+		job j;
+
+		if (g_stealing) {
+			if (! pop_local(q, &j)) {
+				if (! steal(cn->n_q, &j)) {
+					park(q);
+					continue;
+				}
+
+				cn->n_stolen++;
+			}
+		}
+		else if (cf_queue_pop(q->q, &j, CF_QUEUE_FOREVER) != CF_QUEUE_OK) {
+			continue;
+		}
+
+		if (j.producer_id == UINT32_MAX) {
+			break; // told to stop
+		}
+
+		bench_lat_add(&cn->lat, bench_now_ns() - j.push_ns);
+		process(&j);
+		cn->n_popped++;
+		cf_atomic32_decr(&g_producers[j.producer_id].n_outstanding);
+	}
+
+	return NULL;
+}
+
+// As tsvc_queue_push() - keep FIFO once anything has overflowed, and wake a
+// parked thread here, or else on the next queue to steal.
+static void
+push(uint32_t n_q, const job* j)
+{
+	queue* q = &g_queues[n_q];
+
+	if (cf_atomic32_get(q->n_overflow) != 0 ||
+			! cf_mpmc_ring_push(&q->ring, j)) {
+		cf_atomic32_incr(&q->n_overflow);
+		cf_queue_push(q->overflow, j);
+	}
+
+	__sync_synchronize();
+
+	if (cf_atomic32_get(q->n_parked) != 0) {
+		wake(q);
+		return;
+	}
+
+	queue* nq = &g_queues[(n_q + 1) % g_n_queues];
+
+	if (nq != q && cf_atomic32_get(nq->n_parked) != 0) {
+		wake(nq);
+	}
+}
+
+static bool
+pop_local(queue* q, job* j)
+{
+	if (cf_mpmc_ring_pop(&q->ring, j)) {
+		return true;
+	}
+
+	if (cf_atomic32_get(q->n_overflow) != 0 &&
+			cf_queue_pop(q->overflow, j, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		cf_atomic32_decr(&q->n_overflow);
+		return true;
+	}
+
+	return false;
+}
+
+static bool
+steal(uint32_t n_q, job* j)
+{
+	for (uint32_t i = 1; i < g_n_queues; i++) {
+		queue* victim = &g_queues[(n_q + i) % g_n_queues];
+
+		if ((cf_mpmc_ring_sz(&victim->ring) != 0 ||
+				cf_atomic32_get(victim->n_overflow) != 0) &&
+				pop_local(victim, j)) {
+			// Never steal the stop marker - it's for the victim's threads.
+			if (j->producer_id == UINT32_MAX) {
+				push((n_q + i) % g_n_queues, j);
+				return false;
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void
+park(queue* q)
+{
+	pthread_mutex_lock(&q->park_lock);
+
+	cf_atomic32_incr(&q->n_parked); // full barrier
+
+	if (cf_mpmc_ring_sz(&q->ring) == 0 &&
+			cf_atomic32_get(q->n_overflow) == 0) {
+		struct timespec ts;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += PARK_NS;
+
+		if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000 * 1000 * 1000;
+		}
+
+		pthread_cond_timedwait(&q->park_cond, &q->park_lock, &ts);
+	}
+
+	cf_atomic32_decr(&q->n_parked);
+
+	pthread_mutex_unlock(&q->park_lock);
+}
+
+static void
+wake(queue* q)
+{
+	pthread_mutex_lock(&q->park_lock);
+	pthread_cond_signal(&q->park_cond);
+	pthread_mutex_unlock(&q->park_lock);
+}
+
+static void
+process(const job* j)
+{
+	uint64_t end_ns = bench_now_ns() +
+			(j->slow ? g_work_ns * SLOW_MULTIPLIER : g_work_ns);
+
+	while (bench_now_ns() < end_ns) {
+		;
+	}
+}
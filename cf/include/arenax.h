@@ -44,11 +44,51 @@
 #define CF_ARENAX_BIGLOCK	(1 << 0)
 #define CF_ARENAX_CALLOC	(1 << 1)
 
+// Stage placement - back stages with huge pages (explicit 2M or 1G pages fall
+// back to transparent huge pages if none are reserved), and spread pages of
+// every stage over all NUMA nodes, or bind whole stages to nodes round-robin.
+#define CF_ARENAX_HUGE_PAGES_THP	(1 << 2)
+#define CF_ARENAX_HUGE_PAGES_2M		(1 << 3)
+#define CF_ARENAX_HUGE_PAGES_1G		(1 << 4)
+#define CF_ARENAX_NUMA_INTERLEAVE	(1 << 5)
+#define CF_ARENAX_NUMA_STRIPE		(1 << 6)
+
+#define CF_ARENAX_HUGE_PAGES_MASK \
+	(CF_ARENAX_HUGE_PAGES_THP | CF_ARENAX_HUGE_PAGES_2M | CF_ARENAX_HUGE_PAGES_1G)
+#define CF_ARENAX_NUMA_MASK \
+	(CF_ARENAX_NUMA_INTERLEAVE | CF_ARENAX_NUMA_STRIPE)
+
+#define CF_ARENAX_MAX_NUMA_NODES 64
+
 // Stage is indexed by 8 bits.
 #define CF_ARENAX_MAX_STAGES (1 << 8) // 256
 
 typedef uint32_t cf_arenax_handle;
 
+// How a stage's memory was obtained.
+typedef enum {
+	CF_ARENAX_BACKING_HEAP,
+	CF_ARENAX_BACKING_MMAP,
+	CF_ARENAX_BACKING_THP,
+	CF_ARENAX_BACKING_HUGE_2M,
+	CF_ARENAX_BACKING_HUGE_1G
+} cf_arenax_backing;
+
+// Stage node for stages not placed by NUMA policy, or interleaved over all
+// nodes, rather than bound to a single node.
+#define CF_ARENAX_NO_NODE (-1)
+#define CF_ARENAX_ALL_NODES (-2)
+
+// Where an arena's stages are, for stats.
+typedef struct cf_arenax_placement_s {
+	uint32_t	stages;
+	uint32_t	stages_thp;
+	uint32_t	stages_huge_2m;
+	uint32_t	stages_huge_1g;
+	uint32_t	stages_interleaved;
+	uint32_t	stages_per_node[CF_ARENAX_MAX_NUMA_NODES];
+} cf_arenax_placement;
+
 // Must be in-sync with internal array ARENAX_ERR_STRINGS[]:
 typedef enum {
 	CF_ARENAX_OK = 0,
@@ -91,6 +131,10 @@ typedef struct cf_arenax_s {
 	// Current Stages
 	uint32_t			stage_count;
 	uint8_t*			stages[CF_ARENAX_MAX_STAGES];
+
+	// Stage Placement
+	uint8_t				stage_backing[CF_ARENAX_MAX_STAGES];
+	int8_t				stage_node[CF_ARENAX_MAX_STAGES];
 } cf_arenax;
 
 typedef struct arenax_handle_s {
@@ -138,9 +182,23 @@ void cf_arenax_free(cf_arenax* _this, cf_arenax_handle h);
 //
 void* cf_arenax_resolve(cf_arenax* _this, cf_arenax_handle h);
 
+//------------------------------------------------
+// Get Stage Placement Stats
+//
+void cf_arenax_get_placement(cf_arenax* _this, cf_arenax_placement* placement);
+
 
 //==========================================================
 // Private API - for enterprise separation only
 //
 
 cf_arenax_err cf_arenax_add_stage(cf_arenax* _this);
+
+//------------------------------------------------
+// Community edition only - save an arena to, and
+// re-create it from, an index snapshot file.
+//
+cf_arenax_err cf_arenax_save(cf_arenax* _this, int fd, uint32_t* p_crc);
+cf_arenax_err cf_arenax_load(cf_arenax* _this, int fd, uint32_t element_size,
+		uint32_t flags, uint32_t* p_crc);
+void cf_arenax_destroy(cf_arenax* _this);
@@ -0,0 +1,49 @@
+/*
+ * crc32c.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+
+/*
+ * CRC-32C (Castagnoli) - uses the SSE4.2 crc32 instruction when the CPU has
+ * it, otherwise a table-driven software implementation.
+ */
+
+#pragma once
+
+
+//==========================================================
+// Includes
+//
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+//==========================================================
+// Public API
+//
+
+// Pass crc 0 to start. Pass a previous result to continue over more data.
+uint32_t cf_crc32c(uint32_t crc, const void* buf, size_t size);
+
+// True if the hardware implementation is in use.
+bool cf_crc32c_is_hw(void);
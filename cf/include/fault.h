@@ -109,6 +109,8 @@ typedef enum {
 	AS_UDF,
 	AS_XDR,
 
+	CF_IORING,
+
 	CF_FAULT_CONTEXT_UNDEF
 } cf_fault_context;
 
@@ -63,6 +63,7 @@ extern void histogram_dump(histogram *h );
 
 extern uint64_t histogram_insert_data_point(histogram *h, uint64_t start_ns);
 extern void histogram_insert_raw(histogram *h, uint64_t value);
+extern void histogram_get_counts(histogram *h, uint64_t counts[N_BUCKETS]);
 
 
 // TODO - reinstate this elsewhere as needed.
@@ -0,0 +1,127 @@
+/*
+ * ioring.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Positional device I/O which may be completed asynchronously - inline, by a
+ * pool of worker threads, or by the kernel via io_uring.
+ */
+
+#pragma once
+
+
+//==========================================================
+// Includes
+//
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+
+//==========================================================
+// Typedefs & Constants
+//
+
+typedef enum {
+	CF_IORING_SYNC,		// I/O inline in the calling thread
+	CF_IORING_THREADS,	// I/O in a pool of worker threads
+	CF_IORING_URING,	// kernel io_uring, if built with USE_IO_URING
+
+	CF_IORING_NUM_TYPES
+} cf_ioring_type;
+
+#define CF_IORING_DEFAULT_DEPTH 64
+#define CF_IORING_MAX_DEPTH 4096
+#define CF_IORING_MAX_THREADS 64
+
+typedef struct cf_ioring_s cf_ioring;
+
+//------------------------------------------------
+// An operation in flight. Caller owns the memory,
+// which must stay valid until cf_ioring_wait()
+// returns. DO NOT access member data directly.
+//
+typedef struct cf_ioring_op_s {
+	int					opcode;
+	int					fd;
+	void*				buf;
+	size_t				size;
+	const struct iovec*	iov;
+	int					iovcnt;
+	off_t				offset;
+
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+	bool				done;
+	ssize_t				result;
+	int					err;
+} cf_ioring_op;
+
+
+//==========================================================
+// Public API
+//
+
+//------------------------------------------------
+// Constructor & Destructor
+//
+cf_ioring* cf_ioring_create(cf_ioring_type type, uint32_t depth,
+		uint32_t n_threads);
+void cf_ioring_destroy(cf_ioring* ring);
+
+//------------------------------------------------
+// Type actually in use - may differ from what was
+// requested if io_uring is unavailable.
+//
+cf_ioring_type cf_ioring_get_type(const cf_ioring* ring);
+const char* cf_ioring_type_str(cf_ioring_type type);
+
+//------------------------------------------------
+// Asynchronous Read
+//
+void cf_ioring_read_submit(cf_ioring* ring, cf_ioring_op* op, int fd,
+		void* buf, size_t size, off_t offset);
+ssize_t cf_ioring_wait(cf_ioring_op* op);
+
+//------------------------------------------------
+// Asynchronous Vectored Write - iov array must
+// stay valid until cf_ioring_wait() returns.
+//
+void cf_ioring_writev_submit(cf_ioring* ring, cf_ioring_op* op, int fd,
+		const struct iovec* iov, int iovcnt, off_t offset);
+
+//------------------------------------------------
+// Synchronous Read & Write - submit and wait.
+// Returns bytes transferred, or -1 with errno set.
+//
+ssize_t cf_ioring_read(cf_ioring* ring, int fd, void* buf, size_t size,
+		off_t offset);
+ssize_t cf_ioring_writev(cf_ioring* ring, int fd, const struct iovec* iov,
+		int iovcnt, off_t offset);
+
+//------------------------------------------------
+// Statistics
+//
+uint32_t cf_ioring_in_flight(const cf_ioring* ring);
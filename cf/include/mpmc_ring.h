@@ -0,0 +1,75 @@
+/*
+ * mpmc_ring.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#pragma once
+
+//==========================================================
+// Includes.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Bounded, lock-free, multi-producer multi-consumer ring of fixed-size
+// elements. Each slot carries a sequence number which tells producers and
+// consumers whether it's free or full for the lap they're on - no locks, one
+// CAS per push or pop. Never blocks - callers decide what to do when the ring
+// is full or empty.
+
+#define CF_MPMC_RING_CACHE_LINE_SIZE 64
+
+typedef struct cf_mpmc_ring_s {
+	// Set at create - read-only after that.
+	uint32_t	ele_size;
+	uint32_t	slot_size;
+	uint64_t	mask;
+	uint8_t*	slots;
+
+	// Producers and consumers each get their own cache line.
+	volatile uint64_t	head __attribute__ ((aligned(CF_MPMC_RING_CACHE_LINE_SIZE)));
+	volatile uint64_t	tail __attribute__ ((aligned(CF_MPMC_RING_CACHE_LINE_SIZE)));
+} __attribute__ ((aligned(CF_MPMC_RING_CACHE_LINE_SIZE))) cf_mpmc_ring;
+
+
+//==========================================================
+// Public API.
+//
+
+bool cf_mpmc_ring_init(cf_mpmc_ring* ring, uint32_t ele_size, uint32_t n_slots);
+void cf_mpmc_ring_destroy(cf_mpmc_ring* ring);
+bool cf_mpmc_ring_push(cf_mpmc_ring* ring, const void* ele);
+bool cf_mpmc_ring_pop(cf_mpmc_ring* ring, void* ele);
+
+// Approximate - other threads may be pushing or popping.
+static inline uint32_t
+cf_mpmc_ring_sz(const cf_mpmc_ring* ring)
+{
+	uint64_t tail = ring->tail;
+	uint64_t head = ring->head;
+
+	return head > tail ? (uint32_t)(head - tail) : 0;
+}
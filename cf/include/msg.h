@@ -123,6 +123,7 @@ typedef struct msg_t {
 	uint32_t			bytes_alloc;
 	bool				just_parsed; // fields point into fabric buffer
 	msg_type			type;
+	void				*rc_buf; // reserved buffer fields point into, if any
 	const msg_template	*mt;
 	msg_field			f[];
 } msg;
@@ -184,6 +185,7 @@ int msg_fillbuf(const msg *m, uint8_t *buf, size_t *buflen);
 //
 
 int msg_parse(msg *m, const uint8_t *buf, const size_t buflen);
+int msg_parse_rc(msg *m, const uint8_t *buf, const size_t buflen, void *rc_buf);
 int msg_get_initial(uint32_t *size, msg_type *type, const uint8_t *buf, uint32_t buflen);
 
 void msg_reset(msg *m);
@@ -29,17 +29,41 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <citrusleaf/cf_atomic.h>
 #include <citrusleaf/cf_digest.h>
 
+#include "hist.h"
+
+
+// Each lock gets its own cache line, so threads hammering different records
+// don't bounce a line shared by neighbouring mutexes.
+#define OLOCK_CACHE_LINE_SIZE 64
+
+typedef struct olock_entry_s {
+	pthread_mutex_t lock;
+} __attribute__ ((aligned(OLOCK_CACHE_LINE_SIZE))) olock_entry;
+
+typedef enum {
+	OLOCK_TYPE_MUTEX,		// plain mutex - block as soon as lock is taken
+	OLOCK_TYPE_ADAPTIVE		// spin briefly, then park in the kernel
+} olock_type;
 
 typedef struct olock_s {
+	// Read on every lock - never written after create.
 	uint32_t n_locks;
 	uint32_t mask;
-	pthread_mutex_t locks[];
-} olock;
+	olock_type type;
+	histogram *wait_hist; // may be NULL
+
+	// Contention statistics - only touched when a lock is found held. Own
+	// cache line, so counting doesn't invalidate mask for every locker.
+	cf_atomic64 n_contended __attribute__ ((aligned(OLOCK_CACHE_LINE_SIZE)));
+
+	olock_entry locks[];
+} __attribute__ ((aligned(OLOCK_CACHE_LINE_SIZE))) olock;
 
 void olock_lock(olock *ol, cf_digest *d);
 void olock_vlock(olock *ol, cf_digest *d, pthread_mutex_t **vlock);
 void olock_unlock(olock *ol, cf_digest *d);
-olock *olock_create(uint32_t n_locks, bool mutex);
+olock *olock_create(uint32_t n_locks, olock_type type, histogram *wait_hist);
 void olock_destroy(olock *o);
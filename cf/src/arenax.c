@@ -140,6 +140,8 @@ cf_arenax_create(cf_arenax* this, key_t key_base, uint32_t element_size,
 
 	this->stage_count = 0;
 	memset(this->stages, 0, sizeof(this->stages));
+	memset(this->stage_backing, 0, sizeof(this->stage_backing));
+	memset(this->stage_node, CF_ARENAX_NO_NODE, sizeof(this->stage_node));
 
 	// Add first stage.
 	cf_arenax_err result = cf_arenax_add_stage(this);
@@ -237,3 +239,46 @@ cf_arenax_resolve(cf_arenax* this, cf_arenax_handle h)
 	return this->stages[((arenax_handle*)&h)->stage_id] +
 			(((arenax_handle*)&h)->element_id * this->element_size);
 }
+
+//------------------------------------------------
+// Count stages by backing and NUMA placement.
+//
+void
+cf_arenax_get_placement(cf_arenax* this, cf_arenax_placement* placement)
+{
+	memset(placement, 0, sizeof(cf_arenax_placement));
+
+	if ((this->flags & CF_ARENAX_BIGLOCK) &&
+			pthread_mutex_lock(&this->lock) != 0) {
+		return;
+	}
+
+	placement->stages = this->stage_count;
+
+	for (uint32_t i = 0; i < this->stage_count; i++) {
+		switch (this->stage_backing[i]) {
+		case CF_ARENAX_BACKING_THP:
+			placement->stages_thp++;
+			break;
+		case CF_ARENAX_BACKING_HUGE_2M:
+			placement->stages_huge_2m++;
+			break;
+		case CF_ARENAX_BACKING_HUGE_1G:
+			placement->stages_huge_1g++;
+			break;
+		default:
+			break;
+		}
+
+		if (this->stage_node[i] == CF_ARENAX_ALL_NODES) {
+			placement->stages_interleaved++;
+		}
+		else if (this->stage_node[i] != CF_ARENAX_NO_NODE) {
+			placement->stages_per_node[this->stage_node[i]]++;
+		}
+	}
+
+	if (this->flags & CF_ARENAX_BIGLOCK) {
+		pthread_mutex_unlock(&this->lock);
+	}
+}
@@ -22,11 +22,230 @@
 
 #include "arenax.h"
 
+#include <errno.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include "citrusleaf/alloc.h"
+#include "crc32c.h"
 #include "fault.h"
 
 
+//------------------------------------------------
+// Arena state as written to a snapshot file, in
+// front of the stages' contents.
+//
+typedef struct arenax_snapshot_s {
+	uint32_t			element_size;
+	uint32_t			stage_capacity;
+	uint32_t			max_stages;
+	uint32_t			flags;
+	cf_arenax_handle	free_h;
+	uint32_t			at_stage_id;
+	uint32_t			at_element_id;
+	uint32_t			stage_count;
+} __attribute__ ((__packed__)) arenax_snapshot;
+
+// Transfer at most this much per read() or write() call.
+#define MAX_IO_CHUNK (64 * 1024 * 1024)
+
+// Older headers may lack these.
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+// From linux/mempolicy.h - we call mbind() directly rather than need libnuma.
+#define ARENAX_MPOL_BIND		2
+#define ARENAX_MPOL_INTERLEAVE	3
+
+#define HUGE_2M_SIZE (2UL * 1024 * 1024)
+#define HUGE_1G_SIZE (1024UL * 1024 * 1024)
+
+
+//------------------------------------------------
+// Mask of online NUMA nodes, read once. Zero if
+// unknown, e.g. on a kernel without NUMA.
+//
+static uint64_t
+numa_online_nodes()
+{
+	static uint64_t g_nodes = 0;
+	static bool g_nodes_read = false;
+
+	if (g_nodes_read) {
+		return g_nodes;
+	}
+
+	FILE* f = fopen("/sys/devices/system/node/online", "r");
+
+	if (f) {
+		// Format is a list of ranges, e.g. "0-1" or "0,2-3".
+		char buf[256];
+
+		if (fgets(buf, sizeof(buf), f)) {
+			char* p = buf;
+
+			while (*p >= '0' && *p <= '9') {
+				unsigned long first = strtoul(p, &p, 10);
+				unsigned long last = first;
+
+				if (*p == '-') {
+					last = strtoul(p + 1, &p, 10);
+				}
+
+				for (unsigned long n = first;
+						n <= last && n < CF_ARENAX_MAX_NUMA_NODES; n++) {
+					g_nodes |= 1UL << n;
+				}
+
+				if (*p == ',') {
+					p++;
+				}
+			}
+		}
+
+		fclose(f);
+	}
+
+	g_nodes_read = true;
+
+	return g_nodes;
+}
+
+//------------------------------------------------
+// Which online node is the n'th, wrapping around.
+//
+static int
+numa_nth_node(uint64_t nodes, uint32_t n)
+{
+	n %= (uint32_t)__builtin_popcountll(nodes);
+
+	for (int node = 0; node < CF_ARENAX_MAX_NUMA_NODES; node++) {
+		if ((nodes & (1UL << node)) != 0 && n-- == 0) {
+			return node;
+		}
+	}
+
+	return CF_ARENAX_NO_NODE; // can't get here
+}
+
+//------------------------------------------------
+// Size of a stage's mapping - explicit huge page
+// mappings must be whole huge pages.
+//
+static size_t
+stage_map_size(const cf_arenax* this, uint8_t backing)
+{
+	size_t align = backing == CF_ARENAX_BACKING_HUGE_1G ? HUGE_1G_SIZE :
+			(backing == CF_ARENAX_BACKING_HUGE_2M ? HUGE_2M_SIZE : 1);
+
+	return (this->stage_size + align - 1) / align * align;
+}
+
+//------------------------------------------------
+// Map memory for a stage per the arena's page
+// size and NUMA flags, and note its placement.
+// Memory must be placed before it's touched.
+//
+static uint8_t*
+stage_map(cf_arenax* this, uint32_t stage_id)
+{
+	uint8_t backing = CF_ARENAX_BACKING_MMAP;
+	void* p = MAP_FAILED;
+	int prot = PROT_READ | PROT_WRITE;
+	int map_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+	if (this->flags & (CF_ARENAX_HUGE_PAGES_2M | CF_ARENAX_HUGE_PAGES_1G)) {
+		bool is_1g = (this->flags & CF_ARENAX_HUGE_PAGES_1G) != 0;
+
+		backing = is_1g ? CF_ARENAX_BACKING_HUGE_1G : CF_ARENAX_BACKING_HUGE_2M;
+		p = mmap(NULL, stage_map_size(this, backing), prot, map_flags |
+				MAP_HUGETLB | (is_1g ? MAP_HUGE_1GB : MAP_HUGE_2MB), -1, 0);
+
+		if (p == MAP_FAILED) {
+			cf_warning(CF_ARENAX, "no %s huge pages for arena stage %u (errno %d) - using transparent huge pages",
+					is_1g ? "1G" : "2M", stage_id, errno);
+		}
+	}
+
+	if (p == MAP_FAILED) {
+		backing = (this->flags & CF_ARENAX_HUGE_PAGES_MASK) != 0 ?
+				CF_ARENAX_BACKING_THP : CF_ARENAX_BACKING_MMAP;
+		p = mmap(NULL, stage_map_size(this, backing), prot, map_flags, -1, 0);
+
+		if (p == MAP_FAILED) {
+			return NULL;
+		}
+
+		if (backing == CF_ARENAX_BACKING_THP &&
+				madvise(p, this->stage_size, MADV_HUGEPAGE) != 0) {
+			cf_warning(CF_ARENAX, "can't use transparent huge pages for arena stage %u: errno %d",
+					stage_id, errno);
+			backing = CF_ARENAX_BACKING_MMAP;
+		}
+	}
+
+	this->stage_backing[stage_id] = backing;
+	this->stage_node[stage_id] = CF_ARENAX_NO_NODE;
+
+	uint64_t nodes = numa_online_nodes();
+
+	if ((this->flags & CF_ARENAX_NUMA_MASK) == 0 ||
+			__builtin_popcountll(nodes) < 2) {
+		return (uint8_t*)p;
+	}
+
+	int node = CF_ARENAX_ALL_NODES;
+	int mode = ARENAX_MPOL_INTERLEAVE;
+	uint64_t mask = nodes;
+
+	if (this->flags & CF_ARENAX_NUMA_STRIPE) {
+		node = numa_nth_node(nodes, stage_id);
+		mode = ARENAX_MPOL_BIND;
+		mask = 1UL << node;
+	}
+
+	if (syscall(SYS_mbind, p, stage_map_size(this, backing), mode, &mask,
+			CF_ARENAX_MAX_NUMA_NODES + 1, 0) != 0) {
+		cf_warning(CF_ARENAX, "can't set NUMA policy for arena stage %u: errno %d",
+				stage_id, errno);
+	}
+	else {
+		this->stage_node[stage_id] = (int8_t)node;
+	}
+
+	return (uint8_t*)p;
+}
+
+//------------------------------------------------
+// Free a stage's memory, however it was obtained.
+//
+static void
+stage_free(cf_arenax* this, uint32_t stage_id)
+{
+	uint8_t backing = this->stage_backing[stage_id];
+
+	if (backing == CF_ARENAX_BACKING_HEAP) {
+		cf_free(this->stages[stage_id]);
+	}
+	else {
+		munmap(this->stages[stage_id], stage_map_size(this, backing));
+	}
+
+	this->stages[stage_id] = NULL;
+}
+
+
 //------------------------------------------------
 // Create and attach a persistent memory block,
 // and store its pointer in the stages array.
@@ -40,7 +259,16 @@ cf_arenax_add_stage(cf_arenax* this)
 		return CF_ARENAX_ERR_STAGE_CREATE;
 	}
 
-	uint8_t* p_stage = (uint8_t*)cf_malloc(this->stage_size);
+	uint8_t* p_stage;
+
+	if ((this->flags & (CF_ARENAX_HUGE_PAGES_MASK | CF_ARENAX_NUMA_MASK)) == 0) {
+		p_stage = (uint8_t*)cf_malloc(this->stage_size);
+		this->stage_backing[this->stage_count] = CF_ARENAX_BACKING_HEAP;
+		this->stage_node[this->stage_count] = CF_ARENAX_NO_NODE;
+	}
+	else {
+		p_stage = stage_map(this, this->stage_count);
+	}
 
 	if (! p_stage) {
 		cf_warning(CF_ARENAX, "could not allocate %lu-byte arena stage %u",
@@ -52,3 +280,182 @@ cf_arenax_add_stage(cf_arenax* this)
 
 	return CF_ARENAX_OK;
 }
+
+//------------------------------------------------
+// Write all of buf to fd, accumulating CRC32C.
+//
+static bool
+write_all(int fd, const void* buf, size_t size, uint32_t* p_crc)
+{
+	const uint8_t* p = (const uint8_t*)buf;
+
+	*p_crc = cf_crc32c(*p_crc, buf, size);
+
+	while (size != 0) {
+		ssize_t rv = write(fd, p, size > MAX_IO_CHUNK ? MAX_IO_CHUNK : size);
+
+		if (rv < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (rv <= 0) {
+			return false;
+		}
+
+		p += rv;
+		size -= (size_t)rv;
+	}
+
+	return true;
+}
+
+//------------------------------------------------
+// Read exactly size bytes from fd, accumulating
+// CRC32C.
+//
+static bool
+read_all(int fd, void* buf, size_t size, uint32_t* p_crc)
+{
+	uint8_t* p = (uint8_t*)buf;
+	size_t remaining = size;
+
+	while (remaining != 0) {
+		ssize_t rv = read(fd, p,
+				remaining > MAX_IO_CHUNK ? MAX_IO_CHUNK : remaining);
+
+		if (rv < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (rv <= 0) {
+			return false;
+		}
+
+		p += rv;
+		remaining -= (size_t)rv;
+	}
+
+	*p_crc = cf_crc32c(*p_crc, buf, size);
+
+	return true;
+}
+
+//------------------------------------------------
+// Number of bytes in use in a stage - elements in
+// the current stage past the end-allocation point
+// have never been touched.
+//
+static size_t
+stage_used_size(const cf_arenax* this, uint32_t stage_id)
+{
+	return stage_id == this->at_stage_id ?
+			(size_t)this->at_element_id * this->element_size :
+			this->stage_size;
+}
+
+//------------------------------------------------
+// Write arena and stage contents to fd for a later
+// cf_arenax_load(). Caller must make sure nothing
+// allocates or frees elements meanwhile.
+//
+cf_arenax_err
+cf_arenax_save(cf_arenax* this, int fd, uint32_t* p_crc)
+{
+	arenax_snapshot snap = {
+			.element_size = this->element_size,
+			.stage_capacity = this->stage_capacity,
+			.max_stages = this->max_stages,
+			.flags = this->flags,
+			.free_h = this->free_h,
+			.at_stage_id = this->at_stage_id,
+			.at_element_id = this->at_element_id,
+			.stage_count = this->stage_count
+	};
+
+	if (! write_all(fd, &snap, sizeof(snap), p_crc)) {
+		return CF_ARENAX_ERR_UNKNOWN;
+	}
+
+	for (uint32_t i = 0; i < this->stage_count; i++) {
+		if (! write_all(fd, this->stages[i], stage_used_size(this, i), p_crc)) {
+			cf_warning(CF_ARENAX, "failed writing arena stage %u: errno %d",
+					i, errno);
+			return CF_ARENAX_ERR_UNKNOWN;
+		}
+	}
+
+	return CF_ARENAX_OK;
+}
+
+//------------------------------------------------
+// Create an arena from what cf_arenax_save() wrote
+// to fd. Element size must match. Flags are taken
+// from the caller, not the snapshot, so changed
+// page size or NUMA config applies. On failure,
+// everything allocated here is freed again.
+//
+cf_arenax_err
+cf_arenax_load(cf_arenax* this, int fd, uint32_t element_size,
+		uint32_t flags, uint32_t* p_crc)
+{
+	arenax_snapshot snap;
+
+	if (! read_all(fd, &snap, sizeof(snap), p_crc)) {
+		return CF_ARENAX_ERR_STAGE_ATTACH;
+	}
+
+	if (snap.element_size != element_size || snap.stage_count == 0 ||
+			snap.at_stage_id != snap.stage_count - 1 ||
+			snap.at_element_id > snap.stage_capacity) {
+		cf_warning(CF_ARENAX, "arena snapshot has bad parameters");
+		return CF_ARENAX_ERR_BAD_PARAM;
+	}
+
+	// Creates the first stage.
+	cf_arenax_err result = cf_arenax_create(this, 0, snap.element_size,
+			snap.stage_capacity, snap.max_stages, flags);
+
+	if (result != CF_ARENAX_OK) {
+		return result;
+	}
+
+	this->free_h = snap.free_h;
+	this->at_stage_id = snap.at_stage_id;
+	this->at_element_id = snap.at_element_id;
+
+	for (uint32_t i = 0; i < snap.stage_count; i++) {
+		if (i != 0 && (result = cf_arenax_add_stage(this)) != CF_ARENAX_OK) {
+			break;
+		}
+
+		if (! read_all(fd, this->stages[i], stage_used_size(this, i), p_crc)) {
+			cf_warning(CF_ARENAX, "failed reading arena stage %u", i);
+			result = CF_ARENAX_ERR_STAGE_ATTACH;
+			break;
+		}
+	}
+
+	if (result != CF_ARENAX_OK) {
+		cf_arenax_destroy(this);
+	}
+
+	return result;
+}
+
+//------------------------------------------------
+// Free all stages of an arena that was never used,
+// e.g. after a failed or rejected load.
+//
+void
+cf_arenax_destroy(cf_arenax* this)
+{
+	for (uint32_t i = 0; i < this->stage_count; i++) {
+		stage_free(this, i);
+	}
+
+	this->stage_count = 0;
+
+	if (this->flags & CF_ARENAX_BIGLOCK) {
+		pthread_mutex_destroy(&this->lock);
+	}
+}
@@ -0,0 +1,200 @@
+/*
+ * crc32c.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+
+/*
+ * CRC-32C (Castagnoli).
+ */
+
+
+//==========================================================
+// Includes
+//
+
+#include "crc32c.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+//==========================================================
+// Constants & Typedefs
+//
+
+#define CRC32C_POLY 0x82F63B78 // reflected
+
+typedef uint32_t (*crc32c_fn)(uint32_t crc, const uint8_t* p, size_t size);
+
+
+//==========================================================
+// Globals
+//
+
+static pthread_once_t g_init_once = PTHREAD_ONCE_INIT;
+static crc32c_fn g_crc32c_fn;
+
+// Slicing-by-8 tables for the software implementation.
+static uint32_t g_table[8][256];
+
+
+//==========================================================
+// Forward Declarations
+//
+
+static void crc32c_init(void);
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t* p, size_t size);
+
+#if defined(__x86_64__)
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t* p, size_t size);
+#endif
+
+
+//==========================================================
+// Public API
+//
+
+uint32_t
+cf_crc32c(uint32_t crc, const void* buf, size_t size)
+{
+	pthread_once(&g_init_once, crc32c_init);
+
+	return ~g_crc32c_fn(~crc, (const uint8_t*)buf, size);
+}
+
+bool
+cf_crc32c_is_hw(void)
+{
+	pthread_once(&g_init_once, crc32c_init);
+
+	return g_crc32c_fn != crc32c_sw;
+}
+
+
+//==========================================================
+// Local Helpers
+//
+
+static void
+crc32c_init(void)
+{
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+
+		for (int b = 0; b < 8; b++) {
+			crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+		}
+
+		g_table[0][i] = crc;
+	}
+
+	for (uint32_t i = 0; i < 256; i++) {
+		for (int t = 1; t < 8; t++) {
+			g_table[t][i] = (g_table[t - 1][i] >> 8) ^
+					g_table[0][g_table[t - 1][i] & 0xFF];
+		}
+	}
+
+	g_crc32c_fn = crc32c_sw;
+
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse4.2")) {
+		g_crc32c_fn = crc32c_hw;
+	}
+#endif
+}
+
+static uint32_t
+crc32c_sw(uint32_t crc, const uint8_t* p, size_t size)
+{
+	while (size != 0 && ((uintptr_t)p & 7) != 0) {
+		crc = (crc >> 8) ^ g_table[0][(crc ^ *p++) & 0xFF];
+		size--;
+	}
+
+	while (size >= 8) {
+		uint64_t v;
+
+		memcpy(&v, p, 8);
+		v ^= crc; // little-endian
+
+		crc = g_table[7][v & 0xFF] ^
+				g_table[6][(v >> 8) & 0xFF] ^
+				g_table[5][(v >> 16) & 0xFF] ^
+				g_table[4][(v >> 24) & 0xFF] ^
+				g_table[3][(v >> 32) & 0xFF] ^
+				g_table[2][(v >> 40) & 0xFF] ^
+				g_table[1][(v >> 48) & 0xFF] ^
+				g_table[0][v >> 56];
+
+		p += 8;
+		size -= 8;
+	}
+
+	while (size != 0) {
+		crc = (crc >> 8) ^ g_table[0][(crc ^ *p++) & 0xFF];
+		size--;
+	}
+
+	return crc;
+}
+
+#if defined(__x86_64__)
+
+// Compiled for SSE4.2 regardless of build flags - only called if the CPU
+// supports it.
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_hw(uint32_t crc, const uint8_t* p, size_t size)
+{
+	while (size != 0 && ((uintptr_t)p & 7) != 0) {
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+		size--;
+	}
+
+	uint64_t crc64 = crc;
+
+	while (size >= 8) {
+		uint64_t v;
+
+		memcpy(&v, p, 8);
+		crc64 = __builtin_ia32_crc32di(crc64, v);
+
+		p += 8;
+		size -= 8;
+	}
+
+	crc = (uint32_t)crc64;
+
+	while (size != 0) {
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+		size--;
+	}
+
+	return crc;
+}
+
+#endif
@@ -99,7 +99,9 @@ char *cf_fault_context_strings[] = {
 		"storage",
 		"tsvc",
 		"udf",
-		"xdr"
+		"xdr",
+
+		"cf:ioring"
 };
 
 COMPILER_ASSERT(sizeof(cf_fault_context_strings) / sizeof(char*) == CF_FAULT_CONTEXT_UNDEF);
@@ -95,6 +95,18 @@ histogram_clear(histogram *h)
 	}
 }
 
+//------------------------------------------------
+// Snapshot a histogram's bucket counts - callers
+// take deltas between snapshots.
+//
+void
+histogram_get_counts(histogram *h, uint64_t counts[N_BUCKETS])
+{
+	for (int i = 0; i < N_BUCKETS; i++) {
+		counts[i] = cf_atomic64_get(h->counts[i]);
+	}
+}
+
 //------------------------------------------------
 // Dump a histogram to log.
 //
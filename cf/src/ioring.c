@@ -0,0 +1,717 @@
+/*
+ * ioring.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Positional device I/O which may be completed asynchronously.
+ */
+
+
+//==========================================================
+// Includes
+//
+
+#include "ioring.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_atomic.h>
+#include <citrusleaf/cf_queue.h>
+
+#include "fault.h"
+
+#ifdef USE_IO_URING
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+
+//==========================================================
+// Constants & Typedefs
+//
+
+typedef enum {
+	IO_OP_READ,
+	IO_OP_WRITEV
+} io_opcode;
+
+// Must be in-sync with cf_ioring_type:
+static const char* IORING_TYPE_STRINGS[] = {
+	"sync",
+	"threads",
+	"io_uring"
+};
+
+struct cf_ioring_s {
+	cf_ioring_type		type;
+	uint32_t			depth;
+	cf_atomic32			in_flight;
+
+	// CF_IORING_THREADS
+	cf_queue*			op_q;
+	uint32_t			n_threads;
+	pthread_t			threads[CF_IORING_MAX_THREADS];
+
+#ifdef USE_IO_URING
+	// CF_IORING_URING
+	int					ring_fd;
+	pthread_mutex_t		sq_lock;
+	pthread_cond_t		sq_cond;
+	pthread_t			reaper;
+
+	void*				sq_ptr;
+	size_t				sq_map_sz;
+	void*				cq_ptr;
+	size_t				cq_map_sz;
+	struct io_uring_sqe* sqes;
+	size_t				sqes_map_sz;
+
+	uint32_t*			sq_tail;
+	uint32_t*			sq_mask;
+	uint32_t*			sq_array;
+	uint32_t*			cq_head;
+	uint32_t*			cq_tail;
+	uint32_t*			cq_mask;
+	struct io_uring_cqe* cqes;
+#endif
+};
+
+
+//==========================================================
+// Forward Declarations
+//
+
+static void op_init(cf_ioring_op* op, io_opcode opcode, int fd,
+		void* buf, size_t size, const struct iovec* iov, int iovcnt,
+		off_t offset);
+static void op_submit(cf_ioring* ring, cf_ioring_op* op);
+static void op_execute(cf_ioring_op* op);
+static void op_complete(cf_ioring_op* op, ssize_t result, int err);
+static bool threads_create(cf_ioring* ring, uint32_t n_threads);
+static void threads_destroy(cf_ioring* ring);
+static void* run_ioring_worker(void* udata);
+
+#ifdef USE_IO_URING
+static bool uring_create(cf_ioring* ring, uint32_t depth);
+static void uring_destroy(cf_ioring* ring);
+static void uring_submit(cf_ioring* ring, cf_ioring_op* op, bool nop);
+static void* run_ioring_reaper(void* udata);
+#endif
+
+
+//==========================================================
+// Public API
+//
+
+//------------------------------------------------
+// Create an I/O ring. If the requested type is
+// unavailable, fall back to worker threads.
+//
+cf_ioring*
+cf_ioring_create(cf_ioring_type type, uint32_t depth, uint32_t n_threads)
+{
+	if (type >= CF_IORING_NUM_TYPES) {
+		cf_warning(CF_IORING, "bad ioring type %d", type);
+		return NULL;
+	}
+
+	if (depth == 0) {
+		depth = CF_IORING_DEFAULT_DEPTH;
+	}
+	else if (depth > CF_IORING_MAX_DEPTH) {
+		depth = CF_IORING_MAX_DEPTH;
+	}
+
+	if (n_threads == 0) {
+		n_threads = 1;
+	}
+	else if (n_threads > CF_IORING_MAX_THREADS) {
+		n_threads = CF_IORING_MAX_THREADS;
+	}
+
+	cf_ioring* ring = cf_malloc(sizeof(cf_ioring));
+
+	if (! ring) {
+		return NULL;
+	}
+
+	memset(ring, 0, sizeof(cf_ioring));
+
+	ring->type = type;
+	ring->depth = depth;
+
+	if (type == CF_IORING_URING) {
+#ifdef USE_IO_URING
+		if (uring_create(ring, depth)) {
+			return ring;
+		}
+
+		cf_warning(CF_IORING, "io_uring setup failed - using threads");
+#else
+		cf_warning(CF_IORING, "built without io_uring support - using threads");
+#endif
+		ring->type = CF_IORING_THREADS;
+	}
+
+	if (ring->type == CF_IORING_THREADS && ! threads_create(ring, n_threads)) {
+		cf_free(ring);
+		return NULL;
+	}
+
+	return ring;
+}
+
+//------------------------------------------------
+// Destroy an I/O ring. Caller must ensure nothing
+// is in flight.
+//
+void
+cf_ioring_destroy(cf_ioring* ring)
+{
+	switch (ring->type) {
+	case CF_IORING_THREADS:
+		threads_destroy(ring);
+		break;
+#ifdef USE_IO_URING
+	case CF_IORING_URING:
+		uring_destroy(ring);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	cf_free(ring);
+}
+
+//------------------------------------------------
+// Type actually in use.
+//
+cf_ioring_type
+cf_ioring_get_type(const cf_ioring* ring)
+{
+	return ring->type;
+}
+
+//------------------------------------------------
+// Convert cf_ioring_type to config string.
+//
+const char*
+cf_ioring_type_str(cf_ioring_type type)
+{
+	return type < CF_IORING_NUM_TYPES ? IORING_TYPE_STRINGS[type] : "illegal";
+}
+
+//------------------------------------------------
+// Start a read. Does not block unless the ring is
+// full (or of type sync, in which case the read is
+// done before returning).
+//
+void
+cf_ioring_read_submit(cf_ioring* ring, cf_ioring_op* op, int fd, void* buf,
+		size_t size, off_t offset)
+{
+	op_init(op, IO_OP_READ, fd, buf, size, NULL, 0, offset);
+	op_submit(ring, op);
+}
+
+//------------------------------------------------
+// Start a vectored write. Blocking behavior is as
+// for cf_ioring_read_submit().
+//
+void
+cf_ioring_writev_submit(cf_ioring* ring, cf_ioring_op* op, int fd,
+		const struct iovec* iov, int iovcnt, off_t offset)
+{
+	op_init(op, IO_OP_WRITEV, fd, NULL, 0, iov, iovcnt, offset);
+	op_submit(ring, op);
+}
+
+//------------------------------------------------
+// Wait for a submitted operation to complete and
+// release its resources. Returns bytes read, or -1
+// with errno set.
+//
+ssize_t
+cf_ioring_wait(cf_ioring_op* op)
+{
+	pthread_mutex_lock(&op->lock);
+
+	while (! op->done) {
+		pthread_cond_wait(&op->cond, &op->lock);
+	}
+
+	pthread_mutex_unlock(&op->lock);
+
+	pthread_cond_destroy(&op->cond);
+	pthread_mutex_destroy(&op->lock);
+
+	if (op->result < 0) {
+		errno = op->err;
+	}
+
+	return op->result;
+}
+
+//------------------------------------------------
+// Read and wait. Sync type bypasses the op.
+//
+ssize_t
+cf_ioring_read(cf_ioring* ring, int fd, void* buf, size_t size, off_t offset)
+{
+	if (ring->type == CF_IORING_SYNC) {
+		return pread(fd, buf, size, offset);
+	}
+
+	cf_ioring_op op;
+
+	cf_ioring_read_submit(ring, &op, fd, buf, size, offset);
+
+	return cf_ioring_wait(&op);
+}
+
+//------------------------------------------------
+// Vectored write and wait. Sync type bypasses the
+// op.
+//
+ssize_t
+cf_ioring_writev(cf_ioring* ring, int fd, const struct iovec* iov, int iovcnt,
+		off_t offset)
+{
+	if (ring->type == CF_IORING_SYNC) {
+		return pwritev(fd, iov, iovcnt, offset);
+	}
+
+	cf_ioring_op op;
+
+	cf_ioring_writev_submit(ring, &op, fd, iov, iovcnt, offset);
+
+	return cf_ioring_wait(&op);
+}
+
+//------------------------------------------------
+// Number of operations submitted but not yet
+// completed.
+//
+uint32_t
+cf_ioring_in_flight(const cf_ioring* ring)
+{
+	return cf_atomic32_get(ring->in_flight);
+}
+
+
+//==========================================================
+// Local Helpers - operations
+//
+
+static void
+op_init(cf_ioring_op* op, io_opcode opcode, int fd, void* buf,
+		size_t size, const struct iovec* iov, int iovcnt, off_t offset)
+{
+	op->opcode = (int)opcode;
+	op->fd = fd;
+	op->buf = buf;
+	op->size = size;
+	op->iov = iov;
+	op->iovcnt = iovcnt;
+	op->offset = offset;
+
+	pthread_mutex_init(&op->lock, NULL);
+	pthread_cond_init(&op->cond, NULL);
+	op->done = false;
+	op->result = 0;
+	op->err = 0;
+}
+
+static void
+op_submit(cf_ioring* ring, cf_ioring_op* op)
+{
+	switch (ring->type) {
+	case CF_IORING_THREADS:
+		cf_atomic32_incr(&ring->in_flight);
+		cf_queue_push(ring->op_q, &op);
+		break;
+#ifdef USE_IO_URING
+	case CF_IORING_URING:
+		uring_submit(ring, op, false);
+		break;
+#endif
+	default:
+		op_execute(op);
+		break;
+	}
+}
+
+// Do the I/O in the current thread.
+static void
+op_execute(cf_ioring_op* op)
+{
+	ssize_t rv = op->opcode == IO_OP_WRITEV ?
+			pwritev(op->fd, op->iov, op->iovcnt, op->offset) :
+			pread(op->fd, op->buf, op->size, op->offset);
+
+	op_complete(op, rv, rv < 0 ? errno : 0);
+}
+
+// Note - op may be destroyed by its waiter as soon as the lock is released.
+static void
+op_complete(cf_ioring_op* op, ssize_t result, int err)
+{
+	pthread_mutex_lock(&op->lock);
+
+	op->result = result;
+	op->err = err;
+	op->done = true;
+
+	pthread_cond_signal(&op->cond);
+	pthread_mutex_unlock(&op->lock);
+}
+
+
+//==========================================================
+// Local Helpers - worker threads
+//
+
+static bool
+threads_create(cf_ioring* ring, uint32_t n_threads)
+{
+	ring->op_q = cf_queue_create(sizeof(cf_ioring_op*), true);
+
+	if (! ring->op_q) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < n_threads; i++) {
+		if (pthread_create(&ring->threads[i], NULL, run_ioring_worker,
+				(void*)ring) != 0) {
+			cf_crash(CF_IORING, "failed to create ioring worker thread");
+		}
+	}
+
+	ring->n_threads = n_threads;
+
+	return true;
+}
+
+static void
+threads_destroy(cf_ioring* ring)
+{
+	// A null op tells a worker to exit.
+	cf_ioring_op* null_op = NULL;
+
+	for (uint32_t i = 0; i < ring->n_threads; i++) {
+		cf_queue_push(ring->op_q, &null_op);
+	}
+
+	for (uint32_t i = 0; i < ring->n_threads; i++) {
+		pthread_join(ring->threads[i], NULL);
+	}
+
+	cf_queue_destroy(ring->op_q);
+}
+
+static void*
+run_ioring_worker(void* udata)
+{
+	cf_ioring* ring = (cf_ioring*)udata;
+	cf_ioring_op* op;
+
+	while (cf_queue_pop(ring->op_q, &op, CF_QUEUE_FOREVER) == CF_QUEUE_OK) {
+		if (! op) {
+			break;
+		}
+
+		op_execute(op);
+
+		// Don't touch op after it's complete - its waiter may have freed it.
+		cf_atomic32_decr(&ring->in_flight);
+	}
+
+	return NULL;
+}
+
+
+#ifdef USE_IO_URING
+
+//==========================================================
+// Local Helpers - io_uring
+//
+// We drive the kernel interface directly rather than link liburing. Reads
+// use IORING_OP_READ, so kernel 5.6 or later is required - on older kernels
+// setup still succeeds but reads complete with -EINVAL, so we probe first.
+// Writes use IORING_OP_WRITEV (kernel 5.1).
+//
+
+static inline int
+sys_io_uring_setup(uint32_t entries, struct io_uring_params* p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int
+sys_io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete,
+		uint32_t flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			flags, NULL, 0);
+}
+
+static bool
+uring_create(cf_ioring* ring, uint32_t depth)
+{
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+
+	int fd = sys_io_uring_setup(depth, &p);
+
+	if (fd < 0) {
+		cf_warning(CF_IORING, "io_uring_setup failed: errno %d (%s)", errno,
+				cf_strerror(errno));
+		return false;
+	}
+
+	ring->sq_map_sz = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	ring->cq_map_sz = p.cq_off.cqes +
+			p.cq_entries * sizeof(struct io_uring_cqe);
+
+	bool single_map = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+	if (single_map && ring->cq_map_sz > ring->sq_map_sz) {
+		ring->sq_map_sz = ring->cq_map_sz;
+	}
+
+	ring->sq_ptr = mmap(NULL, ring->sq_map_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+	if (ring->sq_ptr == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	if (single_map) {
+		ring->cq_ptr = ring->sq_ptr;
+	}
+	else {
+		ring->cq_ptr = mmap(NULL, ring->cq_map_sz, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+		if (ring->cq_ptr == MAP_FAILED) {
+			munmap(ring->sq_ptr, ring->sq_map_sz);
+			close(fd);
+			return false;
+		}
+	}
+
+	ring->sqes_map_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_map_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+	if (ring->sqes == MAP_FAILED) {
+		if (! single_map) {
+			munmap(ring->cq_ptr, ring->cq_map_sz);
+		}
+
+		munmap(ring->sq_ptr, ring->sq_map_sz);
+		close(fd);
+		return false;
+	}
+
+	uint8_t* sq = (uint8_t*)ring->sq_ptr;
+	uint8_t* cq = (uint8_t*)ring->cq_ptr;
+
+	ring->sq_tail = (uint32_t*)(sq + p.sq_off.tail);
+	ring->sq_mask = (uint32_t*)(sq + p.sq_off.ring_mask);
+	ring->sq_array = (uint32_t*)(sq + p.sq_off.array);
+	ring->cq_head = (uint32_t*)(cq + p.cq_off.head);
+	ring->cq_tail = (uint32_t*)(cq + p.cq_off.tail);
+	ring->cq_mask = (uint32_t*)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+	ring->ring_fd = fd;
+
+	// Kernel may round entries up - never have more in flight than the SQ
+	// holds, so the (twice as big) CQ can't overflow.
+	if (ring->depth > p.sq_entries) {
+		ring->depth = p.sq_entries;
+	}
+
+	pthread_mutex_init(&ring->sq_lock, NULL);
+	pthread_cond_init(&ring->sq_cond, NULL);
+
+	if (pthread_create(&ring->reaper, NULL, run_ioring_reaper,
+			(void*)ring) != 0) {
+		cf_crash(CF_IORING, "failed to create ioring reaper thread");
+	}
+
+	// Probe for IORING_OP_READ support with a zero-length read.
+	int probe_fd = open("/dev/null", O_RDONLY);
+
+	if (probe_fd < 0) {
+		uring_destroy(ring);
+		return false;
+	}
+
+	cf_ioring_op op;
+	uint8_t probe_buf[1];
+
+	op_init(&op, IO_OP_READ, probe_fd, probe_buf, 0, NULL, 0, 0);
+	uring_submit(ring, &op, false);
+
+	ssize_t probe_rv = cf_ioring_wait(&op);
+
+	close(probe_fd);
+
+	if (probe_rv < 0) {
+		cf_warning(CF_IORING, "kernel does not support io_uring reads");
+		uring_destroy(ring);
+		return false;
+	}
+
+	return true;
+}
+
+static void
+uring_destroy(cf_ioring* ring)
+{
+	// A no-op with null user data tells the reaper to exit.
+	uring_submit(ring, NULL, true);
+	pthread_join(ring->reaper, NULL);
+
+	munmap(ring->sqes, ring->sqes_map_sz);
+
+	if (ring->cq_ptr != ring->sq_ptr) {
+		munmap(ring->cq_ptr, ring->cq_map_sz);
+	}
+
+	munmap(ring->sq_ptr, ring->sq_map_sz);
+	close(ring->ring_fd);
+
+	pthread_cond_destroy(&ring->sq_cond);
+	pthread_mutex_destroy(&ring->sq_lock);
+}
+
+static void
+uring_submit(cf_ioring* ring, cf_ioring_op* op, bool nop)
+{
+	pthread_mutex_lock(&ring->sq_lock);
+
+	while (! nop && cf_atomic32_get(ring->in_flight) >= ring->depth) {
+		pthread_cond_wait(&ring->sq_cond, &ring->sq_lock);
+	}
+
+	uint32_t tail = *ring->sq_tail;
+	uint32_t index = tail & *ring->sq_mask;
+	struct io_uring_sqe* sqe = &ring->sqes[index];
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+	sqe->user_data = (uint64_t)op;
+
+	if (nop) {
+		sqe->opcode = IORING_OP_NOP;
+	}
+	else {
+		if (op->opcode == IO_OP_WRITEV) {
+			sqe->opcode = IORING_OP_WRITEV;
+			sqe->addr = (uint64_t)op->iov;
+			sqe->len = (uint32_t)op->iovcnt;
+		}
+		else {
+			sqe->opcode = IORING_OP_READ;
+			sqe->addr = (uint64_t)op->buf;
+			sqe->len = (uint32_t)op->size;
+		}
+
+		sqe->fd = op->fd;
+		sqe->off = (uint64_t)op->offset;
+
+		cf_atomic32_incr(&ring->in_flight);
+	}
+
+	ring->sq_array[index] = index;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	int rv;
+
+	while ((rv = sys_io_uring_enter(ring->ring_fd, 1, 0, 0)) < 0 &&
+			(errno == EINTR || errno == EAGAIN)) {
+		;
+	}
+
+	pthread_mutex_unlock(&ring->sq_lock);
+
+	if (rv != 1) {
+		cf_crash(CF_IORING, "io_uring_enter failed: errno %d (%s)", errno,
+				cf_strerror(errno));
+	}
+}
+
+static void*
+run_ioring_reaper(void* udata)
+{
+	cf_ioring* ring = (cf_ioring*)udata;
+
+	while (true) {
+		uint32_t head = *ring->cq_head;
+
+		if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+			if (sys_io_uring_enter(ring->ring_fd, 0, 1,
+					IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+				cf_crash(CF_IORING, "io_uring_enter failed: errno %d (%s)",
+						errno, cf_strerror(errno));
+			}
+
+			continue;
+		}
+
+		struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+		cf_ioring_op* op = (cf_ioring_op*)cqe->user_data;
+		int32_t res = cqe->res;
+
+		__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+		if (! op) {
+			break;
+		}
+
+		pthread_mutex_lock(&ring->sq_lock);
+		cf_atomic32_decr(&ring->in_flight);
+		pthread_cond_signal(&ring->sq_cond);
+		pthread_mutex_unlock(&ring->sq_lock);
+
+		op_complete(op, res < 0 ? -1 : (ssize_t)res, res < 0 ? -res : 0);
+	}
+
+	return NULL;
+}
+
+#endif // USE_IO_URING
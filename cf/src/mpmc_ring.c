@@ -0,0 +1,178 @@
+/*
+ * mpmc_ring.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "mpmc_ring.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "citrusleaf/alloc.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Each slot is a sequence number followed by the element.
+typedef struct ring_slot_s {
+	volatile uint64_t	seq;
+	uint8_t				ele[];
+} ring_slot;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static inline ring_slot* ring_slot_at(cf_mpmc_ring* ring, uint64_t pos);
+
+
+//==========================================================
+// Public API.
+//
+
+// n_slots must be a power of 2.
+bool
+cf_mpmc_ring_init(cf_mpmc_ring* ring, uint32_t ele_size, uint32_t n_slots)
+{
+	if (ele_size == 0 || n_slots == 0 || (n_slots & (n_slots - 1)) != 0) {
+		return false;
+	}
+
+	memset(ring, 0, sizeof(cf_mpmc_ring));
+
+	ring->ele_size = ele_size;
+	ring->slot_size = (sizeof(ring_slot) + ele_size + 7) & ~7;
+	ring->mask = n_slots - 1;
+
+	if (! (ring->slots = cf_malloc((size_t)ring->slot_size * n_slots))) {
+		return false;
+	}
+
+	// Slot i is free for the producer whose position is i.
+	for (uint64_t i = 0; i < n_slots; i++) {
+		ring_slot_at(ring, i)->seq = i;
+	}
+
+	return true;
+}
+
+void
+cf_mpmc_ring_destroy(cf_mpmc_ring* ring)
+{
+	cf_free(ring->slots);
+	ring->slots = NULL;
+}
+
+// Returns false if the ring is full.
+bool
+cf_mpmc_ring_push(cf_mpmc_ring* ring, const void* ele)
+{
+	uint64_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	ring_slot* slot;
+
+	while (true) {
+		slot = ring_slot_at(ring, pos);
+
+		int64_t diff = (int64_t)__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) -
+				(int64_t)pos;
+
+		if (diff == 0) {
+			// Slot is free on this lap - claim it.
+			if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+			// else - pos was reloaded by the failed CAS.
+		}
+		else if (diff < 0) {
+			// Slot still holds an element from the previous lap - full.
+			return false;
+		}
+		else {
+			// Another producer got here first.
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	memcpy(slot->ele, ele, ring->ele_size);
+
+	// Publish to consumers.
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+// Returns false if the ring is empty.
+bool
+cf_mpmc_ring_pop(cf_mpmc_ring* ring, void* ele)
+{
+	uint64_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	ring_slot* slot;
+
+	while (true) {
+		slot = ring_slot_at(ring, pos);
+
+		int64_t diff = (int64_t)__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) -
+				(int64_t)(pos + 1);
+
+		if (diff == 0) {
+			// Slot is full on this lap - claim it.
+			if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+			// else - pos was reloaded by the failed CAS.
+		}
+		else if (diff < 0) {
+			// Producer hasn't filled this slot yet - empty.
+			return false;
+		}
+		else {
+			// Another consumer got here first.
+			pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	memcpy(ele, slot->ele, ring->ele_size);
+
+	// Free the slot for the producer on the next lap.
+	__atomic_store_n(&slot->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static inline ring_slot*
+ring_slot_at(cf_mpmc_ring* ring, uint64_t pos)
+{
+	return (ring_slot*)(ring->slots + ((pos & ring->mask) * ring->slot_size));
+}
@@ -64,6 +64,7 @@ static int64_t g_max_msgs_per_type = -1;
 static size_t msg_get_wire_field_size(const msg_field *mf);
 static uint32_t msg_stamp_field(uint8_t *buf, const msg_field *mf);
 static void msg_field_save(msg *m, msg_field *mf);
+static void msg_release_rc_buf(msg *m);
 static msg_str_array *msg_str_array_create(int n_strs, int total_len);
 static int msg_str_array_set(msg_str_array *str_a, int idx, const char *v);
 static msg_buf_array *msg_buf_array_create(int n_bufs, int buf_len);
@@ -140,6 +141,7 @@ msg_create(msg **m_r, msg_type type, const msg_template *mt, size_t mt_sz,
 	m->just_parsed = false;
 	m->type = type;
 	m->mt = mt;
+	m->rc_buf = NULL;
 
 	for (int i = 0; i < max_id; i++) {
 		m->f[i].is_valid = false;
@@ -178,6 +180,7 @@ msg_destroy(msg *m)
 			}
 		}
 
+		msg_release_rc_buf(m);
 		msg_put(m);
 	}
 }
@@ -293,6 +296,9 @@ msg_parse(msg *m, const uint8_t *buf, const size_t buflen)
 
 	buf += 2;
 
+	// Any previously reserved buffer is no longer the one fields point into.
+	msg_release_rc_buf(m);
+
 	const uint8_t *eob = buf + len;
 
 	while (buf < eob) {
@@ -362,6 +368,23 @@ msg_parse(msg *m, const uint8_t *buf, const size_t buflen)
 }
 
 
+// Like msg_parse(), but buf lies in rc_buf, a cf_rc_alloc()'d buffer. The msg
+// keeps a reservation on rc_buf until it's reset or destroyed, so preserving
+// fields doesn't need to copy them.
+int
+msg_parse_rc(msg *m, const uint8_t *buf, const size_t buflen, void *rc_buf)
+{
+	int rv = msg_parse(m, buf, buflen);
+
+	if (rv == 0) {
+		cf_rc_reserve(rc_buf);
+		m->rc_buf = rc_buf;
+	}
+
+	return rv;
+}
+
+
 int
 msg_get_initial(uint32_t *size_r, msg_type *type_r, const uint8_t *buf,
 		uint32_t buflen)
@@ -391,6 +414,8 @@ msg_reset(msg *m)
 	m->bytes_used = (m->n_fields * sizeof(msg_field)) + sizeof(msg);
 	m->just_parsed = false;
 
+	msg_release_rc_buf(m);
+
 	for (uint32_t i = 0; i < m->n_fields; i++) {
 		msg_field *mf = &m->f[i];
 
@@ -429,7 +454,7 @@ msg_preserve_fields(msg *m, uint32_t n_field_ids, ...)
 
 		if (mf->is_valid && mf->is_set) {
 			if (reflect[i]) {
-				if (m->just_parsed) {
+				if (m->just_parsed && ! m->rc_buf) {
 					msg_field_save(m, mf);
 				}
 			}
@@ -450,6 +475,12 @@ msg_preserve_all_fields(msg *m)
 		return;
 	}
 
+	// Fields point into a buffer we hold a reservation on - nothing to copy.
+	if (m->rc_buf) {
+		m->just_parsed = false;
+		return;
+	}
+
 	for (uint32_t i = 0; i < m->n_fields; i++) {
 		msg_field *mf = &m->f[i];
 
@@ -1277,6 +1308,16 @@ msg_field_save(msg *m, msg_field *mf)
 }
 
 
+static void
+msg_release_rc_buf(msg *m)
+{
+	if (m->rc_buf) {
+		cf_rc_releaseandfree(m->rc_buf);
+		m->rc_buf = NULL;
+	}
+}
+
+
 static msg_str_array *
 msg_str_array_create(int n_strs, int total_len)
 {
@@ -32,26 +32,86 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
+#include <citrusleaf/cf_atomic.h>
+#include <citrusleaf/cf_clock.h>
 #include <citrusleaf/cf_digest.h>
 #include <citrusleaf/alloc.h>
 
+#include "hist.h"
+
 
 // an interesting detail: since this digest is used to choose among
 // servers, you must use different bits to choose which OLOCK
+//
+// Bytes 2 and 3 alone only cover 64K locks - fold in bytes 4 and 5 so bigger
+// tables are fully used. For tables of 64K locks or fewer the mapping is the
+// same as it always was.
 
 //
 // ASSUMES d is DIGEST and ol is OLOCK *
 //
 
-#define OLOCK_HASH(__ol, __d) ( ( (__d->digest[2] << 8) | (__d->digest[3]) ) & __ol->mask )
+#define OLOCK_HASH(__ol, __d) ( ( \
+		((uint32_t)__d->digest[5] << 24) | \
+		((uint32_t)__d->digest[4] << 16) | \
+		((uint32_t)__d->digest[2] << 8) | \
+		((uint32_t)__d->digest[3]) ) & __ol->mask )
+
+// How many times an adaptive lock polls before parking in the kernel. Record
+// lock hold times are short (no storage I/O under most of them), so a brief
+// spin usually wins the lock without a futex round trip.
+#define OLOCK_SPIN_TRIES 100
+
+static inline void
+olock_cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__asm__ __volatile__ ("pause" ::: "memory");
+#elif defined(__aarch64__)
+	__asm__ __volatile__ ("yield" ::: "memory");
+#endif
+}
+
+static inline void
+olock_acquire(olock *ol, pthread_mutex_t *lock)
+{
+	// Uncontended case - no timing, no shared counters.
+	if (pthread_mutex_trylock(lock) == 0) {
+		return;
+	}
+
+	uint64_t start_ns = cf_getns();
+
+	if (ol->type == OLOCK_TYPE_ADAPTIVE) {
+		for (int i = 0; i < OLOCK_SPIN_TRIES; i++) {
+			olock_cpu_relax();
+
+			if (pthread_mutex_trylock(lock) == 0) {
+				goto Acquired;
+			}
+		}
+	}
+
+	if (0 != pthread_mutex_lock(lock)) {
+		fprintf(stderr, "olock lock failed\n");
+	}
+
+Acquired:
+	cf_atomic64_incr(&ol->n_contended);
+
+	if (ol->wait_hist) {
+		histogram_insert_data_point(ol->wait_hist, start_ns);
+	}
+}
 
 void
 olock_lock(olock *ol, cf_digest *d)
 {
 	uint32_t n = OLOCK_HASH(ol, d);
 
-	pthread_mutex_lock(&ol->locks[n]);
+	olock_acquire(ol, &ol->locks[n].lock);
 }
 
 void
@@ -59,11 +119,9 @@ olock_vlock(olock *ol, cf_digest *d, pthread_mutex_t **vlock)
 {
 	uint32_t n = OLOCK_HASH(ol, d);
 
-	*vlock = &ol->locks[n];
+	*vlock = &ol->locks[n].lock;
 
-	if (0 != pthread_mutex_lock(*vlock)) {
-		fprintf(stderr, "olock vlock failed\n");
-	}
+	olock_acquire(ol, *vlock);
 }
 
 void
@@ -71,37 +129,37 @@ olock_unlock(olock *ol, cf_digest *d)
 {
 	uint32_t n = OLOCK_HASH(ol, d);
 
-	if (0 != pthread_mutex_unlock(&ol->locks[n])) {
+	if (0 != pthread_mutex_unlock(&ol->locks[n].lock)) {
 		fprintf(stderr, "olock unlock failed %d\n", errno);
 	}
 }
 
 olock *
-olock_create(uint32_t n_locks, bool mutex)
+olock_create(uint32_t n_locks, olock_type type, histogram *wait_hist)
 {
-	olock *ol = cf_malloc(sizeof(olock) + (sizeof(pthread_mutex_t) * n_locks));
+	uint32_t mask = n_locks - 1;
 
-	if (! ol) {
+	if (n_locks == 0 || (mask & n_locks) != 0) {
+		fprintf(stderr, "olock: make sure your number of locks is a power of 2, n_locks aint\n");
 		return 0;
 	}
 
-	uint32_t mask = n_locks - 1;
+	// Page-aligned, so every entry sits on its own cache line.
+	olock *ol = cf_valloc(sizeof(olock) + (sizeof(olock_entry) * n_locks));
 
-	if ((mask & n_locks) != 0) {
-		fprintf(stderr, "olock: make sure your number of locks is a power of 2, n_locks aint\n");
+	if (! ol) {
 		return 0;
 	}
 
+	memset(ol, 0, sizeof(olock));
+
 	ol->n_locks = n_locks;
 	ol->mask = mask;
+	ol->type = type;
+	ol->wait_hist = wait_hist;
 
-	for (int i = 0; i < n_locks; i++) {
-		if (mutex) {
-			pthread_mutex_init(&ol->locks[i], 0);
-		}
-		else {
-			fprintf(stderr, "olock: todo add reader writer locks\n");
-		}
+	for (uint32_t i = 0; i < n_locks; i++) {
+		pthread_mutex_init(&ol->locks[i].lock, 0);
 	}
 
 	return ol;
@@ -110,8 +168,8 @@ olock_create(uint32_t n_locks, bool mutex)
 void
 olock_destroy(olock *ol)
 {
-	for (int i = 0; i < ol->n_locks; i++) {
-		pthread_mutex_destroy(&ol->locks[i]);
+	for (uint32_t i = 0; i < ol->n_locks; i++) {
+		pthread_mutex_destroy(&ol->locks[i].lock);
 	}
 
 	cf_free(ol);
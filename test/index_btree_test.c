@@ -0,0 +1,567 @@
+/*
+ * index_btree_test.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Unit tests for the index B+tree - leaf and inner node splits, merging sparse
+ * leaves on delete, digest prefix ties, reduce_from, and random inserts and
+ * deletes checked against a reference.
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "citrusleaf/cf_digest.h"
+
+#include "arenax.h"
+
+#include "base/index.h"
+#include "base/index_btree.h"
+
+#include "test.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Must match BTREE_ORDER in index_btree.c.
+#define ORDER 32
+
+#define MAX_KEYS (100 * 1000)
+
+typedef struct collect_s {
+	cf_arenax_handle* handles;
+	uint32_t		n;
+	uint32_t		max; // stop the reduce after this many
+} collect;
+
+
+//==========================================================
+// Globals.
+//
+
+static cf_arenax* g_arena;
+static cf_arenax_handle g_handles[MAX_KEYS];
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void test_empty(void);
+static void test_leaf_split(void);
+static void test_inner_splits(void);
+static void test_prefix_ties(void);
+static void test_merge(void);
+static void test_reduce_from(void);
+static void test_random_vs_reference(void);
+
+static void make_keys(uint32_t n, bool tie_prefixes);
+static void free_keys(uint32_t n);
+static const cf_digest* key_of(cf_arenax_handle h);
+static int digest_cmp(const cf_digest* a, const cf_digest* b);
+static int key_cmp(const void* pa, const void* pb);
+static void shuffle(uint32_t* ixs, uint32_t n, uint64_t* state);
+static bool collect_cb(cf_arenax_handle h, void* udata);
+static bool check_ordered(as_btree* bt, uint32_t n_expected);
+static void delete_all(as_btree* bt, uint32_t n);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char* argv[])
+{
+	g_arena = malloc(cf_arenax_sizeof());
+
+	if (cf_arenax_create(g_arena, 0, sizeof(as_index), 1024 * 1024,
+			CF_ARENAX_MAX_STAGES, 0) != CF_ARENAX_OK) {
+		fprintf(stderr, "can't create arena\n");
+		return 1;
+	}
+
+	TEST_RUN(test_empty);
+	TEST_RUN(test_leaf_split);
+	TEST_RUN(test_inner_splits);
+	TEST_RUN(test_prefix_ties);
+	TEST_RUN(test_merge);
+	TEST_RUN(test_reduce_from);
+	TEST_RUN(test_random_vs_reference);
+
+	return test_result();
+}
+
+
+//==========================================================
+// Test cases.
+//
+
+static void
+test_empty(void)
+{
+	as_btree bt;
+	cf_digest keyd;
+	cf_arenax_handle h;
+
+	memset(&keyd, 0x5a, sizeof(keyd));
+	as_btree_init(&bt);
+
+	TEST_CHECK(as_btree_search(&bt, g_arena, &keyd, &h) == -1);
+	TEST_CHECK(as_btree_delete(&bt, g_arena, &keyd, &h) == -1);
+	TEST_CHECK(as_btree_size(&bt) == 0);
+	TEST_CHECK(check_ordered(&bt, 0));
+
+	collect c = { .max = 1 };
+
+	as_btree_reduce_from(&bt, g_arena, &keyd, collect_cb, &c);
+	TEST_CHECK(c.n == 0);
+
+	as_btree_destroy(&bt);
+}
+
+static void
+test_leaf_split(void)
+{
+	as_btree bt;
+	cf_arenax_handle h;
+
+	make_keys(ORDER + 1, false);
+	as_btree_init(&bt);
+
+	for (uint32_t i = 0; i < ORDER; i++) {
+		as_btree_insert(&bt, g_arena, g_handles[i]);
+	}
+
+	uint64_t leaf_sz = as_btree_size(&bt);
+
+	TEST_CHECK(leaf_sz != 0);
+	TEST_CHECK(check_ordered(&bt, ORDER));
+
+	// One more - the full root leaf splits under a new inner root.
+	as_btree_insert(&bt, g_arena, g_handles[ORDER]);
+
+	TEST_CHECK(as_btree_size(&bt) > 2 * leaf_sz);
+	TEST_CHECK(check_ordered(&bt, ORDER + 1));
+
+	for (uint32_t i = 0; i <= ORDER; i++) {
+		TEST_CHECK(as_btree_search(&bt, g_arena, key_of(g_handles[i]), &h) == 0
+				&& h == g_handles[i]);
+	}
+
+	// Emptying the tree frees every node.
+	delete_all(&bt, ORDER + 1);
+	TEST_CHECK(bt.root == NULL);
+	TEST_CHECK(as_btree_size(&bt) == 0);
+
+	as_btree_destroy(&bt);
+	free_keys(ORDER + 1);
+}
+
+static void
+test_inner_splits(void)
+{
+	as_btree bt;
+	cf_arenax_handle h;
+	uint32_t n = MAX_KEYS; // enough leaves to split inner nodes too
+
+	make_keys(n, false);
+	as_btree_init(&bt);
+
+	for (uint32_t i = 0; i < n; i++) {
+		as_btree_insert(&bt, g_arena, g_handles[i]);
+	}
+
+	TEST_CHECK(check_ordered(&bt, n));
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (as_btree_search(&bt, g_arena, key_of(g_handles[i]), &h) != 0 ||
+				h != g_handles[i]) {
+			TEST_CHECK(false);
+			break;
+		}
+	}
+
+	cf_digest absent = *key_of(g_handles[0]);
+
+	absent.digest[0] ^= 0xFF;
+	TEST_CHECK(as_btree_search(&bt, g_arena, &absent, &h) == -1);
+	TEST_CHECK(as_btree_delete(&bt, g_arena, &absent, &h) == -1);
+
+	delete_all(&bt, n);
+	TEST_CHECK(bt.root == NULL);
+
+	as_btree_destroy(&bt);
+	free_keys(n);
+}
+
+static void
+test_prefix_ties(void)
+{
+	as_btree bt;
+	cf_arenax_handle h;
+	uint32_t n = 4 * ORDER; // ties span several leaves
+
+	make_keys(n, true);
+	as_btree_init(&bt);
+
+	for (uint32_t i = 0; i < n; i++) {
+		as_btree_insert(&bt, g_arena, g_handles[i]);
+	}
+
+	TEST_CHECK(check_ordered(&bt, n));
+
+	for (uint32_t i = 0; i < n; i++) {
+		TEST_CHECK(as_btree_search(&bt, g_arena, key_of(g_handles[i]), &h) == 0
+				&& h == g_handles[i]);
+	}
+
+	for (uint32_t i = 0; i < n; i += 2) {
+		TEST_CHECK(as_btree_delete(&bt, g_arena, key_of(g_handles[i]), &h) == 0
+				&& h == g_handles[i]);
+	}
+
+	for (uint32_t i = 0; i < n; i++) {
+		TEST_CHECK(as_btree_search(&bt, g_arena, key_of(g_handles[i]), &h) ==
+				(i % 2 == 0 ? -1 : 0));
+	}
+
+	TEST_CHECK(check_ordered(&bt, n / 2));
+
+	as_btree_destroy(&bt);
+	free_keys(n);
+}
+
+static void
+test_merge(void)
+{
+	as_btree bt;
+	cf_arenax_handle h;
+	uint32_t n = 10 * 1000;
+	uint32_t* ixs = malloc(n * sizeof(uint32_t));
+	uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+	make_keys(n, false);
+	as_btree_init(&bt);
+
+	for (uint32_t i = 0; i < n; i++) {
+		as_btree_insert(&bt, g_arena, g_handles[i]);
+		ixs[i] = i;
+	}
+
+	uint64_t full_sz = as_btree_size(&bt);
+
+	// Delete 95% in random order. Left unmerged, most leaves would keep a key
+	// or two and the tree would stay near its full size.
+	shuffle(ixs, n, &state);
+
+	uint32_t n_keep = n / 20;
+
+	for (uint32_t i = n_keep; i < n; i++) {
+		TEST_CHECK(as_btree_delete(&bt, g_arena, key_of(g_handles[ixs[i]]),
+				&h) == 0);
+	}
+
+	TEST_CHECK(as_btree_size(&bt) < full_sz / 4);
+	TEST_CHECK(check_ordered(&bt, n_keep));
+
+	for (uint32_t i = 0; i < n_keep; i++) {
+		TEST_CHECK(as_btree_search(&bt, g_arena, key_of(g_handles[ixs[i]]),
+				&h) == 0 && h == g_handles[ixs[i]]);
+	}
+
+	// Refill after merging - merged leaves split again.
+	for (uint32_t i = n_keep; i < n; i++) {
+		as_btree_insert(&bt, g_arena, g_handles[ixs[i]]);
+	}
+
+	TEST_CHECK(check_ordered(&bt, n));
+
+	delete_all(&bt, n);
+	TEST_CHECK(bt.root == NULL);
+
+	as_btree_destroy(&bt);
+	free_keys(n);
+	free(ixs);
+}
+
+static void
+test_reduce_from(void)
+{
+	as_btree bt;
+	uint32_t n = 1000;
+	cf_arenax_handle* sorted = malloc(n * sizeof(cf_arenax_handle));
+	cf_arenax_handle* got = malloc(n * sizeof(cf_arenax_handle));
+
+	make_keys(n, false);
+	as_btree_init(&bt);
+
+	for (uint32_t i = 0; i < n; i++) {
+		as_btree_insert(&bt, g_arena, g_handles[i]);
+	}
+
+	memcpy(sorted, g_handles, n * sizeof(cf_arenax_handle));
+	qsort(sorted, n, sizeof(cf_arenax_handle), key_cmp);
+
+	// From each key in the tree - visits exactly the keys after it.
+	for (uint32_t i = 0; i < n; i++) {
+		collect c = { .handles = got, .max = n };
+
+		as_btree_reduce_from(&bt, g_arena, key_of(sorted[i]), collect_cb, &c);
+
+		if (c.n != n - i - 1 || memcmp(got, &sorted[i + 1],
+				c.n * sizeof(cf_arenax_handle)) != 0) {
+			TEST_CHECK(false);
+			break;
+		}
+	}
+
+	// From keys not in the tree - visits the keys after where they'd be.
+	for (uint32_t i = 0; i < n; i += 100) {
+		cf_digest keyd = *key_of(sorted[i]);
+		cf_arenax_handle h;
+
+		keyd.digest[CF_DIGEST_KEY_SZ - 1] ^= 0x01;
+
+		if (as_btree_search(&bt, g_arena, &keyd, &h) == 0) {
+			continue;
+		}
+
+		uint32_t first = 0;
+
+		while (first < n && digest_cmp(key_of(sorted[first]), &keyd) < 0) {
+			first++;
+		}
+
+		collect c = { .handles = got, .max = n };
+
+		as_btree_reduce_from(&bt, g_arena, &keyd, collect_cb, &c);
+
+		TEST_CHECK(c.n == n - first && memcmp(got, &sorted[first],
+				c.n * sizeof(cf_arenax_handle)) == 0);
+	}
+
+	// Stopping early.
+	collect c = { .handles = got, .max = 10 };
+	as_btree_reduce_from(&bt, g_arena, key_of(sorted[0]), collect_cb, &c);
+
+	TEST_CHECK(c.n == 10);
+	TEST_CHECK(memcmp(got, &sorted[1], 10 * sizeof(cf_arenax_handle)) == 0);
+
+	as_btree_destroy(&bt);
+	free_keys(n);
+	free(sorted);
+	free(got);
+}
+
+static void
+test_random_vs_reference(void)
+{
+	as_btree bt;
+	cf_arenax_handle h;
+	uint32_t n = 5000;
+	bool* in_tree = calloc(n, sizeof(bool));
+	uint32_t n_in_tree = 0;
+	uint64_t state = 0x2545F4914F6CDD1DULL;
+
+	make_keys(n, false);
+	as_btree_init(&bt);
+
+	for (uint32_t op = 0; op < 200 * 1000; op++) {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+
+		uint32_t i = (uint32_t)((state * 0x2545F4914F6CDD1DULL) >> 32) % n;
+
+		if (in_tree[i]) {
+			TEST_REQUIRE(as_btree_delete(&bt, g_arena, key_of(g_handles[i]),
+					&h) == 0 && h == g_handles[i]);
+			in_tree[i] = false;
+			n_in_tree--;
+		}
+		else {
+			TEST_REQUIRE(as_btree_search(&bt, g_arena, key_of(g_handles[i]),
+					&h) == -1);
+			as_btree_insert(&bt, g_arena, g_handles[i]);
+			in_tree[i] = true;
+			n_in_tree++;
+		}
+
+		if (op % 10000 == 0) {
+			TEST_REQUIRE(check_ordered(&bt, n_in_tree));
+		}
+	}
+
+	for (uint32_t i = 0; i < n; i++) {
+		TEST_CHECK((as_btree_search(&bt, g_arena, key_of(g_handles[i]), &h) ==
+				0) == in_tree[i]);
+	}
+
+	as_btree_destroy(&bt);
+	free_keys(n);
+	free(in_tree);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+// Fill g_handles with n elements holding distinct pseudo-random digests. With
+// tie_prefixes, all share the 8 bytes the B+tree orders by first.
+static void
+make_keys(uint32_t n, bool tie_prefixes)
+{
+	uint64_t state = 0x9E3779B97F4A7C15ULL * n;
+
+	for (uint32_t i = 0; i < n; i++) {
+		cf_arenax_handle h = cf_arenax_alloc(g_arena);
+		as_index* r = cf_arenax_resolve(g_arena, h);
+
+		memset(r, 0, sizeof(as_index));
+
+		for (uint32_t b = 0; b < CF_DIGEST_KEY_SZ; b++) {
+			state ^= state >> 12;
+			state ^= state << 25;
+			state ^= state >> 27;
+			r->key.digest[b] = (uint8_t)((state * 0x2545F4914F6CDD1DULL) >> 56);
+		}
+
+		// Make sure the keys are distinct.
+		memcpy(&r->key.digest[0], &i, sizeof(i));
+
+		if (tie_prefixes) {
+			memset(&r->key.digest[12], 0x77, 8);
+		}
+
+		g_handles[i] = h;
+	}
+}
+
+static void
+free_keys(uint32_t n)
+{
+	for (uint32_t i = 0; i < n; i++) {
+		cf_arenax_free(g_arena, g_handles[i]);
+	}
+}
+
+static const cf_digest*
+key_of(cf_arenax_handle h)
+{
+	return &((as_index*)cf_arenax_resolve(g_arena, h))->key;
+}
+
+// The B+tree's order - digest bytes 12-19 as a native integer, then the whole
+// digest.
+static int
+digest_cmp(const cf_digest* a, const cf_digest* b)
+{
+	uint64_t prefix_a;
+	uint64_t prefix_b;
+
+	memcpy(&prefix_a, &a->digest[12], sizeof(prefix_a));
+	memcpy(&prefix_b, &b->digest[12], sizeof(prefix_b));
+
+	if (prefix_a != prefix_b) {
+		return prefix_a < prefix_b ? -1 : 1;
+	}
+
+	return memcmp(a, b, sizeof(cf_digest));
+}
+
+// Sorts handles by their elements' digests.
+static int
+key_cmp(const void* pa, const void* pb)
+{
+	return digest_cmp(key_of(*(const cf_arenax_handle*)pa),
+			key_of(*(const cf_arenax_handle*)pb));
+}
+
+static void
+shuffle(uint32_t* ixs, uint32_t n, uint64_t* state)
+{
+	for (uint32_t i = n - 1; i > 0; i--) {
+		*state ^= *state >> 12;
+		*state ^= *state << 25;
+		*state ^= *state >> 27;
+
+		uint32_t j = (uint32_t)((*state * 0x2545F4914F6CDD1DULL) >> 32) %
+				(i + 1);
+		uint32_t t = ixs[i];
+
+		ixs[i] = ixs[j];
+		ixs[j] = t;
+	}
+}
+
+static bool
+collect_cb(cf_arenax_handle h, void* udata)
+{
+	collect* c = (collect*)udata;
+
+	if (c->handles) {
+		c->handles[c->n] = h;
+	}
+
+	return ++c->n < c->max;
+}
+
+// Reduce visits n_expected elements, in strictly increasing order.
+static bool
+check_ordered(as_btree* bt, uint32_t n_expected)
+{
+	cf_arenax_handle* handles = malloc((n_expected + 1) *
+			sizeof(cf_arenax_handle));
+	collect c = { .handles = handles, .max = n_expected + 1 };
+
+	as_btree_reduce(bt, collect_cb, &c);
+
+	bool ok = c.n == n_expected;
+
+	for (uint32_t i = 1; ok && i < c.n; i++) {
+		ok = key_cmp(&handles[i - 1], &handles[i]) < 0;
+	}
+
+	free(handles);
+
+	return ok;
+}
+
+static void
+delete_all(as_btree* bt, uint32_t n)
+{
+	cf_arenax_handle h;
+
+	for (uint32_t i = 0; i < n; i++) {
+		TEST_CHECK(as_btree_delete(bt, g_arena, key_of(g_handles[i]), &h) == 0
+				&& h == g_handles[i]);
+	}
+}
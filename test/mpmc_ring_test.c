@@ -0,0 +1,343 @@
+/*
+ * mpmc_ring_test.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Unit tests for cf_mpmc_ring - full and empty rings, wrap-around, odd element
+ * sizes, and concurrent producers and consumers.
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mpmc_ring.h"
+
+#include "test.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define N_PRODUCERS 4
+#define N_CONSUMERS 4
+#define N_PER_PRODUCER (256 * 1024)
+#define N_TOTAL ((uint64_t)N_PRODUCERS * N_PER_PRODUCER)
+
+typedef struct producer_s {
+	pthread_t	thread;
+	cf_mpmc_ring* ring;
+	uint64_t	id;
+} producer;
+
+typedef struct consumer_s {
+	pthread_t	thread;
+	cf_mpmc_ring* ring;
+	uint64_t	n_popped;
+	uint64_t	n_out_of_order;
+} consumer;
+
+
+//==========================================================
+// Globals.
+//
+
+static uint8_t* g_seen; // one flag per element pushed in concurrent test
+static uint64_t g_n_popped = 0;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void test_init_rejects_bad_sizes(void);
+static void test_empty(void);
+static void test_full(void);
+static void test_wrap_around(void);
+static void test_odd_element_size(void);
+static void test_concurrent(void);
+static void* run_producer(void* udata);
+static void* run_consumer(void* udata);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char* argv[])
+{
+	TEST_RUN(test_init_rejects_bad_sizes);
+	TEST_RUN(test_empty);
+	TEST_RUN(test_full);
+	TEST_RUN(test_wrap_around);
+	TEST_RUN(test_odd_element_size);
+	TEST_RUN(test_concurrent);
+
+	return test_result();
+}
+
+
+//==========================================================
+// Test cases.
+//
+
+static void
+test_init_rejects_bad_sizes(void)
+{
+	cf_mpmc_ring ring;
+
+	TEST_CHECK(! cf_mpmc_ring_init(&ring, 0, 16));
+	TEST_CHECK(! cf_mpmc_ring_init(&ring, 8, 0));
+	TEST_CHECK(! cf_mpmc_ring_init(&ring, 8, 12));
+
+	TEST_REQUIRE(cf_mpmc_ring_init(&ring, 8, 1));
+	cf_mpmc_ring_destroy(&ring);
+}
+
+static void
+test_empty(void)
+{
+	cf_mpmc_ring ring;
+	uint64_t v = 0;
+
+	TEST_REQUIRE(cf_mpmc_ring_init(&ring, sizeof(v), 8));
+
+	TEST_CHECK(cf_mpmc_ring_sz(&ring) == 0);
+	TEST_CHECK(! cf_mpmc_ring_pop(&ring, &v));
+
+	// Empty again after a push and pop.
+	v = 7;
+	TEST_CHECK(cf_mpmc_ring_push(&ring, &v));
+	TEST_CHECK(cf_mpmc_ring_pop(&ring, &v) && v == 7);
+	TEST_CHECK(! cf_mpmc_ring_pop(&ring, &v));
+	TEST_CHECK(cf_mpmc_ring_sz(&ring) == 0);
+
+	cf_mpmc_ring_destroy(&ring);
+}
+
+static void
+test_full(void)
+{
+	cf_mpmc_ring ring;
+
+	TEST_REQUIRE(cf_mpmc_ring_init(&ring, sizeof(uint64_t), 8));
+
+	for (uint64_t i = 0; i < 8; i++) {
+		TEST_CHECK(cf_mpmc_ring_push(&ring, &i));
+	}
+
+	uint64_t v = 100;
+
+	TEST_CHECK(cf_mpmc_ring_sz(&ring) == 8);
+	TEST_CHECK(! cf_mpmc_ring_push(&ring, &v));
+
+	// One pop makes room for exactly one push.
+	TEST_CHECK(cf_mpmc_ring_pop(&ring, &v) && v == 0);
+	v = 8;
+	TEST_CHECK(cf_mpmc_ring_push(&ring, &v));
+	TEST_CHECK(! cf_mpmc_ring_push(&ring, &v));
+
+	for (uint64_t i = 1; i <= 8; i++) {
+		TEST_CHECK(cf_mpmc_ring_pop(&ring, &v) && v == i);
+	}
+
+	TEST_CHECK(! cf_mpmc_ring_pop(&ring, &v));
+
+	cf_mpmc_ring_destroy(&ring);
+}
+
+static void
+test_wrap_around(void)
+{
+	cf_mpmc_ring ring;
+
+	TEST_REQUIRE(cf_mpmc_ring_init(&ring, sizeof(uint64_t), 4));
+
+	// Many laps, with the ring part full so head and tail wrap at different
+	// slots.
+	uint64_t next_push = 0;
+	uint64_t next_pop = 0;
+
+	for (uint32_t lap = 0; lap < 1000; lap++) {
+		while (cf_mpmc_ring_sz(&ring) < 3) {
+			TEST_REQUIRE(cf_mpmc_ring_push(&ring, &next_push));
+			next_push++;
+		}
+
+		uint64_t v;
+
+		for (uint32_t i = 0; i < 2; i++) {
+			TEST_REQUIRE(cf_mpmc_ring_pop(&ring, &v));
+			TEST_CHECK(v == next_pop);
+			next_pop++;
+		}
+	}
+
+	uint64_t v;
+
+	while (cf_mpmc_ring_pop(&ring, &v)) {
+		TEST_CHECK(v == next_pop);
+		next_pop++;
+	}
+
+	TEST_CHECK(next_pop == next_push);
+
+	cf_mpmc_ring_destroy(&ring);
+}
+
+static void
+test_odd_element_size(void)
+{
+	cf_mpmc_ring ring;
+	uint8_t in[13];
+	uint8_t out[13];
+
+	TEST_REQUIRE(cf_mpmc_ring_init(&ring, sizeof(in), 4));
+
+	for (uint32_t n = 0; n < 10; n++) {
+		memset(in, (int)n, sizeof(in));
+		TEST_REQUIRE(cf_mpmc_ring_push(&ring, in));
+
+		memset(out, 0xFF, sizeof(out));
+		TEST_REQUIRE(cf_mpmc_ring_pop(&ring, out));
+		TEST_CHECK(memcmp(in, out, sizeof(in)) == 0);
+	}
+
+	cf_mpmc_ring_destroy(&ring);
+}
+
+static void
+test_concurrent(void)
+{
+	cf_mpmc_ring ring;
+
+	// Small ring, so producers and consumers keep finding it full and empty.
+	TEST_REQUIRE(cf_mpmc_ring_init(&ring, sizeof(uint64_t), 64));
+	TEST_REQUIRE((g_seen = calloc(N_TOTAL, 1)) != NULL);
+
+	producer producers[N_PRODUCERS];
+	consumer consumers[N_CONSUMERS];
+
+	for (uint32_t i = 0; i < N_CONSUMERS; i++) {
+		consumers[i] = (consumer){ .ring = &ring };
+		pthread_create(&consumers[i].thread, NULL, run_consumer, &consumers[i]);
+	}
+
+	for (uint32_t i = 0; i < N_PRODUCERS; i++) {
+		producers[i] = (producer){ .ring = &ring, .id = i };
+		pthread_create(&producers[i].thread, NULL, run_producer, &producers[i]);
+	}
+
+	for (uint32_t i = 0; i < N_PRODUCERS; i++) {
+		pthread_join(producers[i].thread, NULL);
+	}
+
+	uint64_t n_popped = 0;
+
+	for (uint32_t i = 0; i < N_CONSUMERS; i++) {
+		pthread_join(consumers[i].thread, NULL);
+		n_popped += consumers[i].n_popped;
+
+		// Each consumer sees each producer's elements in push order.
+		TEST_CHECK(consumers[i].n_out_of_order == 0);
+	}
+
+	TEST_CHECK(n_popped == N_TOTAL);
+
+	uint64_t n_missing = 0;
+	uint64_t n_duplicated = 0;
+
+	for (uint64_t i = 0; i < N_TOTAL; i++) {
+		n_missing += g_seen[i] == 0;
+		n_duplicated += g_seen[i] > 1;
+	}
+
+	TEST_CHECK(n_missing == 0);
+	TEST_CHECK(n_duplicated == 0);
+	TEST_CHECK(cf_mpmc_ring_sz(&ring) == 0);
+
+	free(g_seen);
+	cf_mpmc_ring_destroy(&ring);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static void*
+run_producer(void* udata)
+{
+	producer* p = (producer*)udata;
+
+	for (uint64_t seq = 0; seq < N_PER_PRODUCER; seq++) {
+		uint64_t v = (p->id << 32) | seq;
+
+		while (! cf_mpmc_ring_push(p->ring, &v)) {
+			sched_yield(); // full - let consumers make room
+		}
+	}
+
+	return NULL;
+}
+
+static void*
+run_consumer(void* udata)
+{
+	consumer* c = (consumer*)udata;
+	uint64_t last_seq[N_PRODUCERS];
+
+	memset(last_seq, 0xFF, sizeof(last_seq));
+
+	while (__atomic_load_n(&g_n_popped, __ATOMIC_RELAXED) < N_TOTAL) {
+		uint64_t v;
+
+		if (! cf_mpmc_ring_pop(c->ring, &v)) {
+			sched_yield(); // empty - let producers fill it
+			continue;
+		}
+
+		__atomic_add_fetch(&g_n_popped, 1, __ATOMIC_RELAXED);
+
+		uint64_t id = v >> 32;
+		uint64_t seq = v & 0xFFFFFFFF;
+
+		if (last_seq[id] != UINT64_MAX && seq <= last_seq[id]) {
+			c->n_out_of_order++;
+		}
+
+		last_seq[id] = seq;
+		__atomic_add_fetch(&g_seen[(id * N_PER_PRODUCER) + seq], 1,
+				__ATOMIC_RELAXED);
+		c->n_popped++;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,89 @@
+/*
+ * test.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Minimal unit test harness - each test file is its own program, runs its
+ * cases in order, and exits non-zero if any check failed.
+ */
+
+#pragma once
+
+//==========================================================
+// Includes.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+//==========================================================
+// Globals.
+//
+
+static uint32_t g_test_n_failed = 0;
+
+
+//==========================================================
+// Public API.
+//
+
+// Check a condition - on failure, report it and carry on with the case.
+#define TEST_CHECK(_cond) \
+	do { \
+		if (! (_cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+					#_cond); \
+			g_test_n_failed++; \
+		} \
+	} while (false)
+
+// Check a condition - on failure, report it and abandon the case.
+#define TEST_REQUIRE(_cond) \
+	do { \
+		if (! (_cond)) { \
+			fprintf(stderr, "%s:%d: requirement failed: %s\n", __FILE__, \
+					__LINE__, #_cond); \
+			g_test_n_failed++; \
+			return; \
+		} \
+	} while (false)
+
+#define TEST_RUN(_fn) \
+	do { \
+		uint32_t n_failed_before = g_test_n_failed; \
+		_fn(); \
+		printf("%-40s %s\n", #_fn, \
+				g_test_n_failed == n_failed_before ? "ok" : "FAILED"); \
+	} while (false)
+
+// Return from main().
+static inline int
+test_result(void)
+{
+	if (g_test_n_failed != 0) {
+		printf("%u checks failed\n", g_test_n_failed);
+		return 1;
+	}
+
+	return 0;
+}